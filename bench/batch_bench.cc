@@ -0,0 +1,126 @@
+// Cross-instance batching versus per-instance calls. Runs N stereo
+// instances of soft_clip.expr, each with its own parameters, on 64-frame
+// blocks: once calling process() per instance as the host would, once
+// through the plugin's Batcher (one process_wide() call per host cycle,
+// transposes included).
+//
+// Usage: batch_bench [instances] [blocks]   (run from the repository root)
+
+#include <llvm/Support/Error.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../jit/JIT.h"
+#include "../plugin/batcher.h"
+
+float g_params[16] = {};
+
+namespace {
+
+constexpr uint32_t kFrames = 64;
+constexpr uint32_t kChannels = 2;
+
+using ProcessFn = void(const float *const *, float *const *, uint32_t,
+                       uint32_t);
+using WideFn = void(const float *, float *, const float *, const float *,
+                    uint32_t, uint32_t);
+
+template <typename FnT>
+bool lookup(clap_rt::ClapJIT &jit, const char *name, FnT *&out) {
+  auto FnOrErr = jit.lookupAs<FnT>(name);
+  if (!FnOrErr) {
+    llvm::errs() << llvm::toString(FnOrErr.takeError()) << "\n";
+    return false;
+  }
+  out = *FnOrErr;
+  return true;
+}
+
+struct Instance {
+  float params[16] = {};
+  std::vector<float> in[kChannels], out[kChannels];
+  int lane = -1;
+};
+
+// Nanoseconds per sample of running every instance for `blocks` cycles
+template <typename RunFn>
+double time_ns(std::vector<Instance> &instances, int blocks, RunFn run) {
+  auto cycle = [&] {
+    for (auto &inst : instances)
+      run(inst);
+  };
+  for (int b = 0; b < 16; ++b)
+    cycle();
+
+  auto start = std::chrono::steady_clock::now();
+  for (int b = 0; b < blocks; ++b)
+    cycle();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         (static_cast<double>(blocks) * instances.size() * kFrames * kChannels);
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? std::clamp(std::atoi(argv[1]), 1, 32) : 16;
+  int blocks = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20000;
+
+  clap_rt::ClapJIT::initializeLLVM();
+  auto JITOrErr = clap_rt::ClapJIT::create();
+  if (!JITOrErr) {
+    llvm::errs() << llvm::toString(JITOrErr.takeError()) << "\n";
+    return 1;
+  }
+  auto JIT = std::move(*JITOrErr);
+  if (auto Err = JIT.defineSymbol("g_params", g_params)) {
+    llvm::errs() << llvm::toString(std::move(Err)) << "\n";
+    return 1;
+  }
+  if (auto Err = JIT.addModule("bench/soft_clip.expr")) {
+    llvm::errs() << llvm::toString(std::move(Err)) << "\n";
+    return 1;
+  }
+  ProcessFn *process = nullptr;
+  WideFn *wide = nullptr;
+  if (!lookup(JIT, "process", process) || !lookup(JIT, "process_wide", wide))
+    return 1;
+
+  dsp::Batcher batcher(kFrames);
+  std::vector<Instance> instances(count);
+  for (int i = 0; i < count; ++i) {
+    auto &inst = instances[i];
+    inst.params[0] = static_cast<float>(i) / count;
+    inst.params[1] = 0.5f;
+    for (uint32_t ch = 0; ch < kChannels; ++ch) {
+      inst.in[ch].resize(kFrames);
+      inst.out[ch].resize(kFrames);
+      for (uint32_t t = 0; t < kFrames; ++t)
+        inst.in[ch][t] = std::sin(0.05f * t + ch + i);
+    }
+    inst.lane = batcher.join(kChannels);
+  }
+
+  double single = time_ns(instances, blocks, [&](Instance &inst) {
+    std::copy(inst.params, inst.params + 16, g_params);
+    const float *in[kChannels] = {inst.in[0].data(), inst.in[1].data()};
+    float *out[kChannels] = {inst.out[0].data(), inst.out[1].data()};
+    process(in, out, kChannels, kFrames);
+  });
+
+  double batched = time_ns(instances, blocks, [&](Instance &inst) {
+    const float *in[kChannels] = {inst.in[0].data(), inst.in[1].data()};
+    float *out[kChannels] = {inst.out[0].data(), inst.out[1].data()};
+    batcher.process(wide, inst.lane, in, out, kChannels, kFrames, inst.params);
+  });
+
+  std::printf("%d instances, %u-frame blocks\n", count, kFrames);
+  std::printf("per-instance %7.3f ns/sample\n", single);
+  std::printf("batched      %7.3f ns/sample  %5.2fx\n", batched, single / batched);
+  return 0;
+}
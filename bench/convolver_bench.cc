@@ -0,0 +1,49 @@
+// CPU cost of the partitioned convolver versus IR length, processing
+// 64-sample blocks with 64-sample partitions at 48 kHz.
+//
+// Usage: convolver_bench [seconds of audio per IR length]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../plugin/convolver.h"
+
+int main(int argc, char **argv) {
+  const double sample_rate = 48000.0;
+  const uint32_t block = 64;
+  double seconds = argc > 1 ? std::atof(argv[1]) : 10.0;
+  if (seconds <= 0.0)
+    seconds = 10.0;
+
+  std::vector<float> in(block), out(block);
+  for (uint32_t i = 0; i < block; ++i)
+    in[i] = std::sin(static_cast<float>(i) * 0.1f);
+
+  std::printf("%10s %10s %14s %12s\n", "IR (s)", "taps", "ns/sample",
+              "% realtime");
+  for (double ir_seconds : {0.1, 0.25, 0.5, 1.0, 2.0, 4.0, 8.0}) {
+    uint32_t taps = static_cast<uint32_t>(ir_seconds * sample_rate);
+    std::vector<float> ir(taps);
+    for (uint32_t i = 0; i < taps; ++i)
+      ir[i] = std::exp(-6.0f * i / taps) * ((i * 2654435761u) >> 31 ? 1.0f : -1.0f);
+
+    rtclap_convolver *conv = rtclap_conv_create(ir.data(), taps, block);
+    const uint64_t blocks = static_cast<uint64_t>(seconds * sample_rate / block);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t b = 0; b < blocks; ++b)
+      rtclap_conv_process(conv, in.data(), out.data(), block);
+    auto end = std::chrono::steady_clock::now();
+    rtclap_conv_destroy(conv);
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    double per_sample = ns / (static_cast<double>(blocks) * block);
+    double realtime = 100.0 * ns / (seconds * 1e9);
+    std::printf("%10.2f %10u %14.2f %11.2f%%\n", ir_seconds, taps, per_sample,
+                realtime);
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+// Measures how long a DSP reload takes: create a JIT, add the source, look up
+// process and run one block. Compares an .expr file against the equivalent
+// C++ file, both with the object cache disabled, and shows what the C++
+// reload costs when the toolchain probe and driver run again each time.
+//
+// Usage: reload_latency [iterations]   (run from the repository root)
+
+#include <llvm/Support/Error.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../jit/JIT.h"
+
+float g_params[16] = {0.5f, 0.5f};
+
+namespace {
+
+using ProcessFn = void(const float *const *, float *const *, uint32_t,
+                       uint32_t);
+
+bool reload(const char *path) {
+  auto JITOrErr = clap_rt::ClapJIT::create();
+  if (!JITOrErr) {
+    llvm::errs() << llvm::toString(JITOrErr.takeError()) << "\n";
+    return false;
+  }
+  auto JIT = std::move(*JITOrErr);
+
+  if (auto Err = JIT.defineSymbol("g_params", g_params)) {
+    llvm::errs() << llvm::toString(std::move(Err)) << "\n";
+    return false;
+  }
+  if (auto Err = JIT.addModule(path)) {
+    llvm::errs() << llvm::toString(std::move(Err)) << "\n";
+    return false;
+  }
+  auto ProcessOrErr = JIT.lookupAs<ProcessFn>("process");
+  if (!ProcessOrErr) {
+    llvm::errs() << llvm::toString(ProcessOrErr.takeError()) << "\n";
+    return false;
+  }
+
+  // Materialization is lazy, so include one call in the measurement
+  float in[64] = {0.25f}, out[64];
+  const float *in_ptr = in;
+  float *out_ptr = out;
+  (*ProcessOrErr)(&in_ptr, &out_ptr, 1, 64);
+  return true;
+}
+
+void run(const char *label, const char *path, int iterations,
+         bool fresh_driver = false) {
+  // The first reload probes the toolchain and runs the driver
+  if (!fresh_driver && !reload(path))
+    return;
+
+  std::vector<double> ms;
+  for (int i = 0; i < iterations; ++i) {
+    if (fresh_driver)
+      clap_rt::ClapJIT::resetToolchain();
+    auto start = std::chrono::steady_clock::now();
+    if (!reload(path))
+      return;
+    auto end = std::chrono::steady_clock::now();
+    ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  std::sort(ms.begin(), ms.end());
+  std::printf("%-32s min %8.3f ms  median %8.3f ms  max %8.3f ms\n", label,
+              ms.front(), ms[ms.size() / 2], ms.back());
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+
+  clap_rt::ClapJIT::initializeLLVM();
+
+  run("bench/soft_clip.expr", "bench/soft_clip.expr", iterations);
+  run("bench/soft_clip.cc", "bench/soft_clip.cc", iterations);
+  run("bench/soft_clip.cc, fresh driver", "bench/soft_clip.cc", iterations,
+      true);
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Compares the lib/rtclap runtime against the naive DSP patterns used in the
+// examples. Both kernel files are JIT-compiled with -O3, as a DSP file with
+// "// rtclap: -O3" would be, and timed on stereo 256-frame blocks.
+//
+// Usage: runtime_bench [blocks]   (run from the repository root)
+
+#include <llvm/Support/Error.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+
+#include "../jit/JIT.h"
+
+namespace {
+
+constexpr unsigned kFrames = 256;
+constexpr unsigned kChannels = 2;
+
+using UnaryFn = void(float *, unsigned int);
+using SmoothFn = void(float *, unsigned int, float);
+using MultiFn = void(float *const *, unsigned int, unsigned int);
+
+struct Kernels {
+  std::unique_ptr<clap_rt::ClapJIT> jit;
+  UnaryFn *tanh = nullptr;
+  SmoothFn *smooth = nullptr;
+  MultiFn *delay = nullptr;
+  MultiFn *biquad = nullptr;
+};
+
+template <typename FnT>
+bool lookup(clap_rt::ClapJIT &jit, const char *name, FnT *&out) {
+  auto FnOrErr = jit.lookupAs<FnT>(name);
+  if (!FnOrErr) {
+    llvm::errs() << llvm::toString(FnOrErr.takeError()) << "\n";
+    return false;
+  }
+  out = *FnOrErr;
+  return true;
+}
+
+bool load(const char *path, Kernels &k) {
+  clap_rt::JITOptions opts;
+  opts.includePaths.push_back("examples/lib");
+  auto JITOrErr = clap_rt::ClapJIT::create(opts);
+  if (!JITOrErr) {
+    llvm::errs() << llvm::toString(JITOrErr.takeError()) << "\n";
+    return false;
+  }
+  k.jit = std::make_unique<clap_rt::ClapJIT>(std::move(*JITOrErr));
+  if (auto Err = k.jit->addModule(path)) {
+    llvm::errs() << llvm::toString(std::move(Err)) << "\n";
+    return false;
+  }
+  return lookup(*k.jit, "bench_tanh", k.tanh) &&
+         lookup(*k.jit, "bench_smooth", k.smooth) &&
+         lookup(*k.jit, "bench_delay", k.delay) &&
+         lookup(*k.jit, "bench_biquad", k.biquad);
+}
+
+// Nanoseconds per sample of one kernel call on a stereo block. The block is
+// refilled before every call so in-place kernels never feed on themselves;
+// both sides pay for the copy.
+double time_ns(int blocks, const std::function<void(float *const *)> &kernel) {
+  static float source[kFrames], left[kFrames], right[kFrames];
+  float *bufs[kChannels] = {left, right};
+  for (unsigned i = 0; i < kFrames; ++i)
+    source[i] = static_cast<float>(i % 64) / 64.0f - 0.5f;
+
+  auto run = [&] {
+    std::copy(source, source + kFrames, left);
+    std::copy(source, source + kFrames, right);
+    kernel(bufs);
+  };
+
+  // Warm up: materialization and first-touch page faults
+  for (int b = 0; b < 16; ++b)
+    run();
+
+  auto start = std::chrono::steady_clock::now();
+  for (int b = 0; b < blocks; ++b)
+    run();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         (static_cast<double>(blocks) * kFrames * kChannels);
+}
+
+void report(const char *name, double naive, double fast) {
+  std::printf("%-8s naive %7.3f ns/sample  rtclap %7.3f ns/sample  %5.2fx\n",
+              name, naive, fast, naive / fast);
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  int blocks = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20000;
+
+  clap_rt::ClapJIT::initializeLLVM();
+
+  Kernels naive, fast;
+  if (!load("bench/runtime_naive.cc", naive) ||
+      !load("bench/runtime_fast.cc", fast))
+    return 1;
+
+  auto per_channel = [](UnaryFn *fn) {
+    return [fn](float *const *bufs) {
+      for (unsigned ch = 0; ch < kChannels; ++ch)
+        fn(bufs[ch], kFrames);
+    };
+  };
+  report("tanh", time_ns(blocks, per_channel(naive.tanh)),
+         time_ns(blocks, per_channel(fast.tanh)));
+
+  auto smooth = [](SmoothFn *fn) {
+    return [fn](float *const *bufs) {
+      for (unsigned ch = 0; ch < kChannels; ++ch)
+        fn(bufs[ch], kFrames, (ch & 1) ? 0.25f : 0.75f);
+    };
+  };
+  report("smooth", time_ns(blocks, smooth(naive.smooth)),
+         time_ns(blocks, smooth(fast.smooth)));
+
+  auto multi = [](MultiFn *fn) {
+    return [fn](float *const *bufs) { fn(bufs, kChannels, kFrames); };
+  };
+  report("delay", time_ns(blocks, multi(naive.delay)),
+         time_ns(blocks, multi(fast.delay)));
+  report("biquad", time_ns(blocks, multi(naive.biquad)),
+         time_ns(blocks, multi(fast.biquad)));
+  return 0;
+}
@@ -0,0 +1,54 @@
+// rtclap: -O3
+// Runtime benchmark: the same kernels on top of lib/rtclap
+
+#include "rtclap/rtclap.h"
+
+static rtclap::DelayLine<65536> delay_lines[2];
+static rtclap::Smoother smoother;
+static rtclap::BiquadCascade<2, 4> biquads;
+static bool ready = false;
+
+static void setup() {
+  smoother.set_time(2.0f, 48000.0);
+  for (unsigned int s = 0; s < 4; ++s)
+    biquads.set_stage(s, rtclap::BiquadCoeffs{0.2f, 0.4f, 0.2f, -0.3f, 0.1f});
+  ready = true;
+}
+
+void bench_tanh(float *buf, unsigned int n) {
+  for (unsigned int i = 0; i < n; ++i)
+    buf[i] = rtclap::fast_tanh(buf[i] * 4.0f);
+}
+
+void bench_smooth(float *buf, unsigned int n, float target) {
+  if (!ready)
+    setup();
+  smoother.apply(buf, n, target);
+}
+
+void bench_delay(float *const *bufs, unsigned int num_channels,
+                 unsigned int n) {
+  const unsigned int delay = 12000;
+  float wet[256];
+  for (unsigned int ch = 0; ch < num_channels; ++ch) {
+    for (unsigned int off = 0; off < n; off += 256) {
+      const unsigned int len = n - off < 256 ? n - off : 256;
+      float *io = bufs[ch] + off;
+      delay_lines[ch].read_block(wet, len, delay);
+      for (unsigned int i = 0; i < len; ++i) {
+        const float dry = io[i];
+        io[i] = dry + wet[i];
+        wet[i] = dry + wet[i] * 0.5f;
+      }
+      delay_lines[ch].write_block(wet, len);
+    }
+  }
+}
+
+void bench_biquad(float *const *bufs, unsigned int num_channels,
+                  unsigned int n) {
+  if (!ready)
+    setup();
+  if (num_channels == 2)
+    biquads.process(bufs, bufs, n);
+}
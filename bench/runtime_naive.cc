@@ -0,0 +1,66 @@
+// rtclap: -O3
+// Runtime benchmark: kernels written the way the examples do it
+
+#include <cmath>
+
+static constexpr unsigned int kDelaySize = 48000;
+static float delay_buffer[2][kDelaySize];
+static unsigned int delay_pos = 0;
+
+// Per-sample one-pole with global state, as in lib/utils.cc
+static float lowpass_state = 0.0f;
+
+static float lowpass(float input, float cutoff) {
+  lowpass_state = lowpass_state + cutoff * (input - lowpass_state);
+  return lowpass_state;
+}
+
+struct Biquad {
+  float b0 = 0.2f, b1 = 0.4f, b2 = 0.2f, a1 = -0.3f, a2 = 0.1f;
+  float z1 = 0.0f, z2 = 0.0f;
+
+  float process(float x) {
+    float y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    return y;
+  }
+};
+
+static Biquad biquads[2][4];
+
+void bench_tanh(float *buf, unsigned int n) {
+  for (unsigned int i = 0; i < n; ++i)
+    buf[i] = std::tanh(buf[i] * 4.0f);
+}
+
+void bench_smooth(float *buf, unsigned int n, float target) {
+  for (unsigned int i = 0; i < n; ++i)
+    buf[i] *= lowpass(target, 0.01f);
+}
+
+void bench_delay(float *const *bufs, unsigned int num_channels,
+                 unsigned int n) {
+  const unsigned int delay = 12000;
+  for (unsigned int i = 0; i < n; ++i) {
+    for (unsigned int ch = 0; ch < num_channels; ++ch) {
+      unsigned int read_pos = (delay_pos + kDelaySize - delay) % kDelaySize;
+      float wet = delay_buffer[ch][read_pos];
+      delay_buffer[ch][delay_pos] = bufs[ch][i] + wet * 0.5f;
+      bufs[ch][i] += wet;
+    }
+    delay_pos = (delay_pos + 1) % kDelaySize;
+  }
+}
+
+void bench_biquad(float *const *bufs, unsigned int num_channels,
+                  unsigned int n) {
+  for (unsigned int ch = 0; ch < num_channels; ++ch) {
+    for (unsigned int i = 0; i < n; ++i) {
+      float x = bufs[ch][i];
+      for (auto &stage : biquads[ch])
+        x = stage.process(x);
+      bufs[ch][i] = x;
+    }
+  }
+}
@@ -0,0 +1,28 @@
+// Reload benchmark: soft clipper, twin of soft_clip.expr
+
+extern float g_params[];
+
+int param_count() { return 2; }
+
+const char *param_name(int i) {
+  static const char *names[] = {"drive", "output"};
+  return (i < 2) ? names[i] : "?";
+}
+
+float param_min(int) { return 0.0f; }
+float param_max(int) { return 1.0f; }
+float param_default(int) { return 0.5f; }
+
+void process(const float *const *inputs, float *const *outputs,
+             unsigned int num_channels, unsigned int num_frames) {
+  const float drive = 1.0f + g_params[0] * 9.0f;
+  const float output = g_params[1];
+
+  for (unsigned int ch = 0; ch < num_channels; ++ch) {
+    for (unsigned int i = 0; i < num_frames; ++i) {
+      float x = inputs[ch][i] * drive;
+      float x2 = x * x;
+      outputs[ch][i] = x * (27.0f + x2) / (27.0f + 9.0f * x2) * output;
+    }
+  }
+}
@@ -0,0 +1,67 @@
+// Audio files provided by the plugin, decoded once and memory-mapped.
+//
+// Paths are relative to the DSP folder. Every instance opening the same
+// file shares one read-only mapping. List the files in asset_path() and
+// the plugin maps and faults them in on the compile thread, so opening
+// them in init() costs a table lookup:
+//
+//   const char *asset_path(int i) { return i == 0 ? "irs/hall.wav" : nullptr; }
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+// Planar samples: channel c starts at data + c * frames
+struct rtclap_asset {
+  const float *data;
+  uint64_t frames;
+  uint32_t channels;
+  double sample_rate;
+};
+
+// WAV (16/24/32-bit PCM, 32-bit float); returns nullptr on failure
+const rtclap_asset *rtclap_asset_open(const char *path);
+void rtclap_asset_close(const rtclap_asset *asset);
+}
+
+namespace rtclap {
+
+// Owning handle for an asset
+class Asset {
+public:
+  Asset() = default;
+  Asset(const Asset &) = delete;
+  Asset &operator=(const Asset &) = delete;
+  ~Asset() { close(); }
+
+  bool open(const char *path) {
+    close();
+    asset_ = rtclap_asset_open(path);
+    return asset_ != nullptr;
+  }
+
+  void close() {
+    if (asset_)
+      rtclap_asset_close(asset_);
+    asset_ = nullptr;
+  }
+
+  bool loaded() const { return asset_ != nullptr; }
+  uint64_t frames() const { return asset_ ? asset_->frames : 0; }
+  uint32_t channels() const { return asset_ ? asset_->channels : 0; }
+  double sample_rate() const { return asset_ ? asset_->sample_rate : 0.0; }
+
+  // Samples of channel ch; mono files return their only channel
+  const float *channel(uint32_t ch) const {
+    if (!asset_)
+      return nullptr;
+    if (ch >= asset_->channels)
+      ch = asset_->channels - 1;
+    return asset_->data + ch * asset_->frames;
+  }
+
+private:
+  const rtclap_asset *asset_ = nullptr;
+};
+
+} // namespace rtclap
@@ -0,0 +1,139 @@
+// Biquad filters in structure-of-arrays layout.
+//
+// A BiquadCascade holds Stages filters for Channels channels. Coefficients
+// and state are stored [stage][channel], so the innermost loop runs over
+// channels with identical work per lane and clang vectorizes it. The state
+// lives in locals during a block to keep it out of memory.
+#pragma once
+
+#include <cmath>
+
+namespace rtclap {
+
+// Normalized coefficients (a0 = 1), transposed direct form II
+struct BiquadCoeffs {
+  float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+};
+
+namespace biquad {
+
+inline constexpr double kTwoPiD = 6.283185307179586;
+
+// RBJ audio EQ cookbook designs, meant for init() or control rate
+
+inline BiquadCoeffs normalize(double b0, double b1, double b2, double a0,
+                              double a1, double a2) {
+  return {static_cast<float>(b0 / a0), static_cast<float>(b1 / a0),
+          static_cast<float>(b2 / a0), static_cast<float>(a1 / a0),
+          static_cast<float>(a2 / a0)};
+}
+
+inline BiquadCoeffs lowpass(double freq, double q, double sample_rate) {
+  const double w = kTwoPiD * freq / sample_rate;
+  const double cw = std::cos(w), alpha = std::sin(w) / (2.0 * q);
+  return normalize((1 - cw) / 2, 1 - cw, (1 - cw) / 2, 1 + alpha, -2 * cw,
+                   1 - alpha);
+}
+
+inline BiquadCoeffs highpass(double freq, double q, double sample_rate) {
+  const double w = kTwoPiD * freq / sample_rate;
+  const double cw = std::cos(w), alpha = std::sin(w) / (2.0 * q);
+  return normalize((1 + cw) / 2, -(1 + cw), (1 + cw) / 2, 1 + alpha, -2 * cw,
+                   1 - alpha);
+}
+
+inline BiquadCoeffs bandpass(double freq, double q, double sample_rate) {
+  const double w = kTwoPiD * freq / sample_rate;
+  const double cw = std::cos(w), alpha = std::sin(w) / (2.0 * q);
+  return normalize(alpha, 0, -alpha, 1 + alpha, -2 * cw, 1 - alpha);
+}
+
+inline BiquadCoeffs notch(double freq, double q, double sample_rate) {
+  const double w = kTwoPiD * freq / sample_rate;
+  const double cw = std::cos(w), alpha = std::sin(w) / (2.0 * q);
+  return normalize(1, -2 * cw, 1, 1 + alpha, -2 * cw, 1 - alpha);
+}
+
+inline BiquadCoeffs peak(double freq, double q, double gain_db,
+                         double sample_rate) {
+  const double w = kTwoPiD * freq / sample_rate;
+  const double cw = std::cos(w), alpha = std::sin(w) / (2.0 * q);
+  const double a = std::pow(10.0, gain_db / 40.0);
+  return normalize(1 + alpha * a, -2 * cw, 1 - alpha * a, 1 + alpha / a,
+                   -2 * cw, 1 - alpha / a);
+}
+
+} // namespace biquad
+
+template <unsigned Channels, unsigned Stages = 1>
+struct BiquadCascade {
+  alignas(32) float b0[Stages][Channels];
+  alignas(32) float b1[Stages][Channels];
+  alignas(32) float b2[Stages][Channels];
+  alignas(32) float a1[Stages][Channels];
+  alignas(32) float a2[Stages][Channels];
+  alignas(32) float z1[Stages][Channels] = {};
+  alignas(32) float z2[Stages][Channels] = {};
+
+  BiquadCascade() {
+    for (unsigned s = 0; s < Stages; ++s)
+      set_stage(s, BiquadCoeffs{});
+  }
+
+  // Same coefficients for every channel
+  void set_stage(unsigned stage, const BiquadCoeffs &c) {
+    for (unsigned ch = 0; ch < Channels; ++ch)
+      set_stage(stage, ch, c);
+  }
+
+  void set_stage(unsigned stage, unsigned ch, const BiquadCoeffs &c) {
+    b0[stage][ch] = c.b0;
+    b1[stage][ch] = c.b1;
+    b2[stage][ch] = c.b2;
+    a1[stage][ch] = c.a1;
+    a2[stage][ch] = c.a2;
+  }
+
+  void reset() {
+    for (unsigned s = 0; s < Stages; ++s) {
+      for (unsigned ch = 0; ch < Channels; ++ch)
+        z1[s][ch] = z2[s][ch] = 0.0f;
+    }
+  }
+
+  // Filters Channels channels in place or from in to out
+  void process(const float *const *in, float *const *out, unsigned frames) {
+    float s1[Stages][Channels], s2[Stages][Channels];
+    for (unsigned s = 0; s < Stages; ++s) {
+      for (unsigned ch = 0; ch < Channels; ++ch) {
+        s1[s][ch] = z1[s][ch];
+        s2[s][ch] = z2[s][ch];
+      }
+    }
+
+    for (unsigned i = 0; i < frames; ++i) {
+      float x[Channels];
+      for (unsigned ch = 0; ch < Channels; ++ch)
+        x[ch] = in[ch][i];
+      for (unsigned s = 0; s < Stages; ++s) {
+        for (unsigned ch = 0; ch < Channels; ++ch) {
+          const float y = b0[s][ch] * x[ch] + s1[s][ch];
+          s1[s][ch] = b1[s][ch] * x[ch] - a1[s][ch] * y + s2[s][ch];
+          s2[s][ch] = b2[s][ch] * x[ch] - a2[s][ch] * y;
+          x[ch] = y;
+        }
+      }
+      for (unsigned ch = 0; ch < Channels; ++ch)
+        out[ch][i] = x[ch];
+    }
+
+    for (unsigned s = 0; s < Stages; ++s) {
+      for (unsigned ch = 0; ch < Channels; ++ch) {
+        z1[s][ch] = s1[s][ch];
+        z2[s][ch] = s2[s][ch];
+      }
+    }
+  }
+};
+
+} // namespace rtclap
@@ -0,0 +1,56 @@
+// Partitioned FFT convolution provided by the plugin.
+//
+// Create convolvers in init() and destroy them in destroy(); process() is
+// real-time safe. Output is delayed by block_size samples. Instances built
+// from identical IR samples share one read-only copy of the IR spectra.
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+struct rtclap_convolver;
+
+// block_size must be a power of two; returns nullptr on invalid arguments
+rtclap_convolver *rtclap_conv_create(const float *ir, uint32_t length,
+                                     uint32_t block_size);
+void rtclap_conv_process(rtclap_convolver *conv, const float *in, float *out,
+                         uint32_t frames);
+uint32_t rtclap_conv_latency(const rtclap_convolver *conv);
+void rtclap_conv_reset(rtclap_convolver *conv);
+void rtclap_conv_destroy(rtclap_convolver *conv);
+}
+
+namespace rtclap {
+
+// Owning handle for one channel of convolution
+class Convolver {
+public:
+  Convolver() = default;
+  Convolver(const Convolver &) = delete;
+  Convolver &operator=(const Convolver &) = delete;
+  ~Convolver() { close(); }
+
+  bool load(const float *ir, uint32_t length, uint32_t block_size = 64) {
+    close();
+    conv_ = rtclap_conv_create(ir, length, block_size);
+    return conv_ != nullptr;
+  }
+
+  void close() {
+    if (conv_)
+      rtclap_conv_destroy(conv_);
+    conv_ = nullptr;
+  }
+
+  bool loaded() const { return conv_ != nullptr; }
+  uint32_t latency() const { return conv_ ? rtclap_conv_latency(conv_) : 0; }
+
+  void process(const float *in, float *out, uint32_t frames) {
+    rtclap_conv_process(conv_, in, out, frames);
+  }
+
+private:
+  rtclap_convolver *conv_ = nullptr;
+};
+
+} // namespace rtclap
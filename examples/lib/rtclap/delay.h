@@ -0,0 +1,61 @@
+// Power-of-two delay line. Indices wrap with a mask instead of a modulo,
+// and block reads/writes are split into at most two contiguous runs so
+// the copies vectorize.
+#pragma once
+
+namespace rtclap {
+
+template <unsigned Size>
+struct DelayLine {
+  static_assert(Size > 0 && (Size & (Size - 1)) == 0,
+                "DelayLine size must be a power of two");
+  static constexpr unsigned kMask = Size - 1;
+
+  alignas(64) float buffer[Size] = {};
+  unsigned pos = 0;  // next write index
+
+  void reset() {
+    for (unsigned i = 0; i < Size; ++i)
+      buffer[i] = 0.0f;
+    pos = 0;
+  }
+
+  // Sample written `delay` pushes ago (1 = the last one), delay in [1, Size]
+  float tap(unsigned delay) const { return buffer[(pos - delay) & kMask]; }
+
+  // Fractional delay with linear interpolation, delay in [1, Size - 1]
+  float tap_frac(float delay) const {
+    const unsigned d = static_cast<unsigned>(delay);
+    const float frac = delay - static_cast<float>(d);
+    const float a = buffer[(pos - d) & kMask];
+    const float b = buffer[(pos - d - 1) & kMask];
+    return a + frac * (b - a);
+  }
+
+  void push(float x) {
+    buffer[pos] = x;
+    pos = (pos + 1) & kMask;
+  }
+
+  // out[i] = tap(delay) as seen when frame i is pushed; needs delay >= n
+  // so the block never reads samples that are not written yet
+  void read_block(float *__restrict out, unsigned n, unsigned delay) const {
+    unsigned start = (pos - delay) & kMask;
+    unsigned first = n < Size - start ? n : Size - start;
+    for (unsigned i = 0; i < first; ++i)
+      out[i] = buffer[start + i];
+    for (unsigned i = first; i < n; ++i)
+      out[i] = buffer[i - first];
+  }
+
+  void write_block(const float *__restrict in, unsigned n) {
+    unsigned first = n < Size - pos ? n : Size - pos;
+    for (unsigned i = 0; i < first; ++i)
+      buffer[pos + i] = in[i];
+    for (unsigned i = first; i < n; ++i)
+      buffer[i - first] = in[i];
+    pos = (pos + n) & kMask;
+  }
+};
+
+} // namespace rtclap
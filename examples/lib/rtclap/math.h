@@ -0,0 +1,79 @@
+// Fast math approximations for DSP code.
+//
+// Every function is branch-free (selects only), so loops calling them
+// vectorize once inlined. Compile with -O2 or higher, e.g.
+// "// rtclap: -O3 -ffast-math", for clang to vectorize at all.
+#pragma once
+
+#include <cstdint>
+
+namespace rtclap {
+
+inline constexpr float kPi = 3.14159265358979f;
+inline constexpr float kTwoPi = 6.28318530717959f;
+
+inline float clampf(float x, float lo, float hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+inline float bits_to_float(uint32_t u) {
+  float f;
+  __builtin_memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+// tanh, Pade (7,6) approximant. Max absolute error ~1e-4 (near the ends);
+// the input is clamped to [-4.97, 4.97], just short of where the approximant
+// would overshoot +-1, so large inputs give +-0.9999994, not exactly +-1
+inline float fast_tanh(float x) {
+  x = clampf(x, -4.97f, 4.97f);
+  const float x2 = x * x;
+  const float num = x * (135135.0f + x2 * (17325.0f + x2 * (378.0f + x2)));
+  const float den = 135135.0f + x2 * (62370.0f + x2 * (3150.0f + x2 * 28.0f));
+  return num / den;
+}
+
+// 2^x for x in [-126, 126]. Relative error ~2e-7
+inline float fast_exp2(float x) {
+  x = clampf(x, -126.0f, 126.0f);
+  // Round to nearest without a libm call, leaving f in [-0.5, 0.5]
+  const int i = static_cast<int>(x + (x >= 0.0f ? 0.5f : -0.5f));
+  const float f = x - static_cast<float>(i);
+  // Taylor series of 2^f = e^(f ln 2)
+  const float p =
+      1.0f +
+      f * (0.69314718f +
+           f * (0.24022651f +
+                f * (0.05550411f +
+                     f * (0.00961813f + f * (0.00133336f + f * 0.00015404f)))));
+  return bits_to_float(static_cast<uint32_t>(i + 127) << 23) * p;
+}
+
+// e^x, via fast_exp2
+inline float fast_exp(float x) { return fast_exp2(x * 1.44269504f); }
+
+// sin, folded to [-pi/2, pi/2]. Absolute error ~1e-7 near zero, growing
+// with |x| through the float range reduction (~5e-7 at |x| = 20)
+inline float fast_sin(float x) {
+  // Reduce to [-pi, pi]
+  const float k = x * (1.0f / kTwoPi);
+  const int n = static_cast<int>(k + (k >= 0.0f ? 0.5f : -0.5f));
+  x -= static_cast<float>(n) * kTwoPi;
+  // Fold to [-pi/2, pi/2] using sin(pi - x) = sin(x)
+  x = x > 0.5f * kPi ? kPi - x : x;
+  x = x < -0.5f * kPi ? -kPi - x : x;
+  // Taylor series up to x^11
+  const float x2 = x * x;
+  return x * (1.0f +
+              x2 * (-1.0f / 6 +
+                    x2 * (1.0f / 120 +
+                          x2 * (-1.0f / 5040 +
+                                x2 * (1.0f / 362880 + x2 * (-1.0f / 39916800))))));
+}
+
+inline float fast_cos(float x) { return fast_sin(x + 0.5f * kPi); }
+
+// Gain from decibels
+inline float db_to_gain(float db) { return fast_exp2(db * 0.16609640f); }
+
+} // namespace rtclap
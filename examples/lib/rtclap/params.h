@@ -0,0 +1,28 @@
+// Per-sample parameter modulation.
+//
+// Hosts can modulate parameters (CLAP_EVENT_PARAM_MOD) without moving
+// their automation. g_params always holds base + modulation at block
+// rate. For sample-accurate modulation, return a bit mask of the params
+// you want from param_buffer_mask():
+//
+//   uint32_t param_buffer_mask() { return 1u << 0; }  // param 0
+//
+// While such a param is modulated, g_param_buffers[i] holds one value per
+// frame of the current process() call; otherwise it is nullptr and costs
+// nothing. rtclap::param() picks whichever applies.
+#pragma once
+
+#include <cstdint>
+
+extern float g_params[];
+extern const float *g_param_buffers[];
+
+namespace rtclap {
+
+// Value of param i at frame n of the current process() call
+inline float param(int i, uint32_t n) {
+  const float *buffer = g_param_buffers[i];
+  return buffer ? buffer[n] : g_params[i];
+}
+
+} // namespace rtclap
@@ -0,0 +1,13 @@
+// DSP runtime for JIT'd code: fast math, smoothers, delay lines, biquads.
+//
+//   #include "rtclap/rtclap.h"
+//
+// Everything is header-only and written so clang vectorizes it across
+// channels and frames. That only happens with optimizations enabled:
+// add "// rtclap: -O3" (optionally -ffast-math) to the DSP file.
+#pragma once
+
+#include "biquad.h"
+#include "delay.h"
+#include "math.h"
+#include "smoother.h"
@@ -0,0 +1,71 @@
+// One-pole parameter smoother.
+//
+// next() runs per sample; fill() and apply() produce a whole block using
+// the closed form t + (y - t) * a^k, 8 frames at a time, which vectorizes
+// where the per-sample recurrence cannot.
+#pragma once
+
+#include <cmath>
+
+namespace rtclap {
+
+struct Smoother {
+  static constexpr unsigned kLanes = 8;
+
+  float value = 0.0f;
+  float target = 0.0f;
+  float coeff = 0.0f;
+  float coeff_pow[kLanes] = {};  // coeff^1 .. coeff^8
+
+  // Time to get ~63% of the way to a new target
+  void set_time(float ms, double sample_rate) {
+    const double samples = ms * 0.001 * sample_rate;
+    coeff = samples > 0.0 ? static_cast<float>(std::exp(-1.0 / samples)) : 0.0f;
+    float p = 1.0f;
+    for (unsigned k = 0; k < kLanes; ++k)
+      coeff_pow[k] = p *= coeff;
+  }
+
+  void reset(float v) { value = target = v; }
+
+  float next() {
+    value = target + (value - target) * coeff;
+    return value;
+  }
+
+  // out[i] = smoothed value of frame i while moving toward new_target
+  void fill(float *__restrict out, unsigned n, float new_target) {
+    target = new_target;
+    float d = value - target;
+    unsigned i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+      for (unsigned k = 0; k < kLanes; ++k)
+        out[i + k] = target + d * coeff_pow[k];
+      d *= coeff_pow[kLanes - 1];
+    }
+    for (; i < n; ++i) {
+      d *= coeff;
+      out[i] = target + d;
+    }
+    value = target + d;
+  }
+
+  // buf[i] *= smoothed value, e.g. a click-free gain change
+  void apply(float *__restrict buf, unsigned n, float new_target) {
+    target = new_target;
+    float d = value - target;
+    unsigned i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+      for (unsigned k = 0; k < kLanes; ++k)
+        buf[i + k] *= target + d * coeff_pow[k];
+      d *= coeff_pow[kLanes - 1];
+    }
+    for (; i < n; ++i) {
+      d *= coeff;
+      buf[i] *= target + d;
+    }
+    value = target + d;
+  }
+};
+
+} // namespace rtclap
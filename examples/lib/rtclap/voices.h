@@ -0,0 +1,44 @@
+// Voice pool passed to process_voices() by the "JIT Synth" plugin.
+//
+//   void process_voices(rtclap_voices *v, uint32_t count,
+//                       float *const *outputs, uint32_t num_channels,
+//                       uint32_t num_frames);
+//
+// Voices [0, count) are active. Every field is an array indexed by voice,
+// so loop over voices in the inner loop and clang vectorizes across them
+// (with "// rtclap: -O3 -ffast-math"; summing voices into one sample is a
+// reduction). Add into outputs; they arrive cleared. Keep
+// per-voice state in v->state (zeroed on note on) and set v->done[i] once
+// a released voice has faded out, or it keeps its slot. Polyphonic
+// modulation of param p arrives in v->mod[p][i]; add it to g_params[p].
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+
+enum {
+  RTCLAP_MAX_VOICES = 32,  // Fixed polyphony
+  RTCLAP_VOICE_STATE = 16,  // DSP-owned floats per voice
+  RTCLAP_VOICE_PARAMS = 16  // Params with per-voice modulation
+};
+
+struct alignas(64) rtclap_voices {
+  float key[RTCLAP_MAX_VOICES];       // MIDI key
+  float freq[RTCLAP_MAX_VOICES];      // Hz, equal temperament
+  float velocity[RTCLAP_MAX_VOICES];  // 0..1
+  float gate[RTCLAP_MAX_VOICES];      // 1 while held, 0 once released
+  uint32_t age[RTCLAP_MAX_VOICES];    // Samples since note on
+  int32_t done[RTCLAP_MAX_VOICES];    // Set when the tail ended
+  float state[RTCLAP_VOICE_STATE][RTCLAP_MAX_VOICES];  // Zeroed on note on
+
+  // Host identity of each voice (read-only)
+  int32_t note_id[RTCLAP_MAX_VOICES];
+  int16_t channel[RTCLAP_MAX_VOICES];
+  int16_t port[RTCLAP_MAX_VOICES];
+
+  // Polyphonic modulation: offset of g_params[p] for this voice, from
+  // note-targeted host modulation. Zeroed on note on.
+  float mod[RTCLAP_VOICE_PARAMS][RTCLAP_MAX_VOICES];
+};
+}
@@ -0,0 +1,68 @@
+// Convolution reverb with a synthetic 2 s IR (decaying noise)
+// tags: reverb, convolution
+// rtclap: -O2
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "rtclap/convolver.h"
+
+extern float g_params[];
+
+static rtclap::Convolver reverb[2];
+static std::vector<float> wet;
+
+// Parameters: [0] = Mix, [1] = Decay
+int param_count() { return 2; }
+
+const char *param_name(int i) {
+  static const char *names[] = {"Mix", "Decay"};
+  return (i < 2) ? names[i] : "?";
+}
+
+float param_min(int) { return 0.0f; }
+float param_max(int) { return 1.0f; }
+
+float param_default(int i) {
+  static float defaults[] = {0.3f, 0.5f};
+  return (i < 2) ? defaults[i] : 0.5f;
+}
+
+bool init(double sample_rate, uint32_t, uint32_t max_frames) {
+  const uint32_t length = static_cast<uint32_t>(sample_rate * 2.0);
+  const float decay = 3.0f + g_params[1] * 6.0f;
+
+  // Different noise per channel for a wide stereo image
+  uint32_t seed = 12345;
+  std::vector<float> ir(length);
+  for (int ch = 0; ch < 2; ++ch) {
+    for (uint32_t i = 0; i < length; ++i) {
+      seed = seed * 1664525u + 1013904223u;
+      float noise = static_cast<float>(seed >> 8) / 8388608.0f - 1.0f;
+      ir[i] = 0.05f * noise * std::exp(-decay * i / static_cast<float>(length));
+    }
+    if (!reverb[ch].load(ir.data(), length, 64))
+      return false;
+  }
+  wet.assign(max_frames, 0.0f);
+  return true;
+}
+
+void destroy() {
+  reverb[0].close();
+  reverb[1].close();
+}
+
+void process(const float *const *inputs, float *const *outputs,
+             unsigned int num_channels, unsigned int num_frames) {
+  const float mix = g_params[0];
+
+  for (unsigned int ch = 0; ch < num_channels && ch < 2; ++ch) {
+    if (!reverb[ch].loaded() || num_frames > wet.size())
+      return;
+    reverb[ch].process(inputs[ch], wet.data(), num_frames);
+    for (unsigned int i = 0; i < num_frames; ++i)
+      outputs[ch][i] = inputs[ch][i] * (1.0f - mix) + wet[i] * mix;
+  }
+}
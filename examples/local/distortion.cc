@@ -1,6 +1,7 @@
 // Soft-clip distortion with drive and output controls
 
 extern float g_params[];
+extern int g_render_offline;
 
 // Parameters: [0] = Drive, [1] = Output
 int param_count() { return 2; }
@@ -18,11 +19,22 @@ float param_default(int i) {
   return (i < 2) ? defaults[i] : 0.5f;
 }
 
+// Run at 4x the host rate to keep clipping harmonics from aliasing, 8x
+// when bouncing
+int oversampling_factor() { return g_render_offline ? 8 : 4; }
+
+static float drive = 5.5f;
+static float output_gain = 0.5f;
+
+// Called before process() whenever a parameter moved (and once on load)
+void on_params_changed(const float *params, const unsigned int *) {
+  // Drive: 0.0 = 1x, 1.0 = 10x
+  drive = 1.0f + params[0] * 9.0f;
+  output_gain = params[1];
+}
+
 void process(const float *const *inputs, float *const *outputs,
              unsigned int num_channels, unsigned int num_frames) {
-  // Drive: 0.0 = 1x, 1.0 = 10x
-  const float drive = 1.0f + g_params[0] * 9.0f;
-  const float output_gain = g_params[1];
 
   for (unsigned int ch = 0; ch < num_channels; ++ch) {
     for (unsigned int i = 0; i < num_frames; ++i) {
@@ -1,8 +1,9 @@
 // DSP processing code - JIT compiled at plugin initialization
 // Edit this file to change the audio processing
 
-// Parameter array from plugin
-extern float g_params[];
+#include <cstdint>
+
+#include "rtclap/params.h"
 
 // Parameter definitions
 int param_count() { return 1; }
@@ -16,13 +17,17 @@ float param_min(int) { return 0.0f; }
 float param_max(int) { return 1.0f; }
 float param_default(int) { return 1.0f; }
 
+// Follow host modulation of Gain sample by sample
+uint32_t param_buffer_mask() { return 1u << 0; }
+
 void process(const float *const *inputs, float *const *outputs,
              unsigned int num_channels, unsigned int num_frames) {
+  const float *gain_buffer = g_param_buffers[0];
   const float gain = g_params[0];
 
   for (unsigned int ch = 0; ch < num_channels; ++ch) {
     for (unsigned int i = 0; i < num_frames; ++i) {
-      outputs[ch][i] = inputs[ch][i] * gain;
+      outputs[ch][i] = inputs[ch][i] * (gain_buffer ? gain_buffer[i] : gain);
     }
   }
 }
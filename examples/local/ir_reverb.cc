@@ -0,0 +1,62 @@
+// Convolution reverb with an impulse response from irs/room.wav
+// tags: reverb, convolution, asset
+// rtclap: -O2
+
+#include <cstdint>
+#include <vector>
+
+#include "rtclap/asset.h"
+#include "rtclap/convolver.h"
+
+extern float g_params[];
+
+static rtclap::Asset ir_file;
+static rtclap::Convolver reverb[2];
+static std::vector<float> wet;
+
+// Mapped and prefetched by the plugin before init()
+const char *asset_path(int i) { return i == 0 ? "irs/room.wav" : nullptr; }
+
+// Parameters: [0] = Mix
+int param_count() { return 1; }
+const char *param_name(int) { return "Mix"; }
+float param_min(int) { return 0.0f; }
+float param_max(int) { return 1.0f; }
+float param_default(int) { return 0.3f; }
+
+bool init(double, uint32_t, uint32_t max_frames) {
+  if (!ir_file.open("irs/room.wav"))
+    return false;
+
+  // Cap at 4 s so a stray long file cannot stall the audio thread
+  uint64_t length = ir_file.frames();
+  uint64_t max_length = static_cast<uint64_t>(ir_file.sample_rate() * 4.0);
+  if (length > max_length)
+    length = max_length;
+
+  for (uint32_t ch = 0; ch < 2; ++ch) {
+    if (!reverb[ch].load(ir_file.channel(ch), static_cast<uint32_t>(length), 64))
+      return false;
+  }
+  wet.assign(max_frames, 0.0f);
+  return true;
+}
+
+void destroy() {
+  reverb[0].close();
+  reverb[1].close();
+  ir_file.close();
+}
+
+void process(const float *const *inputs, float *const *outputs,
+             unsigned int num_channels, unsigned int num_frames) {
+  const float mix = g_params[0];
+
+  for (unsigned int ch = 0; ch < num_channels && ch < 2; ++ch) {
+    if (!reverb[ch].loaded() || num_frames > wet.size())
+      return;
+    reverb[ch].process(inputs[ch], wet.data(), num_frames);
+    for (unsigned int i = 0; i < num_frames; ++i)
+      outputs[ch][i] = inputs[ch][i] * (1.0f - mix) + wet[i] * mix;
+  }
+}
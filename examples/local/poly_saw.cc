@@ -0,0 +1,77 @@
+// Polyphonic saw synth with a one-pole lowpass and linear envelope.
+// Load it in the "JIT Synth" plugin. Cutoff takes per-voice modulation.
+// tags: synth, instrument, polyphonic
+// rtclap: -O3 -ffast-math
+
+#include <cstdint>
+
+#include "rtclap/voices.h"
+
+extern float g_params[];
+
+// Per-voice state slots
+enum { PHASE, ENV, LOWPASS };
+
+static double rate = 48000.0;
+
+// Parameters: [0] = Cutoff, [1] = Release, [2] = Volume
+int param_count() { return 3; }
+
+const char *param_name(int i) {
+  static const char *names[] = {"Cutoff", "Release", "Volume"};
+  return (i < 3) ? names[i] : "?";
+}
+
+float param_min(int) { return 0.0f; }
+float param_max(int) { return 1.0f; }
+
+float param_default(int i) {
+  static float defaults[] = {0.3f, 0.3f, 0.5f};
+  return (i < 3) ? defaults[i] : 0.5f;
+}
+
+bool init(double sample_rate, uint32_t, uint32_t) {
+  rate = sample_rate;
+  return true;
+}
+
+void process_voices(rtclap_voices *v, uint32_t count, float *const *outputs,
+                    uint32_t num_channels, uint32_t num_frames) {
+  const float attack = 1.0f / (0.005f * static_cast<float>(rate));
+  const float release = 1.0f / ((0.01f + g_params[1] * 2.0f) * static_cast<float>(rate));
+  const float volume = g_params[2] * 0.25f;
+
+  float step[RTCLAP_MAX_VOICES], cutoff[RTCLAP_MAX_VOICES];
+  for (uint32_t i = 0; i < count; ++i) {
+    step[i] = v->freq[i] / static_cast<float>(rate);
+    float c = g_params[0] + v->mod[0][i];
+    c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+    cutoff[i] = 0.005f + c * c * 0.5f;
+  }
+
+  float *phase = v->state[PHASE];
+  float *env = v->state[ENV];
+  float *lp = v->state[LOWPASS];
+
+  for (uint32_t n = 0; n < num_frames; ++n) {
+    float mix = 0.0f;
+    // Inner loop over voices: straight-line code clang vectorizes
+    for (uint32_t i = 0; i < count; ++i) {
+      phase[i] += step[i];
+      phase[i] -= phase[i] >= 1.0f ? 1.0f : 0.0f;
+      float target = v->gate[i];
+      float rate_i = target > env[i] ? attack : release;
+      float next = env[i] + (target > env[i] ? rate_i : -rate_i);
+      env[i] = target > env[i] ? (next < target ? next : target)
+                               : (next > 0.0f ? next : 0.0f);
+      lp[i] += cutoff[i] * ((2.0f * phase[i] - 1.0f) - lp[i]);
+      mix += lp[i] * env[i] * v->velocity[i];
+    }
+    for (uint32_t ch = 0; ch < num_channels; ++ch)
+      outputs[ch][n] += mix * volume;
+  }
+
+  // Released voices are done once the envelope reached zero
+  for (uint32_t i = 0; i < count; ++i)
+    v->done[i] = v->gate[i] == 0.0f && env[i] == 0.0f;
+}
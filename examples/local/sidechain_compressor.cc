@@ -0,0 +1,62 @@
+// Compressor keyed from the sidechain input (bus 1)
+// tags: dynamics, compressor, sidechain
+// rtclap: -O2
+
+#include <cmath>
+#include <cstdint>
+
+extern float g_params[];
+
+static float envelope = 0.0f;
+static float attack_coeff = 0.0f;
+static float release_coeff = 0.0f;
+
+// Main input plus one sidechain; one output
+int input_bus_count() { return 2; }
+int output_bus_count() { return 1; }
+
+// Parameters: [0] = Threshold (dB), [1] = Ratio
+int param_count() { return 2; }
+
+const char *param_name(int i) {
+  static const char *names[] = {"Threshold", "Ratio"};
+  return (i < 2) ? names[i] : "?";
+}
+
+float param_min(int i) { return i == 0 ? -60.0f : 1.0f; }
+float param_max(int i) { return i == 0 ? 0.0f : 20.0f; }
+
+float param_default(int i) {
+  static float defaults[] = {-20.0f, 4.0f};
+  return (i < 2) ? defaults[i] : 0.5f;
+}
+
+bool init(double sample_rate, uint32_t, uint32_t) {
+  attack_coeff = std::exp(-1.0f / (0.005f * static_cast<float>(sample_rate)));
+  release_coeff = std::exp(-1.0f / (0.150f * static_cast<float>(sample_rate)));
+  envelope = 0.0f;
+  return true;
+}
+
+// inputs[bus][channel]; a sidechain the host did not connect reads silence
+void process_buses(const float *const *const *inputs, uint32_t, float *const *const *outputs,
+                   uint32_t, uint32_t num_channels, uint32_t num_frames) {
+  const float threshold = g_params[0];
+  const float slope = 1.0f - 1.0f / g_params[1];
+  const float *const *main = inputs[0];
+  const float *const *key = inputs[1];
+
+  for (uint32_t i = 0; i < num_frames; ++i) {
+    float level = std::fabs(key[0][i]) > std::fabs(key[1][i]) ? std::fabs(key[0][i])
+                                                               : std::fabs(key[1][i]);
+    float coeff = level > envelope ? attack_coeff : release_coeff;
+    envelope = level + coeff * (envelope - level);
+
+    float db = 20.0f * std::log10(envelope + 1e-9f);
+    float reduction = db > threshold ? (db - threshold) * slope : 0.0f;
+    float gain = std::pow(10.0f, -reduction / 20.0f);
+
+    for (uint32_t ch = 0; ch < num_channels; ++ch)
+      outputs[0][ch][i] = main[ch][i] * gain;
+  }
+}
@@ -0,0 +1,41 @@
+// Spectral gate: mutes bins below a threshold (broadband noise reduction)
+// tags: spectral, denoise, fft
+
+#include <cmath>
+
+extern float g_params[];
+
+// Parameters: [0] = Threshold (dB), [1] = Floor
+int param_count() { return 2; }
+
+const char *param_name(int i) {
+  static const char *names[] = {"Threshold", "Floor"};
+  return (i < 2) ? names[i] : "?";
+}
+
+float param_min(int i) { return i == 0 ? -100.0f : 0.0f; }
+float param_max(int i) { return i == 0 ? 0.0f : 1.0f; }
+
+float param_default(int i) {
+  static float defaults[] = {-60.0f, 0.0f};
+  return (i < 2) ? defaults[i] : 0.5f;
+}
+
+// 2048-point frames, hop 512: finer bins than the 1024 default
+int stft_size() { return 2048; }
+
+// bins holds num_bins (re, im) pairs; called once per hop and channel
+void process_spectrum(float *bins, int num_bins, int) {
+  // Bin magnitudes scale with the window sum: size / 2 = num_bins - 1
+  const float window_sum = static_cast<float>(num_bins - 1);
+  const float threshold = std::pow(10.0f, g_params[0] / 20.0f) * window_sum;
+  const float floor = g_params[1];
+
+  for (int k = 0; k < num_bins; ++k) {
+    float re = bins[2 * k], im = bins[2 * k + 1];
+    if (re * re + im * im < threshold * threshold) {
+      bins[2 * k] = re * floor;
+      bins[2 * k + 1] = im * floor;
+    }
+  }
+}
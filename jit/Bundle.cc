@@ -0,0 +1,247 @@
+#include "Bundle.h"
+#include "Error.h"
+
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+#include <set>
+
+namespace clap_rt {
+
+namespace {
+
+constexpr char kMagic[8] = {'R', 'T', 'C', 'L', 'A', 'P', 'B', '\0'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 8 + 4 + 4 + 8;
+
+enum class SectionKind : uint32_t {
+  Manifest = 1,
+  Source = 2,
+  LibSource = 3,
+  Object = 4,
+  Symbols = 5,
+};
+
+void appendU32(std::string &Out, uint32_t V) {
+  char Buf[4];
+  llvm::support::endian::write32le(Buf, V);
+  Out.append(Buf, 4);
+}
+
+void appendU64(std::string &Out, uint64_t V) {
+  char Buf[8];
+  llvm::support::endian::write64le(Buf, V);
+  Out.append(Buf, 8);
+}
+
+void appendSection(std::string &Out, SectionKind Kind, llvm::StringRef Name,
+                   llvm::StringRef Data) {
+  appendU32(Out, static_cast<uint32_t>(Kind));
+  appendU32(Out, static_cast<uint32_t>(Name.size()));
+  appendU64(Out, Data.size());
+  Out.append(Name.data(), Name.size());
+  Out.append(Data.data(), Data.size());
+}
+
+std::string serializeManifest(const BundleManifest &M) {
+  std::string Out;
+  Out += "name = " + M.name + "\n";
+  Out += "source = " + M.source + "\n";
+  for (const auto &E : M.entryPoints)
+    Out += "entry = " + E + "\n";
+  for (const auto &P : M.params)
+    Out += "param = " + P + "\n";
+  for (const auto &F : M.requiredFeatures)
+    Out += "requires = " + F + "\n";
+  return Out;
+}
+
+BundleManifest parseManifest(llvm::StringRef Text) {
+  BundleManifest M;
+  llvm::SmallVector<llvm::StringRef, 16> Lines;
+  Text.split(Lines, '\n', -1, false);
+  for (llvm::StringRef Line : Lines) {
+    auto [Key, Value] = Line.split(" = ");
+    Key = Key.trim();
+    if (Key == "name")
+      M.name = Value.str();
+    else if (Key == "source")
+      M.source = Value.str();
+    else if (Key == "entry")
+      M.entryPoints.push_back(Value.str());
+    else if (Key == "param")
+      M.params.push_back(Value.str());
+    else if (Key == "requires")
+      M.requiredFeatures.push_back(Value.str());
+  }
+  return M;
+}
+
+} // anonymous namespace
+
+std::vector<const BundleObject *> Bundle::selectObjects(CpuLevel Host) const {
+  // Sources that need an object (headers are only used as includes)
+  std::set<std::string> compiled;
+  for (const auto &O : objects)
+    compiled.insert(O.source);
+
+  for (int L = static_cast<int>(Host); L >= 0; --L) {
+    CpuLevel Level = static_cast<CpuLevel>(L);
+    std::vector<const BundleObject *> Selected;
+    std::set<std::string> covered;
+    for (const auto &O : objects) {
+      if (O.level == Level) {
+        Selected.push_back(&O);
+        covered.insert(O.source);
+      }
+    }
+    if (!Selected.empty() && covered == compiled)
+      return Selected;
+  }
+  return {};
+}
+
+std::string serializeBundle(const Bundle &B) {
+  std::string Body;
+  uint32_t Count = 0;
+
+  appendSection(Body, SectionKind::Manifest, "manifest",
+                serializeManifest(B.manifest));
+  ++Count;
+
+  for (const auto &S : B.sources) {
+    appendSection(Body, S.isLib ? SectionKind::LibSource : SectionKind::Source,
+                  S.name, S.contents);
+    ++Count;
+  }
+
+  if (!B.symbols.empty()) {
+    appendSection(Body, SectionKind::Symbols, "symbols", B.symbols);
+    ++Count;
+  }
+
+  for (const auto &O : B.objects) {
+    appendSection(Body, SectionKind::Object,
+                  (cpuLevelName(O.level) + "/" + O.source).str(), O.data);
+    ++Count;
+  }
+
+  std::string Out(kMagic, sizeof(kMagic));
+  appendU32(Out, kVersion);
+  appendU32(Out, Count);
+  appendU64(Out, llvm::xxh3_64bits(llvm::StringRef(Body)));
+  Out += Body;
+  return Out;
+}
+
+bool isValidSourceName(llvm::StringRef Name) {
+  return !Name.empty() && Name != "." && Name != ".." &&
+         Name.find_first_of(llvm::StringRef("/\\\0", 3)) ==
+             llvm::StringRef::npos;
+}
+
+llvm::Error writeBundle(const Bundle &B, llvm::StringRef Path) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_None);
+  if (EC)
+    return makeError(ErrorCode::InvalidBundle,
+                     "Could not open bundle for writing: " + EC.message(), Path);
+
+  OS << serializeBundle(B);
+  OS.flush();
+  if (OS.has_error())
+    return makeError(ErrorCode::InvalidBundle,
+                     "Write failed: " + OS.error().message(), Path);
+  return llvm::Error::success();
+}
+
+llvm::Expected<Bundle> parseBundle(llvm::StringRef Data, llvm::StringRef Name) {
+  using namespace llvm::support::endian;
+
+  if (Data.size() < kHeaderSize ||
+      !Data.starts_with(llvm::StringRef(kMagic, sizeof(kMagic))))
+    return makeError(ErrorCode::InvalidBundle, "Bad magic", Name);
+
+  const char *P = Data.data() + sizeof(kMagic);
+  uint32_t Version = read32le(P);
+  uint32_t Count = read32le(P + 4);
+  uint64_t Checksum = read64le(P + 8);
+  if (Version != kVersion)
+    return makeError(ErrorCode::InvalidBundle,
+                     "Unsupported version " + std::to_string(Version), Name);
+
+  llvm::StringRef Body = Data.drop_front(kHeaderSize);
+  if (llvm::xxh3_64bits(Body) != Checksum)
+    return makeError(ErrorCode::InvalidBundle, "Checksum mismatch", Name);
+
+  Bundle B;
+  B.checksum = Checksum;
+  bool HasManifest = false;
+
+  for (uint32_t I = 0; I < Count; ++I) {
+    if (Body.size() < 16)
+      return makeError(ErrorCode::InvalidBundle, "Truncated section", Name);
+    auto Kind = static_cast<SectionKind>(read32le(Body.data()));
+    uint32_t NameLen = read32le(Body.data() + 4);
+    uint64_t DataLen = read64le(Body.data() + 8);
+    Body = Body.drop_front(16);
+    if (Body.size() < NameLen || Body.size() - NameLen < DataLen)
+      return makeError(ErrorCode::InvalidBundle, "Truncated section", Name);
+
+    llvm::StringRef SecName = Body.take_front(NameLen);
+    llvm::StringRef SecData = Body.substr(NameLen, DataLen);
+    Body = Body.drop_front(NameLen + DataLen);
+
+    switch (Kind) {
+    case SectionKind::Manifest:
+      B.manifest = parseManifest(SecData);
+      HasManifest = true;
+      break;
+    case SectionKind::Source:
+    case SectionKind::LibSource:
+      // Sources are extracted to disk under their names
+      if (!isValidSourceName(SecName))
+        return makeError(ErrorCode::InvalidBundle,
+                         "Invalid source name: " + SecName.str(), Name);
+      B.sources.push_back(
+          {SecName.str(), SecData.str(), Kind == SectionKind::LibSource});
+      break;
+    case SectionKind::Symbols:
+      B.symbols = SecData.str();
+      break;
+    case SectionKind::Object: {
+      auto [LevelName, Source] = SecName.split('/');
+      auto Level = parseCpuLevel(LevelName);
+      if (!Level)
+        return makeError(ErrorCode::InvalidBundle,
+                         "Unknown CPU level: " + LevelName.str(), Name);
+      if (!isValidSourceName(Source))
+        return makeError(ErrorCode::InvalidBundle,
+                         "Invalid object name: " + SecName.str(), Name);
+      B.objects.push_back({*Level, Source.str(), SecData.str()});
+      break;
+    }
+    default:
+      // Unknown sections are skipped so newer writers stay readable
+      break;
+    }
+  }
+
+  if (!HasManifest)
+    return makeError(ErrorCode::InvalidBundle, "Missing manifest", Name);
+  return B;
+}
+
+llvm::Expected<Bundle> readBundle(llvm::StringRef Path) {
+  auto BufferOrErr = llvm::MemoryBuffer::getFile(Path);
+  if (!BufferOrErr)
+    return makeError(ErrorCode::InvalidBundle,
+                     "Failed to read bundle: " + BufferOrErr.getError().message(),
+                     Path);
+  return parseBundle((*BufferOrErr)->getBuffer(), Path);
+}
+
+} // namespace clap_rt
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Target.h"
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/Error.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace clap_rt {
+
+/// Describes what a bundle contains and what it needs to run.
+struct BundleManifest {
+  std::string name;                         // Display name, e.g. "gain"
+  std::string source;                       // File name of the main DSP source
+  std::vector<std::string> entryPoints;     // Defined functions (demangled)
+  std::vector<std::string> params;          // Parameter names
+  std::vector<std::string> requiredFeatures; // Features of the lowest object level
+};
+
+/// A source file stored in a bundle.
+struct BundleSource {
+  std::string name;     // File name ("gain.cc", "utils.h")
+  std::string contents;
+  bool isLib = false;   // Belongs to lib/ (include path + compiled first)
+};
+
+/// A precompiled object for one source at one CPU level.
+struct BundleObject {
+  CpuLevel level = CpuLevel::Generic;
+  std::string source;   // Name of the BundleSource it was compiled from
+  std::string data;     // ELF object file
+};
+
+/// Single-file package of a DSP: sources, lib/ dependencies, manifest and
+/// optional prebuilt objects for several x86-64 levels.
+///
+/// On-disk layout (little endian):
+///   "RTCLAPB\0" | u32 version | u32 section count | u64 xxh3 checksum
+///   sections: u32 kind | u32 name length | u64 data length | name | data
+/// The checksum covers everything after the header.
+struct Bundle {
+  BundleManifest manifest;
+  std::vector<BundleSource> sources;
+  std::vector<BundleObject> objects;
+  std::string symbols;  // "demangled\tmangled" lines, shared by all levels
+  uint64_t checksum = 0; // Set by readBundle()
+
+  /// Returns objects of the best level <= Host that covers every compiled
+  /// source, or an empty list if no level does.
+  std::vector<const BundleObject *> selectObjects(CpuLevel Host) const;
+};
+
+/// True if Name can be used as a source file name when a bundle is
+/// extracted: not empty, "." or "..", and no path separators.
+bool isValidSourceName(llvm::StringRef Name);
+
+/// Serializes a bundle to Path.
+[[nodiscard]] llvm::Error writeBundle(const Bundle &B, llvm::StringRef Path);
+
+/// Reads a bundle and verifies its checksum.
+[[nodiscard]] llvm::Expected<Bundle> readBundle(llvm::StringRef Path);
+
+/// Parses a bundle from memory and verifies its checksum and source names.
+[[nodiscard]] llvm::Expected<Bundle> parseBundle(llvm::StringRef Data,
+                                                 llvm::StringRef Name = "");
+
+/// Serializes a bundle into a string (same format as writeBundle).
+std::string serializeBundle(const Bundle &B);
+
+} // namespace clap_rt
@@ -0,0 +1,371 @@
+#include "Chain.h"
+#include "Error.h"
+
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace clap_rt {
+
+namespace {
+
+/// Frames per inner block; bounds the size of the intermediate buffers
+constexpr unsigned kChainBlock = 256;
+
+/// Channels handled by the chain, further channels pass through
+constexpr unsigned kChainMaxChannels = 8;
+
+bool isNodeName(llvm::StringRef S) {
+  if (S.empty() || std::isdigit(static_cast<unsigned char>(S.front())))
+    return false;
+  return llvm::all_of(S, [](char C) {
+    return std::isalnum(static_cast<unsigned char>(C)) || C == '_';
+  });
+}
+
+llvm::Error lineError(llvm::StringRef Path, size_t Line, const llvm::Twine &Msg) {
+  return makeError(ErrorCode::CompilationFailed,
+                   "line " + std::to_string(Line) + ": " + Msg.str(), Path);
+}
+
+/// Kahn's algorithm, keeping declaration order among ready nodes
+llvm::Error sortNodes(ChainGraph &Graph, llvm::StringRef Path) {
+  std::vector<ChainNode> sorted;
+  std::vector<bool> placed(Graph.nodes.size(), false);
+
+  while (sorted.size() < Graph.nodes.size()) {
+    bool progress = false;
+    for (size_t i = 0; i < Graph.nodes.size(); ++i) {
+      if (placed[i])
+        continue;
+      bool ready = true;
+      for (const auto &from : Graph.inputsOf(Graph.nodes[i].name)) {
+        if (from != "in" &&
+            std::none_of(sorted.begin(), sorted.end(),
+                         [&](const ChainNode &n) { return n.name == from; })) {
+          ready = false;
+          break;
+        }
+      }
+      if (ready) {
+        sorted.push_back(Graph.nodes[i]);
+        placed[i] = true;
+        progress = true;
+      }
+    }
+    if (!progress)
+      return makeError(ErrorCode::CompilationFailed,
+                       "chain contains a cycle", Path);
+  }
+
+  Graph.nodes = std::move(sorted);
+  return llvm::Error::success();
+}
+
+/// Node whose output goes straight to the plugin outputs, if any. It is the
+/// sole input of `out` and feeds nothing else, so it can skip a copy.
+const ChainNode *directOutputNode(const ChainGraph &Graph) {
+  auto outInputs = Graph.inputsOf("out");
+  if (outInputs.size() != 1 || outInputs[0] == "in")
+    return nullptr;
+  for (const auto &[from, to] : Graph.edges) {
+    if (from == outInputs[0] && to != "out")
+      return nullptr;
+  }
+  for (const auto &node : Graph.nodes) {
+    if (node.name == outInputs[0])
+      return &node;
+  }
+  return nullptr;
+}
+
+} // anonymous namespace
+
+bool ChainNode::has(llvm::StringRef EntryPoint) const {
+  return std::find(entryPoints.begin(), entryPoints.end(), EntryPoint) !=
+         entryPoints.end();
+}
+
+std::vector<std::string> ChainGraph::inputsOf(llvm::StringRef To) const {
+  std::vector<std::string> inputs;
+  for (const auto &[from, to] : edges) {
+    if (to == To)
+      inputs.push_back(from);
+  }
+  return inputs;
+}
+
+llvm::Expected<ChainGraph> parseChain(llvm::StringRef Source,
+                                      llvm::StringRef Path) {
+  ChainGraph graph;
+  llvm::StringSet<> names;
+  llvm::SmallString<256> baseDir(llvm::sys::path::parent_path(Path));
+
+  llvm::SmallVector<llvm::StringRef, 16> lines;
+  Source.split(lines, '\n');
+  for (size_t lineNo = 1; lineNo <= lines.size(); ++lineNo) {
+    llvm::StringRef line = lines[lineNo - 1].split('#').first.trim();
+    if (line.empty())
+      continue;
+
+    llvm::SmallVector<llvm::StringRef, 8> words;
+    line.split(words, ' ', -1, false);
+    for (auto &w : words)
+      w = w.trim();
+    llvm::erase_if(words, [](llvm::StringRef w) { return w.empty(); });
+
+    if (words[0] == "node") {
+      if (words.size() != 3)
+        return lineError(Path, lineNo, "expected 'node <name> <file>'");
+      if (!isNodeName(words[1]) || words[1] == "in" || words[1] == "out")
+        return lineError(Path, lineNo, "invalid node name '" + words[1] + "'");
+      if (!names.insert(words[1]).second)
+        return lineError(Path, lineNo, "duplicate node '" + words[1] + "'");
+
+      ChainNode node;
+      node.name = words[1].str();
+      llvm::SmallString<256> nodePath(words[2]);
+      if (llvm::sys::path::is_relative(nodePath)) {
+        nodePath = baseDir;
+        llvm::sys::path::append(nodePath, words[2]);
+      }
+      node.path = nodePath.str().str();
+      graph.nodes.push_back(std::move(node));
+      continue;
+    }
+
+    if (words[0] == "connect") {
+      // connect a -> b [-> c ...]
+      if (words.size() < 4 || words.size() % 2 != 0)
+        return lineError(Path, lineNo, "expected 'connect <a> -> <b>'");
+      for (size_t i = 1; i + 2 < words.size(); i += 2) {
+        if (words[i + 1] != "->")
+          return lineError(Path, lineNo, "expected '->'");
+        graph.edges.emplace_back(words[i].str(), words[i + 2].str());
+      }
+      continue;
+    }
+
+    return lineError(Path, lineNo, "unknown statement '" + words[0] + "'");
+  }
+
+  // Validate connections
+  for (const auto &[from, to] : graph.edges) {
+    if (from == "out" || (from != "in" && !names.contains(from)))
+      return makeError(ErrorCode::CompilationFailed,
+                       "invalid connection source '" + from + "'", Path);
+    if (to == "in" || (to != "out" && !names.contains(to)))
+      return makeError(ErrorCode::CompilationFailed,
+                       "invalid connection target '" + to + "'", Path);
+    if (std::count(graph.edges.begin(), graph.edges.end(),
+                   std::make_pair(from, to)) > 1)
+      return makeError(ErrorCode::CompilationFailed,
+                       "duplicate connection " + from + " -> " + to, Path);
+  }
+  if (graph.nodes.empty())
+    return makeError(ErrorCode::CompilationFailed, "chain has no nodes", Path);
+  for (const auto &node : graph.nodes) {
+    if (graph.inputsOf(node.name).empty())
+      return makeError(ErrorCode::CompilationFailed,
+                       "node '" + node.name + "' has no input", Path);
+  }
+  if (graph.inputsOf("out").empty())
+    return makeError(ErrorCode::CompilationFailed,
+                     "nothing is connected to 'out'", Path);
+
+  if (auto Err = sortNodes(graph, Path))
+    return std::move(Err);
+
+  // The node writing straight to the outputs runs last, after every node
+  // that may still read inputs the host passed in place
+  if (const ChainNode *direct = directOutputNode(graph)) {
+    auto it = graph.nodes.begin() + (direct - graph.nodes.data());
+    std::rotate(it, it + 1, graph.nodes.end());
+  }
+
+  return graph;
+}
+
+llvm::Expected<ChainGraph> readChain(llvm::StringRef Path) {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(Path);
+  if (!BufOrErr)
+    return makeError(ErrorCode::CompilationFailed,
+                     BufOrErr.getError().message(), Path);
+  return parseChain((*BufOrErr)->getBuffer(), Path);
+}
+
+std::string chainSymbol(llvm::StringRef Node, llvm::StringRef Function) {
+  return ("__rtclap_chain_" + Node + "_" + Function).str();
+}
+
+std::string generateChainWrapper(const ChainGraph &Graph) {
+  const ChainNode *direct = directOutputNode(Graph);
+  std::string s;
+
+  auto sym = [](const ChainNode &n, llvm::StringRef fn) {
+    return chainSymbol(n.name, fn);
+  };
+
+  // Buffer a node reads from for channel `ch` of the current block
+  auto source = [&](const std::string &name) -> std::string {
+    if (name == "in")
+      return "inputs[ch] + off";
+    return "buf_" + name + "[ch]";
+  };
+
+  s += "// Fused DSP chain, generated by ClapJIT\n\n";
+
+  // Declarations of the renamed node entry points
+  s += "extern \"C\" {\n";
+  for (const auto &n : Graph.nodes) {
+    s += "void " + sym(n, "process") +
+         "(const float *const *, float *const *, unsigned int, unsigned int);\n";
+    if (n.has("init"))
+      s += "bool " + sym(n, "init") + "(double, unsigned int, unsigned int);\n";
+    if (n.has("destroy"))
+      s += "void " + sym(n, "destroy") + "();\n";
+    if (n.has("param_name"))
+      s += "const char *" + sym(n, "param_name") + "(int);\n";
+    for (const char *fn : {"param_min", "param_max", "param_default"}) {
+      if (n.has(fn))
+        s += "float " + sym(n, fn) + "(int);\n";
+    }
+  }
+  s += "}\n\n";
+
+  s += "namespace {\n";
+  s += "constexpr unsigned int kBlock = " + std::to_string(kChainBlock) + ";\n";
+  s += "constexpr unsigned int kMaxChannels = " +
+       std::to_string(kChainMaxChannels) + ";\n";
+  s += "} // namespace\n\n";
+
+  // process: run nodes block by block through stack buffers
+  s += "void process(const float *const *inputs, float *const *outputs,\n"
+       "             unsigned int num_channels, unsigned int num_frames) {\n";
+  s += "  const unsigned int nch =\n"
+       "      num_channels < kMaxChannels ? num_channels : kMaxChannels;\n";
+  for (const auto &n : Graph.nodes) {
+    if (&n != direct)
+      s += "  alignas(64) float buf_" + n.name + "[kMaxChannels][kBlock];\n";
+    if (Graph.inputsOf(n.name).size() > 1)
+      s += "  alignas(64) float mix_" + n.name + "[kMaxChannels][kBlock];\n";
+  }
+  s += "  const float *node_in[kMaxChannels];\n";
+  s += "  float *node_out[kMaxChannels];\n\n";
+
+  s += "  for (unsigned int off = 0; off < num_frames; off += kBlock) {\n";
+  s += "    const unsigned int n =\n"
+       "        num_frames - off < kBlock ? num_frames - off : kBlock;\n";
+  for (const auto &n : Graph.nodes) {
+    auto inputs = Graph.inputsOf(n.name);
+    s += "\n    // " + n.name + "\n";
+    if (inputs.size() > 1) {
+      s += "    for (unsigned int ch = 0; ch < nch; ++ch) {\n";
+      s += "      for (unsigned int i = 0; i < n; ++i) {\n";
+      s += "        mix_" + n.name + "[ch][i] = ";
+      for (size_t i = 0; i < inputs.size(); ++i)
+        s += (i ? " + (" : "(") + source(inputs[i]) + ")[i]";
+      s += ";\n      }\n    }\n";
+    }
+    s += "    for (unsigned int ch = 0; ch < nch; ++ch) {\n";
+    s += "      node_in[ch] = " +
+         (inputs.size() > 1 ? "mix_" + n.name + "[ch]" : source(inputs[0])) +
+         ";\n";
+    s += "      node_out[ch] = " +
+         (&n == direct ? std::string("outputs[ch] + off")
+                       : "buf_" + n.name + "[ch]") +
+         ";\n";
+    s += "    }\n";
+    s += "    " + sym(n, "process") + "(node_in, node_out, nch, n);\n";
+  }
+  if (!direct) {
+    auto inputs = Graph.inputsOf("out");
+    s += "\n    // out\n";
+    s += "    for (unsigned int ch = 0; ch < nch; ++ch) {\n";
+    s += "      for (unsigned int i = 0; i < n; ++i) {\n";
+    s += "        outputs[ch][off + i] = ";
+    for (size_t i = 0; i < inputs.size(); ++i)
+      s += (i ? " + (" : "(") + source(inputs[i]) + ")[i]";
+    s += ";\n      }\n    }\n";
+  }
+  s += "  }\n\n";
+  s += "  // Channels beyond kMaxChannels pass through\n";
+  s += "  for (unsigned int ch = nch; ch < num_channels; ++ch) {\n";
+  s += "    for (unsigned int i = 0; i < num_frames; ++i)\n";
+  s += "      outputs[ch][i] = inputs[ch][i];\n";
+  s += "  }\n";
+  s += "}\n\n";
+
+  // init / destroy
+  s += "bool init(double sample_rate, unsigned int min_frames,\n"
+       "          unsigned int max_frames) {\n";
+  s += "  bool ok = true;\n";
+  for (const auto &n : Graph.nodes) {
+    if (n.has("init"))
+      s += "  ok = " + sym(n, "init") +
+           "(sample_rate, min_frames, max_frames) && ok;\n";
+  }
+  s += "  return ok;\n}\n\n";
+
+  s += "void destroy() {\n";
+  for (const auto &n : Graph.nodes) {
+    if (n.has("destroy"))
+      s += "  " + sym(n, "destroy") + "();\n";
+  }
+  s += "}\n\n";
+
+  // Parameters: each node's params in order, names prefixed with the node
+  int total = 0;
+  for (const auto &n : Graph.nodes)
+    total += n.paramCount;
+
+  s += "int param_count() { return " + std::to_string(total) + "; }\n\n";
+  if (total == 0)
+    return s;
+
+  s += "namespace {\n";
+  s += "char g_param_names[" + std::to_string(total) + "][64];\n\n";
+  s += "const char *prefixed(int slot, const char *node, const char *name) {\n"
+       "  char *out = g_param_names[slot];\n"
+       "  unsigned int len = 0;\n"
+       "  for (const char *p = node; *p && len < 40; ++p)\n"
+       "    out[len++] = *p;\n"
+       "  out[len++] = ':';\n"
+       "  out[len++] = ' ';\n"
+       "  for (const char *p = name; *p && len < 63; ++p)\n"
+       "    out[len++] = *p;\n"
+       "  out[len] = '\\0';\n"
+       "  return out;\n"
+       "}\n";
+  s += "} // namespace\n\n";
+
+  auto dispatch = [&](const char *ret, const char *fn, const char *fallback,
+                      bool prefix) {
+    s += std::string(ret) + fn + "(int i) {\n";
+    int base = 0;
+    for (const auto &n : Graph.nodes) {
+      if (n.paramCount == 0)
+        continue;
+      std::string local = "i - " + std::to_string(base);
+      std::string value =
+          n.has(fn) ? sym(n, fn) + "(" + local + ")" : std::string(fallback);
+      if (prefix)
+        value = "prefixed(i, \"" + n.name + "\", " + value + ")";
+      s += "  if (i >= " + std::to_string(base) + " && i < " +
+           std::to_string(base + n.paramCount) + ")\n";
+      s += "    return " + value + ";\n";
+      base += n.paramCount;
+    }
+    s += "  return " + std::string(fallback) + ";\n}\n\n";
+  };
+  dispatch("const char *", "param_name", "\"Param\"", true);
+  dispatch("float ", "param_min", "0.0f", false);
+  dispatch("float ", "param_max", "1.0f", false);
+  dispatch("float ", "param_default", "0.5f", false);
+  return s;
+}
+
+} // namespace clap_rt
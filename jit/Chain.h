@@ -0,0 +1,58 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <string>
+#include <vector>
+
+namespace clap_rt {
+
+/// Slots in the plugin's g_params array shared by all nodes of a chain
+constexpr int kMaxChainParams = 16;
+
+/// One DSP file in a chain
+struct ChainNode {
+  std::string name;
+  std::string path;  // absolute, or relative to the working directory
+
+  // Filled in by the JIT once the node is compiled
+  int paramCount = 0;
+  std::vector<std::string> entryPoints;  // "process", "init", "param_name", ...
+
+  bool has(llvm::StringRef EntryPoint) const;
+};
+
+/// A graph of DSP files fused into one module (.chain file).
+///
+///   # comment
+///   node drive distortion.cc     # paths are relative to the .chain file
+///   node tone  filter.expr
+///   connect in -> drive -> tone -> out
+///
+/// `in` and `out` are the plugin's audio ports. A node with several inputs
+/// gets their sum, as does `out`. Nodes are stored in topological order.
+struct ChainGraph {
+  std::vector<ChainNode> nodes;
+  std::vector<std::pair<std::string, std::string>> edges;  // (from, to)
+
+  /// Names feeding `To` ("in" or node names), in declaration order
+  std::vector<std::string> inputsOf(llvm::StringRef To) const;
+};
+
+/// Parses a chain description. Path is used to resolve node paths and in
+/// error messages.
+[[nodiscard]] llvm::Expected<ChainGraph> parseChain(llvm::StringRef Source,
+                                                    llvm::StringRef Path);
+
+/// Reads and parses a .chain file
+[[nodiscard]] llvm::Expected<ChainGraph> readChain(llvm::StringRef Path);
+
+/// Name of a node's renamed entry point, e.g. "__rtclap_chain_drive_process"
+std::string chainSymbol(llvm::StringRef Node, llvm::StringRef Function);
+
+/// Generates the C++ source of the fused entry points. Each node's process,
+/// init, destroy and param_* functions must already be renamed with
+/// chainSymbol() and its params rebased into g_params.
+std::string generateChainWrapper(const ChainGraph &Graph);
+
+} // namespace clap_rt
@@ -0,0 +1,160 @@
+#include "CompileOptions.h"
+#include "Error.h"
+
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <cctype>
+
+namespace clap_rt {
+
+namespace {
+
+/// Directive prefix in the leading comment block
+constexpr llvm::StringRef kDirective = "// rtclap:";
+
+/// Leading lines searched for directives
+constexpr int kDirectiveScanLines = 32;
+
+const llvm::StringSet<> &allowedFlags() {
+  static const llvm::StringSet<> flags = {
+      // Optimization level
+      "-O0", "-O1", "-O2", "-O3", "-Os", "-Oz",
+      // Floating point model
+      "-ffast-math", "-fno-fast-math", "-fno-math-errno", "-fmath-errno",
+      "-ffinite-math-only", "-fno-finite-math-only", "-fassociative-math",
+      "-fno-associative-math", "-freciprocal-math", "-fno-reciprocal-math",
+      "-fno-signed-zeros", "-fsigned-zeros", "-ffp-contract=fast",
+      "-ffp-contract=on", "-ffp-contract=off", "-ffp-model=strict",
+      "-ffp-model=precise", "-ffp-model=fast",
+      // Loop transforms
+      "-funroll-loops", "-fno-unroll-loops", "-fvectorize", "-fno-vectorize",
+      "-fslp-vectorize", "-fno-slp-vectorize",
+      // Target CPU
+      "-march=x86-64", "-march=x86-64-v2", "-march=x86-64-v3",
+      "-march=x86-64-v4", "-march=native", "-mtune=native", "-mtune=generic",
+  };
+  return flags;
+}
+
+/// Individual x86 features that may be toggled with -m<feature>/-mno-<feature>
+const llvm::StringSet<> &allowedFeatures() {
+  static const llvm::StringSet<> features = {
+      "sse3",    "ssse3",    "sse4.1",   "sse4.2",   "popcnt",   "avx",
+      "avx2",    "fma",      "f16c",     "bmi",      "bmi2",     "lzcnt",
+      "avx512f", "avx512bw", "avx512cd", "avx512dq", "avx512vl",
+  };
+  return features;
+}
+
+bool isIdentifier(llvm::StringRef S) {
+  if (S.empty() || std::isdigit(static_cast<unsigned char>(S.front())))
+    return false;
+  for (char C : S) {
+    if (!std::isalnum(static_cast<unsigned char>(C)) && C != '_')
+      return false;
+  }
+  return true;
+}
+
+void splitFlags(llvm::StringRef Text, std::vector<std::string> &Out) {
+  llvm::SmallVector<llvm::StringRef, 8> Parts;
+  Text.split(Parts, ' ', -1, false);
+  for (llvm::StringRef Part : Parts) {
+    Part = Part.trim();
+    if (!Part.empty())
+      Out.push_back(Part.str());
+  }
+}
+
+// Collects directives from the leading comment block
+void scanDirectives(llvm::StringRef Rest, std::vector<std::string> &Out) {
+  for (int I = 0; I < kDirectiveScanLines && !Rest.empty(); ++I) {
+    auto [Line, Tail] = Rest.split('\n');
+    Rest = Tail;
+    Line = Line.trim();
+    if (Line.empty())
+      continue;
+    if (!Line.starts_with("//"))
+      break;
+    if (Line.consume_front(kDirective))
+      splitFlags(Line, Out);
+  }
+}
+
+// Rejects any flag that is not in the allowlist
+llvm::Error checkFlags(const std::vector<std::string> &Flags,
+                       llvm::StringRef SourcePath) {
+  for (const auto &Flag : Flags) {
+    if (!isAllowedCompileOption(Flag))
+      return makeError(ErrorCode::InvalidCompileOption,
+                       "'" + Flag + "' is not in the allowlist", SourcePath);
+  }
+  return llvm::Error::success();
+}
+
+} // anonymous namespace
+
+bool isAllowedCompileOption(llvm::StringRef Flag) {
+  if (allowedFlags().contains(Flag))
+    return true;
+
+  // Feature toggles: -mavx2, -mno-avx512f
+  llvm::StringRef Feature = Flag;
+  if (Feature.consume_front("-mno-") || Feature.consume_front("-m"))
+    return allowedFeatures().contains(Feature);
+
+  // Preprocessor defines with plain values: -DNAME or -DNAME=value
+  llvm::StringRef Define = Flag;
+  if (Define.consume_front("-D")) {
+    auto [Name, Value] = Define.split('=');
+    return isIdentifier(Name) &&
+           llvm::all_of(Value, [](char C) {
+             return std::isalnum(static_cast<unsigned char>(C)) || C == '_' ||
+                    C == '.' || C == '-';
+           });
+  }
+
+  return false;
+}
+
+bool pinsTargetCPU(const std::vector<std::string> &Flags) {
+  for (const auto &Flag : Flags) {
+    llvm::StringRef F(Flag);
+    if (F.starts_with("-march=") || (F.starts_with("-m") && !F.starts_with("-mtune=")))
+      return true;
+  }
+  return false;
+}
+
+llvm::Expected<std::vector<std::string>>
+readCompileOptions(llvm::StringRef SourcePath) {
+  std::vector<std::string> Flags;
+
+  // In-source directives
+  if (auto Buf = llvm::MemoryBuffer::getFile(SourcePath))
+    scanDirectives((*Buf)->getBuffer(), Flags);
+
+  // Sidecar manifest
+  if (auto Buf = llvm::MemoryBuffer::getFile(SourcePath + ".opts")) {
+    llvm::SmallVector<llvm::StringRef, 8> Lines;
+    (*Buf)->getBuffer().split(Lines, '\n', -1, false);
+    for (llvm::StringRef Line : Lines)
+      splitFlags(Line.split('#').first, Flags);
+  }
+
+  if (auto Err = checkFlags(Flags, SourcePath))
+    return std::move(Err);
+  return Flags;
+}
+
+llvm::Expected<std::vector<std::string>>
+parseCompileOptions(llvm::StringRef Source, llvm::StringRef Name) {
+  std::vector<std::string> Flags;
+  scanDirectives(Source, Flags);
+  if (auto Err = checkFlags(Flags, Name))
+    return std::move(Err);
+  return Flags;
+}
+
+} // namespace clap_rt
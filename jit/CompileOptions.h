@@ -0,0 +1,31 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <string>
+#include <vector>
+
+namespace clap_rt {
+
+/// Reads per-file compiler flags for a DSP source.
+///
+/// Flags come from "// rtclap: -O3 -ffast-math" directives in the leading
+/// comment block of the file and from an optional sidecar manifest next to
+/// it ("<file>.opts", whitespace separated, '#' starts a comment). Every
+/// flag is checked against an allowlist; anything else is an error.
+[[nodiscard]] llvm::Expected<std::vector<std::string>>
+readCompileOptions(llvm::StringRef SourcePath);
+
+/// Reads the in-source directives of a DSP held in memory. There is no
+/// sidecar manifest; Name is only used in error messages.
+[[nodiscard]] llvm::Expected<std::vector<std::string>>
+parseCompileOptions(llvm::StringRef Source, llvm::StringRef Name);
+
+/// Returns true if Flag may be passed to the compiler from a DSP file.
+bool isAllowedCompileOption(llvm::StringRef Flag);
+
+/// Returns true if the flags pin the target CPU or its features, in which
+/// case the object must not be retargeted to another CPU level.
+bool pinsTargetCPU(const std::vector<std::string> &Flags);
+
+} // namespace clap_rt
@@ -10,7 +10,9 @@ enum class ErrorCode {
   TargetCreationFailed,
   CompilationFailed,
   ModuleGenerationFailed,
-  SymbolNotFound
+  SymbolNotFound,
+  InvalidBundle,
+  InvalidCompileOption
 };
 
 inline const std::error_category &ClapErrorCategory() {
@@ -28,6 +30,10 @@ inline const std::error_category &ClapErrorCategory() {
         return "Failed to generate module";
       case ErrorCode::SymbolNotFound:
         return "Symbol not found";
+      case ErrorCode::InvalidBundle:
+        return "Invalid bundle";
+      case ErrorCode::InvalidCompileOption:
+        return "Invalid compile option";
       default:
         return "Unknown error";
       }
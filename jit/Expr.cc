@@ -0,0 +1,863 @@
+#include "Expr.h"
+#include "Error.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clap_rt {
+
+namespace {
+
+/// Frames processed per vector iteration
+constexpr unsigned kVectorWidth = 8;
+
+/// Size of the plugin's g_params array
+constexpr unsigned kMaxParams = 16;
+
+// ---- Lexer ----
+
+enum class Tok { Number, Ident, Op, Newline, End };
+
+struct Token {
+  Tok kind = Tok::End;
+  std::string text;
+  double value = 0.0;
+  int line = 1;
+  int col = 1;
+};
+
+class Lexer {
+public:
+  Lexer(llvm::StringRef Src, llvm::StringRef File) : src_(Src), file_(File) {}
+
+  llvm::Expected<std::vector<Token>> run() {
+    std::vector<Token> toks;
+    while (pos_ < src_.size()) {
+      char c = src_[pos_];
+
+      if (c == '#' || (c == '/' && peek(1) == '/')) {
+        while (pos_ < src_.size() && src_[pos_] != '\n')
+          advance();
+        continue;
+      }
+      if (c == '\n' || c == ';') {
+        toks.push_back(make(Tok::Newline, std::string(1, c)));
+        advance();
+        continue;
+      }
+      if (std::isspace(static_cast<unsigned char>(c))) {
+        advance();
+        continue;
+      }
+      if (std::isdigit(static_cast<unsigned char>(c)) ||
+          (c == '.' && std::isdigit(static_cast<unsigned char>(peek(1))))) {
+        Token t = make(Tok::Number, "");
+        size_t start = pos_;
+        while (pos_ < src_.size() &&
+               (std::isalnum(static_cast<unsigned char>(src_[pos_])) ||
+                src_[pos_] == '.' ||
+                ((src_[pos_] == '-' || src_[pos_] == '+') &&
+                 (src_[pos_ - 1] == 'e' || src_[pos_ - 1] == 'E'))))
+          advance();
+        t.text = src_.substr(start, pos_ - start).str();
+        char *end = nullptr;
+        t.value = std::strtod(t.text.c_str(), &end);
+        if (*end != '\0' && *end != 'f')
+          return error(t, "invalid number '" + t.text + "'");
+        toks.push_back(t);
+        continue;
+      }
+      if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+        Token t = make(Tok::Ident, "");
+        size_t start = pos_;
+        while (pos_ < src_.size() &&
+               (std::isalnum(static_cast<unsigned char>(src_[pos_])) ||
+                src_[pos_] == '_'))
+          advance();
+        t.text = src_.substr(start, pos_ - start).str();
+        toks.push_back(t);
+        continue;
+      }
+      if (llvm::StringRef("+-*/^()=,").contains(c)) {
+        toks.push_back(make(Tok::Op, std::string(1, c)));
+        advance();
+        continue;
+      }
+      return error(make(Tok::Op, ""), std::string("unexpected character '") +
+                                          c + "'");
+    }
+    toks.push_back(make(Tok::Newline, ""));
+    toks.push_back(make(Tok::End, ""));
+    return toks;
+  }
+
+private:
+  char peek(size_t off) const {
+    return pos_ + off < src_.size() ? src_[pos_ + off] : '\0';
+  }
+
+  void advance() {
+    if (src_[pos_] == '\n') {
+      ++line_;
+      col_ = 1;
+    } else {
+      ++col_;
+    }
+    ++pos_;
+  }
+
+  Token make(Tok kind, std::string text) const {
+    Token t;
+    t.kind = kind;
+    t.text = std::move(text);
+    t.line = line_;
+    t.col = col_;
+    return t;
+  }
+
+  llvm::Error error(const Token &t, const std::string &msg) const {
+    return makeError(ErrorCode::CompilationFailed,
+                     std::to_string(t.line) + ":" + std::to_string(t.col) +
+                         ": " + msg,
+                     file_);
+  }
+
+  llvm::StringRef src_;
+  llvm::StringRef file_;
+  size_t pos_ = 0;
+  int line_ = 1;
+  int col_ = 1;
+};
+
+// ---- AST ----
+
+struct Node {
+  enum Kind { Num, Var, Call, Neg, Bin } kind = Num;
+  double value = 0.0;
+  std::string name;  // Var / Call name, Bin operator
+  std::vector<std::unique_ptr<Node>> args;
+  int line = 0;
+  int col = 0;
+};
+
+struct ParamDecl {
+  std::string name;
+  float min = 0.0f;
+  float max = 1.0f;
+  float def = 0.5f;
+};
+
+struct Program {
+  std::vector<ParamDecl> params;
+  std::vector<std::pair<std::string, std::unique_ptr<Node>>> lets;
+  std::unique_ptr<Node> out;
+};
+
+// ---- Parser ----
+
+class Parser {
+public:
+  Parser(std::vector<Token> Toks, llvm::StringRef File)
+      : toks_(std::move(Toks)), file_(File) {}
+
+  llvm::Expected<Program> run() {
+    Program prog;
+    while (cur().kind != Tok::End) {
+      if (cur().kind == Tok::Newline) {
+        ++pos_;
+        continue;
+      }
+      if (auto Err = statement(prog))
+        return std::move(Err);
+      if (cur().kind != Tok::Newline)
+        return error(cur(), "expected end of statement");
+    }
+    if (!prog.out)
+      return makeError(ErrorCode::CompilationFailed,
+                       "missing 'out = ...' statement", file_);
+    return std::move(prog);
+  }
+
+private:
+  const Token &cur() const { return toks_[pos_]; }
+
+  bool isOp(const char *op) const {
+    return cur().kind == Tok::Op && cur().text == op;
+  }
+
+  llvm::Error error(const Token &t, const std::string &msg) const {
+    return makeError(ErrorCode::CompilationFailed,
+                     std::to_string(t.line) + ":" + std::to_string(t.col) +
+                         ": " + msg,
+                     file_);
+  }
+
+  llvm::Error expectOp(const char *op) {
+    if (!isOp(op))
+      return error(cur(), std::string("expected '") + op + "'");
+    ++pos_;
+    return llvm::Error::success();
+  }
+
+  llvm::Expected<double> number() {
+    bool negative = false;
+    if (isOp("-")) {
+      negative = true;
+      ++pos_;
+    }
+    if (cur().kind != Tok::Number)
+      return error(cur(), "expected number");
+    double v = cur().value;
+    ++pos_;
+    return negative ? -v : v;
+  }
+
+  llvm::Error statement(Program &prog) {
+    if (cur().kind != Tok::Ident)
+      return error(cur(), "expected statement");
+
+    std::string keyword = cur().text;
+    if (keyword == "param") {
+      ++pos_;
+      if (cur().kind != Tok::Ident)
+        return error(cur(), "expected parameter name");
+      ParamDecl p;
+      p.name = cur().text;
+      ++pos_;
+      for (float *field : {&p.min, &p.max, &p.def}) {
+        auto v = number();
+        if (!v)
+          return v.takeError();
+        *field = static_cast<float>(*v);
+      }
+      if (prog.params.size() >= kMaxParams)
+        return error(cur(), "too many parameters");
+      prog.params.push_back(p);
+      return llvm::Error::success();
+    }
+
+    if (keyword == "let") {
+      ++pos_;
+      if (cur().kind != Tok::Ident)
+        return error(cur(), "expected variable name");
+      std::string name = cur().text;
+      ++pos_;
+      if (auto Err = expectOp("="))
+        return Err;
+      auto e = expr();
+      if (!e)
+        return e.takeError();
+      prog.lets.emplace_back(name, std::move(*e));
+      return llvm::Error::success();
+    }
+
+    if (keyword == "out") {
+      if (prog.out)
+        return error(cur(), "'out' assigned twice");
+      ++pos_;
+      if (auto Err = expectOp("="))
+        return Err;
+      auto e = expr();
+      if (!e)
+        return e.takeError();
+      prog.out = std::move(*e);
+      return llvm::Error::success();
+    }
+
+    return error(cur(), "unknown statement '" + keyword + "'");
+  }
+
+  std::unique_ptr<Node> node(Node::Kind kind, const Token &at) {
+    auto n = std::make_unique<Node>();
+    n->kind = kind;
+    n->line = at.line;
+    n->col = at.col;
+    return n;
+  }
+
+  // expr := term (('+'|'-') term)*
+  llvm::Expected<std::unique_ptr<Node>> expr() {
+    auto lhs = term();
+    if (!lhs)
+      return lhs.takeError();
+    while (isOp("+") || isOp("-")) {
+      auto n = node(Node::Bin, cur());
+      n->name = cur().text;
+      ++pos_;
+      auto rhs = term();
+      if (!rhs)
+        return rhs.takeError();
+      n->args.push_back(std::move(*lhs));
+      n->args.push_back(std::move(*rhs));
+      *lhs = std::move(n);
+    }
+    return lhs;
+  }
+
+  // term := unary (('*'|'/') unary)*
+  llvm::Expected<std::unique_ptr<Node>> term() {
+    auto lhs = unary();
+    if (!lhs)
+      return lhs.takeError();
+    while (isOp("*") || isOp("/")) {
+      auto n = node(Node::Bin, cur());
+      n->name = cur().text;
+      ++pos_;
+      auto rhs = unary();
+      if (!rhs)
+        return rhs.takeError();
+      n->args.push_back(std::move(*lhs));
+      n->args.push_back(std::move(*rhs));
+      *lhs = std::move(n);
+    }
+    return lhs;
+  }
+
+  // unary := '-' unary | power
+  llvm::Expected<std::unique_ptr<Node>> unary() {
+    if (isOp("-")) {
+      auto n = node(Node::Neg, cur());
+      ++pos_;
+      auto operand = unary();
+      if (!operand)
+        return operand.takeError();
+      n->args.push_back(std::move(*operand));
+      return std::move(n);
+    }
+    return power();
+  }
+
+  // power := primary ('^' unary)?
+  llvm::Expected<std::unique_ptr<Node>> power() {
+    auto base = primary();
+    if (!base)
+      return base.takeError();
+    if (!isOp("^"))
+      return base;
+    auto n = node(Node::Call, cur());
+    n->name = "pow";
+    ++pos_;
+    auto exponent = unary();
+    if (!exponent)
+      return exponent.takeError();
+    n->args.push_back(std::move(*base));
+    n->args.push_back(std::move(*exponent));
+    return std::move(n);
+  }
+
+  // primary := NUMBER | IDENT | IDENT '(' args ')' | '(' expr ')'
+  llvm::Expected<std::unique_ptr<Node>> primary() {
+    const Token &t = cur();
+    if (t.kind == Tok::Number) {
+      auto n = node(Node::Num, t);
+      n->value = t.value;
+      ++pos_;
+      return std::move(n);
+    }
+    if (t.kind == Tok::Ident) {
+      ++pos_;
+      if (!isOp("(")) {
+        auto n = node(Node::Var, t);
+        n->name = t.text;
+        return std::move(n);
+      }
+      auto n = node(Node::Call, t);
+      n->name = t.text;
+      ++pos_;
+      if (!isOp(")")) {
+        while (true) {
+          auto arg = expr();
+          if (!arg)
+            return arg.takeError();
+          n->args.push_back(std::move(*arg));
+          if (!isOp(","))
+            break;
+          ++pos_;
+        }
+      }
+      if (auto Err = expectOp(")"))
+        return std::move(Err);
+      return std::move(n);
+    }
+    if (isOp("(")) {
+      ++pos_;
+      auto e = expr();
+      if (!e)
+        return e.takeError();
+      if (auto Err = expectOp(")"))
+        return std::move(Err);
+      return e;
+    }
+    return error(t, "expected expression");
+  }
+
+  std::vector<Token> toks_;
+  llvm::StringRef file_;
+  size_t pos_ = 0;
+};
+
+// ---- Code generation ----
+
+class CodeGen {
+public:
+  CodeGen(const Program &P, llvm::Module &M)
+      : prog_(P), mod_(M), ctx_(M.getContext()), b_(ctx_) {
+    floatTy_ = b_.getFloatTy();
+    i32Ty_ = b_.getInt32Ty();
+    i64Ty_ = b_.getInt64Ty();
+    ptrTy_ = b_.getPtrTy();
+  }
+
+  llvm::Error run() {
+    // extern float g_params[16]; internal sample rate set by init()
+    auto *paramsTy = llvm::ArrayType::get(floatTy_, kMaxParams);
+    params_ = new llvm::GlobalVariable(mod_, paramsTy, false,
+                                       llvm::GlobalValue::ExternalLinkage,
+                                       nullptr, "g_params");
+    sampleRate_ = new llvm::GlobalVariable(
+        mod_, floatTy_, false, llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantFP::get(floatTy_, 48000.0), "expr_sample_rate");
+
+    if (auto Err = emitProcess())
+      return Err;
+    if (auto Err = emitProcessWide())
+      return Err;
+    emitInit();
+    emitParamQueries();
+    return llvm::Error::success();
+  }
+
+private:
+  using Scope = std::map<std::string, llvm::Value *>;
+
+  llvm::Error error(const Node &n, const std::string &msg) const {
+    return makeError(ErrorCode::CompilationFailed,
+                     std::to_string(n.line) + ":" + std::to_string(n.col) +
+                         ": " + msg,
+                     mod_.getModuleIdentifier());
+  }
+
+  /// Evaluates an expression in the current block; Ty is float or <W x float>
+  llvm::Expected<llvm::Value *> eval(const Node &n, const Scope &scope,
+                                     llvm::Type *ty) {
+    switch (n.kind) {
+    case Node::Num:
+      return llvm::ConstantFP::get(ty, n.value);
+
+    case Node::Var: {
+      auto it = scope.find(n.name);
+      if (it == scope.end())
+        return error(n, "unknown variable '" + n.name + "'");
+      return it->second;
+    }
+
+    case Node::Neg: {
+      auto v = eval(*n.args[0], scope, ty);
+      if (!v)
+        return v.takeError();
+      return b_.CreateFNeg(*v);
+    }
+
+    case Node::Bin: {
+      auto l = eval(*n.args[0], scope, ty);
+      if (!l)
+        return l.takeError();
+      auto r = eval(*n.args[1], scope, ty);
+      if (!r)
+        return r.takeError();
+      switch (n.name[0]) {
+      case '+':
+        return b_.CreateFAdd(*l, *r);
+      case '-':
+        return b_.CreateFSub(*l, *r);
+      case '*':
+        return b_.CreateFMul(*l, *r);
+      default:
+        return b_.CreateFDiv(*l, *r);
+      }
+    }
+
+    case Node::Call:
+      return evalCall(n, scope, ty);
+    }
+    return error(n, "invalid expression");
+  }
+
+  llvm::Expected<llvm::Value *> evalCall(const Node &n, const Scope &scope,
+                                         llvm::Type *ty) {
+    static const std::map<std::string, std::pair<llvm::Intrinsic::ID, size_t>>
+        intrinsics = {
+            {"abs", {llvm::Intrinsic::fabs, 1}},
+            {"sqrt", {llvm::Intrinsic::sqrt, 1}},
+            {"exp", {llvm::Intrinsic::exp, 1}},
+            {"log", {llvm::Intrinsic::log, 1}},
+            {"sin", {llvm::Intrinsic::sin, 1}},
+            {"cos", {llvm::Intrinsic::cos, 1}},
+            {"tanh", {llvm::Intrinsic::tanh, 1}},
+            {"floor", {llvm::Intrinsic::floor, 1}},
+            {"min", {llvm::Intrinsic::minnum, 2}},
+            {"max", {llvm::Intrinsic::maxnum, 2}},
+            {"pow", {llvm::Intrinsic::pow, 2}},
+        };
+
+    std::vector<llvm::Value *> args;
+    for (const auto &a : n.args) {
+      auto v = eval(*a, scope, ty);
+      if (!v)
+        return v.takeError();
+      args.push_back(*v);
+    }
+
+    if (n.name == "clamp") {
+      if (args.size() != 3)
+        return error(n, "clamp() takes 3 arguments");
+      auto *lo = b_.CreateBinaryIntrinsic(llvm::Intrinsic::maxnum, args[0], args[1]);
+      return b_.CreateBinaryIntrinsic(llvm::Intrinsic::minnum, lo, args[2]);
+    }
+
+    auto it = intrinsics.find(n.name);
+    if (it == intrinsics.end())
+      return error(n, "unknown function '" + n.name + "'");
+    auto [id, arity] = it->second;
+    if (args.size() != arity)
+      return error(n, n.name + "() takes " + std::to_string(arity) +
+                          " argument(s)");
+    if (arity == 1)
+      return b_.CreateUnaryIntrinsic(id, args[0]);
+    return b_.CreateBinaryIntrinsic(id, args[0], args[1]);
+  }
+
+  /// Builds the scope for one sample (or vector of samples) and evaluates
+  /// lets and the output expression. chf and paramValues_ may already be
+  /// vectors (one value per lane in process_wide).
+  llvm::Expected<llvm::Value *> evalOut(llvm::Value *in, llvm::Value *chf,
+                                        llvm::Type *ty) {
+    auto splat = [&](llvm::Value *value) -> llvm::Value * {
+      if (ty->isVectorTy() && !value->getType()->isVectorTy())
+        return b_.CreateVectorSplat(kVectorWidth, value);
+      return value;
+    };
+
+    Scope scope;
+    scope["in"] = in;
+    scope["ch"] = splat(chf);
+    scope["sr"] = splat(sampleRateValue_);
+    for (unsigned i = 0; i < kMaxParams; ++i)
+      scope["p" + std::to_string(i)] = splat(paramValues_[i]);
+    for (size_t i = 0; i < prog_.params.size(); ++i)
+      scope[prog_.params[i].name] = scope["p" + std::to_string(i)];
+
+    for (const auto &[name, e] : prog_.lets) {
+      auto v = eval(*e, scope, ty);
+      if (!v)
+        return v.takeError();
+      scope[name] = *v;
+    }
+    return eval(*prog_.out, scope, ty);
+  }
+
+  llvm::Error emitProcess() {
+    // void process(const float *const *, float *const *, uint32_t, uint32_t)
+    auto *fnTy = llvm::FunctionType::get(b_.getVoidTy(),
+                                         {ptrTy_, ptrTy_, i32Ty_, i32Ty_}, false);
+    auto *fn = llvm::Function::Create(fnTy, llvm::GlobalValue::ExternalLinkage,
+                                      "process", mod_);
+    auto argIt = fn->arg_begin();
+    llvm::Value *inputs = &*argIt++;
+    llvm::Value *outputs = &*argIt++;
+    llvm::Value *numChannels = &*argIt++;
+    llvm::Value *numFrames = &*argIt++;
+
+    auto *entry = llvm::BasicBlock::Create(ctx_, "entry", fn);
+    auto *chCond = llvm::BasicBlock::Create(ctx_, "ch.cond", fn);
+    auto *chBody = llvm::BasicBlock::Create(ctx_, "ch.body", fn);
+    auto *vecCond = llvm::BasicBlock::Create(ctx_, "vec.cond", fn);
+    auto *vecBody = llvm::BasicBlock::Create(ctx_, "vec.body", fn);
+    auto *tailCond = llvm::BasicBlock::Create(ctx_, "tail.cond", fn);
+    auto *tailBody = llvm::BasicBlock::Create(ctx_, "tail.body", fn);
+    auto *chEnd = llvm::BasicBlock::Create(ctx_, "ch.end", fn);
+    auto *exit = llvm::BasicBlock::Create(ctx_, "exit", fn);
+
+    // Parameters are read once per block, like the C++ examples do
+    b_.SetInsertPoint(entry);
+    for (unsigned i = 0; i < kMaxParams; ++i) {
+      auto *ptr = b_.CreateConstInBoundsGEP2_32(params_->getValueType(),
+                                                params_, 0, i);
+      paramValues_[i] = b_.CreateLoad(floatTy_, ptr, "p" + std::to_string(i));
+    }
+    sampleRateValue_ = b_.CreateLoad(floatTy_, sampleRate_, "sr");
+    auto *numVec = b_.CreateAnd(numFrames, ~(kVectorWidth - 1), "nvec");
+    b_.CreateBr(chCond);
+
+    // for (ch = 0; ch < num_channels; ++ch)
+    b_.SetInsertPoint(chCond);
+    auto *ch = b_.CreatePHI(i32Ty_, 2, "ch");
+    ch->addIncoming(b_.getInt32(0), entry);
+    b_.CreateCondBr(b_.CreateICmpULT(ch, numChannels), chBody, exit);
+
+    b_.SetInsertPoint(chBody);
+    auto *ch64 = b_.CreateZExt(ch, i64Ty_);
+    auto *inPtr = b_.CreateLoad(ptrTy_, b_.CreateGEP(ptrTy_, inputs, ch64), "in");
+    auto *outPtr =
+        b_.CreateLoad(ptrTy_, b_.CreateGEP(ptrTy_, outputs, ch64), "out");
+    auto *chf = b_.CreateUIToFP(ch, floatTy_, "chf");
+    b_.CreateBr(vecCond);
+
+    // Vector loop: kVectorWidth frames per iteration
+    auto *vecTy = llvm::FixedVectorType::get(floatTy_, kVectorWidth);
+    b_.SetInsertPoint(vecCond);
+    auto *i = b_.CreatePHI(i32Ty_, 2, "i");
+    i->addIncoming(b_.getInt32(0), chBody);
+    b_.CreateCondBr(b_.CreateICmpULT(i, numVec), vecBody, tailCond);
+
+    b_.SetInsertPoint(vecBody);
+    auto *i64 = b_.CreateZExt(i, i64Ty_);
+    auto *vin = b_.CreateAlignedLoad(vecTy, b_.CreateGEP(floatTy_, inPtr, i64),
+                                     llvm::Align(4), "x");
+    auto vout = evalOut(vin, chf, vecTy);
+    if (!vout)
+      return vout.takeError();
+    b_.CreateAlignedStore(*vout, b_.CreateGEP(floatTy_, outPtr, i64),
+                          llvm::Align(4));
+    auto *iNext = b_.CreateAdd(i, b_.getInt32(kVectorWidth));
+    i->addIncoming(iNext, b_.GetInsertBlock());
+    b_.CreateBr(vecCond);
+
+    // Scalar tail for the remaining frames
+    b_.SetInsertPoint(tailCond);
+    auto *j = b_.CreatePHI(i32Ty_, 2, "j");
+    j->addIncoming(numVec, vecCond);
+    b_.CreateCondBr(b_.CreateICmpULT(j, numFrames), tailBody, chEnd);
+
+    b_.SetInsertPoint(tailBody);
+    auto *j64 = b_.CreateZExt(j, i64Ty_);
+    auto *sin =
+        b_.CreateLoad(floatTy_, b_.CreateGEP(floatTy_, inPtr, j64), "x");
+    auto sout = evalOut(sin, chf, floatTy_);
+    if (!sout)
+      return sout.takeError();
+    b_.CreateStore(*sout, b_.CreateGEP(floatTy_, outPtr, j64));
+    auto *jNext = b_.CreateAdd(j, b_.getInt32(1));
+    j->addIncoming(jNext, b_.GetInsertBlock());
+    b_.CreateBr(tailCond);
+
+    b_.SetInsertPoint(chEnd);
+    ch->addIncoming(b_.CreateAdd(ch, b_.getInt32(1)), chEnd);
+    b_.CreateBr(chCond);
+
+    b_.SetInsertPoint(exit);
+    b_.CreateRetVoid();
+    return llvm::Error::success();
+  }
+
+  llvm::Error emitProcessWide() {
+    // void process_wide(const float *in, float *out, const float *params,
+    //                   const float *channels, uint32_t lanes, uint32_t frames)
+    //
+    // Runs `lanes` independent signals at once, kVectorWidth per vector:
+    // in/out are interleaved (in[frame * lanes + lane]), params is
+    // structure of arrays (params[p * lanes + lane]) and channels holds the
+    // `ch` of each lane. lanes must be a multiple of kVectorWidth.
+    auto *fnTy = llvm::FunctionType::get(
+        b_.getVoidTy(), {ptrTy_, ptrTy_, ptrTy_, ptrTy_, i32Ty_, i32Ty_}, false);
+    auto *fn = llvm::Function::Create(fnTy, llvm::GlobalValue::ExternalLinkage,
+                                      "process_wide", mod_);
+    auto argIt = fn->arg_begin();
+    llvm::Value *in = &*argIt++;
+    llvm::Value *out = &*argIt++;
+    llvm::Value *params = &*argIt++;
+    llvm::Value *channels = &*argIt++;
+    llvm::Value *numLanes = &*argIt++;
+    llvm::Value *numFrames = &*argIt++;
+
+    auto *entry = llvm::BasicBlock::Create(ctx_, "entry", fn);
+    auto *laneCond = llvm::BasicBlock::Create(ctx_, "lane.cond", fn);
+    auto *laneBody = llvm::BasicBlock::Create(ctx_, "lane.body", fn);
+    auto *frameCond = llvm::BasicBlock::Create(ctx_, "frame.cond", fn);
+    auto *frameBody = llvm::BasicBlock::Create(ctx_, "frame.body", fn);
+    auto *laneEnd = llvm::BasicBlock::Create(ctx_, "lane.end", fn);
+    auto *exit = llvm::BasicBlock::Create(ctx_, "exit", fn);
+    auto *vecTy = llvm::FixedVectorType::get(floatTy_, kVectorWidth);
+
+    b_.SetInsertPoint(entry);
+    sampleRateValue_ = b_.CreateLoad(floatTy_, sampleRate_, "sr");
+    auto *lanes64 = b_.CreateZExt(numLanes, i64Ty_);
+    b_.CreateBr(laneCond);
+
+    // for (lane = 0; lane < lanes; lane += kVectorWidth)
+    b_.SetInsertPoint(laneCond);
+    auto *lane = b_.CreatePHI(i32Ty_, 2, "lane");
+    lane->addIncoming(b_.getInt32(0), entry);
+    b_.CreateCondBr(b_.CreateICmpULT(lane, numLanes), laneBody, exit);
+
+    // Parameters and channel of these lanes, once per block
+    b_.SetInsertPoint(laneBody);
+    auto *lane64 = b_.CreateZExt(lane, i64Ty_);
+    for (unsigned i = 0; i < kMaxParams; ++i) {
+      auto *offset = b_.CreateAdd(b_.CreateMul(lanes64, b_.getInt64(i)), lane64);
+      paramValues_[i] =
+          b_.CreateAlignedLoad(vecTy, b_.CreateGEP(floatTy_, params, offset),
+                               llvm::Align(4), "p" + std::to_string(i));
+    }
+    auto *chv = b_.CreateAlignedLoad(
+        vecTy, b_.CreateGEP(floatTy_, channels, lane64), llvm::Align(4), "ch");
+    b_.CreateBr(frameCond);
+
+    b_.SetInsertPoint(frameCond);
+    auto *i = b_.CreatePHI(i32Ty_, 2, "i");
+    i->addIncoming(b_.getInt32(0), laneBody);
+    b_.CreateCondBr(b_.CreateICmpULT(i, numFrames), frameBody, laneEnd);
+
+    b_.SetInsertPoint(frameBody);
+    auto *index =
+        b_.CreateAdd(b_.CreateMul(b_.CreateZExt(i, i64Ty_), lanes64), lane64);
+    auto *x = b_.CreateAlignedLoad(vecTy, b_.CreateGEP(floatTy_, in, index),
+                                   llvm::Align(4), "x");
+    auto y = evalOut(x, chv, vecTy);
+    if (!y)
+      return y.takeError();
+    b_.CreateAlignedStore(*y, b_.CreateGEP(floatTy_, out, index), llvm::Align(4));
+    i->addIncoming(b_.CreateAdd(i, b_.getInt32(1)), b_.GetInsertBlock());
+    b_.CreateBr(frameCond);
+
+    b_.SetInsertPoint(laneEnd);
+    lane->addIncoming(b_.CreateAdd(lane, b_.getInt32(kVectorWidth)), laneEnd);
+    b_.CreateBr(laneCond);
+
+    b_.SetInsertPoint(exit);
+    b_.CreateRetVoid();
+    return llvm::Error::success();
+  }
+
+  void emitInit() {
+    // bool init(double sample_rate, uint32_t, uint32_t)
+    auto *fnTy = llvm::FunctionType::get(
+        b_.getInt1Ty(), {b_.getDoubleTy(), i32Ty_, i32Ty_}, false);
+    auto *fn = llvm::Function::Create(fnTy, llvm::GlobalValue::ExternalLinkage,
+                                      "init", mod_);
+    b_.SetInsertPoint(llvm::BasicBlock::Create(ctx_, "entry", fn));
+    b_.CreateStore(b_.CreateFPTrunc(fn->getArg(0), floatTy_), sampleRate_);
+    b_.CreateRet(b_.getTrue());
+  }
+
+  /// Emits `T name(int i)` returning table[i], or fallback when out of range
+  void emitTableQuery(const char *name, llvm::Type *retTy,
+                      llvm::Constant *table, size_t count,
+                      llvm::Constant *fallback) {
+    auto *fnTy = llvm::FunctionType::get(retTy, {i32Ty_}, false);
+    auto *fn = llvm::Function::Create(fnTy, llvm::GlobalValue::ExternalLinkage,
+                                      name, mod_);
+    auto *entry = llvm::BasicBlock::Create(ctx_, "entry", fn);
+    auto *inRange = llvm::BasicBlock::Create(ctx_, "in_range", fn);
+    auto *outOfRange = llvm::BasicBlock::Create(ctx_, "out_of_range", fn);
+
+    b_.SetInsertPoint(entry);
+    llvm::Value *idx = fn->getArg(0);
+    b_.CreateCondBr(b_.CreateICmpULT(idx, b_.getInt32(count)), inRange,
+                    outOfRange);
+
+    b_.SetInsertPoint(inRange);
+    auto *global = new llvm::GlobalVariable(
+        mod_, table->getType(), true, llvm::GlobalValue::PrivateLinkage, table,
+        std::string(name) + ".table");
+    auto *ptr = b_.CreateInBoundsGEP(table->getType(), global,
+                                     {b_.getInt32(0), idx});
+    b_.CreateRet(b_.CreateLoad(retTy, ptr));
+
+    b_.SetInsertPoint(outOfRange);
+    b_.CreateRet(fallback);
+  }
+
+  void emitParamQueries() {
+    const size_t n = prog_.params.size();
+
+    // int param_count()
+    auto *countFn = llvm::Function::Create(
+        llvm::FunctionType::get(i32Ty_, false),
+        llvm::GlobalValue::ExternalLinkage, "param_count", mod_);
+    b_.SetInsertPoint(llvm::BasicBlock::Create(ctx_, "entry", countFn));
+    b_.CreateRet(b_.getInt32(n));
+    if (n == 0)
+      return;
+
+    std::vector<llvm::Constant *> names, mins, maxs, defs;
+    for (const auto &p : prog_.params) {
+      names.push_back(b_.CreateGlobalString(p.name, "param." + p.name, 0, &mod_));
+      mins.push_back(llvm::ConstantFP::get(floatTy_, p.min));
+      maxs.push_back(llvm::ConstantFP::get(floatTy_, p.max));
+      defs.push_back(llvm::ConstantFP::get(floatTy_, p.def));
+    }
+
+    auto floatTable = [&](const std::vector<llvm::Constant *> &values) {
+      return llvm::ConstantArray::get(llvm::ArrayType::get(floatTy_, n), values);
+    };
+
+    auto *unknown = b_.CreateGlobalString("?", "param.unknown", 0, &mod_);
+    emitTableQuery("param_name", ptrTy_,
+                   llvm::ConstantArray::get(llvm::ArrayType::get(ptrTy_, n), names),
+                   n, unknown);
+    emitTableQuery("param_min", floatTy_, floatTable(mins), n,
+                   llvm::ConstantFP::get(floatTy_, 0.0));
+    emitTableQuery("param_max", floatTy_, floatTable(maxs), n,
+                   llvm::ConstantFP::get(floatTy_, 1.0));
+    emitTableQuery("param_default", floatTy_, floatTable(defs), n,
+                   llvm::ConstantFP::get(floatTy_, 0.5));
+  }
+
+  const Program &prog_;
+  llvm::Module &mod_;
+  llvm::LLVMContext &ctx_;
+  llvm::IRBuilder<> b_;
+
+  llvm::Type *floatTy_ = nullptr;
+  llvm::IntegerType *i32Ty_ = nullptr;
+  llvm::IntegerType *i64Ty_ = nullptr;
+  llvm::PointerType *ptrTy_ = nullptr;
+
+  llvm::GlobalVariable *params_ = nullptr;
+  llvm::GlobalVariable *sampleRate_ = nullptr;
+  llvm::Value *paramValues_[kMaxParams] = {};
+  llvm::Value *sampleRateValue_ = nullptr;
+};
+
+} // anonymous namespace
+
+llvm::Expected<std::unique_ptr<llvm::Module>>
+compileExpr(llvm::StringRef Source, llvm::StringRef Name,
+            llvm::LLVMContext &Ctx) {
+  auto ToksOrErr = Lexer(Source, Name).run();
+  if (!ToksOrErr)
+    return ToksOrErr.takeError();
+
+  auto ProgOrErr = Parser(std::move(*ToksOrErr), Name).run();
+  if (!ProgOrErr)
+    return ProgOrErr.takeError();
+
+  auto M = std::make_unique<llvm::Module>(Name, Ctx);
+  if (auto Err = CodeGen(*ProgOrErr, *M).run())
+    return std::move(Err);
+
+  std::string verifyErrors;
+  llvm::raw_string_ostream verifyStream(verifyErrors);
+  if (llvm::verifyModule(*M, &verifyStream)) {
+    verifyStream.flush();
+    return makeError(ErrorCode::ModuleGenerationFailed, verifyErrors, Name);
+  }
+  return std::move(M);
+}
+
+} // namespace clap_rt
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <memory>
+
+namespace clap_rt {
+
+/// Compiles an expression DSP (.expr file) straight to LLVM IR.
+///
+/// The language is a handful of statements, one per line (or ';'):
+///
+///   # comment
+///   param drive 0 1 0.5       # name, min, max, default -> p0
+///   let x = in * (1 + drive * 9)
+///   out = tanh(x) * p1
+///
+/// Inputs are `in` (current sample), `ch` (channel index), `sr` (sample
+/// rate), `p0`..`p15` (raw g_params) and declared param names. Functions:
+/// abs, sqrt, exp, log, sin, cos, tanh, floor, min, max, pow, clamp;
+/// `a ^ b` is pow(a, b).
+///
+/// The module implements the same ABI as C++ DSP files: `process` (frames
+/// processed 8 at a time with vector IR plus a scalar tail), `init`, and
+/// param_count/param_name/param_min/param_max/param_default. Parameters
+/// are read from the external `g_params` array.
+///
+/// It also defines `process_wide`, which runs many signals (e.g. the
+/// channels of several plugin instances) side by side, one per vector lane,
+/// each with its own parameters:
+///
+///   void process_wide(const float *in, float *out, const float *params,
+///                     const float *channels, uint32_t lanes, uint32_t frames)
+///
+/// in/out are interleaved (in[frame * lanes + lane]), params holds
+/// params[p * lanes + lane] for p < 16 and channels the `ch` of each lane.
+/// lanes must be a multiple of 8.
+[[nodiscard]] llvm::Expected<std::unique_ptr<llvm::Module>>
+compileExpr(llvm::StringRef Source, llvm::StringRef Name,
+            llvm::LLVMContext &Ctx);
+
+} // namespace clap_rt
@@ -1,5 +1,9 @@
 #include "JIT.h"
+#include "CompileOptions.h"
+#include "Chain.h"
 #include "Error.h"
+#include "Expr.h"
+#include "SlabMemory.h"
 
 #include <clang/Basic/DiagnosticOptions.h>
 #include <clang/Basic/Version.h>
@@ -9,26 +13,52 @@
 #include <clang/Driver/Job.h>
 #include <clang/Frontend/CompilerInstance.h>
 #include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Frontend/PreprocessorOutputOptions.h>
 #include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Frontend/Utils.h>
 #include <clang/Lex/HeaderSearchOptions.h>
 #include <clang/Lex/PreprocessorOptions.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/Demangle/Demangle.h>
+#include <llvm/ExecutionEngine/Orc/EHFrameRegistrationPlugin.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 #include <llvm/ExecutionEngine/Orc/EPCDynamicLibrarySearchGenerator.h>
-#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/MC/TargetRegistry.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/VirtualFileSystem.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/TargetParser/Host.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 
+#include <algorithm>
 #include <cctype>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+
+#include <dlfcn.h>
+#include <link.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace clap_rt {
 
@@ -77,47 +107,126 @@ std::string detectClangIncludePath() {
   return "/usr/lib/clang/" + version + "/include"; // Fallback
 }
 
-} // anonymous namespace
+// Include directories found by probing the system
+struct Toolchain {
+  std::string libstdcxx;       // Empty if no libstdc++ headers were found
+  std::string libstdcxxTarget; // Target headers (bits/c++config.h), or empty
+  std::string clangInclude;
+};
+
+// Changes when a GCC version is installed or removed, or Clang is upgraded
+std::string toolchainStamp() {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time("/usr/include/c++", ec);
+  return "clang " + std::to_string(CLANG_VERSION_MAJOR) + " " +
+         (ec ? "-" : std::to_string(time.time_since_epoch().count()));
+}
 
-void ClapJIT::initializeLLVM() {
-  llvm::InitializeNativeTarget();
-  llvm::InitializeNativeTargetAsmParser();
-  llvm::InitializeNativeTargetAsmPrinter();
+Toolchain probeToolchain() {
+  Toolchain T;
+  T.libstdcxx = detectLibstdcxxPath();
+  if (!T.libstdcxx.empty()) {
+    std::string target =
+        T.libstdcxx + "/../../x86_64-linux-gnu/" +
+        std::filesystem::path(T.libstdcxx).filename().string();
+    if (std::filesystem::exists(target))
+      T.libstdcxxTarget = target;
+  }
+  T.clangInclude = detectClangIncludePath();
+  return T;
 }
 
-llvm::Expected<ClapJIT> ClapJIT::create(JITOptions opts) {
-  ClapJIT jit;
-  jit.options_ = std::move(opts);
+// Write then rename, as for objects: the cache may be shared by several
+// machines, and readers must never see a half-written file
+void writeCacheFile(const std::string &Path,
+                    llvm::function_ref<void(llvm::raw_ostream &)> Write) {
+  std::filesystem::create_directories(std::filesystem::path(Path).parent_path());
+  std::string tmpPath = Path + ".tmp" + std::to_string(::getpid());
+  {
+    std::error_code EC;
+    llvm::raw_fd_ostream out(tmpPath, EC, llvm::sys::fs::OF_None);
+    if (EC)
+      return;
+    Write(out);
+  }
+  if (llvm::sys::fs::rename(tmpPath, Path))
+    llvm::sys::fs::remove(tmpPath);
+}
 
-  auto JITOrErr = orc::LLJITBuilder().create();
-  if (!JITOrErr)
-    return JITOrErr.takeError();
+// Probe results persisted in the cache directory. The cache may be shared
+// by several machines, so each host has its own file.
+std::string toolchainFile(llvm::StringRef CacheDir) {
+  char host[256] = {};
+  if (::gethostname(host, sizeof(host) - 1) != 0)
+    host[0] = '\0';
+  return (std::filesystem::path(CacheDir.str()) /
+          ("toolchain-" + std::string(host)))
+      .string();
+}
 
-  jit.llJIT_ = std::move(*JITOrErr);
+std::optional<Toolchain> readToolchain(const std::string &Path,
+                                       llvm::StringRef Stamp) {
+  auto Buf = llvm::MemoryBuffer::getFile(Path);
+  if (!Buf)
+    return std::nullopt;
+  llvm::SmallVector<llvm::StringRef, 4> Lines;
+  (*Buf)->getBuffer().split(Lines, '\n');
+  if (Lines.size() < 4 || Lines[0] != Stamp)
+    return std::nullopt;
+  return Toolchain{Lines[1].str(), Lines[2].str(), Lines[3].str()};
+}
 
-  // Allow JIT to resolve symbols from the host process and C++ runtime
-  auto &ES = jit.llJIT_->getExecutionSession();
-  auto &MainJD = jit.llJIT_->getMainJITDylib();
+void writeToolchain(const std::string &Path, llvm::StringRef Stamp,
+                    const Toolchain &T) {
+  writeCacheFile(Path, [&](llvm::raw_ostream &OS) {
+    OS << Stamp << '\n'
+       << T.libstdcxx << '\n'
+       << T.libstdcxxTarget << '\n'
+       << T.clangInclude << '\n';
+  });
+}
 
-  // Load libstdc++ for STL support
-  auto LibStdCxxGen = orc::EPCDynamicLibrarySearchGenerator::Load(ES, "libstdc++.so.6");
-  if (!LibStdCxxGen) {
-    LibStdCxxGen = orc::EPCDynamicLibrarySearchGenerator::Load(ES, "libstdc++.so");
+// Toolchain probe and driver output, shared by every ClapJIT of the process
+std::mutex g_toolchainMutex;
+std::optional<Toolchain> g_toolchain;
+std::map<std::string, std::shared_ptr<const clang::CompilerInvocation>>
+    g_invocations;
+
+// Probes once per process. With a cache directory the result is also kept
+// on disk, so the next process skips the directory scan.
+Toolchain getToolchain(llvm::StringRef CacheDir) {
+  std::lock_guard<std::mutex> lock(g_toolchainMutex);
+  if (g_toolchain)
+    return *g_toolchain;
+
+  std::string stamp = toolchainStamp();
+  std::string path = CacheDir.empty() ? "" : toolchainFile(CacheDir);
+  if (!path.empty())
+    g_toolchain = readToolchain(path, stamp);
+  if (!g_toolchain) {
+    g_toolchain = probeToolchain();
+    if (!path.empty())
+      writeToolchain(path, stamp, *g_toolchain);
   }
-  if (LibStdCxxGen)
-    MainJD.addGenerator(std::move(*LibStdCxxGen));
+  return *g_toolchain;
+}
 
-  // Also search in the host process
-  auto DLSG = orc::EPCDynamicLibrarySearchGenerator::GetForTargetProcess(ES);
-  if (!DLSG)
-    return DLSG.takeError();
-  MainJD.addGenerator(std::move(*DLSG));
+// Placeholder input the invocation templates are built for
+constexpr llvm::StringRef kTemplateInput = "rtclap-input.cc";
 
-  return jit;
-}
+// Chain nodes are compiled with optimizations on but no IR passes run, so
+// functions are not marked optnone and the fused module can inline them
+const std::vector<std::string> kChainNodeFlags = {"-O2", "-Xclang",
+                                                  "-disable-llvm-passes"};
 
-llvm::Expected<std::unique_ptr<llvm::Module>>
-ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
+const char *const kChainEntryPoints[] = {
+    "process",   "init",      "destroy",  "param_count",
+    "param_name", "param_min", "param_max", "param_default",
+};
+
+// Runs the driver for the placeholder input and parses its cc1 arguments
+llvm::Expected<std::shared_ptr<const clang::CompilerInvocation>>
+buildInvocation(const JITOptions &Opts, llvm::ArrayRef<std::string> FileOptions) {
   // Build command-line arguments for clang
   std::vector<std::string> argStorage;
   std::vector<const char *> Args;
@@ -125,7 +234,7 @@ ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
   argStorage.push_back("clang++");
 
   // Language standard
-  switch (options_.langStandard) {
+  switch (Opts.langStandard) {
   case LangStandard::CXX14:
     argStorage.push_back("-std=c++14");
     break;
@@ -137,22 +246,19 @@ ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
     break;
   }
 
+  Toolchain T = getToolchain(Opts.cacheDir);
+
   // Linux: Use libstdc++ (system default)
-  std::string libstdcxxPath = detectLibstdcxxPath();
-  if (!libstdcxxPath.empty()) {
-    argStorage.push_back("-I" + libstdcxxPath);
+  if (!T.libstdcxx.empty()) {
+    argStorage.push_back("-I" + T.libstdcxx);
     // Platform-specific headers (e.g., bits/c++config.h)
-    std::string platformPath = libstdcxxPath + "/../../x86_64-linux-gnu/" +
-                               std::filesystem::path(libstdcxxPath).filename().string();
-    if (std::filesystem::exists(platformPath)) {
-      argStorage.push_back("-I" + platformPath);
-    }
+    if (!T.libstdcxxTarget.empty())
+      argStorage.push_back("-I" + T.libstdcxxTarget);
   }
 
   // Clang builtins
-  std::string clangPath = detectClangIncludePath();
-  if (!clangPath.empty()) {
-    argStorage.push_back("-I" + clangPath);
+  if (!T.clangInclude.empty()) {
+    argStorage.push_back("-I" + T.clangInclude);
   }
 
   // System headers
@@ -160,12 +266,17 @@ ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
   argStorage.push_back("-I/usr/include");
 
   // Add user include paths
-  for (const auto &path : options_.includePaths) {
+  for (const auto &path : Opts.includePaths) {
     argStorage.push_back("-I" + path);
   }
 
-  // File to compile
-  argStorage.push_back(FilePath.str());
+  // Per-file options (already checked against the allowlist)
+  for (const auto &opt : FileOptions) {
+    argStorage.push_back(opt);
+  }
+
+  // File to compile, replaced per compile
+  argStorage.push_back(kTemplateInput.str());
 
   // Output as LLVM IR (not used, but needed for driver)
   argStorage.push_back("-emit-llvm");
@@ -185,11 +296,11 @@ ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
       new clang::DiagnosticsEngine(
           llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs>(
               new clang::DiagnosticIDs()),
-          diagOpts, diagPrinter, false);
+          diagOpts, diagPrinter);
 
-  std::string triple = options_.targetTriple.empty()
+  std::string triple = Opts.targetTriple.empty()
                            ? llvm::sys::getProcessTriple()
-                           : options_.targetTriple;
+                           : Opts.targetTriple;
 
   clang::driver::Driver Driver("clang++", triple, *Diags);
   Driver.setCheckInputsExist(false);
@@ -197,13 +308,13 @@ ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
   std::unique_ptr<clang::driver::Compilation> C(Driver.BuildCompilation(Args));
   if (!C) {
     return makeError(ErrorCode::CompilationFailed,
-                     "Failed to create compilation", FilePath);
+                     "Failed to create compilation", kTemplateInput);
   }
 
   const clang::driver::JobList &Jobs = C->getJobs();
   if (Jobs.size() != 1 || !clang::isa<clang::driver::Command>(*Jobs.begin())) {
     return makeError(ErrorCode::CompilationFailed,
-                     "Expected exactly one compile job", FilePath);
+                     "Expected exactly one compile job", kTemplateInput);
   }
 
   const clang::driver::Command &Cmd =
@@ -211,24 +322,97 @@ ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
   const llvm::opt::ArgStringList &CCArgs = Cmd.getArguments();
 
   // Create compiler invocation from driver-generated args
-  clang::CompilerInstance CI;
-  if (!clang::CompilerInvocation::CreateFromArgs(CI.getInvocation(), CCArgs, *Diags)) {
+  auto Invocation = std::make_shared<clang::CompilerInvocation>();
+  if (!clang::CompilerInvocation::CreateFromArgs(*Invocation, CCArgs, *Diags)) {
     diagStream.flush();
     return makeError(ErrorCode::CompilationFailed,
                      "Failed to create CompilerInvocation: " + diagOutput,
-                     FilePath);
+                     kTemplateInput);
   }
+  return Invocation;
+}
 
-  CI.createDiagnostics(diagPrinter, false);
+// The driver's cc1 arguments only depend on the JIT configuration and the
+// per-file flags, so each combination is resolved once per process
+llvm::Expected<std::shared_ptr<const clang::CompilerInvocation>>
+getInvocation(const JITOptions &Opts, llvm::ArrayRef<std::string> FileOptions) {
+  std::string key = std::to_string(static_cast<int>(Opts.langStandard)) +
+                    '\0' + Opts.targetTriple;
+  for (const auto &path : Opts.includePaths) {
+    key += '\0';
+    key += "-I" + path;
+  }
+  for (const auto &opt : FileOptions) {
+    key += '\0';
+    key += opt;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(g_toolchainMutex);
+    if (auto it = g_invocations.find(key); it != g_invocations.end())
+      return it->second;
+  }
+
+  auto InvocationOrErr = buildInvocation(Opts, FileOptions);
+  if (!InvocationOrErr)
+    return InvocationOrErr.takeError();
+
+  std::lock_guard<std::mutex> lock(g_toolchainMutex);
+  g_invocations.emplace(key, *InvocationOrErr);
+  return *InvocationOrErr;
+}
+
+// Runs Act on a file with the driver's arguments for the flags. Reads go
+// through Opts.sourceCache if set; Contents replaces the file on disk.
+llvm::Error runFrontendAction(const JITOptions &Opts, clang::FrontendAction &Act,
+                              llvm::StringRef FilePath,
+                              llvm::ArrayRef<std::string> FileOptions,
+                              std::optional<llvm::StringRef> Contents) {
+  auto TemplateOrErr = getInvocation(Opts, FileOptions);
+  if (!TemplateOrErr) {
+    std::string message = llvm::toString(TemplateOrErr.takeError());
+    return makeError(ErrorCode::CompilationFailed, message, FilePath);
+  }
+
+  // Copy the template and point it at this file
+  auto Invocation = std::make_shared<clang::CompilerInvocation>(**TemplateOrErr);
+  auto &Inputs = Invocation->getFrontendOpts().Inputs;
+  Inputs = {clang::FrontendInputFile(FilePath, Inputs.front().getKind())};
+  Invocation->getCodeGenOpts().MainFileName =
+      llvm::sys::path::filename(FilePath).str();
+
+  // Set up diagnostics
+  std::string diagOutput;
+  llvm::raw_string_ostream diagStream(diagOutput);
+  clang::DiagnosticOptions diagOpts;
+  clang::TextDiagnosticPrinter diagPrinter(diagStream, diagOpts);
+
+  // Reads go through the shared cache if there is one, with an in-memory
+  // source layered on top under its own path
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> FS =
+      llvm::vfs::getRealFileSystem();
+  if (Opts.sourceCache)
+    FS = Opts.sourceCache;
+  if (Contents) {
+    auto Overlay = llvm::makeIntrusiveRefCnt<llvm::vfs::OverlayFileSystem>(FS);
+    auto Memory = llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>();
+    // Pushed first so it shares the working directory relative paths use
+    Overlay->pushOverlay(Memory);
+    Memory->addFile(FilePath, 0,
+                    llvm::MemoryBuffer::getMemBufferCopy(*Contents, FilePath));
+    FS = Overlay;
+  }
+
+  clang::CompilerInstance CI(std::move(Invocation));
+  CI.createDiagnostics(&diagPrinter, false);
   if (!CI.hasDiagnostics()) {
     return makeError(ErrorCode::CompilationFailed,
                      "Failed to create diagnostics", FilePath);
   }
 
-  // Execute the EmitLLVMOnlyAction
-  auto Act = std::make_unique<clang::EmitLLVMOnlyAction>(&Ctx);
+  CI.createFileManager(FS);
 
-  if (!CI.ExecuteAction(*Act)) {
+  if (!CI.ExecuteAction(Act)) {
     diagStream.flush();
     std::string errMsg = "Compilation failed";
     if (!diagOutput.empty()) {
@@ -236,6 +420,276 @@ ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
     }
     return makeError(ErrorCode::CompilationFailed, errMsg, FilePath);
   }
+  return llvm::Error::success();
+}
+
+// Prints the preprocessed translation unit without line markers and with
+// whitespace minimized, so edits to comments and layout leave it unchanged
+class MinimizedPreprocessAction : public clang::PreprocessorFrontendAction {
+public:
+  explicit MinimizedPreprocessAction(std::string &Out) : out_(Out) {}
+
+protected:
+  void ExecuteAction() override {
+    clang::PreprocessorOutputOptions Opts;
+    Opts.ShowCPP = 1;
+    Opts.ShowLineMarkers = 0;
+    Opts.MinimizeWhitespace = 1;
+    llvm::raw_string_ostream OS(out_);
+    clang::DoPrintPreprocessedInput(getCompilerInstance().getPreprocessor(),
+                                    &OS, Opts);
+  }
+
+private:
+  std::string &out_;
+};
+
+// Appends per-file options to a cache key. "native" stands for a different
+// CPU on each machine sharing a cache dir, so the host CPU is hashed too.
+void appendOptionsKey(std::string &Key, llvm::ArrayRef<std::string> FileOptions) {
+  for (const auto &opt : FileOptions) {
+    Key += '\0';
+    Key += opt;
+    if (opt == "-march=native" || opt == "-mtune=native")
+      Key += "=" + hostCpuDescription();
+  }
+}
+
+// Key of a file in the bitcode cache: its tokens after preprocessing, the
+// flags and everything else that changes what the frontend emits
+llvm::Expected<uint64_t> hashPreprocessed(const JITOptions &Opts,
+                                          llvm::StringRef FilePath,
+                                          llvm::ArrayRef<std::string> FileOptions) {
+  std::string text;
+  MinimizedPreprocessAction Act(text);
+  if (auto Err = runFrontendAction(Opts, Act, FilePath, FileOptions,
+                                   std::nullopt))
+    return std::move(Err);
+
+  text += '\0';
+  text += CLANG_VERSION_STRING;
+  text += '\0' + std::to_string(static_cast<int>(Opts.langStandard));
+  text += '\0' + Opts.targetTriple;
+  appendOptionsKey(text, FileOptions);
+  return llvm::xxh3_64bits(text);
+}
+
+// The optimization pipeline Clang runs for an invocation's options
+struct Pipeline {
+  llvm::OptimizationLevel level = llvm::OptimizationLevel::O0;
+  llvm::PipelineTuningOptions tuning;
+};
+
+Pipeline pipelineFor(const clang::CodeGenOptions &CGO) {
+  Pipeline P;
+  switch (CGO.OptimizationLevel) {
+  case 0:
+    P.level = llvm::OptimizationLevel::O0;
+    break;
+  case 1:
+    P.level = llvm::OptimizationLevel::O1;
+    break;
+  case 2:
+    P.level = CGO.OptimizeSize == 0   ? llvm::OptimizationLevel::O2
+              : CGO.OptimizeSize == 1 ? llvm::OptimizationLevel::Os
+                                      : llvm::OptimizationLevel::Oz;
+    break;
+  default:
+    P.level = llvm::OptimizationLevel::O3;
+    break;
+  }
+  P.tuning.LoopUnrolling = CGO.UnrollLoops;
+  P.tuning.LoopInterleaving = CGO.UnrollLoops;
+  P.tuning.LoopVectorization = CGO.VectorizeLoop;
+  P.tuning.SLPVectorization = CGO.VectorizeSLP;
+  return P;
+}
+
+// Resolves symbols from the link tables of cached objects (see
+// JITOptions::prelink). Runs before the library search generators, and
+// like them only for symbols no module of the JIT defines.
+class PrelinkGenerator : public orc::DefinitionGenerator {
+public:
+  explicit PrelinkGenerator(std::shared_ptr<llvm::StringMap<uint64_t>> Table)
+      : table_(std::move(Table)) {}
+
+  llvm::Error tryToGenerate(orc::LookupState &, orc::LookupKind,
+                            orc::JITDylib &JD, orc::JITDylibLookupFlags,
+                            const orc::SymbolLookupSet &Symbols) override {
+    orc::SymbolMap Defs;
+    for (const auto &[Name, Flags] : Symbols) {
+      auto it = table_->find(*Name);
+      if (it != table_->end())
+        Defs[Name] = {orc::ExecutorAddr(it->second),
+                      llvm::JITSymbolFlags::Exported};
+    }
+    if (Defs.empty())
+      return llvm::Error::success();
+    return JD.define(orc::absoluteSymbols(std::move(Defs)));
+  }
+
+private:
+  std::shared_ptr<llvm::StringMap<uint64_t>> table_;
+};
+
+// A shared library as recorded in a link table
+struct LinkedLibrary {
+  std::string path;
+  uint64_t size = 0;
+  int64_t mtime = 0;
+};
+
+// Identity of a library file, to notice upgrades between processes
+std::optional<LinkedLibrary> identifyLibrary(const std::string &Path) {
+  struct stat st;
+  if (::stat(Path.c_str(), &st) != 0)
+    return std::nullopt;
+  return LinkedLibrary{Path, static_cast<uint64_t>(st.st_size),
+                       static_cast<int64_t>(st.st_mtime)};
+}
+
+// Load base of a library mapped into this process, by the path the
+// dynamic loader knows it under
+std::optional<uint64_t> libraryBase(const std::string &Path) {
+  struct Search {
+    const std::string *path;
+    std::optional<uint64_t> base;
+  } search{&Path, std::nullopt};
+  ::dl_iterate_phdr(
+      [](struct dl_phdr_info *Info, size_t, void *Data) {
+        auto *S = static_cast<Search *>(Data);
+        if (Info->dlpi_name && *S->path == Info->dlpi_name) {
+          S->base = Info->dlpi_addr;
+          return 1;
+        }
+        return 0;
+      },
+      &search);
+  return search.base;
+}
+
+// Where a library recorded in a link table is mapped now, or nullopt if
+// it isn't loaded or is no longer the same file. Checked once per process.
+std::optional<uint64_t> validateLibrary(const LinkedLibrary &Lib) {
+  static std::mutex mutex;
+  static std::map<std::string, std::optional<uint64_t>> checked;
+
+  std::string key = Lib.path + '\0' + std::to_string(Lib.size) + '\0' +
+                    std::to_string(Lib.mtime);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (auto it = checked.find(key); it != checked.end())
+    return it->second;
+
+  std::optional<uint64_t> base;
+  auto current = identifyLibrary(Lib.path);
+  if (current && current->size == Lib.size && current->mtime == Lib.mtime)
+    base = libraryBase(Lib.path);
+  checked.emplace(key, base);
+  return base;
+}
+
+// Resolves an external symbol the way the JIT's generators would: the C++
+// runtime first, then the process
+void *resolveExternal(const std::string &Name) {
+  static void *libstdcxx = [] {
+    void *handle = ::dlopen("libstdc++.so.6", RTLD_LAZY | RTLD_NOLOAD);
+    return handle ? handle : ::dlopen("libstdc++.so", RTLD_LAZY | RTLD_NOLOAD);
+  }();
+  if (libstdcxx) {
+    if (void *addr = ::dlsym(libstdcxx, Name.c_str()))
+      return addr;
+  }
+  return ::dlsym(RTLD_DEFAULT, Name.c_str());
+}
+
+} // anonymous namespace
+
+void ClapJIT::initializeLLVM() {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmParser();
+  llvm::InitializeNativeTargetAsmPrinter();
+}
+
+void ClapJIT::releaseMemory() {
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+}
+
+void ClapJIT::resetToolchain() {
+  std::lock_guard<std::mutex> lock(g_toolchainMutex);
+  g_toolchain.reset();
+  g_invocations.clear();
+}
+
+llvm::Expected<ClapJIT> ClapJIT::create(JITOptions opts) {
+  ClapJIT jit;
+  jit.options_ = std::move(opts);
+
+  orc::LLJITBuilder Builder;
+  SlabMemoryManager *Slab =
+      jit.options_.slabMemory ? SlabMemoryManager::get() : nullptr;
+  if (Slab) {
+    // LLJIT only sets these up for JITLink when it makes the layer itself
+    auto JTMB = orc::JITTargetMachineBuilder::detectHost();
+    if (!JTMB)
+      return JTMB.takeError();
+    JTMB->setRelocationModel(llvm::Reloc::PIC_);
+    JTMB->setCodeModel(llvm::CodeModel::Small);
+    Builder.setJITTargetMachineBuilder(std::move(*JTMB));
+    Builder.setObjectLinkingLayerCreator(
+        [Slab](orc::ExecutionSession &ES)
+            -> llvm::Expected<std::unique_ptr<orc::ObjectLayer>> {
+          auto Layer = std::make_unique<orc::ObjectLinkingLayer>(ES, *Slab);
+          auto EHFrames = orc::EHFrameRegistrationPlugin::Create(ES);
+          if (!EHFrames)
+            return EHFrames.takeError();
+          Layer->addPlugin(std::move(*EHFrames));
+          return std::move(Layer);
+        });
+  }
+
+  auto JITOrErr = Builder.create();
+  if (!JITOrErr)
+    return JITOrErr.takeError();
+
+  jit.llJIT_ = std::move(*JITOrErr);
+
+  // Allow JIT to resolve symbols from the host process and C++ runtime
+  auto &ES = jit.llJIT_->getExecutionSession();
+  auto &MainJD = jit.llJIT_->getMainJITDylib();
+
+  // Symbols recorded in link tables resolve without a library search
+  jit.prelinked_ = std::make_shared<llvm::StringMap<uint64_t>>();
+  if (jit.options_.prelink)
+    MainJD.addGenerator(std::make_unique<PrelinkGenerator>(jit.prelinked_));
+
+  // Load libstdc++ for STL support
+  auto LibStdCxxGen = orc::EPCDynamicLibrarySearchGenerator::Load(ES, "libstdc++.so.6");
+  if (!LibStdCxxGen) {
+    LibStdCxxGen = orc::EPCDynamicLibrarySearchGenerator::Load(ES, "libstdc++.so");
+  }
+  if (LibStdCxxGen)
+    MainJD.addGenerator(std::move(*LibStdCxxGen));
+
+  // Also search in the host process
+  auto DLSG = orc::EPCDynamicLibrarySearchGenerator::GetForTargetProcess(ES);
+  if (!DLSG)
+    return DLSG.takeError();
+  MainJD.addGenerator(std::move(*DLSG));
+
+  return jit;
+}
+
+llvm::Expected<std::unique_ptr<llvm::Module>>
+ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx,
+                           llvm::ArrayRef<std::string> FileOptions,
+                           std::optional<llvm::StringRef> Contents) {
+  // Execute the EmitLLVMOnlyAction
+  auto Act = std::make_unique<clang::EmitLLVMOnlyAction>(&Ctx);
+  if (auto Err =
+          runFrontendAction(options_, *Act, FilePath, FileOptions, Contents))
+    return std::move(Err);
 
   std::unique_ptr<llvm::Module> M = Act->takeModule();
   if (!M) {
@@ -246,63 +700,156 @@ ClapJIT::compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
   return M;
 }
 
+llvm::Error ClapJIT::addExprModule(llvm::StringRef FilePath) {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(FilePath);
+  if (!BufOrErr)
+    return makeError(ErrorCode::CompilationFailed,
+                     BufOrErr.getError().message(), FilePath);
+
+  auto Ctx = std::make_unique<llvm::LLVMContext>();
+  auto IROrErr = compileExpr((*BufOrErr)->getBuffer(), FilePath, *Ctx);
+  if (!IROrErr)
+    return IROrErr.takeError();
+
+  (*IROrErr)->setTargetTriple(llJIT_->getTargetTriple());
+  (*IROrErr)->setDataLayout(llJIT_->getDataLayout());
+
+  collectSymbols(**IROrErr, symbols_);
+
+  // Lowering takes well under a millisecond, so there is nothing to cache
+  return addCompiledModule(std::move(*IROrErr), std::move(Ctx));
+}
+
+llvm::Error
+ClapJIT::addCompiledModule(std::unique_ptr<llvm::Module> M,
+                           std::unique_ptr<llvm::LLVMContext> Ctx) {
+  if (!hostTM_) {
+    // Same target LLJIT compiles IR modules for
+    auto JTMB = orc::JITTargetMachineBuilder::detectHost();
+    if (!JTMB)
+      return JTMB.takeError();
+    JTMB->setRelocationModel(llvm::Reloc::PIC_);
+    JTMB->setCodeModel(llvm::CodeModel::Small);
+    auto TMOrErr = JTMB->createTargetMachine();
+    if (!TMOrErr)
+      return TMOrErr.takeError();
+    hostTM_ = std::move(*TMOrErr);
+  }
+
+  auto ObjOrErr = orc::SimpleCompiler(*hostTM_)(*M);
+  if (!ObjOrErr)
+    return ObjOrErr.takeError();
+
+  // Only the object is kept: the JIT frees it once linked
+  M.reset();
+  Ctx.reset();
+  return llJIT_->addObjectFile(std::move(*ObjOrErr));
+}
+
 llvm::Error ClapJIT::addModule(llvm::StringRef FilePath) {
+  sourceFiles_.push_back(FilePath.str());
+  if (FilePath.ends_with(".expr"))
+    return addExprModule(FilePath);
+
+  auto FileOptionsOrErr = readCompileOptions(FilePath);
+  if (!FileOptionsOrErr)
+    return FileOptionsOrErr.takeError();
+  const auto &fileOptions = *FileOptionsOrErr;
+
   // Check if we have a valid cache
-  std::string cachePath = getCachePath(FilePath);
+  std::string cachePath = getCachePath(FilePath, fileOptions);
   std::string symPath = cachePath.empty() ? "" : cachePath + ".sym";
+  // Files that pick their own -march keep it instead of being retargeted
+  const bool multiLevel = !cachePath.empty() && !options_.cacheLevels.empty() &&
+                          !pinsTargetCPU(fileOptions);
 
-  if (isCacheValid(FilePath, cachePath)) {
+  std::string cachedObject =
+      multiLevel ? findCachedLevel(FilePath, cachePath) : cachePath;
+  if (isCacheValid(FilePath, cachedObject)) {
     // Try to load symbols from cache
-    if (std::filesystem::exists(symPath)) {
-      std::ifstream symFile(symPath);
-      std::string line;
-      while (std::getline(symFile, line)) {
-        auto sep = line.find('\t');
-        if (sep != std::string::npos) {
-          symbols_.emplace_back(line.substr(0, sep), line.substr(sep + 1));
-        }
-      }
+    if (auto SymBuf = llvm::MemoryBuffer::getFile(symPath)) {
+      addSymbolTable((*SymBuf)->getBuffer());
       // Load cached object - full cache hit
-      return loadCachedObject(cachePath);
+      return loadCachedObject(cachedObject);
     }
   }
 
-  // Compile from source
+  // Compile from source. With a cache, the frontend's output is kept too,
+  // so a new object after an edit that left the tokens alone, or for other
+  // CPU levels, starts from bitcode
   auto Ctx = std::make_unique<llvm::LLVMContext>();
-  auto IROrErr = compileSingleFile(FilePath, *Ctx);
+  auto IROrErr = cachePath.empty()
+                     ? compileSingleFile(FilePath, *Ctx, fileOptions)
+                     : compileViaBitcode(FilePath, *Ctx, fileOptions);
   if (!IROrErr)
     return IROrErr.takeError();
 
   // Collect symbols
   std::vector<SymbolEntry> newSymbols;
-  for (const auto &F : **IROrErr) {
-    if (!F.isDeclaration()) {
-      std::string mangled = F.getName().str();
-      std::string demangled = llvm::demangle(mangled);
-      newSymbols.emplace_back(demangled, mangled);
+  collectSymbols(**IROrErr, newSymbols);
+  symbols_.insert(symbols_.end(), newSymbols.begin(), newSymbols.end());
+
+  auto saveSymbols = [&] {
+    std::ofstream symFile(symPath);
+    for (const auto &[demangled, mangled] : newSymbols) {
+      symFile << demangled << '\t' << mangled << '\n';
+    }
+  };
+
+  // Multi-level cache: emit every level, then run the best one directly
+  if (multiLevel) {
+    if (auto Err = compileAndCacheLevels(**IROrErr, cachePath)) {
+      llvm::consumeError(std::move(Err));
+    } else {
+      saveSymbols();
+      std::string best = findCachedLevel(FilePath, cachePath);
+      if (!best.empty())
+        return loadCachedObject(best);
     }
   }
-  symbols_.insert(symbols_.end(), newSymbols.begin(), newSymbols.end());
 
   // Save to cache if caching is enabled
-  if (!cachePath.empty()) {
+  if (!cachePath.empty() && !multiLevel) {
     if (auto Err = compileAndCache(**IROrErr, cachePath)) {
       llvm::consumeError(std::move(Err));
     } else {
       // Save symbols to cache
-      std::ofstream symFile(symPath);
-      for (const auto &[demangled, mangled] : newSymbols) {
-        symFile << demangled << '\t' << mangled << '\n';
-      }
+      saveSymbols();
     }
   }
 
-  auto TSM = orc::ThreadSafeModule(std::move(*IROrErr), std::move(Ctx));
+  return addCompiledModule(std::move(*IROrErr), std::move(Ctx));
+}
 
-  if (auto Err = llJIT_->addIRModule(std::move(TSM)))
-    return Err;
+llvm::Error ClapJIT::addModuleFromBuffer(llvm::StringRef Name,
+                                         llvm::StringRef Source) {
+  // Absolute, so includes resolve the same way as for a file on disk
+  llvm::SmallString<128> path(Name);
+  llvm::sys::fs::make_absolute(path);
 
-  return llvm::Error::success();
+  auto Ctx = std::make_unique<llvm::LLVMContext>();
+  std::unique_ptr<llvm::Module> M;
+  if (Name.ends_with(".expr")) {
+    auto IROrErr = compileExpr(Source, path, *Ctx);
+    if (!IROrErr)
+      return IROrErr.takeError();
+    M = std::move(*IROrErr);
+    M->setTargetTriple(llJIT_->getTargetTriple());
+    M->setDataLayout(llJIT_->getDataLayout());
+  } else {
+    auto FileOptionsOrErr = parseCompileOptions(Source, path);
+    if (!FileOptionsOrErr)
+      return FileOptionsOrErr.takeError();
+    auto IROrErr = compileSingleFile(path, *Ctx, *FileOptionsOrErr, Source);
+    if (!IROrErr)
+      return IROrErr.takeError();
+    M = std::move(*IROrErr);
+  }
+
+  collectSymbols(*M, symbols_);
+
+  // No file and no timestamp to key the object cache on
+  return addCompiledModule(std::move(M), std::move(Ctx));
 }
 
 llvm::Error ClapJIT::addModules(llvm::ArrayRef<llvm::StringRef> FilePaths) {
@@ -313,6 +860,500 @@ llvm::Error ClapJIT::addModules(llvm::ArrayRef<llvm::StringRef> FilePaths) {
   return llvm::Error::success();
 }
 
+llvm::Error ClapJIT::addChain(llvm::StringRef ChainPath) {
+  sourceFiles_.push_back(ChainPath.str());
+
+  auto GraphOrErr = readChain(ChainPath);
+  if (!GraphOrErr)
+    return GraphOrErr.takeError();
+  ChainGraph &Graph = *GraphOrErr;
+
+  // All nodes share one context so they can be linked together
+  auto Ctx = std::make_unique<llvm::LLVMContext>();
+  std::vector<std::unique_ptr<llvm::Module>> nodeModules;
+  int paramBase = 0;
+  for (auto &node : Graph.nodes) {
+    sourceFiles_.push_back(node.path);
+    auto ModOrErr = compileChainNode(node.path, *Ctx);
+    if (!ModOrErr)
+      return ModOrErr.takeError();
+    if (auto Err = prepareChainNode(**ModOrErr, node, paramBase))
+      return Err;
+    if (!node.has("process"))
+      return makeError(ErrorCode::SymbolNotFound,
+                       "chain node '" + node.name + "' has no process()",
+                       node.path);
+    paramBase += node.paramCount;
+    nodeModules.push_back(std::move(*ModOrErr));
+  }
+  if (paramBase > kMaxChainParams)
+    return makeError(ErrorCode::CompilationFailed,
+                     "chain uses " + std::to_string(paramBase) +
+                         " parameters, at most " +
+                         std::to_string(kMaxChainParams) + " are available",
+                     ChainPath);
+
+  // The wrapper goes through Clang like any other source, from memory
+  std::string wrapperPath = ChainPath.str() + ".wrapper.cc";
+  auto FusedOrErr = compileSingleFile(wrapperPath, *Ctx, kChainNodeFlags,
+                                      generateChainWrapper(Graph));
+  if (!FusedOrErr)
+    return FusedOrErr.takeError();
+  llvm::Module &Fused = **FusedOrErr;
+
+  llvm::Linker L(Fused);
+  for (auto &M : nodeModules) {
+    M->setTargetTriple(Fused.getTargetTriple());
+    M->setDataLayout(Fused.getDataLayout());
+    if (L.linkInModule(std::move(M)))
+      return makeError(ErrorCode::ModuleGenerationFailed,
+                       "failed to link chain nodes", ChainPath);
+  }
+
+  // Node entry points are only reachable through the wrapper now, which
+  // lets the inliner fold each process() into the fused one
+  for (auto &F : Fused) {
+    if (!F.isDeclaration() && F.getName().starts_with("__rtclap_chain_"))
+      F.setLinkage(llvm::GlobalValue::InternalLinkage);
+  }
+
+  if (auto Err = optimizeModule(Fused))
+    return Err;
+
+  collectSymbols(Fused, symbols_);
+
+  return addCompiledModule(std::move(*FusedOrErr), std::move(Ctx));
+}
+
+llvm::Expected<std::unique_ptr<llvm::Module>>
+ClapJIT::compileChainNode(llvm::StringRef FilePath, llvm::LLVMContext &Ctx) {
+  if (FilePath.ends_with(".expr")) {
+    auto BufOrErr = llvm::MemoryBuffer::getFile(FilePath);
+    if (!BufOrErr)
+      return makeError(ErrorCode::CompilationFailed,
+                       BufOrErr.getError().message(), FilePath);
+    return compileExpr((*BufOrErr)->getBuffer(), FilePath, Ctx);
+  }
+
+  auto FileOptionsOrErr = readCompileOptions(FilePath);
+  if (!FileOptionsOrErr)
+    return FileOptionsOrErr.takeError();
+
+  // The node's own flags come last so its -O level still wins
+  std::vector<std::string> flags = kChainNodeFlags;
+  flags.insert(flags.end(), FileOptionsOrErr->begin(), FileOptionsOrErr->end());
+  return compileSingleFile(FilePath, Ctx, flags);
+}
+
+llvm::Error ClapJIT::prepareChainNode(llvm::Module &M, ChainNode &Node,
+                                      int ParamBase) {
+  const std::string prefix = chainSymbol(Node.name, "");
+
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+    std::string demangled = llvm::demangle(F.getName().str());
+    llvm::StringRef base = llvm::StringRef(demangled).split('(').first;
+    if (llvm::is_contained(kChainEntryPoints, base)) {
+      Node.entryPoints.push_back(base.str());
+      F.setName(chainSymbol(Node.name, base));
+      F.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      F.setComdat(nullptr);
+    }
+  }
+
+  // Everything else is private to the node, so two nodes may both define
+  // the same helper or static state
+  for (auto &GV : M.global_values()) {
+    if (GV.isDeclaration() || GV.getName().starts_with("llvm.") ||
+        GV.getName().starts_with(prefix))
+      continue;
+    GV.setLinkage(llvm::GlobalValue::InternalLinkage);
+    if (auto *GO = llvm::dyn_cast<llvm::GlobalObject>(&GV))
+      GO->setComdat(nullptr);
+  }
+
+  // param_count() must be a constant to lay out g_params at compile time
+  if (auto *F = M.getFunction(chainSymbol(Node.name, "param_count"))) {
+    std::optional<int64_t> count;
+    for (auto &BB : *F) {
+      auto *Ret = llvm::dyn_cast<llvm::ReturnInst>(BB.getTerminator());
+      if (!Ret)
+        continue;
+      auto *C = llvm::dyn_cast_or_null<llvm::ConstantInt>(Ret->getReturnValue());
+      if (!C || (count && *count != C->getSExtValue())) {
+        count.reset();
+        break;
+      }
+      count = C->getSExtValue();
+    }
+    if (!count || *count < 0)
+      return makeError(ErrorCode::CompilationFailed,
+                       "param_count() of chain node '" + Node.name +
+                           "' must return a constant",
+                       M.getModuleIdentifier());
+    Node.paramCount = static_cast<int>(*count);
+  }
+
+  // g_params[i] -> g_params[ParamBase + i]
+  auto *Params = M.getGlobalVariable("g_params");
+  if (Params && Params->isDeclaration() && ParamBase != 0) {
+    Params->setName("g_params.node");
+    auto *Shared = new llvm::GlobalVariable(
+        M, Params->getValueType(), false, llvm::GlobalValue::ExternalLinkage,
+        nullptr, "g_params");
+    auto *Slice = llvm::ConstantExpr::getInBoundsGetElementPtr(
+        llvm::Type::getFloatTy(M.getContext()), Shared,
+        llvm::ConstantInt::get(llvm::Type::getInt64Ty(M.getContext()),
+                               ParamBase));
+    Params->replaceAllUsesWith(Slice);
+    Params->eraseFromParent();
+  }
+
+  return llvm::Error::success();
+}
+
+llvm::Error ClapJIT::optimizeModule(llvm::Module &M) {
+  return runPipeline(M, llvm::OptimizationLevel::O3, {});
+}
+
+llvm::Error ClapJIT::runPipeline(llvm::Module &M, llvm::OptimizationLevel Level,
+                                 llvm::PipelineTuningOptions Tuning) {
+  auto JTMB = orc::JITTargetMachineBuilder::detectHost();
+  if (!JTMB)
+    return JTMB.takeError();
+  JTMB->setCodeGenOptLevel(llvm::CodeGenOptLevel::Aggressive);
+  auto TM = JTMB->createTargetMachine();
+  if (!TM)
+    return TM.takeError();
+
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+
+  llvm::PassBuilder PB(TM->get(), Tuning);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::ModulePassManager MPM =
+      Level == llvm::OptimizationLevel::O0
+          ? PB.buildO0DefaultPipeline(Level)
+          : PB.buildPerModuleDefaultPipeline(Level);
+  MPM.run(M, MAM);
+  return llvm::Error::success();
+}
+
+llvm::Expected<std::unique_ptr<llvm::Module>>
+ClapJIT::compileViaBitcode(llvm::StringRef FilePath, llvm::LLVMContext &Ctx,
+                           llvm::ArrayRef<std::string> FileOptions) {
+  auto KeyOrErr = hashPreprocessed(options_, FilePath, FileOptions);
+  if (!KeyOrErr)
+    return KeyOrErr.takeError();
+  std::string bitcodePath = getBitcodeCachePath(*KeyOrErr);
+
+  // Frontend output before any LLVM pass, so it can be optimized anew
+  std::unique_ptr<llvm::Module> M;
+  if (auto Buf = llvm::MemoryBuffer::getFile(bitcodePath)) {
+    auto ModOrErr = llvm::parseBitcodeFile(**Buf, Ctx);
+    if (ModOrErr)
+      M = std::move(*ModOrErr);
+    else
+      llvm::consumeError(ModOrErr.takeError());
+  }
+  if (!M) {
+    std::vector<std::string> flags(FileOptions.begin(), FileOptions.end());
+    flags.insert(flags.end(), {"-Xclang", "-disable-llvm-passes"});
+    auto IROrErr = compileSingleFile(FilePath, Ctx, flags);
+    if (!IROrErr)
+      return IROrErr.takeError();
+    M = std::move(*IROrErr);
+    writeCacheFile(bitcodePath,
+                   [&](llvm::raw_ostream &OS) { llvm::WriteBitcodeToFile(*M, OS); });
+  }
+
+  // Then the pipeline Clang would have run for the file's own flags
+  auto InvocationOrErr = getInvocation(options_, FileOptions);
+  if (!InvocationOrErr)
+    return InvocationOrErr.takeError();
+  Pipeline P = pipelineFor((*InvocationOrErr)->getCodeGenOpts());
+  if (auto Err = runPipeline(*M, P.level, P.tuning))
+    return std::move(Err);
+  return M;
+}
+
+std::string ClapJIT::getBitcodeCachePath(uint64_t Key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bc",
+                static_cast<unsigned long long>(Key));
+  return (std::filesystem::path(options_.cacheDir) / "bitcode" / name).string();
+}
+
+llvm::Error ClapJIT::addBundle(llvm::StringRef BundlePath) {
+  sourceFiles_.push_back(BundlePath.str());
+  auto BundleOrErr = readBundle(BundlePath);
+  if (!BundleOrErr)
+    return BundleOrErr.takeError();
+  return addBundle(*BundleOrErr, BundlePath);
+}
+
+llvm::Error ClapJIT::addBundle(const Bundle &B, llvm::StringRef BundlePath) {
+  // Fast path: prebuilt objects for this CPU, Clang is never invoked
+  auto Objects = B.selectObjects(detectHostCpuLevel());
+  if (!Objects.empty()) {
+    addSymbolTable(B.symbols);
+    // lib/ objects first, same order as sources are compiled
+    std::stable_partition(Objects.begin(), Objects.end(),
+                          [&](const BundleObject *O) {
+                            for (const auto &S : B.sources)
+                              if (S.name == O->source)
+                                return S.isLib;
+                            return false;
+                          });
+    for (const BundleObject *O : Objects) {
+      auto Buffer = llvm::MemoryBuffer::getMemBufferCopy(
+          O->data, (BundlePath + ":" + cpuLevelName(O->level) + "/" + O->source).str());
+      if (auto Err = llJIT_->addObjectFile(std::move(Buffer)))
+        return Err;
+    }
+    return llvm::Error::success();
+  }
+
+  // No usable objects: extract sources next to the cache and compile them.
+  // Bundles built in memory have no checksum yet.
+  uint64_t key = B.checksum ? B.checksum : llvm::xxh3_64bits(serializeBundle(B));
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+  std::filesystem::path extractDir =
+      (options_.cacheDir.empty()
+           ? std::filesystem::temp_directory_path() / "rt-clap"
+           : std::filesystem::path(options_.cacheDir)) /
+      "bundles" / hex;
+  std::filesystem::path libDir = extractDir / "lib";
+
+  std::error_code EC;
+  std::filesystem::create_directories(libDir, EC);
+  if (EC)
+    return makeError(ErrorCode::InvalidBundle,
+                     "Failed to create extract dir: " + EC.message(),
+                     BundlePath);
+
+  std::vector<std::string> libFiles, mainFiles;
+  for (const auto &S : B.sources) {
+    // Bundles built in memory never went through parseBundle()
+    if (!isValidSourceName(S.name))
+      return makeError(ErrorCode::InvalidBundle,
+                       "Invalid source name: " + S.name, BundlePath);
+    auto path = (S.isLib ? libDir : extractDir) / S.name;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << S.contents;
+    if (!out)
+      return makeError(ErrorCode::InvalidBundle, "Failed to extract " + S.name,
+                       BundlePath);
+    if (path.extension() == ".cc")
+      (S.isLib ? libFiles : mainFiles).push_back(path.string());
+  }
+
+  options_.includePaths.push_back(libDir.string());
+  for (const auto &file : libFiles) {
+    if (auto Err = addModule(file))
+      return Err;
+  }
+  for (const auto &file : mainFiles) {
+    if (auto Err = addModule(file))
+      return Err;
+  }
+  return llvm::Error::success();
+}
+
+llvm::Expected<Bundle>
+ClapJIT::buildBundle(llvm::StringRef SourcePath,
+                     llvm::ArrayRef<std::string> LibPaths,
+                     llvm::ArrayRef<CpuLevel> Levels) {
+  Bundle B;
+  std::filesystem::path mainPath(SourcePath.str());
+  B.manifest.name = mainPath.stem().string();
+  B.manifest.source = mainPath.filename().string();
+  if (!Levels.empty()) {
+    CpuLevel lowest = *std::min_element(Levels.begin(), Levels.end());
+    llvm::SmallVector<llvm::StringRef, 16> features;
+    llvm::StringRef(cpuLevelFeatures(lowest)).split(features, ',', -1, false);
+    for (auto F : features)
+      B.manifest.requiredFeatures.push_back(F.drop_front().str());
+  }
+
+  std::vector<std::pair<std::string, bool>> inputs;  // (path, isLib)
+  for (const auto &lib : LibPaths)
+    inputs.emplace_back(lib, true);
+  inputs.emplace_back(SourcePath.str(), false);
+
+  std::vector<SymbolEntry> bundleSymbols;
+  for (const auto &[path, isLib] : inputs) {
+    auto BufOrErr = llvm::MemoryBuffer::getFile(path);
+    if (!BufOrErr)
+      return makeError(ErrorCode::InvalidBundle,
+                       "Failed to read source: " + BufOrErr.getError().message(),
+                       path);
+
+    std::string name = std::filesystem::path(path).filename().string();
+    B.sources.push_back({name, (*BufOrErr)->getBuffer().str(), isLib});
+    if (std::filesystem::path(path).extension() != ".cc")
+      continue;
+
+    auto FileOptionsOrErr = readCompileOptions(path);
+    if (!FileOptionsOrErr)
+      return FileOptionsOrErr.takeError();
+
+    // Keep the sidecar manifest with its source
+    if (auto OptsOrErr = llvm::MemoryBuffer::getFile(path + ".opts"))
+      B.sources.push_back(
+          {name + ".opts", (*OptsOrErr)->getBuffer().str(), isLib});
+
+    llvm::LLVMContext Ctx;
+    auto IROrErr = compileSingleFile(path, Ctx, *FileOptionsOrErr);
+    if (!IROrErr)
+      return IROrErr.takeError();
+
+    std::vector<SymbolEntry> moduleSymbols;
+    collectSymbols(**IROrErr, moduleSymbols);
+    if (!isLib) {
+      for (const auto &[demangled, mangled] : moduleSymbols)
+        B.manifest.entryPoints.push_back(demangled);
+    }
+    bundleSymbols.insert(bundleSymbols.end(), moduleSymbols.begin(),
+                         moduleSymbols.end());
+
+    // Code for a pinned CPU (e.g. -march=native) would be stored under
+    // every level and crash other machines. Without objects for it, no
+    // level covers all sources and loading compiles from source instead.
+    if (pinsTargetCPU(*FileOptionsOrErr))
+      continue;
+
+    for (CpuLevel Level : Levels) {
+      // Codegen may touch the IR, so each level gets a fresh copy
+      auto Clone = llvm::CloneModule(**IROrErr);
+      llvm::SmallVector<char, 0> ObjBuffer;
+      llvm::raw_svector_ostream ObjStream(ObjBuffer);
+      if (auto Err = emitObject(*Clone, Level, ObjStream))
+        return std::move(Err);
+      B.objects.push_back(
+          {Level, name, std::string(ObjBuffer.begin(), ObjBuffer.end())});
+    }
+  }
+
+  for (const auto &[demangled, mangled] : bundleSymbols)
+    B.symbols += demangled + "\t" + mangled + "\n";
+
+  return B;
+}
+
+llvm::Expected<Bundle>
+ClapJIT::snapshotBundle(llvm::StringRef SourcePath,
+                        llvm::ArrayRef<std::string> LibPaths) const {
+  Bundle B;
+  std::filesystem::path mainPath(SourcePath.str());
+  B.manifest.name = mainPath.stem().string();
+  B.manifest.source = mainPath.filename().string();
+
+  std::vector<std::pair<std::string, bool>> inputs;  // (path, isLib)
+  for (const auto &lib : LibPaths)
+    inputs.emplace_back(lib, true);
+  inputs.emplace_back(SourcePath.str(), false);
+
+  // Cached objects are generic unless the cache holds several levels;
+  // files pinned to a CPU are left to the compiler
+  bool complete = true;
+  std::vector<BundleObject> objects;
+  std::string symbols;
+  for (const auto &[path, isLib] : inputs) {
+    auto BufOrErr = llvm::MemoryBuffer::getFile(path);
+    if (!BufOrErr)
+      return makeError(ErrorCode::InvalidBundle,
+                       "Failed to read source: " + BufOrErr.getError().message(),
+                       path);
+
+    std::string name = std::filesystem::path(path).filename().string();
+    B.sources.push_back({name, (*BufOrErr)->getBuffer().str(), isLib});
+    if (std::filesystem::path(path).extension() != ".cc")
+      continue;
+
+    auto FileOptionsOrErr = readCompileOptions(path);
+    if (!FileOptionsOrErr)
+      return FileOptionsOrErr.takeError();
+    if (auto OptsOrErr = llvm::MemoryBuffer::getFile(path + ".opts"))
+      B.sources.push_back(
+          {name + ".opts", (*OptsOrErr)->getBuffer().str(), isLib});
+
+    std::string cachePath = getCachePath(path, *FileOptionsOrErr);
+    if (!complete || cachePath.empty() || pinsTargetCPU(*FileOptionsOrErr)) {
+      complete = false;
+      continue;
+    }
+
+    CpuLevel Level = CpuLevel::Generic;
+    std::string object = cachePath;
+    if (!options_.cacheLevels.empty()) {
+      object = findCachedLevel(path, cachePath);
+      for (int L = 0; L <= static_cast<int>(CpuLevel::V4); ++L)
+        if (object == getLevelCachePath(cachePath, static_cast<CpuLevel>(L)))
+          Level = static_cast<CpuLevel>(L);
+    }
+    auto SymOrErr = llvm::MemoryBuffer::getFile(cachePath + ".sym");
+    if (!isCacheValid(path, object) || !SymOrErr) {
+      complete = false;
+      continue;
+    }
+    auto ObjOrErr = llvm::MemoryBuffer::getFile(object);
+    if (!ObjOrErr) {
+      complete = false;
+      continue;
+    }
+
+    objects.push_back({Level, name, (*ObjOrErr)->getBuffer().str()});
+    symbols += (*SymOrErr)->getBuffer();
+    if (!isLib) {
+      llvm::SmallVector<llvm::StringRef, 16> Lines;
+      (*SymOrErr)->getBuffer().split(Lines, '\n', -1, false);
+      for (llvm::StringRef Line : Lines)
+        B.manifest.entryPoints.push_back(Line.split('\t').first.str());
+    }
+  }
+
+  if (complete) {
+    B.objects = std::move(objects);
+    B.symbols = std::move(symbols);
+  }
+  return B;
+}
+
+uint64_t ClapJIT::linkedBytes() const {
+  auto *Slab = options_.slabMemory ? SlabMemoryManager::get() : nullptr;
+  if (!Slab)
+    return 0;
+  return Slab->bytesFor(&llJIT_->getMainJITDylib());
+}
+
+bool ClapJIT::hasCachedObject(llvm::StringRef SourcePath) const {
+  auto FileOptionsOrErr = readCompileOptions(SourcePath);
+  if (!FileOptionsOrErr) {
+    llvm::consumeError(FileOptionsOrErr.takeError());
+    return false;
+  }
+
+  // Same lookup as addModule()
+  std::string cachePath = getCachePath(SourcePath, *FileOptionsOrErr);
+  if (cachePath.empty() || !std::filesystem::exists(cachePath + ".sym"))
+    return false;
+  const bool multiLevel = !options_.cacheLevels.empty() &&
+                          !pinsTargetCPU(*FileOptionsOrErr);
+  return isCacheValid(SourcePath, multiLevel
+                                      ? findCachedLevel(SourcePath, cachePath)
+                                      : cachePath);
+}
+
 llvm::Error ClapJIT::defineSymbol(llvm::StringRef Name, void *Addr) {
   auto &MainJD = llJIT_->getMainJITDylib();
   auto Symbol = llvm::orc::ExecutorSymbolDef(
@@ -352,6 +1393,16 @@ ClapJIT::lookupFunction(llvm::StringRef FunctionName) const {
 }
 
 std::string ClapJIT::getCachePath(llvm::StringRef SourcePath) const {
+  auto FileOptionsOrErr = readCompileOptions(SourcePath);
+  if (!FileOptionsOrErr) {
+    llvm::consumeError(FileOptionsOrErr.takeError());
+    return getCachePath(SourcePath, {});
+  }
+  return getCachePath(SourcePath, *FileOptionsOrErr);
+}
+
+std::string ClapJIT::getCachePath(llvm::StringRef SourcePath,
+                                  llvm::ArrayRef<std::string> FileOptions) const {
   if (options_.cacheDir.empty())
     return "";
 
@@ -359,8 +1410,10 @@ std::string ClapJIT::getCachePath(llvm::StringRef SourcePath) const {
   std::filesystem::path srcPath(SourcePath.str());
   std::string filename = srcPath.filename().string();
 
-  // Simple hash of full path to avoid collisions
-  std::size_t hash = std::hash<std::string>{}(SourcePath.str());
+  // Simple hash of full path and per-file options to avoid collisions
+  std::string key = SourcePath.str();
+  appendOptionsKey(key, FileOptions);
+  std::size_t hash = std::hash<std::string>{}(key);
 
   std::filesystem::path cachePath = options_.cacheDir;
   cachePath /= filename + "." + std::to_string(hash) + ".o";
@@ -385,8 +1438,9 @@ bool ClapJIT::isCacheValid(llvm::StringRef SourcePath,
   return cacheTime >= srcTime;
 }
 
-llvm::Error ClapJIT::compileAndCache(llvm::Module &M,
-                                      llvm::StringRef CachePath) {
+llvm::Error ClapJIT::emitObject(llvm::Module &M,
+                                std::optional<CpuLevel> Level,
+                                llvm::raw_pwrite_stream &OS) {
   // Get target machine
   llvm::Triple triple(options_.targetTriple.empty()
                           ? llvm::sys::getProcessTriple()
@@ -399,10 +1453,13 @@ llvm::Error ClapJIT::compileAndCache(llvm::Module &M,
         "Failed to get target: " + Error, llvm::inconvertibleErrorCode());
   }
 
+  std::string cpu = Level ? cpuLevelCPU(*Level).str() : "generic";
+  std::string features = Level ? cpuLevelFeatures(*Level) : "";
+
   llvm::TargetOptions opt;
   auto RM = std::optional<llvm::Reloc::Model>(llvm::Reloc::PIC_);
   auto TM = std::unique_ptr<llvm::TargetMachine>(
-      Target->createTargetMachine(triple, "generic", "", opt, RM));
+      Target->createTargetMachine(triple, cpu, features, opt, RM));
 
   if (!TM) {
     return llvm::make_error<llvm::StringError>(
@@ -412,6 +1469,30 @@ llvm::Error ClapJIT::compileAndCache(llvm::Module &M,
   M.setDataLayout(TM->createDataLayout());
   M.setTargetTriple(triple);
 
+  // Clang pins the CPU on every function; retarget them explicitly
+  if (Level) {
+    for (auto &F : M) {
+      if (F.isDeclaration())
+        continue;
+      F.addFnAttr("target-cpu", cpu);
+      F.addFnAttr("target-features", features);
+    }
+  }
+
+  llvm::legacy::PassManager pass;
+  if (TM->addPassesToEmitFile(pass, OS, nullptr,
+                               llvm::CodeGenFileType::ObjectFile)) {
+    return llvm::make_error<llvm::StringError>(
+        "Target machine can't emit object file",
+        llvm::inconvertibleErrorCode());
+  }
+
+  pass.run(M);
+  return llvm::Error::success();
+}
+
+llvm::Error ClapJIT::compileAndCache(llvm::Module &M,
+                                      llvm::StringRef CachePath) {
   // Ensure cache directory exists
   std::filesystem::path cacheDir = std::filesystem::path(CachePath.str()).parent_path();
   std::filesystem::create_directories(cacheDir);
@@ -425,20 +1506,89 @@ llvm::Error ClapJIT::compileAndCache(llvm::Module &M,
         llvm::inconvertibleErrorCode());
   }
 
-  llvm::legacy::PassManager pass;
-  if (TM->addPassesToEmitFile(pass, dest, nullptr,
-                               llvm::CodeGenFileType::ObjectFile)) {
-    return llvm::make_error<llvm::StringError>(
-        "Target machine can't emit object file",
-        llvm::inconvertibleErrorCode());
-  }
+  if (auto Err = emitObject(M, std::nullopt, dest))
+    return Err;
 
-  pass.run(M);
   dest.flush();
+  return llvm::Error::success();
+}
+
+llvm::Error ClapJIT::compileAndCacheLevels(llvm::Module &M,
+                                            llvm::StringRef CachePath) {
+  std::filesystem::path cacheDir = std::filesystem::path(CachePath.str()).parent_path();
+  std::filesystem::create_directories(cacheDir);
+
+  for (CpuLevel Level : options_.cacheLevels) {
+    // Codegen may touch the IR, so each level gets a fresh copy
+    auto Clone = llvm::CloneModule(M);
+    llvm::SmallVector<char, 0> ObjBuffer;
+    llvm::raw_svector_ostream ObjStream(ObjBuffer);
+    if (auto Err = emitObject(*Clone, Level, ObjStream))
+      return Err;
+
+    // Write then rename: the cache may be shared by several machines, and
+    // readers must never see a half-written object
+    std::string finalPath = getLevelCachePath(CachePath, Level);
+    std::string tmpPath = finalPath + ".tmp" + std::to_string(::getpid());
+    {
+      std::error_code EC;
+      llvm::raw_fd_ostream dest(tmpPath, EC, llvm::sys::fs::OF_None);
+      if (EC) {
+        return llvm::make_error<llvm::StringError>(
+            "Could not open cache file: " + EC.message(),
+            llvm::inconvertibleErrorCode());
+      }
+      dest << llvm::StringRef(ObjBuffer.data(), ObjBuffer.size());
+    }
+    if (auto EC = llvm::sys::fs::rename(tmpPath, finalPath)) {
+      llvm::sys::fs::remove(tmpPath);
+      return llvm::make_error<llvm::StringError>(
+          "Could not move cache file into place: " + EC.message(),
+          llvm::inconvertibleErrorCode());
+    }
+  }
 
   return llvm::Error::success();
 }
 
+std::string ClapJIT::getLevelCachePath(llvm::StringRef CachePath,
+                                       CpuLevel Level) {
+  // "<key>.o" -> "<key>.<level>.o"
+  return (CachePath.drop_back(2) + "." + cpuLevelName(Level) + ".o").str();
+}
+
+std::string ClapJIT::findCachedLevel(llvm::StringRef SourcePath,
+                                     llvm::StringRef CachePath) const {
+  // Any level up to the host's is usable, whichever machine compiled it
+  for (int L = static_cast<int>(detectHostCpuLevel()); L >= 0; --L) {
+    std::string path = getLevelCachePath(CachePath, static_cast<CpuLevel>(L));
+    if (isCacheValid(SourcePath, path))
+      return path;
+  }
+  return "";
+}
+
+void ClapJIT::collectSymbols(const llvm::Module &M,
+                             std::vector<SymbolEntry> &Out) {
+  for (const auto &F : M) {
+    if (!F.isDeclaration()) {
+      std::string mangled = F.getName().str();
+      std::string demangled = llvm::demangle(mangled);
+      Out.emplace_back(demangled, mangled);
+    }
+  }
+}
+
+void ClapJIT::addSymbolTable(llvm::StringRef Table) {
+  llvm::SmallVector<llvm::StringRef, 16> Lines;
+  Table.split(Lines, '\n', -1, false);
+  for (llvm::StringRef Line : Lines) {
+    auto [demangled, mangled] = Line.split('\t');
+    if (!mangled.empty())
+      symbols_.emplace_back(demangled.str(), mangled.str());
+  }
+}
+
 llvm::Error ClapJIT::loadCachedObject(llvm::StringRef CachePath) {
   auto BufferOrErr = llvm::MemoryBuffer::getFile(CachePath);
   if (!BufferOrErr) {
@@ -447,7 +1597,125 @@ llvm::Error ClapJIT::loadCachedObject(llvm::StringRef CachePath) {
         llvm::inconvertibleErrorCode());
   }
 
+  if (options_.prelink)
+    loadLinkTable(CachePath, (*BufferOrErr)->getMemBufferRef());
+
   return llJIT_->addObjectFile(std::move(*BufferOrErr));
 }
 
+void ClapJIT::loadLinkTable(llvm::StringRef ObjectPath,
+                            llvm::MemoryBufferRef Object) {
+  // Format: "cpu <host CPU>", then "lib <index> <size> <mtime> <path>"
+  // lines, then "sym <lib index> <offset> <name>" lines.
+  //
+  // glibc's IFUNC symbols (memcpy, strlen, ...) resolve to a variant for
+  // the CPU at hand, so the offsets only hold on the CPU that recorded
+  // them. The cache may be shared by several machines; a table from a
+  // different CPU is recorded anew.
+  const std::string tablePath = ObjectPath.str() + ".link";
+  const std::string cpu = hostCpuDescription();
+  if (auto Buf = llvm::MemoryBuffer::getFile(tablePath)) {
+    std::vector<std::optional<uint64_t>> bases;
+    llvm::StringMap<uint64_t> resolved;
+    bool valid = true;
+    bool sameCpu = false;
+    llvm::SmallVector<llvm::StringRef, 64> Lines;
+    (*Buf)->getBuffer().split(Lines, '\n', -1, false);
+    for (llvm::StringRef Line : Lines) {
+      auto [Kind, Rest] = Line.split(' ');
+      if (Kind == "cpu") {
+        sameCpu = Rest == cpu;
+        if (!sameCpu)
+          break;
+      } else if (Kind == "lib") {
+        LinkedLibrary Lib;
+        auto [Index, Tail] = Rest.split(' ');
+        auto [Size, Tail2] = Tail.split(' ');
+        auto [MTime, Path] = Tail2.split(' ');
+        if (Size.getAsInteger(10, Lib.size) || MTime.getAsInteger(10, Lib.mtime)) {
+          valid = false;
+          break;
+        }
+        Lib.path = Path.str();
+        bases.push_back(validateLibrary(Lib));
+        valid = valid && bases.back().has_value();
+      } else if (Kind == "sym") {
+        auto [Index, Tail] = Rest.split(' ');
+        auto [Offset, Name] = Tail.split(' ');
+        size_t lib = 0;
+        uint64_t offset = 0;
+        if (Index.getAsInteger(10, lib) || lib >= bases.size() ||
+            Offset.getAsInteger(16, offset) || Name.empty()) {
+          valid = false;
+          break;
+        }
+        if (bases[lib])
+          resolved[Name] = *bases[lib] + offset;
+      }
+    }
+    if (valid && sameCpu) {
+      for (auto &Entry : resolved)
+        (*prelinked_)[Entry.getKey()] = Entry.getValue();
+      return;
+    }
+    // Another CPU, or a library changed or moved out of the way: record
+    // the table anew
+  }
+
+  auto ObjOrErr = llvm::object::ObjectFile::createObjectFile(Object);
+  if (!ObjOrErr) {
+    llvm::consumeError(ObjOrErr.takeError());
+    return;
+  }
+
+  std::vector<LinkedLibrary> libs;
+  std::string syms;
+  for (const auto &Sym : (*ObjOrErr)->symbols()) {
+    auto FlagsOrErr = Sym.getFlags();
+    auto NameOrErr = Sym.getName();
+    if (!FlagsOrErr || !NameOrErr) {
+      llvm::consumeError(FlagsOrErr.takeError());
+      llvm::consumeError(NameOrErr.takeError());
+      continue;
+    }
+    if (!(*FlagsOrErr & llvm::object::SymbolRef::SF_Undefined) ||
+        NameOrErr->empty())
+      continue;
+
+    // Only symbols found in a shared library can be recorded relative to
+    // its base; the rest (host globals, other modules) resolve as usual
+    std::string name = NameOrErr->str();
+    void *addr = resolveExternal(name);
+    ::Dl_info info;
+    if (!addr || !::dladdr(addr, &info) || !info.dli_fname)
+      continue;
+    std::string path = info.dli_fname;
+    auto base = libraryBase(path);
+    auto lib = identifyLibrary(path);
+    if (!base || !lib)
+      continue;
+
+    auto it = std::find_if(libs.begin(), libs.end(),
+                           [&](const LinkedLibrary &L) { return L.path == path; });
+    size_t index = it - libs.begin();
+    if (it == libs.end())
+      libs.push_back(*lib);
+
+    uint64_t address = reinterpret_cast<uint64_t>(addr);
+    (*prelinked_)[name] = address;
+    char offset[32];
+    std::snprintf(offset, sizeof(offset), "%llx",
+                  static_cast<unsigned long long>(address - *base));
+    syms += "sym " + std::to_string(index) + " " + offset + " " + name + "\n";
+  }
+
+  writeCacheFile(tablePath, [&](llvm::raw_ostream &OS) {
+    OS << "cpu " << cpu << '\n';
+    for (size_t i = 0; i < libs.size(); ++i)
+      OS << "lib " << i << ' ' << libs[i].size << ' ' << libs[i].mtime << ' '
+         << libs[i].path << '\n';
+    OS << syms;
+  });
+}
+
 } // namespace clap_rt
@@ -1,10 +1,21 @@
 #pragma once
 
+#include "Bundle.h"
+#include "Chain.h"
+#include "SourceCache.h"
+#include "Target.h"
+
 #include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBufferRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
 #include <memory>
 #include <optional>
 #include <string>
@@ -19,8 +30,31 @@ struct JITOptions {
   std::string targetTriple; // empty = auto-detect
   std::vector<std::string> includePaths; // additional include directories
 
-  // Object file cache directory (empty = no caching)
+  // Object file cache directory (empty = no caching). Also keeps the
+  // toolchain probe, so new processes skip scanning /usr/include/c++.
   std::string cacheDir;
+
+  // CPU levels to cache objects for (empty = one object for this machine).
+  // Each level is stored under the same cache key and the best one the
+  // host supports is loaded, so a cache can be shared between machines.
+  std::vector<CpuLevel> cacheLevels;
+
+  // Keep a link table next to each cached object: where its external
+  // symbols were found, relative to the base of their shared library.
+  // Loading the object again resolves them from the table, after checking
+  // the libraries and the host CPU are unchanged, instead of searching
+  // libstdc++ and the process for every symbol.
+  bool prelink = false;
+
+  // Link code and data into the process-wide slab (see SlabMemory.h)
+  // instead of pages of their own, packing the code of every ClapJIT
+  // together on huge pages. Falls back to the default manager if the slab
+  // can't be mapped.
+  bool slabMemory = false;
+
+  // Header contents and stat results shared across compiles (null = read
+  // the file system every time). The owner invalidates changed files.
+  llvm::IntrusiveRefCntPtr<SourceCache> sourceCache;
 };
 
 class ClapJIT {
@@ -29,6 +63,15 @@ public:
 
   static void initializeLLVM();
 
+  /// Hand memory freed by compiles and destroyed JITs back to the system
+  /// (malloc_trim). Call on the compiling thread once a reload is done.
+  static void releaseMemory();
+
+  /// Forget the toolchain probe and the driver results compiles reuse (both
+  /// are kept per process), e.g. after installing another GCC. A probe
+  /// persisted in the cache directory is still checked against the system.
+  static void resetToolchain();
+
   // Move semantics
   ClapJIT(ClapJIT &&) noexcept = default;
   ClapJIT &operator=(ClapJIT &&) noexcept = default;
@@ -39,9 +82,56 @@ public:
 
   ~ClapJIT() = default;
 
+  /// Add a DSP source. C++ files go through Clang; .expr files are
+  /// lowered to IR directly (see Expr.h).
   [[nodiscard]] llvm::Error addModule(llvm::StringRef FilePath);
   [[nodiscard]] llvm::Error addModules(llvm::ArrayRef<llvm::StringRef> FilePaths);
 
+  /// Add a DSP source held in memory. Name stands in for its path: the
+  /// extension picks C++ or .expr and quoted includes resolve next to it.
+  /// Directives in the source apply; there is no sidecar and no caching.
+  [[nodiscard]] llvm::Error addModuleFromBuffer(llvm::StringRef Name,
+                                                llvm::StringRef Source);
+
+  /// Compile every node of a .chain file and fuse them into one optimized
+  /// module whose process/init/destroy/param_* drive the whole graph.
+  [[nodiscard]] llvm::Error addChain(llvm::StringRef ChainPath);
+
+  /// Files read by addModule/addChain/addBundle so far, for change watching
+  const std::vector<std::string> &sourceFiles() const { return sourceFiles_; }
+
+  /// Load a DSP bundle. Uses the best prebuilt object set for the host CPU,
+  /// or compiles the embedded sources when no object set fits.
+  [[nodiscard]] llvm::Error addBundle(llvm::StringRef BundlePath);
+
+  /// Load a bundle already in memory, e.g. one embedded in saved plugin
+  /// state. Name labels its objects and extracted sources.
+  [[nodiscard]] llvm::Error addBundle(const Bundle &B, llvm::StringRef Name);
+
+  /// Compile a DSP source and its lib/ files into a bundle with prebuilt
+  /// objects for each CPU level. LibPaths may include headers, which are
+  /// stored but not compiled. Sources whose flags pin the CPU get no
+  /// objects, so such bundles always load from source. The JIT itself is
+  /// left unchanged.
+  [[nodiscard]] llvm::Expected<Bundle>
+  buildBundle(llvm::StringRef SourcePath, llvm::ArrayRef<std::string> LibPaths,
+              llvm::ArrayRef<CpuLevel> Levels);
+
+  /// Package sources with the objects the cache holds for them, without
+  /// compiling. Objects are included only if every .cc file has a valid
+  /// cache entry that is not pinned to a CPU; otherwise the bundle carries
+  /// sources alone and addBundle() compiles them.
+  [[nodiscard]] llvm::Expected<Bundle>
+  snapshotBundle(llvm::StringRef SourcePath,
+                 llvm::ArrayRef<std::string> LibPaths) const;
+
+  /// True if addModule(SourcePath) would load a cached object
+  bool hasCachedObject(llvm::StringRef SourcePath) const;
+
+  /// Code and data bytes linked so far (0 unless options.slabMemory, where
+  /// the slab attributes memory to each JIT)
+  uint64_t linkedBytes() const;
+
   /// Define an external symbol that JIT code can reference
   [[nodiscard]] llvm::Error defineSymbol(llvm::StringRef Name, void *Addr);
 
@@ -57,6 +147,10 @@ public:
   [[nodiscard]] llvm::Expected<llvm::orc::ExecutorAddr>
   lookupFunction(llvm::StringRef FunctionName) const;
 
+  /// Get cache path for a source file (empty if caching disabled).
+  /// The key covers the file's per-file compile options.
+  std::string getCachePath(llvm::StringRef SourcePath) const;
+
   template <typename FuncT>
   [[nodiscard]] llvm::Expected<FuncT *>
   lookupAs(llvm::StringRef FunctionName) const {
@@ -69,29 +163,106 @@ public:
 private:
   ClapJIT() = default;
 
+  // Symbol info: pair of (demangled name, mangled name)
+  using SymbolEntry = std::pair<std::string, std::string>;
+
+  // Contents, if given, replaces the file at FilePath for this compile
+  [[nodiscard]] llvm::Expected<std::unique_ptr<llvm::Module>>
+  compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx,
+                    llvm::ArrayRef<std::string> FileOptions = {},
+                    std::optional<llvm::StringRef> Contents = std::nullopt);
+
+  // Generate code for M now and add the object, so the IR and its context
+  // are freed before returning instead of waiting in the JIT's IR layer
+  [[nodiscard]] llvm::Error
+  addCompiledModule(std::unique_ptr<llvm::Module> M,
+                    std::unique_ptr<llvm::LLVMContext> Ctx);
+
+  // Lower an expression DSP (.expr) to IR and add it; no Clang, no cache
+  [[nodiscard]] llvm::Error addExprModule(llvm::StringRef FilePath);
+
+  // Compile one chain node to unoptimized IR that can still be inlined
   [[nodiscard]] llvm::Expected<std::unique_ptr<llvm::Module>>
-  compileSingleFile(llvm::StringRef FilePath, llvm::LLVMContext &Ctx);
+  compileChainNode(llvm::StringRef FilePath, llvm::LLVMContext &Ctx);
+
+  // Rename a node's entry points, internalize everything else and move its
+  // g_params accesses to the node's slice of the array
+  [[nodiscard]] static llvm::Error prepareChainNode(llvm::Module &M,
+                                                    ChainNode &Node,
+                                                    int ParamBase);
+
+  // Run the O3 pipeline for the host CPU
+  [[nodiscard]] static llvm::Error optimizeModule(llvm::Module &M);
+
+  // Run the default pipeline of a level, tuned like Clang does for -f flags
+  [[nodiscard]] static llvm::Error runPipeline(llvm::Module &M,
+                                               llvm::OptimizationLevel Level,
+                                               llvm::PipelineTuningOptions Tuning);
+
+  // compileSingleFile through the bitcode cache: the frontend's output is
+  // stored unoptimized, keyed by the preprocessed source, and the file's
+  // optimization pipeline runs on it afterwards
+  [[nodiscard]] llvm::Expected<std::unique_ptr<llvm::Module>>
+  compileViaBitcode(llvm::StringRef FilePath, llvm::LLVMContext &Ctx,
+                    llvm::ArrayRef<std::string> FileOptions);
+
+  // Bitcode cache file for a compileViaBitcode key
+  std::string getBitcodeCachePath(uint64_t Key) const;
+
+  // Cache path for a source compiled with the given per-file options
+  std::string getCachePath(llvm::StringRef SourcePath,
+                           llvm::ArrayRef<std::string> FileOptions) const;
+
+  // Compile module to object code. Level overrides the CPU and target
+  // features of every function; nullopt keeps what the frontend chose.
+  [[nodiscard]] llvm::Error emitObject(llvm::Module &M,
+                                       std::optional<CpuLevel> Level,
+                                       llvm::raw_pwrite_stream &OS);
 
   // Compile module to object file and save to cache
   [[nodiscard]] llvm::Error compileAndCache(llvm::Module &M,
                                             llvm::StringRef CachePath);
 
+  // Compile module for every options_.cacheLevels entry and save to cache
+  [[nodiscard]] llvm::Error compileAndCacheLevels(llvm::Module &M,
+                                                  llvm::StringRef CachePath);
+
+  // Cache file of one CPU level for the given cache path
+  static std::string getLevelCachePath(llvm::StringRef CachePath,
+                                       CpuLevel Level);
+
+  // Best valid cached level for the host CPU (empty if none)
+  std::string findCachedLevel(llvm::StringRef SourcePath,
+                              llvm::StringRef CachePath) const;
+
+  // Collect (demangled, mangled) names of functions defined in M
+  static void collectSymbols(const llvm::Module &M,
+                             std::vector<SymbolEntry> &Out);
+
+  // Parse "demangled\tmangled" lines into symbols_
+  void addSymbolTable(llvm::StringRef Table);
+
   // Load cached object file
   [[nodiscard]] llvm::Error loadCachedObject(llvm::StringRef CachePath);
 
-  // Get cache path for a source file (empty if caching disabled)
-  std::string getCachePath(llvm::StringRef SourcePath) const;
+  // Fill prelinked_ from the object's link table, or record the table if
+  // it's missing, a library changed or it was recorded on another CPU
+  void loadLinkTable(llvm::StringRef ObjectPath, llvm::MemoryBufferRef Object);
 
   // Check if cache is valid (exists and newer than source)
   bool isCacheValid(llvm::StringRef SourcePath,
                     llvm::StringRef CachePath) const;
 
-  // Symbol info: pair of (demangled name, mangled name)
-  using SymbolEntry = std::pair<std::string, std::string>;
-
   std::unique_ptr<llvm::orc::LLJIT> llJIT_;
   JITOptions options_;
   std::vector<SymbolEntry> symbols_;
+  std::vector<std::string> sourceFiles_;
+
+  // Host code generator of addCompiledModule(), made on first use
+  std::unique_ptr<llvm::TargetMachine> hostTM_;
+
+  // Addresses from link tables, shared with the JIT's symbol generator
+  std::shared_ptr<llvm::StringMap<uint64_t>> prelinked_;
 };
 
 } // namespace clap_rt
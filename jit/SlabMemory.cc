@@ -0,0 +1,291 @@
+#include "SlabMemory.h"
+
+#include <llvm/ExecutionEngine/JITLink/JITLink.h>
+#include <llvm/ExecutionEngine/Orc/Shared/AllocationActions.h>
+#include <llvm/Support/Alignment.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/Memory.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace clap_rt {
+
+using llvm::jitlink::BasicLayout;
+using llvm::jitlink::LinkGraph;
+
+namespace {
+
+constexpr uint64_t kHugePage = 2ull << 20;
+// Size of each arena. Only touched pages use memory.
+constexpr uint64_t kArenaSize = 256ull << 20;
+// Smallest unit handed out, so neighbouring modules don't share cache lines
+constexpr uint64_t kGranule = 64;
+
+// Bookkeeping of one finalized module, addressed by its FinalizedAlloc
+struct FinalizedInfo {
+  std::vector<SlabMemoryManager::Range> ranges;
+  std::vector<llvm::orc::shared::WrapperFunctionCall> deallocActions;
+};
+
+} // anonymous namespace
+
+class SlabMemoryManager::InFlight
+    : public llvm::jitlink::JITLinkMemoryManager::InFlightAlloc {
+public:
+  InFlight(SlabMemoryManager &MemMgr, LinkGraph &G, BasicLayout BL,
+           std::vector<Range> Standard, std::vector<Range> FinalizeOnly)
+      : memMgr_(MemMgr), graph_(G), layout_(std::move(BL)),
+        standard_(std::move(Standard)), finalizeOnly_(std::move(FinalizeOnly)) {}
+
+  void finalize(OnFinalizedFunction OnFinalized) override {
+    // Code is written through the RW view and run from the RX one, so all
+    // that is left is flushing the instruction cache
+    for (auto &KV : layout_.segments()) {
+      const auto &Seg = KV.second;
+      if ((KV.first.getMemProt() & llvm::orc::MemProt::Exec) !=
+          llvm::orc::MemProt::None)
+        llvm::sys::Memory::InvalidateInstructionCache(
+            Seg.Addr.toPtr<void *>(), Seg.ContentSize + Seg.ZeroFillSize);
+    }
+
+    auto DeallocActions =
+        llvm::orc::shared::runFinalizeActions(graph_.allocActions());
+    for (const Range &R : finalizeOnly_)
+      memMgr_.give(R);
+    finalizeOnly_.clear();
+    if (!DeallocActions) {
+      for (const Range &R : standard_)
+        memMgr_.give(R);
+      standard_.clear();
+      OnFinalized(DeallocActions.takeError());
+      return;
+    }
+
+    auto *Info = new FinalizedInfo{std::move(standard_),
+                                   std::move(*DeallocActions)};
+    OnFinalized(FinalizedAlloc(llvm::orc::ExecutorAddr::fromPtr(Info)));
+  }
+
+  void abandon(OnAbandonedFunction OnAbandoned) override {
+    for (const Range &R : standard_)
+      memMgr_.give(R);
+    for (const Range &R : finalizeOnly_)
+      memMgr_.give(R);
+    standard_.clear();
+    finalizeOnly_.clear();
+    OnAbandoned(llvm::Error::success());
+  }
+
+private:
+  SlabMemoryManager &memMgr_;
+  LinkGraph &graph_;
+  BasicLayout layout_;
+  std::vector<Range> standard_;
+  std::vector<Range> finalizeOnly_;
+};
+
+SlabMemoryManager *SlabMemoryManager::get() {
+  static SlabMemoryManager *instance = []() -> SlabMemoryManager * {
+    const uint64_t size = 2 * kArenaSize;
+    int fd = memfd_create("clap-rt-jit", MFD_CLOEXEC);
+    if (fd < 0)
+      return nullptr;
+    if (ftruncate(fd, size) != 0) {
+      close(fd);
+      return nullptr;
+    }
+
+    // Both views in one reservation, huge-page aligned, so code and data
+    // stay within the +-2 GB reach of the small code model
+    const uint64_t span = 2 * size + kHugePage;
+    void *reserved =
+        mmap(nullptr, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+             -1, 0);
+    if (reserved == MAP_FAILED) {
+      close(fd);
+      return nullptr;
+    }
+    char *base = reinterpret_cast<char *>(
+        llvm::alignTo(reinterpret_cast<uintptr_t>(reserved), kHugePage));
+    void *rx = mmap(base, size, PROT_READ | PROT_EXEC, MAP_SHARED | MAP_FIXED,
+                    fd, 0);
+    void *rw = mmap(base + size, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_FIXED, fd, 0);
+    if (rx == MAP_FAILED || rw == MAP_FAILED) {
+      munmap(reserved, span);
+      close(fd);
+      return nullptr;
+    }
+    // Trim the alignment slack around the views
+    char *end = base + 2 * size;
+    char *reservedEnd = static_cast<char *>(reserved) + span;
+    if (base != reserved)
+      munmap(reserved, base - static_cast<char *>(reserved));
+    if (reservedEnd != end)
+      munmap(end, reservedEnd - end);
+
+    // Best effort: without THP for shmem this is a no-op
+    madvise(rx, size, MADV_HUGEPAGE);
+    madvise(rw, size, MADV_HUGEPAGE);
+    return new SlabMemoryManager(fd, static_cast<char *>(rx),
+                                 static_cast<char *>(rw), size);
+  }();
+  return instance;
+}
+
+SlabMemoryManager::SlabMemoryManager(int FD, char *RX, char *RW, uint64_t Size)
+    : fd_(FD), rx_(RX), rw_(RW) {
+  code_.begin = 0;
+  code_.end = Size / 2;
+  data_.begin = Size / 2;
+  data_.end = Size;
+  code_.free[code_.begin] = code_.end - code_.begin;
+  data_.free[data_.begin] = data_.end - data_.begin;
+}
+
+bool SlabMemoryManager::take(bool Code, uint64_t Size, uint64_t Align,
+                             const llvm::jitlink::JITLinkDylib *Owner,
+                             Range &Out) {
+  Size = llvm::alignTo(std::max<uint64_t>(Size, 1), kGranule);
+  Align = std::max(Align, kGranule);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Arena &arena = Code ? code_ : data_;
+  // First fit keeps live allocations packed at the start of the arena
+  for (auto it = arena.free.begin(); it != arena.free.end(); ++it) {
+    uint64_t start = it->first;
+    uint64_t end = start + it->second;
+    uint64_t aligned = llvm::alignTo(start, Align);
+    if (aligned + Size > end)
+      continue;
+
+    arena.free.erase(it);
+    if (aligned > start)
+      arena.free[start] = aligned - start;
+    if (aligned + Size < end)
+      arena.free[aligned + Size] = end - aligned - Size;
+    arena.used += Size;
+    owners_[Owner] += Size;
+    Out = Range{Code, aligned, Size, Owner};
+    return true;
+  }
+  return false;
+}
+
+void SlabMemoryManager::give(const Range &R) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Arena &arena = R.code ? code_ : data_;
+  arena.used -= R.size;
+  auto owner = owners_.find(R.owner);
+  if (owner != owners_.end() && (owner->second -= R.size) == 0)
+    owners_.erase(owner);
+
+  uint64_t start = R.offset;
+  uint64_t end = R.offset + R.size;
+  auto next = arena.free.lower_bound(start);
+  if (next != arena.free.end() && next->first == end) {
+    end += next->second;
+    next = arena.free.erase(next);
+  }
+  if (next != arena.free.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == start) {
+      start = prev->first;
+      arena.free.erase(prev);
+    }
+  }
+  arena.free[start] = end - start;
+
+  // Hand whole free huge pages back to the kernel
+  uint64_t first = llvm::alignTo(start, kHugePage);
+  uint64_t last = end & ~(kHugePage - 1);
+  if (first < last)
+    fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, first,
+              last - first);
+}
+
+void SlabMemoryManager::allocate(const llvm::jitlink::JITLinkDylib *JD,
+                                 LinkGraph &G,
+                                 OnAllocatedFunction OnAllocated) {
+  BasicLayout BL(G);
+  std::vector<Range> standard;
+  std::vector<Range> finalizeOnly;
+  auto rollBack = [&]() {
+    for (const Range &R : standard)
+      give(R);
+    for (const Range &R : finalizeOnly)
+      give(R);
+  };
+
+  for (auto &KV : BL.segments()) {
+    const auto &AG = KV.first;
+    auto &Seg = KV.second;
+    bool code = (AG.getMemProt() & llvm::orc::MemProt::Exec) !=
+                llvm::orc::MemProt::None;
+    Range range;
+    if (!take(code, Seg.ContentSize + Seg.ZeroFillSize, Seg.Alignment.value(),
+              JD, range)) {
+      rollBack();
+      OnAllocated(llvm::make_error<llvm::StringError>(
+          "JIT " + std::string(code ? "code" : "data") + " slab exhausted",
+          llvm::inconvertibleErrorCode()));
+      return;
+    }
+    // Reused ranges hold old code; zero-fill sections rely on this
+    std::memset(writeAddress(range), 0, range.size);
+    Seg.WorkingMem = writeAddress(range);
+    Seg.Addr = llvm::orc::ExecutorAddr::fromPtr(code ? execAddress(range)
+                                                     : writeAddress(range));
+    if (AG.getMemLifetime() == llvm::orc::MemLifetime::Finalize)
+      finalizeOnly.push_back(range);
+    else
+      standard.push_back(range);
+  }
+
+  if (auto Err = BL.apply()) {
+    rollBack();
+    OnAllocated(std::move(Err));
+    return;
+  }
+  OnAllocated(std::make_unique<InFlight>(*this, G, std::move(BL),
+                                         std::move(standard),
+                                         std::move(finalizeOnly)));
+}
+
+void SlabMemoryManager::deallocate(std::vector<FinalizedAlloc> Allocs,
+                                   OnDeallocatedFunction OnDeallocated) {
+  llvm::Error Err = llvm::Error::success();
+  for (auto &Alloc : Allocs) {
+    auto *Info = Alloc.release().toPtr<FinalizedInfo *>();
+    if (auto E = llvm::orc::shared::runDeallocActions(Info->deallocActions))
+      Err = llvm::joinErrors(std::move(Err), std::move(E));
+    for (const Range &R : Info->ranges)
+      give(R);
+    delete Info;
+  }
+  OnDeallocated(std::move(Err));
+}
+
+uint64_t SlabMemoryManager::codeBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return code_.used;
+}
+
+uint64_t SlabMemoryManager::dataBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return data_.used;
+}
+
+uint64_t SlabMemoryManager::bytesFor(
+    const llvm::jitlink::JITLinkDylib *JD) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = owners_.find(JD);
+  return it == owners_.end() ? 0 : it->second;
+}
+
+} // namespace clap_rt
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/JITLink/JITLinkMemoryManager.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+namespace clap_rt {
+
+/// JIT memory shared by every ClapJIT of the process.
+///
+/// The default manager maps separate pages for each module, so with many
+/// plugin instances the code of their DSPs ends up scattered over 4K pages.
+/// This one carves all code from one arena and all data from another, in
+/// a single memfd mapped twice: read/execute for running code and
+/// read/write for writing it. Protections never change after mapping, so
+/// the arenas can be backed by 2 MB transparent huge pages (memfd huge
+/// pages follow /sys/kernel/mm/transparent_hugepage/shmem_enabled), and
+/// small modules are packed next to each other instead of being rounded
+/// up to whole pages. Freed ranges go back to first-fit free lists; whole
+/// 2 MB blocks that become free are returned to the kernel.
+///
+/// Read-only data is left writable.
+class SlabMemoryManager : public llvm::jitlink::JITLinkMemoryManager {
+public:
+  /// The process-wide manager, or nullptr if the slab could not be mapped
+  /// (callers then keep the default manager). Never destroyed, since JIT
+  /// code may run until the process exits.
+  static SlabMemoryManager *get();
+
+  void allocate(const llvm::jitlink::JITLinkDylib *JD,
+                llvm::jitlink::LinkGraph &G,
+                OnAllocatedFunction OnAllocated) override;
+
+  void deallocate(std::vector<FinalizedAlloc> Allocs,
+                  OnDeallocatedFunction OnDeallocated) override;
+
+  /// Bytes currently allocated to code and to data
+  uint64_t codeBytes() const;
+  uint64_t dataBytes() const;
+
+  /// Code and data bytes linked for JD (e.g. a JIT's main JITDylib)
+  uint64_t bytesFor(const llvm::jitlink::JITLinkDylib *JD) const;
+
+  /// A range handed out by one of the arenas
+  struct Range {
+    bool code = false;
+    uint64_t offset = 0;  // From the start of the memfd
+    uint64_t size = 0;
+    const llvm::jitlink::JITLinkDylib *owner = nullptr;
+  };
+
+private:
+  class InFlight;
+
+  // One contiguous part of the memfd with its own free list
+  struct Arena {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    std::map<uint64_t, uint64_t> free;  // offset -> size, coalesced
+    uint64_t used = 0;
+  };
+
+  SlabMemoryManager(int FD, char *RX, char *RW, uint64_t Size);
+
+  // Take Size bytes aligned to Align from an arena; false if it's full
+  bool take(bool Code, uint64_t Size, uint64_t Align,
+            const llvm::jitlink::JITLinkDylib *Owner, Range &Out);
+  void give(const Range &R);
+
+  // Address code runs at / memory is written through
+  char *execAddress(const Range &R) const { return rx_ + R.offset; }
+  char *writeAddress(const Range &R) const { return rw_ + R.offset; }
+
+  int fd_;
+  char *rx_;
+  char *rw_;
+  mutable std::mutex mutex_;
+  Arena code_;
+  Arena data_;
+  std::map<const llvm::jitlink::JITLinkDylib *, uint64_t> owners_;
+};
+
+} // namespace clap_rt
@@ -0,0 +1,140 @@
+#include "SourceCache.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+namespace clap_rt {
+
+namespace {
+
+// Buffer handed to Clang that keeps the cached contents alive, so an entry
+// can be dropped while a compile still reads from it
+class SharedBuffer : public llvm::MemoryBuffer {
+public:
+  SharedBuffer(std::shared_ptr<llvm::MemoryBuffer> Contents, std::string Name)
+      : contents_(std::move(Contents)), name_(std::move(Name)) {
+    init(contents_->getBufferStart(), contents_->getBufferEnd(),
+         /*RequiresNullTerminator=*/true);
+  }
+
+  llvm::StringRef getBufferIdentifier() const override { return name_; }
+  BufferKind getBufferKind() const override { return MemoryBuffer_Malloc; }
+
+private:
+  std::shared_ptr<llvm::MemoryBuffer> contents_;
+  std::string name_;
+};
+
+class CachedFile : public llvm::vfs::File {
+public:
+  CachedFile(llvm::vfs::Status S, std::shared_ptr<llvm::MemoryBuffer> Contents)
+      : status_(std::move(S)), contents_(std::move(Contents)) {}
+
+  llvm::ErrorOr<llvm::vfs::Status> status() override { return status_; }
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+  getBuffer(const llvm::Twine &Name, int64_t, bool, bool) override {
+    return std::make_unique<SharedBuffer>(contents_, Name.str());
+  }
+
+  std::error_code close() override { return {}; }
+
+private:
+  llvm::vfs::Status status_;
+  std::shared_ptr<llvm::MemoryBuffer> contents_;
+};
+
+} // anonymous namespace
+
+SourceCache::SourceCache() : ProxyFileSystem(llvm::vfs::getRealFileSystem()) {}
+
+std::string SourceCache::key(const llvm::Twine &Path) {
+  llvm::SmallString<256> path;
+  Path.toVector(path);
+  // ".." is kept: folding it is wrong when the parent is a symlink
+  llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/false);
+  return std::string(path);
+}
+
+llvm::ErrorOr<llvm::vfs::Status>
+SourceCache::status(const llvm::Twine &Path) {
+  std::string name = Path.str();
+  std::string k = key(name);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(k);
+    if (it != entries_.end()) {
+      if (!it->second.status)
+        return it->second.status.getError();
+      return llvm::vfs::Status::copyWithNewName(*it->second.status, name);
+    }
+  }
+
+  // Misses are cached too; most header lookups probe directories that
+  // don't have the file
+  auto S = ProxyFileSystem::status(name);
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_[k].status = S;
+  return S;
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+SourceCache::openFileForRead(const llvm::Twine &Path) {
+  std::string name = Path.str();
+  std::string k = key(name);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(k);
+    if (it != entries_.end()) {
+      const Entry &entry = it->second;
+      if (!entry.status)
+        return entry.status.getError();
+      if (entry.contents)
+        return std::make_unique<CachedFile>(
+            llvm::vfs::Status::copyWithNewName(*entry.status, name),
+            entry.contents);
+    }
+  }
+
+  auto FileOrErr = ProxyFileSystem::openFileForRead(name);
+  if (!FileOrErr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[k].status = FileOrErr.getError();
+    return FileOrErr;
+  }
+
+  // Only regular files are kept; anything else is read through each time
+  auto S = (*FileOrErr)->status();
+  if (!S || !S->isRegularFile())
+    return FileOrErr;
+  auto BufOrErr = (*FileOrErr)->getBuffer(name);
+  if (!BufOrErr)
+    return BufOrErr.getError();
+
+  std::shared_ptr<llvm::MemoryBuffer> contents = std::move(*BufOrErr);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry &entry = entries_[k];
+    entry.status = *S;
+    entry.contents = contents;
+  }
+  return std::make_unique<CachedFile>(*S, std::move(contents));
+}
+
+void SourceCache::invalidate(llvm::StringRef Prefix) {
+  std::string prefix = key(Prefix);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    auto current = it++;
+    if (current->getKey().starts_with(prefix))
+      entries_.erase(current);
+  }
+}
+
+void SourceCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+} // namespace clap_rt
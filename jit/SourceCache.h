@@ -0,0 +1,46 @@
+#pragma once
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <memory>
+#include <mutex>
+
+namespace clap_rt {
+
+/// File system for Clang that remembers what it has read.
+///
+/// A DSP compile pulls in hundreds of headers from /usr/include/c++ and
+/// probes every include directory for each of them. This layer keeps file
+/// contents and stat results, including misses, across compiles so only the
+/// first compile pays for those syscalls. Entries stay valid until
+/// invalidate() drops them; callers that watch files call it on changes.
+/// Thread-safe, meant to be shared by every ClapJIT of a process.
+class SourceCache : public llvm::vfs::ProxyFileSystem {
+public:
+  /// Cache over the real file system
+  SourceCache();
+
+  llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine &Path) override;
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+  openFileForRead(const llvm::Twine &Path) override;
+
+  /// Drop entries whose path starts with Prefix, e.g. a watched directory
+  void invalidate(llvm::StringRef Prefix);
+
+  /// Drop every entry
+  void clear();
+
+private:
+  struct Entry {
+    llvm::ErrorOr<llvm::vfs::Status> status = std::error_code();
+    std::shared_ptr<llvm::MemoryBuffer> contents; // Null until opened
+  };
+
+  // Entry key: the path with "./" components removed
+  static std::string key(const llvm::Twine &Path);
+
+  std::mutex mutex_;
+  llvm::StringMap<Entry> entries_;
+};
+
+} // namespace clap_rt
@@ -0,0 +1,124 @@
+#include "Target.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/TargetParser/Host.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+
+namespace clap_rt {
+
+namespace {
+
+// Features each level adds on top of the previous one (x86-64 psABI)
+constexpr std::initializer_list<const char *> kV2Features = {
+    "cx16", "sahf", "popcnt", "sse3", "sse4.1", "sse4.2", "ssse3"};
+constexpr std::initializer_list<const char *> kV3Features = {
+    "avx", "avx2", "bmi", "bmi2", "f16c", "fma", "lzcnt", "movbe", "xsave"};
+constexpr std::initializer_list<const char *> kV4Features = {
+    "avx512f", "avx512bw", "avx512cd", "avx512dq", "avx512vl"};
+
+std::initializer_list<const char *> levelFeatures(CpuLevel Level) {
+  switch (Level) {
+  case CpuLevel::V2:
+    return kV2Features;
+  case CpuLevel::V3:
+    return kV3Features;
+  case CpuLevel::V4:
+    return kV4Features;
+  case CpuLevel::Generic:
+    break;
+  }
+  return {};
+}
+
+constexpr CpuLevel kAllLevels[] = {CpuLevel::Generic, CpuLevel::V2,
+                                   CpuLevel::V3, CpuLevel::V4};
+
+} // anonymous namespace
+
+llvm::StringRef cpuLevelName(CpuLevel Level) {
+  switch (Level) {
+  case CpuLevel::Generic:
+    return "generic";
+  case CpuLevel::V2:
+    return "v2";
+  case CpuLevel::V3:
+    return "v3";
+  case CpuLevel::V4:
+    return "v4";
+  }
+  return "generic";
+}
+
+std::optional<CpuLevel> parseCpuLevel(llvm::StringRef Name) {
+  for (CpuLevel Level : kAllLevels) {
+    if (Name == cpuLevelName(Level) || Name == cpuLevelCPU(Level))
+      return Level;
+  }
+  return std::nullopt;
+}
+
+llvm::StringRef cpuLevelCPU(CpuLevel Level) {
+  switch (Level) {
+  case CpuLevel::Generic:
+    return "x86-64";
+  case CpuLevel::V2:
+    return "x86-64-v2";
+  case CpuLevel::V3:
+    return "x86-64-v3";
+  case CpuLevel::V4:
+    return "x86-64-v4";
+  }
+  return "x86-64";
+}
+
+std::string cpuLevelFeatures(CpuLevel Level) {
+  std::string features;
+  for (CpuLevel L : kAllLevels) {
+    if (L > Level)
+      break;
+    for (const char *F : levelFeatures(L)) {
+      if (!features.empty())
+        features += ',';
+      features += '+';
+      features += F;
+    }
+  }
+  return features;
+}
+
+CpuLevel detectHostCpuLevel() {
+  auto HostFeatures = llvm::sys::getHostCPUFeatures();
+
+  CpuLevel best = CpuLevel::Generic;
+  for (CpuLevel Level : kAllLevels) {
+    for (const char *F : levelFeatures(Level)) {
+      if (!HostFeatures.lookup(F))
+        return best;
+    }
+    best = Level;
+  }
+  return best;
+}
+
+std::string hostCpuDescription() {
+  static const std::string description = [] {
+    // StringMap iteration order is unspecified, so sort for a stable string
+    std::vector<std::string> enabled;
+    for (const auto &F : llvm::sys::getHostCPUFeatures()) {
+      if (F.getValue())
+        enabled.push_back(F.getKey().str());
+    }
+    std::sort(enabled.begin(), enabled.end());
+
+    std::string text = llvm::sys::getHostCPUName().str();
+    for (const auto &F : enabled)
+      text += '+' + F;
+    return text;
+  }();
+  return description;
+}
+
+} // namespace clap_rt
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <optional>
+#include <string>
+
+namespace clap_rt {
+
+/// x86-64 micro-architecture levels code can be compiled for.
+/// Ordered so that a higher level runs everything a lower level supports.
+enum class CpuLevel { Generic, V2, V3, V4 };
+
+/// Short name used in bundles and cache file names ("generic", "v2", ...)
+llvm::StringRef cpuLevelName(CpuLevel Level);
+
+/// Parses a name produced by cpuLevelName()
+std::optional<CpuLevel> parseCpuLevel(llvm::StringRef Name);
+
+/// LLVM CPU name for the level ("x86-64", "x86-64-v2", ...)
+llvm::StringRef cpuLevelCPU(CpuLevel Level);
+
+/// LLVM target feature string for the level ("+sse4.2,+popcnt,...")
+std::string cpuLevelFeatures(CpuLevel Level);
+
+/// Highest level fully supported by the host CPU
+CpuLevel detectHostCpuLevel();
+
+/// Host CPU name and enabled features ("znver3+adx+aes..."), i.e. what
+/// -march=native resolves to on this machine
+std::string hostCpuDescription();
+
+} // namespace clap_rt
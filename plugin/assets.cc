@@ -0,0 +1,320 @@
+#include "assets.h"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/xxhash.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace assets {
+
+namespace {
+
+/// Header of a decoded cache file, followed by planar float samples
+struct CacheHeader {
+  char magic[8];  // "RTCLAPA1"
+  uint32_t channels;
+  uint32_t reserved;
+  uint64_t frames;
+  double sample_rate;
+};
+static_assert(sizeof(CacheHeader) == 32, "samples must stay 16-byte aligned");
+
+constexpr char kMagic[8] = {'R', 'T', 'C', 'L', 'A', 'P', 'A', '1'};
+
+/// One mapped cache file
+struct Entry {
+  rtclap_asset asset{};
+  std::string key;
+  void *map = nullptr;
+  size_t map_size = 0;
+  int refs = 0;
+};
+
+std::mutex g_mutex;
+std::filesystem::path g_root;
+std::filesystem::path g_cache_dir;
+std::unordered_map<std::string, std::unique_ptr<Entry>> g_entries;
+
+struct Decoded {
+  uint32_t channels = 0;
+  double sample_rate = 0;
+  std::vector<float> planar;  // channel after channel
+};
+
+uint32_t read_u32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t read_u16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+bool decode_wav(const std::filesystem::path &path, Decoded &out,
+                std::string &error) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    error = "cannot open " + path.string();
+    return false;
+  }
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  if (bytes.size() < 12 || std::memcmp(bytes.data(), "RIFF", 4) != 0 ||
+      std::memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+    error = path.string() + ": not a WAV file";
+    return false;
+  }
+
+  uint16_t format = 0, bits = 0;
+  uint32_t channels = 0, rate = 0;
+  const uint8_t *data = nullptr;
+  size_t data_size = 0;
+
+  size_t pos = 12;
+  while (pos + 8 <= bytes.size()) {
+    const uint8_t *chunk = bytes.data() + pos;
+    size_t size = read_u32(chunk + 4);
+    size_t body = pos + 8;
+    size = std::min(size, bytes.size() - body);
+    if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+      format = read_u16(chunk + 8);
+      channels = read_u16(chunk + 10);
+      rate = read_u32(chunk + 12);
+      bits = read_u16(chunk + 22);
+      // WAVE_FORMAT_EXTENSIBLE: the real format leads the sub-format GUID
+      if (format == 0xFFFE && size >= 26)
+        format = read_u16(chunk + 32);
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      data = chunk + 8;
+      data_size = size;
+    }
+    pos = body + size + (size & 1);
+  }
+
+  bool pcm = format == 1 && (bits == 16 || bits == 24 || bits == 32);
+  bool ieee = format == 3 && bits == 32;
+  if (!data || channels == 0 || (!pcm && !ieee)) {
+    error = path.string() + ": unsupported WAV format (" +
+            std::to_string(format) + ", " + std::to_string(bits) + " bit)";
+    return false;
+  }
+
+  size_t stride = bits / 8 * channels;
+  size_t frames = data_size / stride;
+  out.channels = channels;
+  out.sample_rate = rate;
+  out.planar.resize(frames * channels);
+
+  for (size_t f = 0; f < frames; ++f) {
+    for (uint32_t c = 0; c < channels; ++c) {
+      const uint8_t *p = data + f * stride + c * (bits / 8);
+      float value;
+      if (ieee) {
+        std::memcpy(&value, p, sizeof(value));
+      } else if (bits == 16) {
+        value = static_cast<int16_t>(read_u16(p)) / 32768.0f;
+      } else if (bits == 24) {
+        int32_t s = static_cast<int32_t>(
+                        (p[0] << 8) | (p[1] << 16) |
+                        (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+        value = s / 8388608.0f;
+      } else {
+        value = static_cast<int32_t>(read_u32(p)) / 2147483648.0f;
+      }
+      out.planar[c * frames + f] = value;
+    }
+  }
+  return true;
+}
+
+/// Writes the decoded samples next to a temporary name and renames it into
+/// place, so concurrent instances never map a half-written file.
+bool write_cache(const std::filesystem::path &cache_path, const Decoded &decoded,
+                 std::string &error) {
+  std::error_code ec;
+  std::filesystem::create_directories(cache_path.parent_path(), ec);
+
+  CacheHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.channels = decoded.channels;
+  header.frames = decoded.planar.size() / decoded.channels;
+  header.sample_rate = decoded.sample_rate;
+
+  auto tmp_path = cache_path;
+  tmp_path += ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(decoded.planar.data()),
+               decoded.planar.size() * sizeof(float));
+    if (!file) {
+      error = "cannot write " + tmp_path.string();
+      std::filesystem::remove(tmp_path, ec);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp_path, cache_path, ec);
+  if (ec) {
+    error = "cannot write " + cache_path.string() + ": " + ec.message();
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+/// Maps a cache file; fails if it is missing or was not written by us
+bool map_cache(const std::filesystem::path &cache_path, Entry &entry) {
+  int fd = ::open(cache_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(CacheHeader)) {
+    ::close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void *map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const auto *header = static_cast<const CacheHeader *>(map);
+  size_t expected = sizeof(CacheHeader) +
+                    header->frames * header->channels * sizeof(float);
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->channels == 0 || size < expected) {
+    ::munmap(map, size);
+    return false;
+  }
+
+  entry.map = map;
+  entry.map_size = size;
+  entry.asset.data = reinterpret_cast<const float *>(
+      static_cast<const char *>(map) + sizeof(CacheHeader));
+  entry.asset.frames = header->frames;
+  entry.asset.channels = header->channels;
+  entry.asset.sample_rate = header->sample_rate;
+  return true;
+}
+
+} // anonymous namespace
+
+void configure(const std::filesystem::path &root,
+               const std::filesystem::path &cache_dir) {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_root = root;
+  g_cache_dir = cache_dir;
+}
+
+const rtclap_asset *acquire(const std::string &path, std::string *error) {
+  std::string local_error;
+  std::string &err = error ? *error : local_error;
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  std::filesystem::path source(path);
+  if (source.is_relative())
+    source = g_root / source;
+
+  struct stat st;
+  if (::stat(source.c_str(), &st) != 0) {
+    err = "cannot open " + source.string();
+    return nullptr;
+  }
+
+  // An edited file gets a new key; instances still holding the old data
+  // keep their mapping until they close it.
+  std::string key = source.lexically_normal().string() + '\0' +
+                    std::to_string(st.st_mtim.tv_sec) + '.' +
+                    std::to_string(st.st_mtim.tv_nsec) + '\0' +
+                    std::to_string(st.st_size);
+  if (auto it = g_entries.find(key); it != g_entries.end()) {
+    ++it->second->refs;
+    return &it->second->asset;
+  }
+
+  auto entry = std::make_unique<Entry>();
+  entry->key = key;
+  auto cache_path = g_cache_dir / "assets" /
+                    (llvm::utohexstr(llvm::xxh3_64bits(
+                         llvm::arrayRefFromStringRef(key))) +
+                     ".f32");
+
+  // Decoding happens once per file version, across processes
+  if (!map_cache(cache_path, *entry)) {
+    Decoded decoded;
+    if (!decode_wav(source, decoded, err) ||
+        !write_cache(cache_path, decoded, err))
+      return nullptr;
+    if (!map_cache(cache_path, *entry)) {
+      err = "cannot map " + cache_path.string();
+      return nullptr;
+    }
+  }
+
+  entry->refs = 1;
+  const rtclap_asset *asset = &entry->asset;
+  g_entries.emplace(key, std::move(entry));
+  return asset;
+}
+
+void release(const rtclap_asset *asset) {
+  if (!asset)
+    return;
+  std::lock_guard<std::mutex> lock(g_mutex);
+  for (auto it = g_entries.begin(); it != g_entries.end(); ++it) {
+    Entry &entry = *it->second;
+    if (&entry.asset != asset)
+      continue;
+    if (--entry.refs == 0) {
+      ::munmap(entry.map, entry.map_size);
+      g_entries.erase(it);
+    }
+    return;
+  }
+}
+
+void prefetch(const rtclap_asset *asset) {
+  if (!asset)
+    return;
+  // The mapping starts one header before the samples
+  auto *map = const_cast<char *>(reinterpret_cast<const char *>(asset->data)) -
+              sizeof(CacheHeader);
+  size_t size = sizeof(CacheHeader) +
+                asset->frames * asset->channels * sizeof(float);
+  ::madvise(map, size, MADV_WILLNEED);
+
+  // madvise only schedules the read; touching each page waits for it
+  const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  volatile const char *bytes = map;
+  char sink = 0;
+  for (size_t offset = 0; offset < size; offset += page)
+    sink ^= bytes[offset];
+  (void)sink;
+}
+
+} // namespace assets
+
+// ============================================================================
+// C interface for JIT code
+// ============================================================================
+
+extern "C" {
+
+const rtclap_asset *rtclap_asset_open(const char *path) {
+  if (!path)
+    return nullptr;
+  return assets::acquire(path, nullptr);
+}
+
+void rtclap_asset_close(const rtclap_asset *asset) { assets::release(asset); }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// C interface exported to JIT code (see examples/lib/rtclap/asset.h)
+extern "C" {
+
+/// Decoded audio, planar: channel c starts at data + c * frames
+struct rtclap_asset {
+  const float *data;
+  uint64_t frames;
+  uint32_t channels;
+  double sample_rate;
+};
+
+/// Opens an audio file (WAV: 16/24/32-bit PCM or 32-bit float). Relative
+/// paths are resolved against the DSP folder. Returns nullptr on failure.
+const rtclap_asset *rtclap_asset_open(const char *path);
+void rtclap_asset_close(const rtclap_asset *asset);
+}
+
+namespace assets {
+
+/// Sets the folder relative asset paths are resolved against and where
+/// decoded float caches are written. Call before loading any DSP.
+void configure(const std::filesystem::path &root,
+               const std::filesystem::path &cache_dir);
+
+/// Opens an asset: decodes it into the float cache on first use, maps
+/// the cache file read-only and shares the mapping between everyone
+/// holding it. Returns nullptr and sets error on failure.
+const rtclap_asset *acquire(const std::string &path, std::string *error);
+
+/// Drops one reference; the mapping goes away with the last one
+void release(const rtclap_asset *asset);
+
+/// Faults in every page of the asset so the audio thread never does
+void prefetch(const rtclap_asset *asset);
+
+/// Reference held by the plugin for assets a DSP announced via
+/// asset_path(), so they are mapped before the DSP's init() runs.
+class Pin {
+public:
+  Pin() = default;
+  explicit Pin(const rtclap_asset *asset) : asset_(asset) {}
+  Pin(Pin &&other) noexcept : asset_(other.asset_) { other.asset_ = nullptr; }
+  Pin &operator=(Pin &&other) noexcept {
+    if (this != &other) {
+      reset();
+      asset_ = other.asset_;
+      other.asset_ = nullptr;
+    }
+    return *this;
+  }
+  Pin(const Pin &) = delete;
+  Pin &operator=(const Pin &) = delete;
+  ~Pin() { reset(); }
+
+  void reset() {
+    if (asset_)
+      release(asset_);
+    asset_ = nullptr;
+  }
+
+private:
+  const rtclap_asset *asset_ = nullptr;
+};
+
+} // namespace assets
@@ -0,0 +1,185 @@
+#include "batcher.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace dsp {
+
+namespace {
+
+std::mutex g_batchers_mutex;
+std::unordered_map<uint64_t, std::weak_ptr<Batcher>> g_batchers;
+
+constexpr uint32_t kChunk = 256;  // Frames per process_wide() call
+
+} // anonymous namespace
+
+std::shared_ptr<Batcher> Batcher::acquire(uint64_t build, double sample_rate,
+                                          uint32_t max_frames) {
+  uint64_t key = build;
+  key ^= std::bit_cast<uint64_t>(sample_rate) * 0x9E3779B97F4A7C15ull;
+  key ^= static_cast<uint64_t>(max_frames) * 0xC2B2AE3D27D4EB4Full;
+
+  std::lock_guard<std::mutex> lock(g_batchers_mutex);
+  if (auto it = g_batchers.find(key); it != g_batchers.end()) {
+    if (auto batcher = it->second.lock())
+      return batcher;
+  }
+
+  // Drop batchers of builds nobody runs anymore
+  for (auto it = g_batchers.begin(); it != g_batchers.end();) {
+    if (it->second.expired())
+      it = g_batchers.erase(it);
+    else
+      ++it;
+  }
+
+  auto batcher = std::make_shared<Batcher>(max_frames);
+  g_batchers[key] = batcher;
+  return batcher;
+}
+
+Batcher::Batcher(uint32_t max_frames)
+    : latency_(max_frames), chunk_(std::min(kChunk, std::max(max_frames, 1u))),
+      mask_(std::bit_ceil(4ull * std::max(max_frames, 1u)) - 1),
+      wide_in_(kMaxLanes * chunk_), wide_out_(kMaxLanes * chunk_),
+      wide_params_(kParams * kMaxLanes), wide_channels_(kMaxLanes) {}
+
+void Batcher::lock() {
+  while (lock_.test_and_set(std::memory_order_acquire)) {
+  }
+}
+
+int Batcher::join(uint32_t channels) {
+  // Allocate before taking the lock the audio threads spin on
+  std::unique_ptr<Lane> fresh[kMaxLanes];
+  for (uint32_t c = 0; c < channels && c < kMaxLanes; ++c) {
+    fresh[c] = std::make_unique<Lane>();
+    fresh[c]->in.assign(mask_ + 1, 0.0f);
+    fresh[c]->out.assign(mask_ + 1, 0.0f);
+    fresh[c]->channel = static_cast<float>(c);
+  }
+
+  lock();
+  // New lanes start where the others are, so they batch with them
+  uint64_t position = 0;
+  for (const auto &lane : lanes_) {
+    if (lane)
+      position = std::max(position, lane->written);
+  }
+
+  int first = -1;
+  for (uint32_t l = 0; l + channels <= kMaxLanes && first < 0; ++l) {
+    bool free = true;
+    for (uint32_t c = 0; c < channels; ++c)
+      free = free && !lanes_[l + c];
+    if (free)
+      first = static_cast<int>(l);
+  }
+  if (first >= 0) {
+    for (uint32_t c = 0; c < channels; ++c) {
+      fresh[c]->written = fresh[c]->processed = position;
+      lanes_[first + c] = std::move(fresh[c]);
+    }
+  }
+  unlock();
+  return first;
+}
+
+void Batcher::leave(int first_lane, uint32_t channels) {
+  std::unique_ptr<Lane> released[kMaxLanes];
+  lock();
+  for (uint32_t c = 0; c < channels; ++c)
+    released[c] = std::move(lanes_[first_lane + c]);
+  unlock();
+  // Freed here, outside the lock
+}
+
+void Batcher::run_group(WideFn fn, const Lane &lane, uint64_t end) {
+  const uint64_t start = lane.processed;
+
+  uint32_t count = 0;
+  for (const auto &other : lanes_) {
+    if (other && other->processed == start && other->written >= end)
+      group_[count++] = other.get();
+  }
+  const uint32_t lanes = (count + kLaneWidth - 1) / kLaneWidth * kLaneWidth;
+
+  // Padding lanes run on silence with zero parameters
+  std::fill(wide_params_.begin(), wide_params_.end(), 0.0f);
+  std::fill(wide_channels_.begin(), wide_channels_.end(), 0.0f);
+  for (uint32_t k = 0; k < count; ++k) {
+    for (uint32_t p = 0; p < kParams; ++p)
+      wide_params_[p * lanes + k] = group_[k]->params[p];
+    wide_channels_[k] = group_[k]->channel;
+  }
+
+  for (uint64_t pos = start; pos < end; pos += chunk_) {
+    const uint32_t frames =
+        static_cast<uint32_t>(std::min<uint64_t>(chunk_, end - pos));
+    std::fill_n(wide_in_.begin(), frames * lanes, 0.0f);
+    for (uint32_t k = 0; k < count; ++k) {
+      const float *ring = group_[k]->in.data();
+      for (uint32_t t = 0; t < frames; ++t)
+        wide_in_[t * lanes + k] = ring[(pos + t) & mask_];
+    }
+
+    fn(wide_in_.data(), wide_out_.data(), wide_params_.data(),
+       wide_channels_.data(), lanes, frames);
+
+    for (uint32_t k = 0; k < count; ++k) {
+      float *ring = group_[k]->out.data();
+      for (uint32_t t = 0; t < frames; ++t)
+        ring[(pos + t) & mask_] = wide_out_[t * lanes + k];
+    }
+  }
+
+  for (uint32_t k = 0; k < count; ++k)
+    group_[k]->processed = end;
+}
+
+void Batcher::process(WideFn fn, int first_lane, const float *const *inputs,
+                      float *const *outputs, uint32_t channels,
+                      uint32_t frames, const float *params) {
+  lock();
+
+  // Queue the block, remembering where each lane's output starts
+  uint64_t starts[kMaxLanes] = {};
+  for (uint32_t c = 0; c < channels; ++c) {
+    Lane *lane = lanes_[first_lane + c].get();
+    if (!lane)
+      continue;
+    starts[c] = lane->written;
+    for (uint32_t t = 0; t < frames; ++t)
+      lane->in[(lane->written + t) & mask_] = inputs[c][t];
+    std::memcpy(lane->params, params, sizeof(lane->params));
+    lane->written += frames;
+  }
+
+  // Output is input from latency_ samples ago. The first instance of a
+  // host cycle runs everyone; later ones find their lanes done.
+  for (uint32_t c = 0; c < channels; ++c) {
+    Lane *lane = lanes_[first_lane + c].get();
+    if (!lane)
+      continue;
+    const uint64_t end = starts[c] + frames;
+    if (end > latency_ && lane->processed < end - latency_)
+      run_group(fn, *lane, end - latency_);
+  }
+
+  for (uint32_t c = 0; c < channels; ++c) {
+    const Lane *lane = lanes_[first_lane + c].get();
+    for (uint32_t t = 0; t < frames; ++t) {
+      const uint64_t s = starts[c] + t;
+      outputs[c][t] = lane && s >= latency_ ? lane->out[(s - latency_) & mask_]
+                                            : 0.0f;
+    }
+  }
+
+  unlock();
+}
+
+} // namespace dsp
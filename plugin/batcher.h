@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dsp {
+
+/// Wide entry point of expression DSPs (see jit/Expr.h): `lanes` signals
+/// side by side, in[frame * lanes + lane], params[p * lanes + lane].
+using WideFn = void (*)(const float *, float *, const float *, const float *,
+                        uint32_t, uint32_t);
+
+/// Runs the channels of many plugin instances of one build through a
+/// single process_wide() call, one SIMD lane per channel (experimental).
+///
+/// Each instance queues its input and reads its output delayed by
+/// latency() samples. That delay is what makes batching possible: by the
+/// time the first instance of a host cycle asks for output, every instance
+/// has already queued the input it needs, so one call serves them all.
+/// Lanes that fall behind (e.g. a track the host stopped processing) are
+/// run on their own. Parameters are the lane's latest, so a change is
+/// heard in the next output block rather than one block later.
+class Batcher {
+public:
+  static constexpr uint32_t kMaxLanes = 64;
+  static constexpr uint32_t kLaneWidth = 8;  // Vector width of process_wide
+  static constexpr uint32_t kParams = 16;
+
+  /// Returns the batcher shared by instances of `build` at this sample
+  /// rate and block size, creating it if needed. Main thread.
+  static std::shared_ptr<Batcher> acquire(uint64_t build, double sample_rate,
+                                          uint32_t max_frames);
+
+  explicit Batcher(uint32_t max_frames);
+
+  /// Reserves `channels` consecutive lanes and returns the first, or -1 if
+  /// the batcher is full. Main thread.
+  int join(uint32_t channels);
+
+  /// Releases lanes reserved by join(). Main thread.
+  void leave(int first_lane, uint32_t channels);
+
+  /// Queues one block of an instance and writes its delayed output. fn is
+  /// the caller's own process_wide(), identical code for every member.
+  /// params holds the instance's kParams values for this block.
+  void process(WideFn fn, int first_lane, const float *const *inputs,
+               float *const *outputs, uint32_t channels, uint32_t frames,
+               const float *params);
+
+  /// Delay added by batching, in samples (the host's max block size)
+  uint32_t latency() const { return latency_; }
+
+private:
+  struct Lane {
+    std::vector<float> in;   // Ring buffers, indexed by sample & mask_
+    std::vector<float> out;
+    uint64_t written = 0;    // Samples queued
+    uint64_t processed = 0;  // Samples run through process_wide()
+    float params[kParams] = {};
+    float channel = 0.0f;
+  };
+
+  // Runs lanes at the same position as `lane` that have input up to `end`
+  void run_group(WideFn fn, const Lane &lane, uint64_t end);
+
+  void lock();
+  void unlock() { lock_.clear(std::memory_order_release); }
+
+  uint32_t latency_;
+  uint32_t chunk_;  // Frames per process_wide() call
+  uint64_t mask_;
+  std::unique_ptr<Lane> lanes_[kMaxLanes];
+
+  // Scratch for one call: interleaved audio, SoA params, lane channels
+  std::vector<float> wide_in_;
+  std::vector<float> wide_out_;
+  std::vector<float> wide_params_;
+  std::vector<float> wide_channels_;
+  Lane *group_[kMaxLanes] = {};
+
+  std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+};
+
+} // namespace dsp
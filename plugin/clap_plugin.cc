@@ -1,13 +1,30 @@
 #include <clap/clap.h>
 
 #include "../jit/JIT.h"
+#include "assets.h"
+#include "batcher.h"
+#include "convolver.h"
 #include "gui.h"
+#include "library.h"
+#include "memory.h"
+#include "oversampler.h"
+#include "stft.h"
+#include "voices.h"
 
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/xxhash.h>
+
+#include <algorithm>
 #include <atomic>
+#include <bit>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <memory>
+#include <optional>
+#include <thread>
 
 // ============================================================================
 // Types and Globals
@@ -16,10 +33,34 @@
 /// Directory containing DSP source files (~/.local/share/rt-clap/)
 static std::filesystem::path g_dsp_dir;
 
+/// Cross-instance batching of expression DSPs, from RTCLAP_BATCH=1
+/// (experimental, adds one host block of latency)
+static bool g_batching = false;
+
+/// Index of all DSP files, shared by every plugin instance (main thread only)
+static library::Library g_library;
+static bool g_library_loaded = false;
+
+/// Every instance's timer refreshes g_library; calls closer together than
+/// this (i.e. from the same tick) reuse the last refresh
+static constexpr auto kLibraryRefreshInterval = std::chrono::milliseconds(400);
+static std::chrono::steady_clock::time_point g_library_refreshed;
+
+/// Headers and stat results read by Clang, shared by every instance's
+/// compiles. DSP folder entries are dropped before each rebuild; toolchain
+/// headers stay cached for the life of the process.
+static llvm::IntrusiveRefCntPtr<clap_rt::SourceCache> g_source_cache;
+
 /// Global parameter array - DSP reads directly for performance
 /// Exported so JIT-compiled DSP code can access via extern
 float g_params[16] = {1.0f};  // [0] = gain, default 1.0
 
+/// Per-sample values of modulated parameters for the current process()
+/// call, or nullptr where a parameter is not modulated (g_params then
+/// holds its value). Only filled for params in the DSP's
+/// param_buffer_mask().
+const float *g_param_buffers[16] = {};
+
 /// DSP function signatures
 using ProcessFn = void (*)(const float *const *, float *const *, uint32_t,
                            uint32_t);
@@ -30,6 +71,48 @@ using DestroyFn = void (*)();
 using ParamCountFn = int (*)();
 using ParamNameFn = const char *(*)(int);
 using ParamFloatFn = float (*)(int);
+using AssetPathFn = const char *(*)(int);
+
+/// Optional DSP state hooks for CLAP state: save_state() returns the size it
+/// needs and writes only if capacity allows; load_state() gets those bytes
+using SaveStateFn = uint32_t (*)(void *, uint32_t);
+using LoadStateFn = bool (*)(const void *, uint32_t);
+
+// PluginState::save_request
+enum SaveRequest { kSaveIdle, kSaveRequested, kSaveRunning, kSaveDone };
+using SpectrumFn = dsp::Stft::SpectrumFn;
+
+/// Multi-bus entry point: inputs[bus][channel], outputs[bus][channel]
+using BusesFn = void (*)(const float *const *const *, uint32_t,
+                         float *const *const *, uint32_t, uint32_t, uint32_t);
+
+/// Audio buses per direction, the main one included
+constexpr uint32_t kMaxBuses = 8;
+
+/// Buses a build declares with input_bus_count()/output_bus_count()
+struct BusLayout {
+  uint32_t inputs = 1;
+  uint32_t outputs = 1;
+
+  bool operator==(const BusLayout &) const = default;
+};
+
+/// Synth entry point: renders count voices, adding into outputs
+using VoicesFn = void (*)(rtclap_voices *, uint32_t, float *const *, uint32_t,
+                          uint32_t);
+
+/// Control-rate entry points
+using ParamsChangedFn = void (*)(const float *, const uint32_t *);
+using ControlTickFn = void (*)();
+
+/// Slots in g_params, and bits in the on_params_changed() mask
+constexpr uint32_t kMaxParams = 16;
+constexpr uint32_t kParamMaskWords = (kMaxParams + 31) / 32;
+static_assert(RTCLAP_VOICE_PARAMS == kMaxParams,
+              "every param can be modulated per voice");
+
+/// Channels of the audio ports, and of the oversampling buffers
+constexpr uint32_t kPortChannels = 2;
 
 /// Parameter info from DSP
 struct ParamInfo {
@@ -49,7 +132,9 @@ struct PluginState {
   // Hot-reload support (atomic swap at frame boundary)
   std::atomic<bool> reload_pending{false};
   ProcessFn pending_fn = nullptr;
-  std::unique_ptr<clap_rt::ClapJIT> pending_jit;  // New JIT, swapped at frame boundary
+  // New JIT, swapped at frame boundary. The swap leaves the old one here
+  // for the main thread to free.
+  std::unique_ptr<clap_rt::ClapJIT> pending_jit;
 
   // DSP lifecycle functions (optional)
   InitFn dsp_init = nullptr;
@@ -59,6 +144,121 @@ struct PluginState {
   InitFn pending_init = nullptr;
   DestroyFn pending_destroy = nullptr;
 
+  // Assets announced by the DSP, mapped before its init() runs. After a
+  // swap pending_assets holds the old build's pins until the next reload
+  // replaces them on the main thread, so nothing is unmapped in process().
+  std::vector<assets::Pin> active_assets;
+  std::vector<assets::Pin> pending_assets;
+
+  // Oversampling requested by the DSP (oversampling_factor()). Buffers are
+  // allocated on the main thread once max_frames is known and handed over
+  // like the JIT; the old ones wait in pending_oversampler for the next
+  // reload to free them.
+  int oversampling = 1;
+  int pending_oversampling = 1;
+  std::unique_ptr<dsp::Oversampler> oversampler;
+  std::unique_ptr<dsp::Oversampler> pending_oversampler;
+
+  // Spectral DSPs (process_spectrum()) run inside an STFT instead of
+  // process(); swapped like the oversampler
+  SpectrumFn spectrum_fn = nullptr;
+  SpectrumFn pending_spectrum_fn = nullptr;
+  std::unique_ptr<dsp::Stft> stft;
+  std::unique_ptr<dsp::Stft> pending_stft;
+
+  // Latency of the newest build, reported to the host (main thread only)
+  uint32_t latency = 0;
+
+  // Cross-instance batching: while activated with g_batching, process_wide()
+  // runs through a Batcher shared with other instances of the same build.
+  // A reload makes the lanes stale until the host restarts the plugin.
+  dsp::WideFn wide_fn = nullptr;
+  dsp::WideFn pending_wide_fn = nullptr;
+  std::shared_ptr<dsp::Batcher> batcher;
+  int batch_lane = -1;
+  uint32_t batch_latency = 0;  // Added to latency while batching
+  bool batch_stale = false;    // Audio thread
+
+  // Control-rate entry points (optional), swapped like the others
+  ParamsChangedFn params_changed_fn = nullptr;
+  ControlTickFn control_tick_fn = nullptr;
+  uint32_t control_interval = 0;
+  ParamsChangedFn pending_params_changed_fn = nullptr;
+  ControlTickFn pending_control_tick_fn = nullptr;
+  uint32_t pending_control_interval = 0;
+
+  // Instruments ("JIT Synth") take notes instead of audio input. Voices
+  // outlive reloads; the new DSP's process_voices() picks them up.
+  bool instrument = false;
+  VoicesFn voices_fn = nullptr;
+  VoicesFn pending_voices_fn = nullptr;
+  dsp::VoicePool voices;  // Audio thread only
+
+  // Extra buses (process_buses()). port_buses is the newest build's layout
+  // reported to the host (main thread); buses is what process() runs.
+  BusesFn buses_fn = nullptr;
+  BusesFn pending_buses_fn = nullptr;
+  BusLayout buses;
+  BusLayout pending_buses;
+  BusLayout port_buses;
+
+  // Stand-ins for buses the host left out: zero_buffer is read for a
+  // missing input channel, discard_buffer written for a missing output
+  // channel. Sized to max_frames in activate.
+  std::vector<float> zero_buffer;
+  std::vector<float> discard_buffer;
+
+  // Parameter modulation (CLAP_EVENT_PARAM_MOD). gui_params holds the base
+  // values, param_mod the offsets; g_params gets their sum clamped to
+  // [param_lo, param_hi]. Buffers are only materialized for params in
+  // param_buffer_mask that are modulated. Note-targeted modulation goes
+  // to the voice pool instead.
+  float param_mod[kMaxParams] = {};  // Audio thread
+  // For each param of the pending build, the param of the running one
+  // whose modulation it keeps, or -1. Applied at the swap.
+  int8_t pending_mod_from[kMaxParams] = {};
+  float param_lo[kMaxParams] = {};   // Written by query_dsp_params()
+  float param_hi[kMaxParams] = {};
+  uint32_t param_buffer_mask = 0;
+  uint32_t pending_param_buffer_mask = 0;
+  std::vector<float> param_buffer_storage;  // kMaxParams * max_frames
+  const float *param_buffers[kMaxParams] = {};  // This block's, or nullptr
+
+  // Audio thread only: values last passed to on_params_changed(), and
+  // host samples left until the next control_tick()
+  float last_params[kMaxParams] = {};
+  bool params_primed = false;  // false: next call reports every param
+  uint32_t samples_to_tick = 0;
+
+  // Session state (CLAP_EXT_STATE). content_hash describes the newest
+  // build (main thread); embedded_bundle caches its serialized snapshot
+  // for embedded_hash. A loaded DSP state waits in restore_blob until the
+  // restored build's init() has run.
+  std::string build_file;  // Relative to the DSP dir
+  bool build_embedded = false;  // Built from embedded_bundle, not the file
+  uint64_t content_hash = 0;
+  std::vector<std::string> build_sources;
+  SaveStateFn save_state_fn = nullptr;  // Active build, audio thread
+  SaveStateFn pending_save_state_fn = nullptr;
+  LoadStateFn load_state_fn = nullptr;  // Active build, audio thread
+  LoadStateFn pending_load_state_fn = nullptr;
+  std::string embedded_bundle;
+  uint64_t embedded_hash = 0;
+  std::string restore_blob;
+  std::atomic<bool> restore_pending{false};
+
+  // save_state() runs between blocks like the rest of the DSP: state_save()
+  // sets save_request and the audio thread fills save_buffer (sized by the
+  // main thread while no request is open), storing the size it needed in
+  // save_size. dsp_busy is held by the audio thread during each block, and
+  // by the main thread when the host isn't processing and it calls
+  // save_state() itself.
+  std::atomic<int> save_request{kSaveIdle};
+  std::vector<char> save_buffer;
+  uint32_t save_size = 0;
+  std::atomic<bool> dsp_busy{false};
+  std::atomic<bool> processing{false};  // Between start/stop_processing
+
   // Audio parameters (stored for hot-reload init calls)
   double sample_rate = 0;
   uint32_t min_frames = 0;
@@ -69,16 +269,30 @@ struct PluginState {
   std::vector<ParamInfo> param_info;
   std::vector<float> gui_params;  // GUI writes, process reads (synced each frame)
 
+  // Offline rendering (main thread): file edits wait for realtime mode
+  bool render_offline = false;
+  // What builds see as g_render_offline, nonzero while the host renders
+  // offline (CLAP_EXT_RENDER). Each build is bound to the slot of the mode
+  // it was made for, so instances and the builds of one instance don't
+  // share a flag; switching rebuilds the DSP.
+  int render_offline_flags[2] = {0, 1};
+
   // File watching for auto-reload
   std::filesystem::file_time_type last_modified{};
-  std::filesystem::file_time_type folder_modified{};
+  std::vector<std::string> watched_files;  // lib/ sources, chain nodes
   clap_id timer_id = CLAP_INVALID_ID;
+  uint64_t library_generation = 0;  // g_library generation last checked
+
+  // Memory attributed to this instance, shown in the GUI and written to
+  // memory.stats
+  memory::Account memory;
 
   // GUI state
   gui::PluginGui gui_state;
 };
 
-/// Plugin descriptor
+/// Plugin descriptors: the effect and the instrument share everything but
+/// their ports
 static const clap_plugin_descriptor_t plugin_descriptor = {
     .clap_version = CLAP_VERSION,
     .id = "com.rt-clap.jit-dsp",
@@ -93,6 +307,21 @@ static const clap_plugin_descriptor_t plugin_descriptor = {
                                  CLAP_PLUGIN_FEATURE_UTILITY, nullptr},
 };
 
+static const clap_plugin_descriptor_t synth_descriptor = {
+    .clap_version = CLAP_VERSION,
+    .id = "com.rt-clap.jit-synth",
+    .name = "JIT Synth",
+    .vendor = "RT_CLAP",
+    .url = "",
+    .manual_url = "",
+    .support_url = "",
+    .version = "0.1.0",
+    .description = "JIT-compiled polyphonic synth plugin",
+    .features = (const char *[]){CLAP_PLUGIN_FEATURE_INSTRUMENT,
+                                 CLAP_PLUGIN_FEATURE_SYNTHESIZER,
+                                 CLAP_PLUGIN_FEATURE_STEREO, nullptr},
+};
+
 // ============================================================================
 // Helper Functions
 // ============================================================================
@@ -112,10 +341,39 @@ PluginGui *get_gui(const clap_plugin_t *plugin) {
 
 /// Returns the currently selected DSP filename.
 static std::string get_selected_dsp_file(PluginState *state) {
-  if (state->gui_state.dsp_files.empty()) {
+  if (state->gui_state.selected_file.empty()) {
     return "dsp.cc";
   }
-  return state->gui_state.dsp_files[state->gui_state.selected_file_index];
+  return state->gui_state.selected_file;
+}
+
+/// Loads the library index on first use and brings it up to date, at most
+/// once per kLibraryRefreshInterval. Returns true if the index changed.
+static bool refresh_library() {
+  auto now = std::chrono::steady_clock::now();
+  if (!g_library_loaded) {
+    g_library.load(g_dsp_dir / "library.index");
+    g_library_loaded = true;
+  } else if (now - g_library_refreshed < kLibraryRefreshInterval) {
+    return false;
+  }
+  g_library_refreshed = now;
+  bool changed = g_library.refresh(g_dsp_dir);
+  if (changed)
+    g_library.save();
+  return changed;
+}
+
+/// Selects local/gain.cc if present, otherwise the first library entry.
+static void select_default_dsp_file(PluginState *state) {
+  const auto &entries = g_library.entries();
+  if (g_library.find("local/gain.cc") >= 0) {
+    state->gui_state.selected_file = "local/gain.cc";
+  } else if (!entries.empty()) {
+    state->gui_state.selected_file = entries.front().path;
+  } else {
+    state->gui_state.selected_file.clear();
+  }
 }
 
 /// Logs compilation errors to ~/.local/share/rt-clap/compile.log
@@ -140,10 +398,30 @@ static std::vector<std::string> get_lib_sources() {
   return sources;
 }
 
+/// Returns lib/ sources and headers, for packaging into bundles
+static std::vector<std::string> get_lib_files() {
+  std::vector<std::string> files;
+  auto lib_dir = g_dsp_dir / "lib";
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(lib_dir, ec)) {
+    auto ext = entry.path().extension();
+    if (entry.is_regular_file() && (ext == ".cc" || ext == ".h")) {
+      files.push_back(entry.path().string());
+    }
+  }
+  return files;
+}
+
 /// Result of a compilation attempt
 struct CompileResult {
   std::unique_ptr<clap_rt::ClapJIT> jit;
   ProcessFn process_fn = nullptr;
+  SpectrumFn spectrum_fn = nullptr;   // Instead of or overriding process_fn
+  VoicesFn voices_fn = nullptr;       // Synths; process_fn becomes optional
+  BusesFn buses_fn = nullptr;         // Multi-bus effects, likewise
+  BusLayout buses;
+  std::unique_ptr<dsp::Stft> stft;
   InitFn init_fn = nullptr;
   DestroyFn destroy_fn = nullptr;
 
@@ -155,31 +433,142 @@ struct CompileResult {
   ParamFloatFn param_default = nullptr;
 
   std::string error;
-
-  bool success() const { return process_fn != nullptr; }
+  std::string cache_key;  // Object cache file of the DSP source (may be empty)
+  std::vector<std::string> sources;  // Every file the build read
+  std::vector<assets::Pin> assets;   // Prefetched asset_path() files
+  int oversampling = 1;              // 1, 2, 4 or 8
+  ParamsChangedFn params_changed_fn = nullptr;
+  ControlTickFn control_tick_fn = nullptr;
+  uint32_t control_interval = 0;     // Host samples between ticks
+  uint32_t param_buffer_mask = 0;    // Params wanting per-sample buffers
+  dsp::WideFn wide_fn = nullptr;     // Expression DSPs, for batching
+  SaveStateFn save_state_fn = nullptr;
+  LoadStateFn load_state_fn = nullptr;
+  uint64_t content_hash = 0;         // Of the sources, see hash_sources()
+
+  bool success() const {
+    return process_fn != nullptr || spectrum_fn != nullptr ||
+           voices_fn != nullptr || buses_fn != nullptr;
+  }
 };
 
-/// Compiles DSP code and returns the result.
-/// Handles lib/ sources and the main DSP file.
-static CompileResult compile_dsp(const std::filesystem::path &dsp_path) {
-  CompileResult result;
-  auto lib_dir = g_dsp_dir / "lib";
+/// Exports the plugin's DSP services to JIT code.
+static llvm::Error define_runtime_symbols(clap_rt::ClapJIT &jit) {
+  const std::pair<const char *, void *> symbols[] = {
+      {"rtclap_conv_create", reinterpret_cast<void *>(&rtclap_conv_create)},
+      {"rtclap_conv_process", reinterpret_cast<void *>(&rtclap_conv_process)},
+      {"rtclap_conv_latency", reinterpret_cast<void *>(&rtclap_conv_latency)},
+      {"rtclap_conv_reset", reinterpret_cast<void *>(&rtclap_conv_reset)},
+      {"rtclap_conv_destroy", reinterpret_cast<void *>(&rtclap_conv_destroy)},
+      {"rtclap_asset_open", reinterpret_cast<void *>(&rtclap_asset_open)},
+      {"rtclap_asset_close", reinterpret_cast<void *>(&rtclap_asset_close)},
+  };
+  for (const auto &[name, addr] : symbols) {
+    if (auto err = jit.defineSymbol(name, addr))
+      return err;
+  }
+  // Heap use of DSP code is charged to the instance running it
+  for (const auto &[name, addr] : memory::jit_symbols()) {
+    if (auto err = jit.defineSymbol(name, addr))
+      return err;
+  }
+  return llvm::Error::success();
+}
 
-  log_compile("Compiling: " + dsp_path.string());
+/// Object and asset cache directory: $RTCLAP_CACHE_DIR or ~/.cache/rt-clap.
+static std::string get_cache_dir() {
+  if (const char *dir = std::getenv("RTCLAP_CACHE_DIR"))
+    return dir;  // e.g. a cache shared between render nodes
+  if (const char *home = std::getenv("HOME"))
+    return (std::filesystem::path(home) / ".cache" / "rt-clap").string();
+  return {};
+}
 
-  // Set up JIT options with lib/ as include path
+/// JIT options shared by every build: lib/ on the include path and the
+/// object cache, optionally holding several CPU levels.
+static clap_rt::JITOptions make_jit_options() {
   clap_rt::JITOptions opts;
+  auto lib_dir = g_dsp_dir / "lib";
   if (std::filesystem::exists(lib_dir)) {
     opts.includePaths.push_back(lib_dir.string());
   }
 
   // Set up cache directory
-  if (const char *home = std::getenv("HOME")) {
-    opts.cacheDir = (std::filesystem::path(home) / ".cache" / "rt-clap").string();
+  opts.cacheDir = get_cache_dir();
+
+  if (!g_source_cache)
+    g_source_cache = llvm::makeIntrusiveRefCnt<clap_rt::SourceCache>();
+  opts.sourceCache = g_source_cache;
+
+  // Cached objects resolve libstdc++ symbols from their link tables
+  opts.prelink = true;
+
+  // Every instance's DSP code shares the huge-page slab
+  opts.slabMemory = true;
+
+  // Optional multi-level cache, e.g. RTCLAP_CACHE_LEVELS=generic,v2,v3,v4
+  if (const char *levels = std::getenv("RTCLAP_CACHE_LEVELS")) {
+    llvm::SmallVector<llvm::StringRef, 4> names;
+    llvm::StringRef(levels).split(names, ',', -1, false);
+    for (auto name : names) {
+      if (auto level = clap_rt::parseCpuLevel(name.trim()))
+        opts.cacheLevels.push_back(*level);
+      else
+        log_compile("Ignoring unknown CPU level: " + name.str());
+    }
   }
+  return opts;
+}
+
+/// Hash of the contents of a build's source files, in build order. Returns
+/// 0 if any of them can't be read.
+static uint64_t hash_sources(const std::vector<std::string> &files) {
+  std::string contents;
+  for (const auto &file : files) {
+    auto buffer = llvm::MemoryBuffer::getFile(file);
+    if (!buffer)
+      return 0;
+    contents += (*buffer)->getBuffer();
+    contents += '\0';
+  }
+  return llvm::xxh3_64bits(contents);
+}
+
+/// Opens and faults in every file the DSP lists in asset_path(), so its
+/// init() finds them mapped. Missing files fail the build.
+static bool prefetch_assets(AssetPathFn asset_path, CompileResult &result) {
+  for (int i = 0; i < 256; ++i) {
+    const char *path = asset_path(i);
+    if (!path)
+      break;
+    std::string error;
+    const rtclap_asset *asset = assets::acquire(path, &error);
+    if (!asset) {
+      result.error = "Asset error: " + error;
+      return false;
+    }
+    assets::prefetch(asset);
+    result.assets.emplace_back(asset);
+    log_compile("Loaded asset: " + std::string(path) + " (" +
+                std::to_string(asset->channels) + " ch, " +
+                std::to_string(asset->frames) + " frames)");
+  }
+  return true;
+}
+
+/// Compiles DSP code and returns the result.
+/// Handles lib/ sources and the main DSP file. An embedded bundle from
+/// saved state replaces the file on disk when given. render_offline is
+/// what the build sees as g_render_offline.
+static CompileResult compile_dsp(const std::filesystem::path &dsp_path,
+                                 int *render_offline,
+                                 const clap_rt::Bundle *embedded = nullptr) {
+  CompileResult result;
+
+  log_compile("Compiling: " + dsp_path.string());
 
   // Create JIT instance
-  auto jit_or_err = clap_rt::ClapJIT::create(opts);
+  auto jit_or_err = clap_rt::ClapJIT::create(make_jit_options());
   if (!jit_or_err) {
     result.error = llvm::toString(jit_or_err.takeError());
     log_compile("JIT create error: " + result.error);
@@ -195,38 +584,160 @@ static CompileResult compile_dsp(const std::filesystem::path &dsp_path) {
     result.jit.reset();
     return result;
   }
+  if (auto err = result.jit->defineSymbol("g_param_buffers", g_param_buffers)) {
+    result.error = llvm::toString(std::move(err));
+    log_compile("Symbol define error: " + result.error);
+    result.jit.reset();
+    return result;
+  }
+  if (auto err = result.jit->defineSymbol("g_render_offline", render_offline)) {
+    result.error = llvm::toString(std::move(err));
+    log_compile("Symbol define error: " + result.error);
+    result.jit.reset();
+    return result;
+  }
+
+  // Plugin-side DSP services (lib/rtclap/convolver.h)
+  if (auto err = define_runtime_symbols(*result.jit)) {
+    result.error = llvm::toString(std::move(err));
+    log_compile("Symbol define error: " + result.error);
+    result.jit.reset();
+    return result;
+  }
+
+  // Bundles carry their own lib/ files and usually prebuilt objects
+  if (embedded) {
+    log_compile("Using build embedded in saved state");
+    if (auto err = result.jit->addBundle(*embedded, dsp_path.string())) {
+      result.error = llvm::toString(std::move(err));
+      log_compile("Bundle load error: " + result.error);
+      result.jit.reset();
+      return result;
+    }
+  } else if (dsp_path.extension() == ".rtclap") {
+    if (auto err = result.jit->addBundle(dsp_path.string())) {
+      result.error = llvm::toString(std::move(err));
+      log_compile("Bundle load error: " + result.error);
+      result.jit.reset();
+      return result;
+    }
+  } else if (dsp_path.extension() == ".chain") {
+    // Chain nodes may call into lib/ like any other DSP file
+    for (const auto &lib_src : get_lib_sources()) {
+      log_compile("Compiling lib: " + lib_src);
+      if (auto err = result.jit->addModule(lib_src)) {
+        result.error = llvm::toString(std::move(err));
+        log_compile("Lib compile error: " + result.error);
+        result.jit.reset();
+        return result;
+      }
+    }
+    if (auto err = result.jit->addChain(dsp_path.string())) {
+      result.error = llvm::toString(std::move(err));
+      log_compile("Chain compile error: " + result.error);
+      result.jit.reset();
+      return result;
+    }
+  } else if (dsp_path.extension() == ".expr") {
+    // Expressions are self-contained and skip Clang entirely
+    if (auto err = result.jit->addModule(dsp_path.string())) {
+      result.error = llvm::toString(std::move(err));
+      log_compile("Compile error: " + result.error);
+      result.jit.reset();
+      return result;
+    }
+  } else {
+    // Compile lib/ sources first
+    for (const auto &lib_src : get_lib_sources()) {
+      log_compile("Compiling lib: " + lib_src);
+      auto err = result.jit->addModule(lib_src);
+      if (err) {
+        result.error = llvm::toString(std::move(err));
+        log_compile("Lib compile error: " + result.error);
+        result.jit.reset();
+        return result;
+      }
+    }
 
-  // Compile lib/ sources first
-  for (const auto &lib_src : get_lib_sources()) {
-    log_compile("Compiling lib: " + lib_src);
-    auto err = result.jit->addModule(lib_src);
+    // Compile DSP code
+    result.cache_key =
+        std::filesystem::path(result.jit->getCachePath(dsp_path.string()))
+            .filename()
+            .string();
+    auto err = result.jit->addModule(dsp_path.string());
     if (err) {
       result.error = llvm::toString(std::move(err));
-      log_compile("Lib compile error: " + result.error);
+      log_compile("Compile error: " + result.error);
       result.jit.reset();
       return result;
     }
   }
 
-  // Compile DSP code
-  auto err = result.jit->addModule(dsp_path.string());
-  if (err) {
-    result.error = llvm::toString(std::move(err));
-    log_compile("Compile error: " + result.error);
-    result.jit.reset();
-    return result;
+  // Lookup optional spectral entry point; the STFT is sized by stft_size()
+  if (auto fn = result.jit->lookupAs<void(float *, int, int)>("process_spectrum")) {
+    result.spectrum_fn = *fn;
+    int size = 1024;
+    if (auto size_fn = result.jit->lookupAs<int()>("stft_size")) {
+      int requested = (*size_fn)();
+      if (requested >= 256 && requested <= 16384 && (requested & (requested - 1)) == 0)
+        size = requested;
+      else
+        log_compile("Ignoring stft_size() " + std::to_string(requested) +
+                    ": must be a power of two in 256-16384");
+    } else {
+      llvm::consumeError(size_fn.takeError());
+    }
+    result.stft = std::make_unique<dsp::Stft>(size, kPortChannels);
+    log_compile("Found process_spectrum(): " + std::to_string(size) + "-point STFT, hop " +
+                std::to_string(result.stft->hop()));
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  // Lookup optional voice renderer; process() then post-processes the mix
+  if (auto fn = result.jit->lookupAs<void(rtclap_voices *, uint32_t, float *const *,
+                                          uint32_t, uint32_t)>("process_voices")) {
+    result.voices_fn = *fn;
+    log_compile("Found process_voices()");
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  // Lookup optional multi-bus process and its bus counts
+  if (auto fn = result.jit->lookupAs<void(const float *const *const *, uint32_t,
+                                          float *const *const *, uint32_t, uint32_t,
+                                          uint32_t)>("process_buses")) {
+    result.buses_fn = *fn;
+    auto count = [&](const char *name) -> uint32_t {
+      auto count_fn = result.jit->lookupAs<int()>(name);
+      if (!count_fn) {
+        llvm::consumeError(count_fn.takeError());
+        return 1;
+      }
+      int n = (*count_fn)();
+      return static_cast<uint32_t>(n < 1 ? 1 : n > int(kMaxBuses) ? kMaxBuses : n);
+    };
+    result.buses.inputs = count("input_bus_count");
+    result.buses.outputs = count("output_bus_count");
+    log_compile("Found process_buses(): " + std::to_string(result.buses.inputs) +
+                " in, " + std::to_string(result.buses.outputs) + " out");
+  } else {
+    llvm::consumeError(fn.takeError());
   }
 
-  // Lookup process function (required)
+  // Lookup process function (required unless another process_* is defined)
   auto fn_or_err = result.jit->lookupAs<void(const float *const *, float *const *,
                                              uint32_t, uint32_t)>("process");
-  if (!fn_or_err) {
+  if (fn_or_err) {
+    result.process_fn = *fn_or_err;
+  } else if (result.spectrum_fn || result.voices_fn || result.buses_fn) {
+    llvm::consumeError(fn_or_err.takeError());
+  } else {
     result.error = llvm::toString(fn_or_err.takeError());
     log_compile("Lookup error: " + result.error);
     result.jit.reset();
     return result;
   }
-  result.process_fn = *fn_or_err;
 
   // Lookup optional init function
   auto init_or_err = result.jit->lookupAs<bool(double, uint32_t, uint32_t)>("init");
@@ -278,14 +789,210 @@ static CompileResult compile_dsp(const std::filesystem::path &dsp_path) {
     llvm::consumeError(fn.takeError());
   }
 
+  // Lookup optional oversampling factor
+  if (auto fn = result.jit->lookupAs<int()>("oversampling_factor")) {
+    int requested = (*fn)();
+    result.oversampling = requested >= 8 ? 8 : requested >= 4 ? 4
+                        : requested >= 2 ? 2 : 1;
+    if (result.oversampling != requested && requested > 1)
+      log_compile("Oversampling " + std::to_string(requested) + "x not supported, using " +
+                  std::to_string(result.oversampling) + "x");
+    else
+      log_compile("Found oversampling_factor(): " + std::to_string(result.oversampling) + "x");
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+  if (result.spectrum_fn && result.oversampling > 1) {
+    log_compile("process_spectrum() runs at the host rate, ignoring oversampling_factor()");
+    result.oversampling = 1;
+  }
+
+  // Lookup optional control-rate entry points
+  if (auto fn = result.jit->lookupAs<void(const float *, const uint32_t *)>(
+          "on_params_changed")) {
+    result.params_changed_fn = *fn;
+    log_compile("Found on_params_changed()");
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  if (auto fn = result.jit->lookupAs<void()>("control_tick")) {
+    result.control_tick_fn = *fn;
+    result.control_interval = 64;
+    if (auto interval = result.jit->lookupAs<int()>("control_interval")) {
+      int requested = (*interval)();
+      result.control_interval = static_cast<uint32_t>(
+          requested < 1 ? 1 : requested > 4096 ? 4096 : requested);
+    } else {
+      llvm::consumeError(interval.takeError());
+    }
+    log_compile("Found control_tick(): every " +
+                std::to_string(result.control_interval) + " samples");
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  // Lookup optional request for per-sample modulation buffers. They are
+  // indexed by host sample, so only plain and multi-bus process() get them.
+  if (auto fn = result.jit->lookupAs<uint32_t()>("param_buffer_mask")) {
+    if (result.oversampling > 1 || result.spectrum_fn) {
+      log_compile("param_buffer_mask() ignored: oversampled or spectral DSP");
+    } else {
+      result.param_buffer_mask = (*fn)() & ((1u << kMaxParams) - 1);
+      log_compile("Found param_buffer_mask()");
+    }
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  // Lookup the wide variant of expression DSPs; batching only covers plain
+  // host-rate process()
+  if (auto fn = result.jit->lookupAs<void(const float *, float *, const float *,
+                                          const float *, uint32_t, uint32_t)>(
+          "process_wide")) {
+    if (result.process_fn && !result.spectrum_fn && !result.voices_fn &&
+        !result.buses_fn && result.oversampling == 1)
+      result.wide_fn = *fn;
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  // Lookup optional DSP state hooks
+  if (auto fn = result.jit->lookupAs<uint32_t(void *, uint32_t)>("save_state")) {
+    result.save_state_fn = *fn;
+    log_compile("Found save_state()");
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  if (auto fn = result.jit->lookupAs<bool(const void *, uint32_t)>("load_state")) {
+    result.load_state_fn = *fn;
+    log_compile("Found load_state()");
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  // Lookup optional asset list and map the files before init() needs them
+  if (auto fn = result.jit->lookupAs<const char *(int)>("asset_path")) {
+    if (!prefetch_assets(*fn, result)) {
+      log_compile(result.error);
+      result.assets.clear();
+      result.process_fn = nullptr;
+      result.spectrum_fn = nullptr;
+      result.voices_fn = nullptr;
+      result.buses_fn = nullptr;
+      result.stft.reset();
+      result.jit.reset();
+      return result;
+    }
+  } else {
+    llvm::consumeError(fn.takeError());
+  }
+
+  result.sources = result.jit->sourceFiles();
+  if (!embedded)
+    result.content_hash = hash_sources(result.sources);
   log_compile("Compile success!");
   return result;
 }
 
-/// Queries DSP for parameter definitions and updates plugin state.
-static void query_dsp_params(PluginState *state, const CompileResult &result) {
+/// Creates the oversampling stage for a build, or nullptr when it runs at
+/// the host rate. Allocates, so main thread only.
+static std::unique_ptr<dsp::Oversampler> make_oversampler(int factor,
+                                                          uint32_t max_frames) {
+  if (factor < 2 || max_frames == 0)
+    return nullptr;
+  return std::make_unique<dsp::Oversampler>(factor, kPortChannels, max_frames);
+}
+
+/// Delay a build adds: oversampling filters or STFT buffering.
+static uint32_t get_latency(const CompileResult &result) {
+  uint32_t latency = dsp::Oversampler::latency_for(result.oversampling);
+  if (result.stft)
+    latency += static_cast<uint32_t>(result.stft->latency());
+  return latency;
+}
+
+/// Calls the DSP's init() with the rate and block sizes it runs at, and
+/// records the heap it kept.
+static bool init_dsp(PluginState *state) {
+  if (!state->dsp_init) {
+    state->memory.init_heap.store(0, std::memory_order_relaxed);
+    return true;
+  }
+  const uint32_t factor = static_cast<uint32_t>(state->oversampling);
+  auto &heap = state->memory.dsp_heap;
+  memory::Scope scope(&heap);
+  int64_t before = heap.load(std::memory_order_relaxed);
+  bool ok = state->dsp_init(state->sample_rate * factor, state->min_frames * factor,
+                            state->max_frames * factor);
+  state->memory.init_heap.store(heap.load(std::memory_order_relaxed) - before,
+                                std::memory_order_relaxed);
+  return ok;
+}
+
+/// Calls the DSP's destroy(), refunding what it frees to the instance.
+static void destroy_dsp(PluginState *state) {
+  memory::Scope scope(&state->memory.dsp_heap);
+  state->dsp_destroy();
+}
+
+/// Memory a build costs an instance: its linked code and data plus the
+/// heap its init() kept. Returns an error message if that is over the
+/// RTCLAP_MEMORY_BUDGET, otherwise an empty string.
+static std::string check_budget(uint64_t jit_bytes, int64_t init_heap) {
+  int64_t budget = memory::budget();
+  int64_t used = static_cast<int64_t>(jit_bytes) + init_heap;
+  if (budget <= 0 || used <= budget)
+    return {};
+  return "Build needs " + memory::format_bytes(used) + " (init() kept " +
+         memory::format_bytes(init_heap) + "), over the " +
+         memory::format_bytes(budget) + " memory budget";
+}
+
+/// Runs a new build's init() and destroy() once on the main thread, before
+/// it replaces the running one, and returns the heap init() kept. Only for
+/// builds with a destroy(), otherwise the trial's allocations and assets
+/// would stay behind.
+static int64_t trial_init(PluginState *state, const CompileResult &result) {
+  std::atomic<int64_t> heap{0};
+  memory::Scope scope(&heap);
+  const uint32_t factor = static_cast<uint32_t>(result.oversampling);
+  result.init_fn(state->sample_rate * factor, state->min_frames * factor,
+                 state->max_frames * factor);
+  int64_t kept = heap.load(std::memory_order_relaxed);
+  result.destroy_fn();
+  memory::forget(&heap);
+  return kept;
+}
+
+/// Hands DSP state from a loaded session to the active build's
+/// load_state(), once its init() has run.
+static void restore_dsp_state(PluginState *state) {
+  if (!state->restore_pending.load(std::memory_order_acquire))
+    return;
+  state->restore_pending.store(false, std::memory_order_relaxed);
+  // A DSP that rejects the data (returns false) keeps its init() state
+  memory::Scope scope(&state->memory.dsp_heap);
+  if (state->load_state_fn)
+    state->load_state_fn(state->restore_blob.data(),
+                         static_cast<uint32_t>(state->restore_blob.size()));
+}
+
+/// Queries DSP for parameter definitions and updates plugin state. With
+/// keep_values, params named like one of the running build keep its value
+/// and modulation; the others start at their default, unmodulated.
+static void query_dsp_params(PluginState *state, const CompileResult &result,
+                             bool keep_values) {
+  std::vector<ParamInfo> old_info;
+  std::vector<float> old_values;
+  if (keep_values) {
+    old_info.swap(state->param_info);
+    old_values.swap(state->gui_params);
+  }
   state->param_info.clear();
   state->gui_params.clear();
+  std::fill(std::begin(state->pending_mod_from), std::end(state->pending_mod_from), -1);
 
   if (!result.param_count) {
     log_compile("No param_count() - using 0 parameters");
@@ -302,9 +1009,23 @@ static void query_dsp_params(PluginState *state, const CompileResult &result) {
     info.max_value = result.param_max ? result.param_max(i) : 1.0f;
     info.default_value = result.param_default ? result.param_default(i) : 0.5f;
 
+    // By name, preferring the same index, like state_load()
+    auto match = [&](const ParamInfo &old) { return old.name == info.name; };
+    auto it = static_cast<size_t>(i) < old_info.size() && match(old_info[i])
+                  ? old_info.begin() + i
+                  : std::find_if(old_info.begin(), old_info.end(), match);
+    float value = info.default_value;
+    if (it != old_info.end()) {
+      auto old = it - old_info.begin();
+      value = std::clamp(old_values[old], info.min_value, info.max_value);
+      state->pending_mod_from[i] = static_cast<int8_t>(old);
+    }
+
     state->param_info.push_back(info);
-    state->gui_params.push_back(info.default_value);
-    g_params[i] = info.default_value;
+    state->gui_params.push_back(value);
+    g_params[i] = value;
+    state->param_lo[i] = info.min_value;
+    state->param_hi[i] = info.max_value;
 
     log_compile("  [" + std::to_string(i) + "] " + info.name +
                 " (" + std::to_string(info.min_value) + " - " +
@@ -313,21 +1034,102 @@ static void query_dsp_params(PluginState *state, const CompileResult &result) {
   }
 }
 
-/// Recompiles the DSP code from the selected file.
+/// Stores the outcome of a build in the library index.
+static void record_build(PluginState *state, const CompileResult &result) {
+  std::vector<std::string> param_names;
+  for (const auto &info : state->param_info)
+    param_names.push_back(info.name);
+
+  g_library.record_compile(get_selected_dsp_file(state), result.success(),
+                           result.error, std::move(param_names),
+                           result.cache_key);
+  g_library.save();
+}
+
+/// Packages the selected DSP file with lib/ and prebuilt objects for every
+/// x86-64 level into bundles/<name>.rtclap.
+static void export_bundle(PluginState *state) {
+  auto dsp_path = g_dsp_dir / get_selected_dsp_file(state);
+  if (dsp_path.extension() != ".cc") {
+    state->gui_state.last_error = "Only .cc files can be exported as bundles";
+    return;
+  }
+
+  clap_rt::JITOptions opts;
+  opts.includePaths.push_back((g_dsp_dir / "lib").string());
+  auto jit_or_err = clap_rt::ClapJIT::create(opts);
+  if (!jit_or_err) {
+    state->gui_state.last_error = llvm::toString(jit_or_err.takeError());
+    return;
+  }
+
+  auto bundle_or_err = jit_or_err->buildBundle(
+      dsp_path.string(), get_lib_files(),
+      {clap_rt::CpuLevel::Generic, clap_rt::CpuLevel::V2,
+       clap_rt::CpuLevel::V3, clap_rt::CpuLevel::V4});
+  if (!bundle_or_err) {
+    state->gui_state.last_error = llvm::toString(bundle_or_err.takeError());
+    log_compile("Bundle export error: " + state->gui_state.last_error);
+    return;
+  }
+
+  for (const auto &info : state->param_info)
+    bundle_or_err->manifest.params.push_back(info.name);
+
+  auto out_dir = g_dsp_dir / "bundles";
+  std::error_code ec;
+  std::filesystem::create_directories(out_dir, ec);
+  auto out_path = out_dir / (dsp_path.stem().string() + ".rtclap");
+  if (auto err = clap_rt::writeBundle(*bundle_or_err, out_path.string())) {
+    state->gui_state.last_error = llvm::toString(std::move(err));
+    return;
+  }
+  log_compile("Exported bundle: " + out_path.string());
+}
+
+/// Recompiles the DSP code from the selected file, or loads the build
+/// embedded in saved state.
 /// Updates GUI state with success/error status.
 /// Uses atomic swap to safely update the process function pointer.
-static void do_recompile(PluginState *state) {
+/// keep_params carries parameter values and modulation over when the
+/// selected file is the one already built.
+static void do_recompile(PluginState *state,
+                         const clap_rt::Bundle *embedded = nullptr,
+                         bool keep_params = false) {
   state->gui_state.last_error.clear();
   state->gui_state.compile_success = false;
 
+  // Re-read the DSP folder on every rebuild: the file watcher only tracks
+  // sources, and an edited header must not be served from the cache
+  if (g_source_cache)
+    g_source_cache->invalidate(g_dsp_dir.string());
+
   auto dsp_path = g_dsp_dir / get_selected_dsp_file(state);
-  auto result = compile_dsp(dsp_path);
+  auto result = compile_dsp(
+      dsp_path, &state->render_offline_flags[state->render_offline], embedded);
+  // The frontend's ASTs and IR are gone by now
+  clap_rt::ClapJIT::releaseMemory();
 
   if (!result.success()) {
     state->gui_state.last_error = result.error;
+    record_build(state, result);
     return;
   }
 
+  // With a memory budget the new init() is tried here first, so a build
+  // that is too big is dropped while the old one keeps running. Builds
+  // without destroy() are checked once their init() ran at the swap.
+  if (memory::budget() > 0 && state->dsp_activated && result.init_fn &&
+      result.destroy_fn) {
+    std::string over =
+        check_budget(result.jit->linkedBytes(), trial_init(state, result));
+    if (!over.empty()) {
+      log_compile(over);
+      state->gui_state.last_error = over;
+      return;
+    }
+  }
+
   // Set pending functions and JIT for atomic swap at frame boundary
   // IMPORTANT: Don't replace state->jit yet - old JIT must stay alive
   // until plugin_process() calls the old destroy() function
@@ -335,10 +1137,43 @@ static void do_recompile(PluginState *state) {
   state->pending_init = result.init_fn;
   state->pending_destroy = result.destroy_fn;
   state->pending_jit = std::move(result.jit);
+  state->memory.jit = state->pending_jit->linkedBytes();
+  state->memory.build = get_selected_dsp_file(state);
+  state->pending_assets = std::move(result.assets);  // Releases the last swap's
+  state->watched_files = std::move(result.sources);
+
+  uint32_t old_latency = state->latency;
+  state->latency = get_latency(result);
+  BusLayout old_ports = state->port_buses;
+  state->port_buses = result.buses;
+  state->pending_buses_fn = result.buses_fn;
+  state->pending_buses = result.buses;
+  state->pending_oversampling = result.oversampling;
+  state->pending_oversampler =
+      state->dsp_activated ? make_oversampler(result.oversampling, state->max_frames)
+                           : nullptr;
+  state->pending_spectrum_fn = result.spectrum_fn;
+  state->pending_stft = std::move(result.stft);
+  state->pending_voices_fn = result.voices_fn;
+  state->pending_params_changed_fn = result.params_changed_fn;
+  state->pending_param_buffer_mask = result.param_buffer_mask;
+  state->pending_control_tick_fn = result.control_tick_fn;
+  state->pending_control_interval = result.control_interval;
+  state->pending_load_state_fn = result.load_state_fn;
+  state->pending_wide_fn = result.wide_fn;
+  state->pending_save_state_fn = result.save_state_fn;
+  keep_params = keep_params && state->build_file == get_selected_dsp_file(state);
+  state->build_file = get_selected_dsp_file(state);
+  state->build_embedded = embedded != nullptr;
+  if (!embedded) {  // Otherwise still those of the saved build
+    state->content_hash = result.content_hash;
+    state->build_sources = result.sources;
+  }
 
   // Query params from new DSP (before swap, but params are just metadata)
   size_t old_count = state->param_info.size();
-  query_dsp_params(state, result);
+  query_dsp_params(state, result, keep_params);
+  record_build(state, result);
 
   // Notify host if param structure changed
   if (state->param_info.size() != old_count) {
@@ -352,6 +1187,28 @@ static void do_recompile(PluginState *state) {
   state->reload_pending.store(true, std::memory_order_release);
   state->gui_state.compile_success = true;
 
+  // Latency and ports may only change while deactivated: ask for a
+  // restart if active
+  bool latency_changed = state->latency != old_latency;
+  bool ports_changed = !(state->port_buses == old_ports);
+  // Batched instances rejoin with the new build on restart
+  if ((latency_changed || ports_changed || state->batcher) && state->dsp_activated) {
+    state->host->request_restart(state->host);
+  } else {
+    if (latency_changed) {
+      auto *latency_host = static_cast<const clap_host_latency_t *>(
+          state->host->get_extension(state->host, CLAP_EXT_LATENCY));
+      if (latency_host && latency_host->changed)
+        latency_host->changed(state->host);
+    }
+    if (ports_changed) {
+      auto *ports_host = static_cast<const clap_host_audio_ports_t *>(
+          state->host->get_extension(state->host, CLAP_EXT_AUDIO_PORTS));
+      if (ports_host && ports_host->rescan)
+        ports_host->rescan(state->host, CLAP_AUDIO_PORTS_RESCAN_LIST);
+    }
+  }
+
   // Reset file watcher timestamp to avoid double-compile on file switch
   state->last_modified = std::filesystem::file_time_type{};
 }
@@ -369,9 +1226,13 @@ static bool plugin_init(const clap_plugin_t *plugin) {
   // Set up GUI state
   state->gui_state.host = state->host;
   state->gui_state.plugin = plugin;
+  state->gui_state.memory = &state->memory;
   state->gui_state.on_recompile = [state]() {
     do_recompile(state);
   };
+  state->gui_state.on_export_bundle = [state]() {
+    export_bundle(state);
+  };
   state->gui_state.on_open_folder = []() {
     std::string cmd = "xdg-open \"" + g_dsp_dir.string() + "\" &";
     std::system(cmd.c_str());
@@ -409,29 +1270,56 @@ static bool plugin_init(const clap_plugin_t *plugin) {
     return 1.0f;
   };
 
-  // Scan for available DSP files
-  gui::scan_dsp_files(&state->gui_state, g_dsp_dir.string().c_str());
-  log_compile("Found " + std::to_string(state->gui_state.dsp_files.size()) + " DSP files");
+  // Load the DSP file index and pick up changes made while we were closed
+  refresh_library();
+  state->gui_state.library = &g_library;
+  select_default_dsp_file(state);
+  log_compile("Found " + std::to_string(g_library.entries().size()) + " DSP files");
 
   // Initialize LLVM (safe to call multiple times)
   clap_rt::ClapJIT::initializeLLVM();
 
   // Compile DSP code
   auto dsp_path = g_dsp_dir / get_selected_dsp_file(state);
-  auto result = compile_dsp(dsp_path);
+  auto result =
+      compile_dsp(dsp_path, &state->render_offline_flags[state->render_offline]);
 
   if (!result.success()) {
     log_compile("Init failed: " + result.error);
+    record_build(state, result);
     return false;
   }
 
   state->jit = std::move(result.jit);
+  state->memory.jit = state->jit->linkedBytes();
+  state->memory.build = get_selected_dsp_file(state);
   state->process_fn.store(result.process_fn, std::memory_order_release);
+  state->watched_files = std::move(result.sources);
+  state->active_assets = std::move(result.assets);
+  state->oversampling = result.oversampling;
+  state->latency = get_latency(result);
+  state->spectrum_fn = result.spectrum_fn;
+  state->stft = std::move(result.stft);
+  state->voices_fn = result.voices_fn;
+  state->buses_fn = result.buses_fn;
+  state->buses = result.buses;
+  state->port_buses = result.buses;
+  state->params_changed_fn = result.params_changed_fn;
+  state->param_buffer_mask = result.param_buffer_mask;
+  state->control_tick_fn = result.control_tick_fn;
+  state->control_interval = result.control_interval;
   state->dsp_init = result.init_fn;
   state->dsp_destroy = result.destroy_fn;
+  state->load_state_fn = result.load_state_fn;
+  state->wide_fn = result.wide_fn;
+  state->save_state_fn = result.save_state_fn;
+  state->build_file = get_selected_dsp_file(state);
+  state->content_hash = result.content_hash;
+  state->build_sources = result.sources;
 
   // Query DSP for parameter definitions
-  query_dsp_params(state, result);
+  query_dsp_params(state, result, false);
+  record_build(state, result);
 
   log_compile("Init success!");
 
@@ -450,7 +1338,7 @@ static void plugin_destroy(const clap_plugin_t *plugin) {
 
   // Call DSP destroy if still activated (shouldn't happen, but be safe)
   if (state->dsp_activated && state->dsp_destroy) {
-    state->dsp_destroy();
+    destroy_dsp(state);
     state->dsp_activated = false;
   }
 
@@ -478,14 +1366,53 @@ static bool plugin_activate(const clap_plugin_t *plugin, double sample_rate,
   state->min_frames = min_frames;
   state->max_frames = max_frames;
 
+  state->params_primed = false;
+  state->samples_to_tick = 0;
+
+  // Stand-ins for missing buses, and per-sample parameter buffers
+  state->zero_buffer.assign(max_frames, 0.0f);
+  state->discard_buffer.assign(max_frames, 0.0f);
+  state->param_buffer_storage.assign(kMaxParams * max_frames, 0.0f);
+
+  // Oversampling buffers for the active build and a pending reload
+  state->oversampler = make_oversampler(state->oversampling, max_frames);
+  if (state->reload_pending.load(std::memory_order_acquire))
+    state->pending_oversampler =
+        make_oversampler(state->pending_oversampling, max_frames);
+
   // Call DSP init if present
   if (state->dsp_init) {
-    if (!state->dsp_init(sample_rate, min_frames, max_frames)) {
+    if (!init_dsp(state)) {
       log_compile("DSP init() returned false");
       return false;
     }
+    std::string over = check_budget(
+        state->memory.jit, state->memory.init_heap.load(std::memory_order_relaxed));
+    if (!over.empty()) {
+      log_compile(over);
+      state->gui_state.last_error = over;
+      if (state->dsp_destroy)
+        destroy_dsp(state);
+      return false;
+    }
     log_compile("DSP init() called");
   }
+  if (!state->reload_pending.load(std::memory_order_acquire))
+    restore_dsp_state(state);  // Otherwise the restored build isn't in yet
+
+  // Share process_wide() calls with other instances of this build
+  if (g_batching && state->wide_fn && state->content_hash != 0 &&
+      !state->reload_pending.load(std::memory_order_acquire)) {
+    state->batcher = dsp::Batcher::acquire(state->content_hash, sample_rate, max_frames);
+    state->batch_lane = state->batcher->join(kPortChannels);
+    if (state->batch_lane < 0) {
+      log_compile("Batcher full, processing this instance alone");
+      state->batcher.reset();
+    } else {
+      state->batch_latency = state->batcher->latency();
+      state->batch_stale = false;
+    }
+  }
 
   state->dsp_activated = true;
   return true;
@@ -496,62 +1423,477 @@ static void plugin_deactivate(const clap_plugin_t *plugin) {
 
   // Call DSP destroy if present
   if (state->dsp_activated && state->dsp_destroy) {
-    state->dsp_destroy();
+    destroy_dsp(state);
     log_compile("DSP destroy() called");
   }
 
+  if (state->batcher) {
+    state->batcher->leave(state->batch_lane, kPortChannels);
+    state->batcher.reset();
+    state->batch_latency = 0;
+  }
+
+  // Stale modulation must not outlive the processing it came with
+  std::fill(std::begin(state->param_mod), std::end(state->param_mod), 0.0f);
+  for (size_t i = 0; i < state->gui_params.size(); ++i)
+    g_params[i] = state->gui_params[i];
+
   state->dsp_activated = false;
 }
 
 static bool plugin_start_processing(const clap_plugin_t *plugin) {
-  (void)plugin;
+  get_state(plugin)->processing.store(true, std::memory_order_release);
   return true;
 }
 
 static void plugin_stop_processing(const clap_plugin_t *plugin) {
-  (void)plugin;
+  get_state(plugin)->processing.store(false, std::memory_order_release);
 }
 
 static void plugin_reset(const clap_plugin_t *plugin) {
-  (void)plugin;
+  auto *state = get_state(plugin);
+  if (state->oversampler)
+    state->oversampler->reset();
+  if (state->stft)
+    state->stft->reset();
+  state->samples_to_tick = 0;
 }
 
 // ============================================================================
 // Audio Processing
 // ============================================================================
 
-static clap_process_status plugin_process(const clap_plugin_t *plugin,
-                                          const clap_process_t *process) {
-  auto *state = get_state(plugin);
+/// Base value plus modulation, kept inside the parameter's range.
+static float modulated_value(const PluginState *state, uint32_t i, float base,
+                             float mod) {
+  float value = base + mod;
+  value = value < state->param_lo[i] ? state->param_lo[i] : value;
+  return value > state->param_hi[i] ? state->param_hi[i] : value;
+}
+
+/// True for PARAM_MOD aimed at notes (polyphonic modulation) rather than
+/// the whole instance.
+static bool targets_notes(const clap_event_param_mod_t *pm) {
+  return pm->note_id >= 0 || pm->key >= 0;
+}
+
+/// Builds this block's per-sample buffers for modulated params the DSP
+/// asked for, replaying PARAM_VALUE/PARAM_MOD events at their sample.
+/// Unmodulated params keep a null buffer and cost nothing.
+static void materialize_param_buffers(PluginState *state,
+                                      const clap_process_t *process,
+                                      const float *start_base,
+                                      const float *start_mod,
+                                      uint32_t mod_events,
+                                      uint32_t param_count) {
+  std::fill(std::begin(state->param_buffers), std::end(state->param_buffers),
+            nullptr);
+  const uint32_t frames = process->frames_count;
+  const size_t stride = state->max_frames;
+  if (!state->param_buffer_mask || frames == 0 || frames > stride ||
+      state->param_buffer_storage.size() < kMaxParams * stride)
+    return;
+
+  const clap_input_events_t *in_events = process->in_events;
+  const uint32_t event_count = in_events ? in_events->size(in_events) : 0;
+
+  for (uint32_t i = 0; i < param_count; ++i) {
+    if (!(state->param_buffer_mask & (1u << i)))
+      continue;
+    // Modulated away from 0 and back within the block still counts
+    if (start_mod[i] == 0.0f && state->param_mod[i] == 0.0f &&
+        !(mod_events & (1u << i)))
+      continue;
+
+    float *buf = state->param_buffer_storage.data() + i * stride;
+    float base = start_base[i];
+    float mod = start_mod[i];
+    uint32_t pos = 0;
+    for (uint32_t e = 0; e < event_count; ++e) {
+      auto *event = in_events->get(in_events, e);
+      if (event->space_id != CLAP_CORE_EVENT_SPACE_ID)
+        continue;
+      float *target = nullptr;
+      float value = 0.0f;
+      if (event->type == CLAP_EVENT_PARAM_VALUE) {
+        auto *pv = reinterpret_cast<const clap_event_param_value_t *>(event);
+        if (pv->param_id == i) {
+          target = &base;
+          value = static_cast<float>(pv->value);
+        }
+      } else if (event->type == CLAP_EVENT_PARAM_MOD) {
+        auto *pm = reinterpret_cast<const clap_event_param_mod_t *>(event);
+        if (pm->param_id == i && !targets_notes(pm)) {
+          target = &mod;
+          value = static_cast<float>(pm->amount);
+        }
+      }
+      if (!target)
+        continue;
+      uint32_t time = event->time < frames ? event->time : frames;
+      std::fill(buf + pos, buf + time, base + mod);
+      pos = time > pos ? time : pos;
+      *target = value;
+    }
+    std::fill(buf + pos, buf + frames, base + mod);
+
+    const float lo = state->param_lo[i], hi = state->param_hi[i];
+    for (uint32_t n = 0; n < frames; ++n) {
+      float v = buf[n] < lo ? lo : buf[n];
+      buf[n] = v > hi ? hi : v;
+    }
+    state->param_buffers[i] = buf;
+  }
+}
+
+/// Points g_param_buffers at this block's buffers, offset for a DSP call
+/// that starts offset samples into the block.
+static void point_param_buffers(const PluginState *state, uint32_t offset) {
+  for (uint32_t i = 0; i < kMaxParams; ++i)
+    g_param_buffers[i] = state->param_buffers[i] ? state->param_buffers[i] + offset
+                                                 : nullptr;
+}
+
+/// Calls on_params_changed() with the parameters that moved since the last
+/// call (all of them after a load).
+static void notify_params_changed(PluginState *state) {
+  if (!state->params_changed_fn)
+    return;
+  uint32_t mask[kParamMaskWords] = {};
+  bool changed = false;
+  for (uint32_t i = 0; i < kMaxParams; ++i) {
+    if (state->params_primed && g_params[i] == state->last_params[i])
+      continue;
+    state->last_params[i] = g_params[i];
+    mask[i / 32] |= 1u << (i % 32);
+    changed = true;
+  }
+  state->params_primed = true;
+  if (changed)
+    state->params_changed_fn(g_params, mask);
+}
+
+/// Runs the active DSP on one span of the host block: through the STFT,
+/// the oversampler, or directly.
+static void run_dsp(PluginState *state, ProcessFn fn, const float *const *inputs,
+                    float *const *outputs, uint32_t num_channels,
+                    uint32_t num_frames) {
+  // Spectral DSP: the STFT calls process_spectrum() once per hop
+  if (state->spectrum_fn && state->stft) {
+    state->stft->process(inputs, outputs, num_channels, num_frames,
+                         state->spectrum_fn);
+    return;
+  }
+
+  dsp::Oversampler *os = state->oversampler.get();
+  if (!os) {
+    fn(inputs, outputs, num_channels, num_frames);
+    return;
+  }
+
+  // Oversampled: the DSP sees factor * frames at factor * sample rate
+  const uint32_t channels = num_channels < kPortChannels ? num_channels : kPortChannels;
+  const uint32_t factor = static_cast<uint32_t>(os->factor());
+  const float *in[kPortChannels];
+  float *out[kPortChannels];
+  for (uint32_t offset = 0; offset < num_frames;) {
+    uint32_t chunk = num_frames - offset;
+    if (chunk > os->max_frames())
+      chunk = static_cast<uint32_t>(os->max_frames());
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      in[ch] = inputs[ch] + offset;
+      out[ch] = outputs[ch] + offset;
+    }
+    const float *const *up = os->upsample(in, channels, chunk);
+    fn(up, os->output(), channels, chunk * factor);
+    os->downsample(out, channels, chunk);
+    offset += chunk;
+  }
+}
+
+/// Multi-bus processing: host buses go to process_buses() as they are.
+/// Only a bus the host left out, or one with fewer channels, gets a
+/// pointer table here, filled with the shared zero and discard buffers.
+static clap_process_status process_buses(PluginState *state,
+                                         const clap_process_t *process) {
+  const uint32_t num_frames = process->frames_count;
+  if (num_frames == 0)
+    return CLAP_PROCESS_CONTINUE;
+  if (num_frames > state->zero_buffer.size())
+    return CLAP_PROCESS_ERROR;
+
+  const BusLayout layout = state->buses;
+  const float *const *inputs[kMaxBuses];
+  float *const *outputs[kMaxBuses];
+  const float *in_fill[kMaxBuses][kPortChannels];
+  float *out_fill[kMaxBuses][kPortChannels];
+
+  for (uint32_t b = 0; b < layout.inputs; ++b) {
+    const clap_audio_buffer_t *bus =
+        b < process->audio_inputs_count ? &process->audio_inputs[b] : nullptr;
+    if (bus && bus->data32 && bus->channel_count >= kPortChannels) {
+      inputs[b] = bus->data32;
+      continue;
+    }
+    for (uint32_t ch = 0; ch < kPortChannels; ++ch) {
+      bool present = bus && bus->data32 && ch < bus->channel_count;
+      in_fill[b][ch] = present ? bus->data32[ch] : state->zero_buffer.data();
+    }
+    inputs[b] = in_fill[b];
+  }
+
+  for (uint32_t b = 0; b < layout.outputs; ++b) {
+    const clap_audio_buffer_t *bus =
+        b < process->audio_outputs_count ? &process->audio_outputs[b] : nullptr;
+    if (bus && bus->data32 && bus->channel_count >= kPortChannels) {
+      outputs[b] = bus->data32;
+      continue;
+    }
+    for (uint32_t ch = 0; ch < kPortChannels; ++ch) {
+      bool present = bus && bus->data32 && ch < bus->channel_count;
+      out_fill[b][ch] = present ? bus->data32[ch] : state->discard_buffer.data();
+    }
+    outputs[b] = out_fill[b];
+  }
+
+  state->buses_fn(inputs, layout.inputs, outputs, layout.outputs, kPortChannels,
+                  num_frames);
+  return CLAP_PROCESS_CONTINUE;
+}
 
+/// Tells the host a voice stopped so it can release per-note state.
+static void push_note_end(const clap_output_events_t *out_events, uint32_t time,
+                          const dsp::VoicePool::Ended &ended) {
+  if (!out_events)
+    return;
+  clap_event_note_t event{};
+  event.header.size = sizeof(event);
+  event.header.time = time;
+  event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+  event.header.type = CLAP_EVENT_NOTE_END;
+  event.note_id = ended.note_id;
+  event.port_index = ended.port;
+  event.channel = ended.channel;
+  event.key = ended.key;
+  out_events->try_push(out_events, &event.header);
+}
+
+/// Applies a note event (CLAP or MIDI dialect) to the voice pool. Voices
+/// it ends are reported at end_time.
+static void handle_note_event(PluginState *state, const clap_event_header_t *event,
+                              const clap_output_events_t *out_events,
+                              uint32_t end_time) {
+  if (event->space_id != CLAP_CORE_EVENT_SPACE_ID)
+    return;
+  auto on_end = [&](const dsp::VoicePool::Ended &ended) {
+    push_note_end(out_events, end_time, ended);
+  };
+
+  switch (event->type) {
+  case CLAP_EVENT_NOTE_ON: {
+    auto *note = reinterpret_cast<const clap_event_note_t *>(event);
+    dsp::VoicePool::Ended stolen;
+    if (state->voices.note_on(note->note_id, note->port_index, note->channel,
+                              note->key, static_cast<float>(note->velocity),
+                              &stolen))
+      on_end(stolen);
+    break;
+  }
+  case CLAP_EVENT_NOTE_OFF: {
+    auto *note = reinterpret_cast<const clap_event_note_t *>(event);
+    state->voices.note_off(note->note_id, note->port_index, note->channel,
+                           note->key);
+    break;
+  }
+  case CLAP_EVENT_NOTE_CHOKE: {
+    auto *note = reinterpret_cast<const clap_event_note_t *>(event);
+    state->voices.choke(note->note_id, note->port_index, note->channel,
+                        note->key, on_end);
+    break;
+  }
+  case CLAP_EVENT_PARAM_MOD: {
+    // Polyphonic modulation; the instance-wide kind was applied for the
+    // whole block
+    auto *pm = reinterpret_cast<const clap_event_param_mod_t *>(event);
+    if (targets_notes(pm))
+      state->voices.modulate(pm->note_id, pm->port_index, pm->channel, pm->key,
+                             pm->param_id, static_cast<float>(pm->amount));
+    break;
+  }
+  case CLAP_EVENT_MIDI: {
+    auto *midi = reinterpret_cast<const clap_event_midi_t *>(event);
+    const uint8_t status = midi->data[0] & 0xF0;
+    const auto port = static_cast<int16_t>(midi->port_index);
+    const auto channel = static_cast<int16_t>(midi->data[0] & 0x0F);
+    const auto key = static_cast<int16_t>(midi->data[1]);
+    if (status == 0x90 && midi->data[2] > 0) {
+      dsp::VoicePool::Ended stolen;
+      if (state->voices.note_on(-1, port, channel, key, midi->data[2] / 127.0f,
+                                &stolen))
+        on_end(stolen);
+    } else if (status == 0x80 || status == 0x90) {
+      state->voices.note_off(-1, port, channel, key);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/// Instrument processing. Note events split the block so voices start and
+/// stop on the sample; process_voices() renders each span into the cleared
+/// outputs, then process() (if any) runs on the mix in place.
+static clap_process_status process_instrument(PluginState *state, ProcessFn fn,
+                                              const clap_process_t *process) {
+  if (!process->audio_outputs || process->audio_outputs_count < 1)
+    return CLAP_PROCESS_ERROR;
+
+  const uint32_t num_frames = process->frames_count;
+  const uint32_t out_channels = process->audio_outputs[0].channel_count;
+  const uint32_t channels = out_channels < kPortChannels ? out_channels : kPortChannels;
+  float *const *outputs = process->audio_outputs[0].data32;
+  const clap_input_events_t *in_events = process->in_events;
+  const uint32_t event_count = in_events ? in_events->size(in_events) : 0;
+  uint32_t next_event = 0;
+
+  float *out[kPortChannels];
+  for (uint32_t offset = 0; offset < num_frames;) {
+    // Apply the events due now; the next one ends the span
+    uint32_t end = num_frames;
+    while (next_event < event_count) {
+      auto *event = in_events->get(in_events, next_event);
+      if (event->time > offset) {
+        end = event->time < end ? event->time : end;
+        break;
+      }
+      handle_note_event(state, event, process->out_events, offset);
+      ++next_event;
+    }
+
+    if (state->control_tick_fn) {
+      if (state->samples_to_tick == 0) {
+        state->control_tick_fn();
+        state->samples_to_tick = state->control_interval;
+      }
+      if (end - offset > state->samples_to_tick)
+        end = offset + state->samples_to_tick;
+    }
+
+    const uint32_t frames = end - offset;
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      out[ch] = outputs[ch] + offset;
+      std::fill(out[ch], out[ch] + frames, 0.0f);
+    }
+    point_param_buffers(state, offset);
+    if (state->voices_fn && state->voices.count() > 0)
+      state->voices_fn(state->voices.voices(), state->voices.count(), out,
+                       channels, frames);
+    state->voices.finish_render(frames, [&](const dsp::VoicePool::Ended &ended) {
+      push_note_end(process->out_events, end - 1, ended);
+    });
+    if (fn || state->spectrum_fn)
+      run_dsp(state, fn, out, out, channels, frames);
+
+    if (state->control_tick_fn)
+      state->samples_to_tick -= frames;
+    offset = end;
+  }
+
+  // Events stamped past the block (out of spec) still count
+  while (next_event < event_count) {
+    handle_note_event(state, in_events->get(in_events, next_event++),
+                      process->out_events, num_frames - 1);
+  }
+  return CLAP_PROCESS_CONTINUE;
+}
+
+/// Writes the active build's state into save_buffer for a waiting
+/// state_save(). Called with dsp_busy held.
+static void take_state_snapshot(PluginState *state) {
+  int expected = kSaveRequested;
+  if (!state->save_request.compare_exchange_strong(expected, kSaveRunning,
+                                                   std::memory_order_acquire))
+    return;
+  // Writes only if the buffer is large enough, else the main thread grows
+  // it and asks again
+  state->save_size = 0;
+  if (state->save_state_fn) {
+    memory::Scope scope(&state->memory.dsp_heap);
+    state->save_size = state->save_state_fn(
+        state->save_buffer.data(), static_cast<uint32_t>(state->save_buffer.size()));
+  }
+  state->save_request.store(kSaveDone, std::memory_order_release);
+}
+
+static clap_process_status process_block(PluginState *state,
+                                         const clap_process_t *process) {
   // Check for hot-reload at frame boundary
   if (state->reload_pending.load(std::memory_order_acquire)) {
     // Call old destroy before swapping (old JIT still alive here)
     if (state->dsp_activated && state->dsp_destroy) {
-      state->dsp_destroy();
+      destroy_dsp(state);
     }
 
-    // Swap JIT instance (destroys old JIT - safe because we already called destroy)
-    state->jit = std::move(state->pending_jit);
+    // Swap JIT instance; the old one waits in pending_jit for the timer to
+    // free it, as tearing down a JIT is no job for the audio thread
+    state->jit.swap(state->pending_jit);
+    state->active_assets.swap(state->pending_assets);  // No unmapping here
+    state->oversampler.swap(state->pending_oversampler);  // Nor freeing
+    state->oversampling = state->pending_oversampling;
+    state->stft.swap(state->pending_stft);
+    state->spectrum_fn = state->pending_spectrum_fn;
+    state->voices_fn = state->pending_voices_fn;
+    state->buses_fn = state->pending_buses_fn;
+    state->buses = state->pending_buses;
+    state->voices.clear_state();
+    // Modulation follows the params it was meant for, if any
+    float new_mod[kMaxParams];
+    for (uint32_t i = 0; i < kMaxParams; ++i) {
+      int from = state->pending_mod_from[i];
+      new_mod[i] = from >= 0 ? state->param_mod[from] : 0.0f;
+    }
+    std::copy(std::begin(new_mod), std::end(new_mod), std::begin(state->param_mod));
+    state->voices.remap_mod(state->pending_mod_from);
+    state->params_changed_fn = state->pending_params_changed_fn;
+    state->param_buffer_mask = state->pending_param_buffer_mask;
+    state->control_tick_fn = state->pending_control_tick_fn;
+    state->control_interval = state->pending_control_interval;
+    state->load_state_fn = state->pending_load_state_fn;
+    state->save_state_fn = state->pending_save_state_fn;
+    state->wide_fn = state->pending_wide_fn;
+    state->batch_stale = state->batcher != nullptr;  // Other code now
+    state->params_primed = false;  // New DSP hears every value once
+    state->samples_to_tick = 0;
 
     // Swap function pointers
     state->process_fn.store(state->pending_fn, std::memory_order_release);
     state->dsp_init = state->pending_init;
     state->dsp_destroy = state->pending_destroy;
-    state->reload_pending.store(false, std::memory_order_release);
 
     // Call new init after swap (new JIT now active)
-    if (state->dsp_activated && state->dsp_init) {
-      state->dsp_init(state->sample_rate, state->min_frames, state->max_frames);
+    if (state->dsp_activated) {
+      init_dsp(state);
+      restore_dsp_state(state);
     }
+    // After init(), so the main thread sees the heap it kept
+    state->reload_pending.store(false, std::memory_order_release);
   }
 
-  // Sync GUI parameters to global array
-  for (size_t i = 0; i < state->gui_params.size(); ++i) {
-    g_params[i] = state->gui_params[i];
+  // Values at the start of the block, for the modulation buffers
+  const uint32_t param_count = static_cast<uint32_t>(
+      state->gui_params.size() < kMaxParams ? state->gui_params.size() : kMaxParams);
+  float start_base[kMaxParams], start_mod[kMaxParams];
+  for (uint32_t i = 0; i < param_count; ++i) {
+    start_base[i] = state->gui_params[i];
+    start_mod[i] = state->param_mod[i];
   }
+  uint32_t mod_events = 0;  // Params with PARAM_MOD in this block
 
-  // Process incoming CLAP parameter events from host
+  // Process incoming CLAP parameter events from host: PARAM_VALUE sets the
+  // base value, PARAM_MOD the modulation offset. Note-targeted PARAM_MOD
+  // is left to process_instrument(), which applies it to matching voices;
+  // effects have no voices and ignore it.
   if (process->in_events) {
     for (uint32_t i = 0; i < process->in_events->size(process->in_events); ++i) {
       auto *event = process->in_events->get(process->in_events, i);
@@ -559,16 +1901,33 @@ static clap_process_status plugin_process(const clap_plugin_t *plugin,
         continue;
       if (event->type == CLAP_EVENT_PARAM_VALUE) {
         auto *pv = reinterpret_cast<const clap_event_param_value_t *>(event);
-        if (pv->param_id < state->gui_params.size()) {
-          g_params[pv->param_id] = static_cast<float>(pv->value);
-          state->gui_params[pv->param_id] = g_params[pv->param_id];
+        if (pv->param_id < param_count)
+          state->gui_params[pv->param_id] = static_cast<float>(pv->value);
+      } else if (event->type == CLAP_EVENT_PARAM_MOD) {
+        auto *pm = reinterpret_cast<const clap_event_param_mod_t *>(event);
+        if (pm->param_id < param_count && !targets_notes(pm)) {
+          state->param_mod[pm->param_id] = static_cast<float>(pm->amount);
+          mod_events |= 1u << pm->param_id;
         }
       }
     }
   }
 
+  // Sync GUI parameters plus modulation to global array
+  for (uint32_t i = 0; i < param_count; ++i)
+    g_params[i] = modulated_value(state, i, state->gui_params[i], state->param_mod[i]);
+  materialize_param_buffers(state, process, start_base, start_mod, mod_events,
+                            param_count);
+  point_param_buffers(state, 0);
+
   ProcessFn fn = state->process_fn.load(std::memory_order_acquire);
-  if (!fn)
+  notify_params_changed(state);
+
+  if (state->instrument)
+    return process_instrument(state, fn, process);
+  if (state->buses_fn)
+    return process_buses(state, process);
+  if (!fn && !state->spectrum_fn)
     return CLAP_PROCESS_ERROR;
 
   // Safety checks
@@ -585,13 +1944,68 @@ static clap_process_status plugin_process(const clap_plugin_t *plugin,
   if (num_channels == 0 || num_frames == 0)
     return CLAP_PROCESS_CONTINUE;
 
-  // Call JIT'd process function
-  fn(process->audio_inputs[0].data32, process->audio_outputs[0].data32,
-     num_channels, num_frames);
+  // Batched with other instances; the host compensates batch_latency
+  if (state->batcher && !state->batch_stale && state->wide_fn) {
+    state->batcher->process(state->wide_fn, state->batch_lane,
+                            process->audio_inputs[0].data32,
+                            process->audio_outputs[0].data32,
+                            num_channels < kPortChannels ? num_channels : kPortChannels,
+                            num_frames, g_params);
+    return CLAP_PROCESS_CONTINUE;
+  }
+
+  if (!state->control_tick_fn) {
+    run_dsp(state, fn, process->audio_inputs[0].data32,
+            process->audio_outputs[0].data32, num_channels, num_frames);
+    return CLAP_PROCESS_CONTINUE;
+  }
+
+  // Split the block so control_tick() runs every control_interval samples,
+  // carrying the phase over from the previous block
+  const uint32_t channels = num_channels < kPortChannels ? num_channels : kPortChannels;
+  const float *in[kPortChannels];
+  float *out[kPortChannels];
+  for (uint32_t offset = 0; offset < num_frames;) {
+    if (state->samples_to_tick == 0) {
+      state->control_tick_fn();
+      state->samples_to_tick = state->control_interval;
+    }
+    uint32_t chunk = num_frames - offset;
+    if (chunk > state->samples_to_tick)
+      chunk = state->samples_to_tick;
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      in[ch] = process->audio_inputs[0].data32[ch] + offset;
+      out[ch] = process->audio_outputs[0].data32[ch] + offset;
+    }
+    point_param_buffers(state, offset);
+    run_dsp(state, fn, in, out, channels, chunk);
+    state->samples_to_tick -= chunk;
+    offset += chunk;
+  }
 
   return CLAP_PROCESS_CONTINUE;
 }
 
+static clap_process_status plugin_process(const clap_plugin_t *plugin,
+                                          const clap_process_t *process) {
+  auto *state = get_state(plugin);
+
+  // The main thread is running save_state() itself (see state_save), the
+  // DSP is not ours for this block
+  if (state->dsp_busy.exchange(true, std::memory_order_acquire)) {
+    for (uint32_t i = 0; i < process->audio_outputs_count; ++i) {
+      const auto &port = process->audio_outputs[i];
+      for (uint32_t ch = 0; ch < port.channel_count; ++ch)
+        std::fill(port.data32[ch], port.data32[ch] + process->frames_count, 0.0f);
+    }
+    return CLAP_PROCESS_CONTINUE;
+  }
+  clap_process_status status = process_block(state, process);
+  take_state_snapshot(state);
+  state->dsp_busy.store(false, std::memory_order_release);
+  return status;
+}
+
 // ============================================================================
 // Extensions
 // ============================================================================
@@ -599,23 +2013,33 @@ static clap_process_status plugin_process(const clap_plugin_t *plugin,
 // --- Audio Ports ---
 
 static uint32_t audio_ports_count(const clap_plugin_t *plugin, bool is_input) {
-  (void)plugin;
-  (void)is_input;
-  return 1; // One stereo port for both input and output
+  // Stereo main ports plus the buses the DSP declares; instruments only
+  // output
+  auto *state = get_state(plugin);
+  if (is_input && state->instrument)
+    return 0;
+  if (state->instrument)
+    return 1;
+  return is_input ? state->port_buses.inputs : state->port_buses.outputs;
 }
 
 static bool audio_ports_get(const clap_plugin_t *plugin, uint32_t index,
                             bool is_input, clap_audio_port_info_t *info) {
-  (void)plugin;
-  if (index != 0)
+  if (index >= audio_ports_count(plugin, is_input))
     return false;
 
-  info->id = is_input ? 0 : 1;
-  snprintf(info->name, sizeof(info->name), "%s", is_input ? "Input" : "Output");
-  info->channel_count = 2;
-  info->flags = CLAP_AUDIO_PORT_IS_MAIN;
+  // Inputs get even ids, outputs odd ones; the main pair keeps 0 and 1
+  info->id = index * 2 + (is_input ? 0 : 1);
+  if (index == 0)
+    snprintf(info->name, sizeof(info->name), "%s", is_input ? "Input" : "Output");
+  else if (is_input)
+    snprintf(info->name, sizeof(info->name), "Sidechain %u", index);
+  else
+    snprintf(info->name, sizeof(info->name), "Output %u", index + 1);
+  info->channel_count = kPortChannels;
+  info->flags = index == 0 ? CLAP_AUDIO_PORT_IS_MAIN : 0;
   info->port_type = CLAP_PORT_STEREO;
-  info->in_place_pair = is_input ? 1 : 0;
+  info->in_place_pair = index == 0 ? (is_input ? 1 : 0) : CLAP_INVALID_ID;
   return true;
 }
 
@@ -624,6 +2048,40 @@ static const clap_plugin_audio_ports_t audio_ports_extension = {
     .get = audio_ports_get,
 };
 
+// --- Note Ports ---
+
+static uint32_t note_ports_count(const clap_plugin_t *plugin, bool is_input) {
+  return is_input && get_state(plugin)->instrument ? 1 : 0;
+}
+
+static bool note_ports_get(const clap_plugin_t *plugin, uint32_t index,
+                           bool is_input, clap_note_port_info_t *info) {
+  if (index != 0 || !is_input || !get_state(plugin)->instrument)
+    return false;
+
+  info->id = 0;
+  info->supported_dialects = CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI;
+  info->preferred_dialect = CLAP_NOTE_DIALECT_CLAP;
+  snprintf(info->name, sizeof(info->name), "%s", "Notes");
+  return true;
+}
+
+static const clap_plugin_note_ports_t note_ports_extension = {
+    .count = note_ports_count,
+    .get = note_ports_get,
+};
+
+// --- Latency ---
+
+static uint32_t latency_get(const clap_plugin_t *plugin) {
+  auto *state = get_state(plugin);
+  return state->latency + state->batch_latency;
+}
+
+static const clap_plugin_latency_t latency_extension = {
+    .get = latency_get,
+};
+
 // --- Parameters ---
 
 static uint32_t params_count(const clap_plugin_t *plugin) {
@@ -639,7 +2097,10 @@ static bool params_get_info(const clap_plugin_t *plugin, uint32_t index,
 
   const auto &p = state->param_info[index];
   info->id = index;
-  info->flags = CLAP_PARAM_IS_AUTOMATABLE;
+  info->flags = CLAP_PARAM_IS_AUTOMATABLE | CLAP_PARAM_IS_MODULATABLE;
+  if (state->instrument)
+    info->flags |= CLAP_PARAM_IS_MODULATABLE_PER_NOTE_ID |
+                   CLAP_PARAM_IS_MODULATABLE_PER_KEY;
   strncpy(info->name, p.name.c_str(), CLAP_NAME_SIZE);
   strncpy(info->module, "", CLAP_PATH_SIZE);
   info->min_value = p.min_value;
@@ -653,7 +2114,7 @@ static bool params_get_value(const clap_plugin_t *plugin, clap_id param_id,
   auto *state = get_state(plugin);
   if (param_id >= state->param_info.size())
     return false;
-  *value = g_params[param_id];
+  *value = state->gui_params[param_id];  // Base value, without modulation
   return true;
 }
 
@@ -688,8 +2149,23 @@ static void params_flush(const clap_plugin_t *plugin,
     if (event->type == CLAP_EVENT_PARAM_VALUE) {
       auto *pv = reinterpret_cast<const clap_event_param_value_t *>(event);
       if (pv->param_id < state->param_info.size()) {
-        g_params[pv->param_id] = static_cast<float>(pv->value);
-        state->gui_params[pv->param_id] = g_params[pv->param_id];
+        state->gui_params[pv->param_id] = static_cast<float>(pv->value);
+        g_params[pv->param_id] =
+            modulated_value(state, pv->param_id, state->gui_params[pv->param_id],
+                            state->param_mod[pv->param_id]);
+      }
+    } else if (event->type == CLAP_EVENT_PARAM_MOD) {
+      auto *pm = reinterpret_cast<const clap_event_param_mod_t *>(event);
+      if (targets_notes(pm)) {
+        // Process isn't running, so the voices are ours to change
+        state->voices.modulate(pm->note_id, pm->port_index, pm->channel,
+                               pm->key, pm->param_id,
+                               static_cast<float>(pm->amount));
+      } else if (pm->param_id < state->param_info.size()) {
+        state->param_mod[pm->param_id] = static_cast<float>(pm->amount);
+        g_params[pm->param_id] =
+            modulated_value(state, pm->param_id, state->gui_params[pm->param_id],
+                            state->param_mod[pm->param_id]);
       }
     }
   }
@@ -704,6 +2180,349 @@ static const clap_plugin_params_t params_extension = {
     .flush = params_flush,
 };
 
+// --- State ---
+
+/// Saved session, little endian:
+///   "RTCLAPS1" | u64 content hash | file | u32 count | source paths |
+///   u32 count | (param name, f32 value) pairs | DSP state | bundle
+/// Strings and blobs are a u32 length followed by the bytes. Paths are
+/// relative to the DSP dir when inside it.
+constexpr char kStateMagic[8] = {'R', 'T', 'C', 'L', 'A', 'P', 'S', '1'};
+
+struct SavedState {
+  uint64_t content_hash = 0;
+  std::string file;
+  std::vector<std::string> sources;
+  std::vector<std::pair<std::string, float>> params;
+  std::string dsp_state;
+  std::string bundle;  // Serialized clap_rt::Bundle of the build, or empty
+};
+
+static void append_u32(std::string &out, uint32_t value) {
+  char buf[4];
+  llvm::support::endian::write32le(buf, value);
+  out.append(buf, 4);
+}
+
+static void append_u64(std::string &out, uint64_t value) {
+  char buf[8];
+  llvm::support::endian::write64le(buf, value);
+  out.append(buf, 8);
+}
+
+static void append_string(std::string &out, llvm::StringRef str) {
+  append_u32(out, static_cast<uint32_t>(str.size()));
+  out.append(str.data(), str.size());
+}
+
+/// Parses a saved session. Returns false on bad magic or truncation.
+static bool parse_state(llvm::StringRef data, SavedState &saved) {
+  using namespace llvm::support::endian;
+  bool ok = data.consume_front(llvm::StringRef(kStateMagic, sizeof(kStateMagic)));
+  auto u32 = [&]() -> uint32_t {
+    if (!ok || data.size() < 4) {
+      ok = false;
+      return 0;
+    }
+    uint32_t value = read32le(data.data());
+    data = data.drop_front(4);
+    return value;
+  };
+  auto str = [&]() -> std::string {
+    uint32_t size = u32();
+    if (!ok || data.size() < size) {
+      ok = false;
+      return {};
+    }
+    std::string value = data.take_front(size).str();
+    data = data.drop_front(size);
+    return value;
+  };
+
+  if (!ok || data.size() < 8)
+    return false;
+  saved.content_hash = read64le(data.data());
+  data = data.drop_front(8);
+  saved.file = str();
+  for (uint32_t i = 0, n = u32(); ok && i < n; ++i)
+    saved.sources.push_back(str());
+  for (uint32_t i = 0, n = u32(); ok && i < n; ++i) {
+    std::string name = str();
+    saved.params.emplace_back(std::move(name), std::bit_cast<float>(u32()));
+  }
+  saved.dsp_state = str();
+  saved.bundle = str();
+  return ok;
+}
+
+static std::string relative_to_dsp_dir(const std::string &path) {
+  auto rel = std::filesystem::path(path).lexically_relative(g_dsp_dir);
+  if (rel.empty() || *rel.begin() == "..")
+    return path;
+  return rel.string();
+}
+
+static std::string resolve_in_dsp_dir(const std::string &path) {
+  std::filesystem::path p(path);
+  return p.is_absolute() ? path : (g_dsp_dir / p).string();
+}
+
+/// Serialized bundle of the newest build, embedded in saved state so it
+/// restores without Clang when the object cache is cold or the sources
+/// are gone. Bundles are stored as they are; .cc builds as their sources
+/// plus whatever objects the cache holds. Rebuilt only when the sources
+/// change.
+static const std::string &get_embedded_bundle(PluginState *state) {
+  if (state->content_hash != 0 && state->embedded_hash == state->content_hash)
+    return state->embedded_bundle;
+  state->embedded_bundle.clear();
+  state->embedded_hash = 0;
+
+  // The files may have changed since they were built
+  if (state->content_hash == 0 ||
+      hash_sources(state->build_sources) != state->content_hash)
+    return state->embedded_bundle;
+
+  auto dsp_path = g_dsp_dir / state->build_file;
+  if (dsp_path.extension() == ".rtclap") {
+    if (auto buffer = llvm::MemoryBuffer::getFile(dsp_path.string()))
+      state->embedded_bundle = (*buffer)->getBuffer().str();
+  } else if (dsp_path.extension() == ".cc") {
+    auto jit_or_err = clap_rt::ClapJIT::create(make_jit_options());
+    if (!jit_or_err) {
+      log_compile("State snapshot error: " + llvm::toString(jit_or_err.takeError()));
+      return state->embedded_bundle;
+    }
+    auto bundle_or_err = jit_or_err->snapshotBundle(dsp_path.string(), get_lib_files());
+    if (!bundle_or_err) {
+      log_compile("State snapshot error: " + llvm::toString(bundle_or_err.takeError()));
+      return state->embedded_bundle;
+    }
+    state->embedded_bundle = clap_rt::serializeBundle(*bundle_or_err);
+  }
+  state->embedded_hash = state->content_hash;
+  return state->embedded_bundle;
+}
+
+/// Returns the active build's save_state() data. The DSP's state belongs to
+/// the audio thread, so the snapshot is taken there at the next block
+/// boundary; only when the host isn't processing is save_state() called
+/// here, with dsp_busy held so a block starting meanwhile outputs silence.
+static std::string save_dsp_state(PluginState *state) {
+  constexpr auto kTimeout = std::chrono::milliseconds(500);
+
+  // The first answer may only be the size it needs; one more try covers
+  // state that grew in between
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    state->save_request.store(kSaveRequested, std::memory_order_release);
+
+    auto deadline = std::chrono::steady_clock::now() + kTimeout;
+    while (state->processing.load(std::memory_order_acquire) &&
+           state->save_request.load(std::memory_order_acquire) != kSaveDone &&
+           std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    int expected = kSaveRequested;
+    if (state->save_request.compare_exchange_strong(expected, kSaveIdle,
+                                                    std::memory_order_acquire)) {
+      // Not picked up: take the DSP from the audio thread and save here
+      while (state->dsp_busy.exchange(true, std::memory_order_acquire))
+        std::this_thread::yield();
+      state->save_request.store(kSaveRequested, std::memory_order_relaxed);
+      take_state_snapshot(state);
+      state->dsp_busy.store(false, std::memory_order_release);
+    }
+    // The audio thread may be inside save_state() right now
+    while (state->save_request.load(std::memory_order_acquire) != kSaveDone)
+      std::this_thread::yield();
+    state->save_request.store(kSaveIdle, std::memory_order_relaxed);
+
+    if (state->save_size <= state->save_buffer.size())
+      return std::string(state->save_buffer.data(), state->save_size);
+    state->save_buffer.resize(state->save_size);
+  }
+  return {};
+}
+
+static bool state_save(const clap_plugin_t *plugin, const clap_ostream_t *stream) {
+  auto *state = get_state(plugin);
+
+  std::string out(kStateMagic, sizeof(kStateMagic));
+  append_u64(out, state->content_hash);
+  append_string(out, state->build_file);
+  append_u32(out, static_cast<uint32_t>(state->build_sources.size()));
+  for (const auto &source : state->build_sources)
+    append_string(out, relative_to_dsp_dir(source));
+  append_u32(out, static_cast<uint32_t>(state->param_info.size()));
+  for (size_t i = 0; i < state->param_info.size(); ++i) {
+    append_string(out, state->param_info[i].name);
+    append_u32(out, std::bit_cast<uint32_t>(state->gui_params[i]));
+  }
+
+  // A restore still waiting for init() is saved as it was loaded; a build
+  // not swapped in yet has no state to save
+  std::string dsp_state;
+  if (state->restore_pending.load(std::memory_order_acquire))
+    dsp_state = state->restore_blob;
+  else if (!state->reload_pending.load(std::memory_order_acquire))
+    dsp_state = save_dsp_state(state);
+  append_string(out, dsp_state);
+  append_string(out, get_embedded_bundle(state));
+
+  for (size_t written = 0; written < out.size();) {
+    int64_t n = stream->write(stream, out.data() + written, out.size() - written);
+    if (n <= 0)
+      return false;
+    written += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+static bool state_load(const clap_plugin_t *plugin, const clap_istream_t *stream) {
+  auto *state = get_state(plugin);
+
+  std::string data;
+  char chunk[4096];
+  for (;;) {
+    int64_t n = stream->read(stream, chunk, sizeof(chunk));
+    if (n < 0)
+      return false;
+    if (n == 0)
+      break;
+    data.append(chunk, static_cast<size_t>(n));
+  }
+
+  SavedState saved;
+  if (!parse_state(data, saved)) {
+    log_compile("State load error: unrecognized data");
+    return false;
+  }
+  log_compile("Restoring session: " + saved.file);
+
+  std::vector<std::string> sources;
+  for (const auto &source : saved.sources)
+    sources.push_back(resolve_in_dsp_dir(source));
+
+  // Unchanged sources with a warm cache load from the cache. Edited or
+  // missing sources, or a cold cache, use the embedded build instead.
+  std::optional<clap_rt::Bundle> embedded;
+  if (!saved.bundle.empty()) {
+    const bool unchanged =
+        saved.content_hash != 0 && hash_sources(sources) == saved.content_hash;
+    bool warm = unchanged;
+    if (unchanged && std::filesystem::path(saved.file).extension() == ".cc") {
+      auto jit_or_err = clap_rt::ClapJIT::create(make_jit_options());
+      if (!jit_or_err) {
+        llvm::consumeError(jit_or_err.takeError());
+        warm = false;
+      }
+      for (const auto &source : sources) {
+        if (warm && std::filesystem::path(source).extension() == ".cc")
+          warm = jit_or_err->hasCachedObject(source);
+      }
+    }
+
+    auto bundle_or_err = clap_rt::parseBundle(saved.bundle, "saved state");
+    if (!bundle_or_err) {
+      log_compile("Embedded build rejected: " +
+                  llvm::toString(bundle_or_err.takeError()));
+    } else {
+      // Sources-only bundles save nothing over compiling the files on disk
+      bool prebuilt =
+          !bundle_or_err->selectObjects(clap_rt::detectHostCpuLevel()).empty();
+      if (!unchanged || (!warm && prebuilt))
+        embedded = std::move(*bundle_or_err);
+    }
+  }
+
+  // DSP state goes to the restored build's load_state() after its init()
+  state->restore_blob = std::move(saved.dsp_state);
+  state->restore_pending.store(!state->restore_blob.empty(),
+                               std::memory_order_release);
+
+  state->gui_state.selected_file = saved.file;
+  do_recompile(state, embedded ? &*embedded : nullptr);
+  if (!state->gui_state.compile_success) {
+    state->restore_pending.store(false, std::memory_order_release);
+    log_compile("State load error: " + state->gui_state.last_error);
+    return false;
+  }
+
+  // The embedded build stands in for the saved one, keep describing that
+  if (embedded) {
+    state->content_hash = saved.content_hash;
+    state->build_sources = std::move(sources);
+    state->embedded_bundle = std::move(saved.bundle);
+    state->embedded_hash = saved.content_hash;
+  }
+
+  // Parameters by name, so reordered or added ones keep their values
+  for (size_t i = 0; i < state->param_info.size(); ++i) {
+    const auto &info = state->param_info[i];
+    auto match = [&](const auto &p) { return p.first == info.name; };
+    auto it = i < saved.params.size() && match(saved.params[i])
+                  ? saved.params.begin() + i
+                  : std::find_if(saved.params.begin(), saved.params.end(), match);
+    if (it == saved.params.end())
+      continue;
+    state->gui_params[i] = std::clamp(it->second, info.min_value, info.max_value);
+    g_params[i] = state->gui_params[i];
+  }
+
+  auto *params_host = static_cast<const clap_host_params_t *>(
+      state->host->get_extension(state->host, CLAP_EXT_PARAMS));
+  if (params_host && params_host->rescan)
+    params_host->rescan(state->host, CLAP_PARAM_RESCAN_VALUES);
+
+  log_compile(embedded ? "Session restored from embedded build"
+                       : "Session restored");
+  return true;
+}
+
+static const clap_plugin_state_t state_extension = {
+    .save = state_save,
+    .load = state_load,
+};
+
+// --- Render ---
+
+static bool render_has_hard_realtime_requirement(const clap_plugin_t *plugin) {
+  (void)plugin;
+  return false;
+}
+
+/// Switches between realtime and offline rendering. The current build is
+/// redone so oversampling_factor() and init() see g_render_offline; the
+/// object cache makes that a reload, not a compile, and the swap happens
+/// before the next process() call. Parameter values and modulation carry
+/// over, so a bounce renders the settings it was started with.
+static bool render_set(const clap_plugin_t *plugin, clap_plugin_render_mode mode) {
+  auto *state = get_state(plugin);
+  const bool offline = mode == CLAP_RENDER_OFFLINE;
+  if (offline == state->render_offline)
+    return true;
+
+  state->render_offline = offline;
+  log_compile(offline ? "Render mode: offline" : "Render mode: realtime");
+
+  // A session restored from its embedded build keeps using it
+  std::optional<clap_rt::Bundle> embedded;
+  if (state->build_embedded) {
+    auto bundle_or_err = clap_rt::parseBundle(state->embedded_bundle, "saved state");
+    if (bundle_or_err)
+      embedded = std::move(*bundle_or_err);
+    else
+      llvm::consumeError(bundle_or_err.takeError());
+  }
+  do_recompile(state, embedded ? &*embedded : nullptr, true);
+  return true;
+}
+
+static const clap_plugin_render_t render_extension = {
+    .has_hard_realtime_requirement = render_has_hard_realtime_requirement,
+    .set = render_set,
+};
+
 // --- Timer Support ---
 
 /// Timer callback handling both file watching and GUI rendering.
@@ -719,16 +2538,44 @@ static void timer_on_timer(const clap_plugin_t *plugin, clap_id timer_id) {
   // Handle file watching timer
   if (timer_id == state->timer_id) {
     std::error_code ec;
+    memory::write_stats(g_dsp_dir / "memory.stats");
+
+    // Free the JIT a reload replaced, and its memory with it
+    if (state->pending_jit &&
+        !state->reload_pending.load(std::memory_order_acquire)) {
+      state->pending_jit.reset();
+      clap_rt::ClapJIT::releaseMemory();
+
+      // Builds that skipped the trial init() are measured now; one over
+      // the budget is stopped by a restart, whose activate() rejects it
+      std::string over =
+          state->dsp_activated
+              ? check_budget(state->memory.jit,
+                             state->memory.init_heap.load(std::memory_order_relaxed))
+              : std::string();
+      if (!over.empty()) {
+        log_compile(over);
+        state->gui_state.last_error = over;
+        state->host->request_restart(state->host);
+      }
+    }
 
-    // Watch folder for new/deleted .cc files
-    auto folder_time = std::filesystem::last_write_time(g_dsp_dir, ec);
-    if (!ec && state->folder_modified != std::filesystem::file_time_type{} &&
-        folder_time != state->folder_modified) {
-      gui::scan_dsp_files(&state->gui_state, g_dsp_dir.string().c_str());
-      log_compile("Folder changed, rescanned. Found " +
-                  std::to_string(state->gui_state.dsp_files.size()) + " files");
+    // Incrementally update the library for new/deleted/changed files
+    if (refresh_library())
+      log_compile("Library changed, reindexed. Found " +
+                  std::to_string(g_library.entries().size()) + " files");
+
+    // The refresh may have run in another instance's tick
+    if (state->library_generation != g_library.generation()) {
+      state->library_generation = g_library.generation();
+      if (g_library.find(state->gui_state.selected_file) < 0)
+        select_default_dsp_file(state);
     }
-    if (!ec) state->folder_modified = folder_time;
+
+    // Edits made during a bounce apply once it's over, keeping it
+    // deterministic
+    if (state->render_offline)
+      return;
 
     // Watch selected file for changes
     auto dsp_path = g_dsp_dir / get_selected_dsp_file(state);
@@ -736,6 +2583,14 @@ static void timer_on_timer(const clap_plugin_t *plugin, clap_id timer_id) {
     if (ec)
       return;
 
+    // Dependencies of the last build count as edits to the selected file
+    for (const auto &file : state->watched_files) {
+      std::error_code dep_ec;
+      auto dep_time = std::filesystem::last_write_time(file, dep_ec);
+      if (!dep_ec && dep_time > mod_time)
+        mod_time = dep_time;
+    }
+
     if (state->last_modified != std::filesystem::file_time_type{} &&
         mod_time != state->last_modified) {
       do_recompile(state);
@@ -755,8 +2610,16 @@ static const void *plugin_get_extension(const clap_plugin_t *plugin,
   (void)plugin;
   if (strcmp(id, CLAP_EXT_AUDIO_PORTS) == 0)
     return &audio_ports_extension;
+  if (strcmp(id, CLAP_EXT_NOTE_PORTS) == 0)
+    return &note_ports_extension;
   if (strcmp(id, CLAP_EXT_PARAMS) == 0)
     return &params_extension;
+  if (strcmp(id, CLAP_EXT_LATENCY) == 0)
+    return &latency_extension;
+  if (strcmp(id, CLAP_EXT_STATE) == 0)
+    return &state_extension;
+  if (strcmp(id, CLAP_EXT_RENDER) == 0)
+    return &render_extension;
   if (strcmp(id, CLAP_EXT_GUI) == 0)
     return gui::get_extension();
   if (strcmp(id, CLAP_EXT_TIMER_SUPPORT) == 0)
@@ -774,7 +2637,7 @@ static void plugin_on_main_thread(const clap_plugin_t *plugin) {
 
 static uint32_t factory_get_plugin_count(const clap_plugin_factory_t *factory) {
   (void)factory;
-  return 1;
+  return 2;
 }
 
 static const clap_plugin_descriptor_t *
@@ -783,6 +2646,8 @@ factory_get_plugin_descriptor(const clap_plugin_factory_t *factory,
   (void)factory;
   if (index == 0)
     return &plugin_descriptor;
+  if (index == 1)
+    return &synth_descriptor;
   return nullptr;
 }
 
@@ -793,14 +2658,20 @@ factory_create_plugin(const clap_plugin_factory_t *factory,
   if (!clap_version_is_compatible(host->clap_version))
     return nullptr;
 
-  if (strcmp(plugin_id, plugin_descriptor.id) != 0)
+  const clap_plugin_descriptor_t *desc = nullptr;
+  if (strcmp(plugin_id, plugin_descriptor.id) == 0)
+    desc = &plugin_descriptor;
+  else if (strcmp(plugin_id, synth_descriptor.id) == 0)
+    desc = &synth_descriptor;
+  else
     return nullptr;
 
   auto *state = new PluginState();
   state->host = host;
+  state->instrument = desc == &synth_descriptor;
 
   auto *plugin = new clap_plugin_t{
-      .desc = &plugin_descriptor,
+      .desc = desc,
       .plugin_data = state,
       .init = plugin_init,
       .destroy = plugin_destroy,
@@ -837,6 +2708,12 @@ static bool entry_init(const char *path) {
   std::error_code ec;
   std::filesystem::create_directories(g_dsp_dir, ec);
 
+  // rtclap_asset_open() paths are relative to the DSP folder
+  assets::configure(g_dsp_dir, get_cache_dir());
+
+  if (const char *batch = getenv("RTCLAP_BATCH"))
+    g_batching = strcmp(batch, "1") == 0;
+
   return true;
 }
 
@@ -0,0 +1,166 @@
+#include "convolver.h"
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/xxhash.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace dsp {
+
+namespace {
+
+std::mutex g_spectra_mutex;
+std::unordered_map<uint64_t, std::weak_ptr<const IRSpectrum>> g_spectra;
+
+std::shared_ptr<const IRSpectrum> build_spectrum(const float *ir, size_t length,
+                                                 size_t block_size) {
+  auto spectrum = std::make_shared<IRSpectrum>();
+  RealFFT fft(2 * block_size);
+  spectrum->block_size = block_size;
+  spectrum->partitions = std::max<size_t>(1, (length + block_size - 1) / block_size);
+  spectrum->bins = fft.bins();
+  spectrum->re.resize(spectrum->partitions * spectrum->bins);
+  spectrum->im.resize(spectrum->partitions * spectrum->bins);
+
+  // Each partition is zero-padded to 2 * block_size for overlap-save
+  std::vector<float> segment(2 * block_size);
+  for (size_t p = 0; p < spectrum->partitions; ++p) {
+    std::fill(segment.begin(), segment.end(), 0.0f);
+    size_t begin = p * block_size;
+    size_t count = begin < length ? std::min(block_size, length - begin) : 0;
+    std::copy_n(ir + begin, count, segment.begin());
+    fft.forward(segment.data(), spectrum->re.data() + p * spectrum->bins,
+                spectrum->im.data() + p * spectrum->bins);
+  }
+  return spectrum;
+}
+
+} // anonymous namespace
+
+std::shared_ptr<const IRSpectrum> get_ir_spectrum(const float *ir,
+                                                  size_t length,
+                                                  size_t block_size) {
+  uint64_t key = llvm::xxh3_64bits(llvm::ArrayRef<uint8_t>(
+      reinterpret_cast<const uint8_t *>(ir), length * sizeof(float)));
+  key ^= static_cast<uint64_t>(block_size) * 0x9E3779B97F4A7C15ull;
+
+  std::lock_guard<std::mutex> lock(g_spectra_mutex);
+  if (auto it = g_spectra.find(key); it != g_spectra.end()) {
+    if (auto spectrum = it->second.lock())
+      return spectrum;
+  }
+
+  // Drop entries of IRs nobody uses anymore
+  for (auto it = g_spectra.begin(); it != g_spectra.end();) {
+    if (it->second.expired())
+      it = g_spectra.erase(it);
+    else
+      ++it;
+  }
+
+  auto spectrum = build_spectrum(ir, length, block_size);
+  g_spectra[key] = spectrum;
+  return spectrum;
+}
+
+Convolver::Convolver(std::shared_ptr<const IRSpectrum> ir)
+    : ir_(std::move(ir)), block_size_(ir_->block_size), bins_(ir_->bins),
+      fft_(2 * block_size_), input_(2 * block_size_), output_(block_size_),
+      fdl_re_(ir_->partitions * bins_), fdl_im_(ir_->partitions * bins_),
+      acc_re_(bins_), acc_im_(bins_), time_(2 * block_size_) {}
+
+void Convolver::reset() {
+  std::fill(input_.begin(), input_.end(), 0.0f);
+  std::fill(output_.begin(), output_.end(), 0.0f);
+  std::fill(fdl_re_.begin(), fdl_re_.end(), 0.0f);
+  std::fill(fdl_im_.begin(), fdl_im_.end(), 0.0f);
+  fdl_head_ = 0;
+  fill_ = 0;
+}
+
+void Convolver::process(const float *in, float *out, size_t frames) {
+  while (frames > 0) {
+    size_t n = std::min(frames, block_size_ - fill_);
+    // Read the input first so in == out works
+    std::memcpy(input_.data() + block_size_ + fill_, in, n * sizeof(float));
+    std::memcpy(out, output_.data() + fill_, n * sizeof(float));
+    fill_ += n;
+    in += n;
+    out += n;
+    frames -= n;
+
+    if (fill_ == block_size_) {
+      process_block();
+      fill_ = 0;
+    }
+  }
+}
+
+void Convolver::process_block() {
+  const size_t partitions = ir_->partitions;
+
+  // Newest input spectrum goes to the head of the delay line
+  float *xr = fdl_re_.data() + fdl_head_ * bins_;
+  float *xi = fdl_im_.data() + fdl_head_ * bins_;
+  fft_.forward(input_.data(), xr, xi);
+
+  // Y = sum over partitions p of X[head - p] * H[p]
+  float *__restrict ar = acc_re_.data();
+  float *__restrict ai = acc_im_.data();
+  std::fill(acc_re_.begin(), acc_re_.end(), 0.0f);
+  std::fill(acc_im_.begin(), acc_im_.end(), 0.0f);
+  for (size_t p = 0; p < partitions; ++p) {
+    size_t slot = (fdl_head_ + partitions - p) % partitions;
+    const float *__restrict sr = fdl_re_.data() + slot * bins_;
+    const float *__restrict si = fdl_im_.data() + slot * bins_;
+    const float *__restrict hr = ir_->re.data() + p * bins_;
+    const float *__restrict hi = ir_->im.data() + p * bins_;
+    for (size_t k = 0; k < bins_; ++k) {
+      ar[k] += sr[k] * hr[k] - si[k] * hi[k];
+      ai[k] += sr[k] * hi[k] + si[k] * hr[k];
+    }
+  }
+
+  // Overlap-save: the second half of the circular result is valid
+  fft_.inverse(ar, ai, time_.data());
+  std::memcpy(output_.data(), time_.data() + block_size_,
+              block_size_ * sizeof(float));
+
+  std::memcpy(input_.data(), input_.data() + block_size_,
+              block_size_ * sizeof(float));
+  fdl_head_ = (fdl_head_ + 1) % partitions;
+}
+
+} // namespace dsp
+
+struct rtclap_convolver {
+  dsp::Convolver conv;
+};
+
+extern "C" {
+
+rtclap_convolver *rtclap_conv_create(const float *ir, uint32_t length,
+                                     uint32_t block_size) {
+  if (!ir || length == 0 || block_size < 2 ||
+      (block_size & (block_size - 1)) != 0)
+    return nullptr;
+  return new rtclap_convolver{
+      dsp::Convolver(dsp::get_ir_spectrum(ir, length, block_size))};
+}
+
+void rtclap_conv_process(rtclap_convolver *conv, const float *in, float *out,
+                         uint32_t frames) {
+  conv->conv.process(in, out, frames);
+}
+
+uint32_t rtclap_conv_latency(const rtclap_convolver *conv) {
+  return static_cast<uint32_t>(conv->conv.latency());
+}
+
+void rtclap_conv_reset(rtclap_convolver *conv) { conv->conv.reset(); }
+
+void rtclap_conv_destroy(rtclap_convolver *conv) { delete conv; }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "fft.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dsp {
+
+/// Frequency-domain partitions of one impulse response. Immutable once
+/// built, so instances running the same IR share one copy.
+struct IRSpectrum {
+  size_t block_size = 0;
+  size_t partitions = 0;
+  size_t bins = 0;
+  std::vector<float> re;  // partitions * bins
+  std::vector<float> im;
+};
+
+/// Returns the spectrum of `ir` for the given block size, reusing one that
+/// is still alive elsewhere if the samples and block size match.
+std::shared_ptr<const IRSpectrum> get_ir_spectrum(const float *ir,
+                                                  size_t length,
+                                                  size_t block_size);
+
+/// Uniformly partitioned overlap-save convolution.
+///
+/// Input is collected into blocks of block_size samples, so the output is
+/// delayed by block_size. All buffers, including the frequency-domain
+/// delay line, are allocated in the constructor; process() does not
+/// allocate or lock.
+class Convolver {
+public:
+  Convolver(std::shared_ptr<const IRSpectrum> ir);
+
+  void process(const float *in, float *out, size_t frames);
+  void reset();
+
+  size_t latency() const { return block_size_; }
+
+private:
+  void process_block();
+
+  std::shared_ptr<const IRSpectrum> ir_;
+  size_t block_size_;
+  size_t bins_;
+  RealFFT fft_;
+
+  std::vector<float> input_;      // 2 * block_size: previous + current block
+  std::vector<float> output_;     // block_size samples ready to play
+  std::vector<float> fdl_re_;     // partitions * bins, ring of input spectra
+  std::vector<float> fdl_im_;
+  std::vector<float> acc_re_, acc_im_;
+  std::vector<float> time_;       // 2 * block_size scratch
+  size_t fdl_head_ = 0;
+  size_t fill_ = 0;               // samples collected in the current block
+};
+
+} // namespace dsp
+
+// C interface exported to JIT code with defineSymbol (see
+// examples/lib/rtclap/convolver.h). Create and destroy belong in init()
+// and destroy(); process is real-time safe.
+extern "C" {
+
+struct rtclap_convolver;
+
+rtclap_convolver *rtclap_conv_create(const float *ir, uint32_t length,
+                                     uint32_t block_size);
+void rtclap_conv_process(rtclap_convolver *conv, const float *in, float *out,
+                         uint32_t frames);
+uint32_t rtclap_conv_latency(const rtclap_convolver *conv);
+void rtclap_conv_reset(rtclap_convolver *conv);
+void rtclap_conv_destroy(rtclap_convolver *conv);
+}
@@ -0,0 +1,161 @@
+#include "fft.h"
+
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace dsp {
+
+namespace {
+
+// One radix-2 stage on a block: a[k], b[k] <- a[k] +- W^k b[k]. Halves and
+// twiddles are contiguous and don't alias, so the loop vectorizes.
+void butterflies(float *__restrict ar, float *__restrict ai,
+                 float *__restrict br, float *__restrict bi,
+                 const float *__restrict wr, const float *__restrict wi,
+                 float sign, size_t h) {
+  for (size_t k = 0; k < h; ++k) {
+    const float w_im = sign * wi[k];
+    const float tr = br[k] * wr[k] - bi[k] * w_im;
+    const float ti = br[k] * w_im + bi[k] * wr[k];
+    br[k] = ar[k] - tr;
+    bi[k] = ai[k] - ti;
+    ar[k] += tr;
+    ai[k] += ti;
+  }
+}
+
+} // anonymous namespace
+
+RealFFT::RealFFT(size_t size) : size_(size), half_(size / 2) {
+  assert(size >= 4 && (size & (size - 1)) == 0);
+
+  unsigned bits = 0;
+  while ((size_t{1} << bits) < half_)
+    ++bits;
+  bitrev_.resize(half_);
+  for (size_t i = 0; i < half_; ++i) {
+    uint32_t r = 0;
+    for (unsigned b = 0; b < bits; ++b)
+      r |= ((i >> b) & 1u) << (bits - 1 - b);
+    bitrev_[i] = r;
+  }
+
+  // Contiguous per stage, so butterflies read them in order
+  tw_re_.resize(half_);
+  tw_im_.resize(half_);
+  for (size_t h = 1; h < half_; h <<= 1) {
+    for (size_t k = 0; k < h; ++k) {
+      double a = -M_PI * static_cast<double>(k) / static_cast<double>(h);
+      tw_re_[h + k] = static_cast<float>(std::cos(a));
+      tw_im_[h + k] = static_cast<float>(std::sin(a));
+    }
+  }
+
+  rcos_.resize(half_);
+  rsin_.resize(half_);
+  for (size_t k = 0; k < half_; ++k) {
+    double a = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(size_);
+    rcos_[k] = static_cast<float>(std::cos(a));
+    rsin_[k] = static_cast<float>(std::sin(a));
+  }
+
+  work_re_.resize(half_);
+  work_im_.resize(half_);
+}
+
+void RealFFT::complex_fft(bool inverse) {
+  float *re = work_re_.data();
+  float *im = work_im_.data();
+
+  for (size_t i = 0; i < half_; ++i) {
+    size_t j = bitrev_[i];
+    if (i < j) {
+      std::swap(re[i], re[j]);
+      std::swap(im[i], im[j]);
+    }
+  }
+
+  const float sign = inverse ? -1.0f : 1.0f;
+  size_t h = 1;
+
+  // The first two stages in one radix-4 pass: their twiddles are 1 and
+  // -i (+i for the inverse), so no multiplies
+  if (half_ >= 4) {
+    for (size_t s = 0; s < half_; s += 4) {
+      const float ar = re[s] + re[s + 1], ai = im[s] + im[s + 1];
+      const float br = re[s] - re[s + 1], bi = im[s] - im[s + 1];
+      const float cr = re[s + 2] + re[s + 3], ci = im[s + 2] + im[s + 3];
+      const float dr = re[s + 2] - re[s + 3], di = im[s + 2] - im[s + 3];
+      const float tr = sign * di, ti = -sign * dr;
+      re[s] = ar + cr;
+      im[s] = ai + ci;
+      re[s + 2] = ar - cr;
+      im[s + 2] = ai - ci;
+      re[s + 1] = br + tr;
+      im[s + 1] = bi + ti;
+      re[s + 3] = br - tr;
+      im[s + 3] = bi - ti;
+    }
+    h = 4;
+  }
+
+  // Remaining radix-2 stages
+  for (; h < half_; h <<= 1) {
+    for (size_t start = 0; start < half_; start += 2 * h)
+      butterflies(re + start, im + start, re + start + h, im + start + h,
+                  tw_re_.data() + h, tw_im_.data() + h, sign, h);
+  }
+}
+
+void RealFFT::forward(const float *in, float *re, float *im) {
+  // Pack even/odd samples as one complex sequence of half the length
+  for (size_t n = 0; n < half_; ++n) {
+    work_re_[n] = in[2 * n];
+    work_im_[n] = in[2 * n + 1];
+  }
+  complex_fft(false);
+
+  // X[k] = E[k] + W^k O[k], with E/O recovered from Z[k] and conj(Z[M-k])
+  const float *zr = work_re_.data();
+  const float *zi = work_im_.data();
+  re[0] = zr[0] + zi[0];
+  im[0] = 0.0f;
+  re[half_] = zr[0] - zi[0];
+  im[half_] = 0.0f;
+  for (size_t k = 1; k < half_; ++k) {
+    const size_t m = half_ - k;
+    const float er = 0.5f * (zr[k] + zr[m]);
+    const float ei = 0.5f * (zi[k] - zi[m]);
+    const float or_ = 0.5f * (zi[k] + zi[m]);
+    const float oi = -0.5f * (zr[k] - zr[m]);
+    re[k] = er + rcos_[k] * or_ - rsin_[k] * oi;
+    im[k] = ei + rcos_[k] * oi + rsin_[k] * or_;
+  }
+}
+
+void RealFFT::inverse(const float *re, const float *im, float *out) {
+  // E[k] = (X[k] + conj(X[M-k])) / 2, O[k] = (X[k] - conj(X[M-k])) / 2 W^-k,
+  // Z[k] = E[k] + i O[k]
+  for (size_t k = 0; k < half_; ++k) {
+    const size_t m = half_ - k;
+    const float er = 0.5f * (re[k] + re[m]);
+    const float ei = 0.5f * (im[k] - im[m]);
+    const float dr = 0.5f * (re[k] - re[m]);
+    const float di = 0.5f * (im[k] + im[m]);
+    // multiply by conj(W^k)
+    const float or_ = dr * rcos_[k] + di * rsin_[k];
+    const float oi = di * rcos_[k] - dr * rsin_[k];
+    work_re_[k] = er - oi;
+    work_im_[k] = ei + or_;
+  }
+  complex_fft(true);
+
+  const float scale = 1.0f / static_cast<float>(half_);
+  for (size_t n = 0; n < half_; ++n) {
+    out[2 * n] = work_re_[n] * scale;
+    out[2 * n + 1] = work_im_[n] * scale;
+  }
+}
+
+} // namespace dsp
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dsp {
+
+/// Real-input FFT of a fixed power-of-two size.
+///
+/// Spectra are kept split into real and imaginary arrays of bins() values,
+/// so spectral loops (multiply-accumulate in the convolver) vectorize.
+/// All tables and scratch space are allocated up front; forward() and
+/// inverse() never allocate. One instance must not be used from two
+/// threads at once.
+class RealFFT {
+public:
+  /// size must be a power of two, at least 4
+  explicit RealFFT(size_t size);
+
+  size_t size() const { return size_; }
+  size_t bins() const { return half_ + 1; }
+
+  /// in: size() samples -> bins() complex values
+  void forward(const float *in, float *re, float *im);
+
+  /// bins() complex values -> size() samples, scaled by 1 / size()
+  void inverse(const float *re, const float *im, float *out);
+
+private:
+  // In-place complex FFT of half_ points on work_re_/work_im_
+  void complex_fft(bool inverse);
+
+  size_t size_;
+  size_t half_;
+  std::vector<uint32_t> bitrev_;
+  // Twiddles of the half_-point FFT, per stage: the stage combining
+  // blocks of h points uses [h, 2h), W^k = e^(-2 pi i k / 2h)
+  std::vector<float> tw_re_, tw_im_;
+  std::vector<float> rcos_, rsin_;  // W^k = e^(-2 pi i k / size) for packing
+  std::vector<float> work_re_, work_im_;
+};
+
+} // namespace dsp
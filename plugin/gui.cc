@@ -8,9 +8,7 @@
 #include <imgui.h>
 #include <imgui_impl_opengl3.h>
 
-#include <algorithm>
 #include <cstring>
-#include <filesystem>
 
 namespace gui {
 
@@ -79,10 +77,33 @@ static bool create_x11_window(PluginGui *gui, Window parent) {
   return true;
 }
 
+static void *imgui_alloc(size_t size, void *) {
+  return memory::charged_malloc(size);
+}
+
+static void imgui_free(void *ptr, void *) { memory::charged_free(ptr); }
+
+/// Counter ImGui allocations of this GUI are charged to
+static std::atomic<int64_t> *gui_heap(PluginGui *gui) {
+  return gui->memory ? &gui->memory->gui_heap : nullptr;
+}
+
+/// Estimated GPU memory: the font atlas and the double-buffered window
+static void update_texture_bytes(PluginGui *gui) {
+  if (!gui->memory)
+    return;
+  const ImFontAtlas *fonts = ImGui::GetIO().Fonts;
+  gui->memory->gui_textures =
+      uint64_t(fonts->TexWidth) * fonts->TexHeight * 4 +
+      uint64_t(gui->width) * gui->height * 4 * 2;
+}
+
 static void init_imgui(PluginGui *gui) {
   glXMakeCurrent(g_display, gui->window, gui->glx_context);
 
   IMGUI_CHECKVERSION();
+  ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free);
+  memory::Scope scope(gui_heap(gui));
   gui->imgui_ctx = ImGui::CreateContext();
   ImGui::SetCurrentContext(gui->imgui_ctx);
 
@@ -126,35 +147,18 @@ static void process_x11_events(PluginGui *gui) {
 // Platform-independent code
 // ============================================================================
 
-void scan_dsp_files(PluginGui *gui, const char *dir) {
-  gui->dsp_files.clear();
-  gui->selected_file_index = 0;
-
-  std::error_code ec;
-  std::filesystem::path base_dir(dir);
-
-  for (const auto &subdir : std::filesystem::directory_iterator(base_dir, ec)) {
-    if (!subdir.is_directory()) continue;
-
-    std::string folder_name = subdir.path().filename().string();
-    if (folder_name == "lib") continue;
-
-    for (const auto &file : std::filesystem::directory_iterator(subdir.path(), ec)) {
-      if (file.path().extension() == ".cc") {
-        std::string relative_path = folder_name + "/" + file.path().filename().string();
-        gui->dsp_files.push_back(relative_path);
-      }
-    }
-  }
-
-  std::sort(gui->dsp_files.begin(), gui->dsp_files.end());
+/// Re-runs the fuzzy search when the query or the library changed.
+/// Results are cached so idle frames cost nothing even with 10k+ entries.
+static void update_search_results(PluginGui *gui) {
+  if (!gui->library)
+    return;
+  if (gui->search_cached_generation == gui->library->generation() &&
+      gui->search_cached_query == gui->search_query)
+    return;
 
-  for (size_t i = 0; i < gui->dsp_files.size(); i++) {
-    if (gui->dsp_files[i] == "local/gain.cc") {
-      gui->selected_file_index = static_cast<int>(i);
-      break;
-    }
-  }
+  library::search(*gui->library, gui->search_query, gui->search_results);
+  gui->search_cached_query = gui->search_query;
+  gui->search_cached_generation = gui->library->generation();
 }
 
 // ============================================================================
@@ -207,10 +211,13 @@ void destroy(const clap_plugin_t *plugin) {
   }
 
   if (gui->imgui_ctx) {
+    memory::Scope scope(gui_heap(gui));
     ImGui::SetCurrentContext(gui->imgui_ctx);
     ImGui_ImplOpenGL3_Shutdown();
     ImGui::DestroyContext(gui->imgui_ctx);
     gui->imgui_ctx = nullptr;
+    if (gui->memory)
+      gui->memory->gui_textures = 0;
   }
 
   g_instance_count--;
@@ -373,6 +380,14 @@ static void draw_gui_content(PluginGui *gui) {
     }
   }
 
+  ImGui::SameLine();
+
+  if (ImGui::Button("Export Bundle", ImVec2(120, 40))) {
+    if (gui->on_export_bundle) {
+      gui->on_export_bundle();
+    }
+  }
+
   ImGui::Spacing();
 
   if (!gui->last_error.empty()) {
@@ -385,29 +400,77 @@ static void draw_gui_content(PluginGui *gui) {
     ImGui::PopStyleColor();
   }
 
+  if (gui->memory) {
+    const memory::Account &m = *gui->memory;
+    int64_t gui_bytes = m.gui_heap.load(std::memory_order_relaxed) +
+                        static_cast<int64_t>(m.gui_textures);
+    ImGui::Text("Memory: %s (JIT %s, DSP heap %s, GUI %s)",
+                memory::format_bytes(m.total()).c_str(),
+                memory::format_bytes(static_cast<int64_t>(m.jit)).c_str(),
+                memory::format_bytes(m.dsp_heap.load(std::memory_order_relaxed)).c_str(),
+                memory::format_bytes(gui_bytes).c_str());
+  }
+
   ImGui::Separator();
   ImGui::Text("JIT DSP - Hot Reload");
 
-  // DSP file selector
-  ImGui::Text("Files found: %zu", gui->dsp_files.size());
-  if (!gui->dsp_files.empty()) {
-    const char *current = gui->dsp_files[gui->selected_file_index].c_str();
+  // DSP file picker: fuzzy search over the library index
+  size_t total = gui->library ? gui->library->entries().size() : 0;
+  ImGui::Text("Files found: %zu", total);
+  if (total > 0) {
+    update_search_results(gui);
+
     ImGui::SetNextItemWidth(200);
-    if (ImGui::BeginCombo("DSP File", current)) {
-      for (int i = 0; i < static_cast<int>(gui->dsp_files.size()); i++) {
-        bool is_selected = (gui->selected_file_index == i);
-        if (ImGui::Selectable(gui->dsp_files[i].c_str(), is_selected)) {
-          gui->selected_file_index = i;
+    ImGui::InputTextWithHint("##search", "Search DSP files...",
+                             gui->search_query, sizeof(gui->search_query));
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu", gui->search_results.size());
+
+    const auto &entries = gui->library->entries();
+    ImGui::BeginChild("DSP Files", ImVec2(0, 90), ImGuiChildFlags_Borders);
+
+    // Only visible rows are submitted, so the list stays cheap at any size
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(gui->search_results.size()));
+    while (clipper.Step()) {
+      for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+        const auto &entry = entries[gui->search_results[row]];
+        bool is_selected = entry.path == gui->selected_file;
+
+        if (entry.status == library::CompileStatus::Failed)
+          ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.4f, 0.4f, 1.0f));
+        ImGui::PushID(gui->search_results[row]);
+        if (ImGui::Selectable(entry.path.c_str(), is_selected)) {
+          gui->selected_file = entry.path;
           if (gui->on_recompile) {
             gui->on_recompile();
           }
         }
-        if (is_selected) {
-          ImGui::SetItemDefaultFocus();
+        ImGui::PopID();
+        if (entry.status == library::CompileStatus::Failed)
+          ImGui::PopStyleColor();
+
+        if (ImGui::IsItemHovered() &&
+            (!entry.tags.empty() || !entry.param_names.empty() ||
+             !entry.error.empty())) {
+          ImGui::BeginTooltip();
+          if (!entry.tags.empty()) {
+            std::string tags;
+            for (const auto &tag : entry.tags)
+              tags += (tags.empty() ? "" : ", ") + tag;
+            ImGui::Text("Tags: %s", tags.c_str());
+          }
+          for (const auto &name : entry.param_names)
+            ImGui::BulletText("%s", name.c_str());
+          if (!entry.error.empty())
+            ImGui::TextWrapped("Last error: %s", entry.error.c_str());
+          ImGui::EndTooltip();
         }
       }
-      ImGui::EndCombo();
     }
+    ImGui::EndChild();
+
+    ImGui::Text("Selected: %s", gui->selected_file.c_str());
   } else {
     ImGui::Text("No .cc files found");
   }
@@ -448,10 +511,11 @@ void render(PluginGui *gui) {
   if (!gui->window || !gui->glx_context || !g_display)
     return;
 
+  memory::Scope scope(gui_heap(gui));
   glXMakeCurrent(g_display, gui->window, gui->glx_context);
-  process_x11_events(gui);
-
   ImGui::SetCurrentContext(gui->imgui_ctx);
+  process_x11_events(gui);
+  update_texture_bytes(gui);
 
   // Start ImGui frame
   ImGuiIO &io = ImGui::GetIO();
@@ -8,6 +8,9 @@
 #include <X11/Xlib.h>
 #include <GL/glx.h>
 
+#include "library.h"
+#include "memory.h"
+
 struct ImGuiContext;
 
 namespace gui {
@@ -28,15 +31,22 @@ struct PluginGui {
   // Callbacks - set by plugin
   std::function<void()> on_recompile;
   std::function<void()> on_open_folder;
+  std::function<void()> on_export_bundle;
   std::function<void(int, float)> on_param_changed;  // (param_id, value)
 
   // Status display
   std::string last_error;
   bool compile_success = true;
 
-  // DSP file selection
-  std::vector<std::string> dsp_files;  // Available .cc files
-  int selected_file_index = 0;          // Currently selected index
+  // DSP file selection (library is owned by the plugin, shared by instances)
+  const library::Library *library = nullptr;
+  std::string selected_file;            // Relative path of the selected file
+
+  // Fuzzy search picker state
+  char search_query[128] = "";
+  std::vector<int> search_results;      // Library indices, best match first
+  std::string search_cached_query;
+  uint64_t search_cached_generation = ~0ull;
 
   // Dynamic parameter callbacks
   std::function<int()> get_param_count;
@@ -45,6 +55,9 @@ struct PluginGui {
   std::function<float(int)> get_param_max;
   std::function<float(int)> get_param_value;
 
+  // Memory of the owning instance; ImGui allocations are charged to it
+  memory::Account *memory = nullptr;
+
   // Host references for timer support
   const clap_host_t *host = nullptr;
   const clap_plugin_t *plugin = nullptr;
@@ -75,9 +88,6 @@ bool hide(const clap_plugin_t *plugin);
 /// Called from the host's timer callback at ~30fps.
 void render(PluginGui *gui);
 
-/// Scans the directory for .cc files and populates dsp_files list.
-void scan_dsp_files(PluginGui *gui, const char *dir);
-
 /// Returns the CLAP GUI extension struct.
 const clap_plugin_gui_t *get_extension();
 
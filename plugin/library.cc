@@ -0,0 +1,390 @@
+#include "library.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+namespace library {
+
+namespace {
+
+constexpr const char *kIndexHeader = "rt-clap-library 1";
+
+/// Number of leading lines searched for a "// tags:" comment.
+constexpr int kTagScanLines = 20;
+
+std::string to_lower(std::string_view s) {
+  std::string out(s);
+  for (auto &c : out)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return out;
+}
+
+std::string trim(std::string_view s) {
+  size_t begin = 0, end = s.size();
+  while (begin < end && std::isspace(static_cast<unsigned char>(s[begin])))
+    ++begin;
+  while (end > begin && std::isspace(static_cast<unsigned char>(s[end - 1])))
+    --end;
+  return std::string(s.substr(begin, end - begin));
+}
+
+/// Replaces characters that would break the index line format.
+std::string sanitize(std::string_view s) {
+  std::string out(s);
+  for (auto &c : out) {
+    if (c == '\t' || c == '\n' || c == '\r' || c == '|')
+      c = ' ';
+  }
+  return out;
+}
+
+std::vector<std::string> split(const std::string &s, char sep) {
+  std::vector<std::string> parts;
+  if (s.empty())
+    return parts;
+  std::string part;
+  std::istringstream in(s);
+  while (std::getline(in, part, sep))
+    parts.push_back(part);
+  return parts;
+}
+
+std::string join(const std::vector<std::string> &parts, char sep) {
+  std::string out;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    if (i)
+      out += sep;
+    out += sanitize(parts[i]);
+  }
+  return out;
+}
+
+int64_t to_ticks(std::filesystem::file_time_type t) {
+  return static_cast<int64_t>(t.time_since_epoch().count());
+}
+
+/// Reads "// tags: a, b" from the head of a source file.
+std::vector<std::string> read_tags(const std::filesystem::path &file) {
+  std::vector<std::string> tags;
+  std::ifstream in(file);
+  std::string line;
+  for (int i = 0; i < kTagScanLines && std::getline(in, line); ++i) {
+    auto pos = line.find("// tags:");
+    if (pos == std::string::npos)
+      continue;
+    for (const auto &tag : split(line.substr(pos + 8), ',')) {
+      auto t = trim(tag);
+      if (!t.empty())
+        tags.push_back(to_lower(t));
+    }
+    break;
+  }
+  return tags;
+}
+
+void update_search_text(Entry &e) {
+  e.search_text = to_lower(e.path);
+  for (const auto &tag : e.tags)
+    e.search_text += " " + tag;
+}
+
+bool is_boundary(char c) {
+  return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ' || c == '@';
+}
+
+} // anonymous namespace
+
+bool is_dsp_source(const std::filesystem::path &path) {
+  auto ext = path.extension();
+  return ext == ".cc" || ext == ".expr" || ext == ".chain" ||
+         ext == ".rtclap";
+}
+
+void Library::load(const std::filesystem::path &index_path) {
+  index_path_ = index_path;
+  entries_.clear();
+  folder_mtimes_.clear();
+
+  std::ifstream in(index_path);
+  std::string line;
+  if (!std::getline(in, line) || line != kIndexHeader) {
+    rebuild_lookup();
+    return;
+  }
+
+  // path \t mtime \t status \t cache_key \t tags \t params \t error
+  while (std::getline(in, line)) {
+    auto fields = split(line, '\t');
+    if (fields.size() < 2)
+      continue;
+    fields.resize(7);
+
+    Entry e;
+    e.path = fields[0];
+    e.mtime = std::strtoll(fields[1].c_str(), nullptr, 10);
+    if (fields[2] == "ok")
+      e.status = CompileStatus::Ok;
+    else if (fields[2] == "failed")
+      e.status = CompileStatus::Failed;
+    e.cache_key = fields[3];
+    e.tags = split(fields[4], '|');
+    e.param_names = split(fields[5], '|');
+    e.error = fields[6];
+    update_search_text(e);
+    entries_.push_back(std::move(e));
+  }
+
+  std::sort(entries_.begin(), entries_.end(),
+            [](const Entry &a, const Entry &b) { return a.path < b.path; });
+  rebuild_lookup();
+}
+
+void Library::save() const {
+  if (index_path_.empty())
+    return;
+
+  // Write to a temp file and rename so concurrent readers never see a
+  // partially written index
+  auto tmp_path = index_path_;
+  tmp_path += ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::trunc);
+    if (!out)
+      return;
+    out << kIndexHeader << '\n';
+    for (const auto &e : entries_) {
+      const char *status = e.status == CompileStatus::Ok       ? "ok"
+                           : e.status == CompileStatus::Failed ? "failed"
+                                                               : "unknown";
+      out << sanitize(e.path) << '\t' << e.mtime << '\t' << status << '\t'
+          << sanitize(e.cache_key) << '\t' << join(e.tags, '|') << '\t'
+          << join(e.param_names, '|') << '\t' << sanitize(e.error) << '\n';
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, index_path_, ec);
+}
+
+bool Library::refresh(const std::filesystem::path &dsp_dir) {
+  std::error_code ec;
+  bool changed = false;
+
+  std::unordered_map<std::string, std::filesystem::file_time_type> seen_folders;
+  std::vector<std::string> rescan;
+
+  for (const auto &subdir : std::filesystem::directory_iterator(dsp_dir, ec)) {
+    if (!subdir.is_directory(ec))
+      continue;
+
+    std::string folder_name = subdir.path().filename().string();
+    if (folder_name == "lib")
+      continue;
+
+    auto folder_time = std::filesystem::last_write_time(subdir.path(), ec);
+    if (ec)
+      continue;
+    seen_folders[folder_name] = folder_time;
+
+    auto it = folder_mtimes_.find(folder_name);
+    if (it == folder_mtimes_.end() || it->second != folder_time)
+      rescan.push_back(folder_name);
+  }
+
+  // Folders that disappeared also need their entries dropped
+  for (const auto &[folder_name, _] : folder_mtimes_) {
+    if (!seen_folders.count(folder_name))
+      rescan.push_back(folder_name);
+  }
+
+  // First refresh after load: folders we never saw in this session but
+  // which have entries in the index must be checked too
+  if (folder_mtimes_.empty()) {
+    for (const auto &e : entries_) {
+      auto folder_name = e.path.substr(0, e.path.find('/'));
+      if (!seen_folders.count(folder_name) &&
+          std::find(rescan.begin(), rescan.end(), folder_name) == rescan.end())
+        rescan.push_back(folder_name);
+    }
+  }
+
+  folder_mtimes_ = std::move(seen_folders);
+
+  // Saving a file in place doesn't touch its folder's mtime. Stat'ing
+  // every file would cost thousands of syscalls per tick, so only the
+  // recently compiled ones are checked
+  for (const auto &path : recent_) {
+    auto folder_name = path.substr(0, path.find('/'));
+    int index = find(path);
+    if (index < 0 ||
+        std::find(rescan.begin(), rescan.end(), folder_name) != rescan.end())
+      continue;
+    auto &e = entries_[index];
+    auto mtime = std::filesystem::last_write_time(dsp_dir / e.path, ec);
+    if (ec || e.mtime == to_ticks(mtime))
+      continue;
+    e.mtime = to_ticks(mtime);
+    e.tags = read_tags(dsp_dir / e.path);
+    e.status = CompileStatus::Unknown;
+    update_search_text(e);
+    changed = true;
+  }
+
+  for (const auto &folder_name : rescan) {
+    const std::string prefix = folder_name + "/";
+
+    // Collect current files of this folder
+    std::unordered_map<std::string, int64_t> files;
+    for (const auto &file :
+         std::filesystem::directory_iterator(dsp_dir / folder_name, ec)) {
+      if (!is_dsp_source(file.path()))
+        continue;
+      auto mtime = std::filesystem::last_write_time(file.path(), ec);
+      if (ec)
+        continue;
+      files[prefix + file.path().filename().string()] = to_ticks(mtime);
+    }
+
+    // Drop entries that no longer exist, update those whose mtime changed
+    auto removed = std::remove_if(
+        entries_.begin(), entries_.end(), [&](const Entry &e) {
+          return e.path.starts_with(prefix) && !files.count(e.path);
+        });
+    if (removed != entries_.end()) {
+      entries_.erase(removed, entries_.end());
+      changed = true;
+    }
+
+    for (auto &e : entries_) {
+      auto it = files.find(e.path);
+      if (it == files.end())
+        continue;
+      if (e.mtime != it->second) {
+        e.mtime = it->second;
+        e.tags = read_tags(dsp_dir / e.path);
+        e.status = CompileStatus::Unknown;
+        update_search_text(e);
+        changed = true;
+      }
+      files.erase(it);
+    }
+
+    // Whatever is left is new
+    for (const auto &[path, mtime] : files) {
+      Entry e;
+      e.path = path;
+      e.mtime = mtime;
+      e.tags = read_tags(dsp_dir / path);
+      update_search_text(e);
+      entries_.push_back(std::move(e));
+      changed = true;
+    }
+  }
+
+  if (changed) {
+    std::sort(entries_.begin(), entries_.end(),
+              [](const Entry &a, const Entry &b) { return a.path < b.path; });
+    rebuild_lookup();
+  }
+  return changed;
+}
+
+void Library::record_compile(const std::string &path, bool success,
+                             const std::string &error,
+                             std::vector<std::string> param_names,
+                             const std::string &cache_key) {
+  int index = find(path);
+  if (index < 0)
+    return;
+
+  // Most recent first
+  auto it = std::find(recent_.begin(), recent_.end(), path);
+  if (it != recent_.end())
+    recent_.erase(it);
+  else if (recent_.size() == kMaxRecent)
+    recent_.pop_back();
+  recent_.insert(recent_.begin(), path);
+
+  auto &e = entries_[index];
+  e.status = success ? CompileStatus::Ok : CompileStatus::Failed;
+  e.error = error.substr(0, error.find('\n'));
+  if (success) {
+    e.param_names = std::move(param_names);
+    e.cache_key = cache_key;
+  }
+  ++generation_;
+}
+
+int Library::find(const std::string &path) const {
+  auto it = lookup_.find(path);
+  return it == lookup_.end() ? -1 : it->second;
+}
+
+void Library::rebuild_lookup() {
+  lookup_.clear();
+  lookup_.reserve(entries_.size());
+  for (size_t i = 0; i < entries_.size(); ++i)
+    lookup_[entries_[i].path] = static_cast<int>(i);
+  ++generation_;
+}
+
+std::optional<int> fuzzy_score(std::string_view pattern, std::string_view text) {
+  // Greedy subsequence match. Rewards consecutive runs and matches at word
+  // boundaries, penalizes gaps - good enough ranking for file names
+  int score = 0;
+  int run = 0;
+  size_t t = 0;
+  for (char pc : pattern) {
+    char lc = static_cast<char>(std::tolower(static_cast<unsigned char>(pc)));
+    if (lc == ' ')
+      continue;
+
+    size_t start = t;
+    while (t < text.size() && text[t] != lc)
+      ++t;
+    if (t == text.size())
+      return std::nullopt;
+
+    if (t == start && start != 0) {
+      run++;
+      score += 4 * run;
+    } else {
+      run = 0;
+      score -= static_cast<int>(std::min<size_t>(t - start, 8));
+    }
+    if (t == 0 || is_boundary(text[t - 1]))
+      score += 8;
+    ++t;
+  }
+  // Prefer shorter paths among equal matches
+  return score * 16 + std::max(0, 255 - static_cast<int>(text.size()));
+}
+
+void search(const Library &lib, std::string_view query, std::vector<int> &out) {
+  out.clear();
+  const auto &entries = lib.entries();
+
+  if (trim(query).empty()) {
+    out.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+      out.push_back(static_cast<int>(i));
+    return;
+  }
+
+  std::vector<std::pair<int, int>> scored;  // (score, index)
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (auto score = fuzzy_score(query, entries[i].search_text))
+      scored.emplace_back(*score, static_cast<int>(i));
+  }
+
+  std::stable_sort(scored.begin(), scored.end(),
+                   [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  out.reserve(scored.size());
+  for (const auto &[score, index] : scored)
+    out.push_back(index);
+}
+
+} // namespace library
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace library {
+
+/// Result of the last compile attempt for a library entry.
+enum class CompileStatus : uint8_t { Unknown, Ok, Failed };
+
+/// Metadata for one DSP source file in the library index.
+struct Entry {
+  std::string path;                      // Relative to DSP dir, e.g. "local/gain.cc"
+  int64_t mtime = 0;                     // Source mtime when last indexed
+  std::vector<std::string> tags;         // From a "// tags: a, b" header comment
+  std::vector<std::string> param_names;  // From the last successful compile
+  std::string cache_key;                 // Object cache file of the last build
+  CompileStatus status = CompileStatus::Unknown;
+  std::string error;                     // First line of the last compile error
+
+  std::string search_text;               // Lowercased path + tags for fuzzy search
+};
+
+/// Persistent, incrementally updated index of DSP files.
+///
+/// The index is stored as a text file next to the DSP folders so that
+/// reopening the plugin only has to stat files instead of re-reading them.
+/// Folders are listed again only when their mtime changes, which keeps
+/// refresh cheap with thousands of files spread over many @username/
+/// folders. In-place edits don't change a folder's mtime; they are picked
+/// up for the files compiled most recently, which covers every file an
+/// instance has selected.
+class Library {
+public:
+  /// Loads the index file. Missing or outdated files yield an empty index.
+  void load(const std::filesystem::path &index_path);
+
+  /// Writes the index back to the file given to load().
+  void save() const;
+
+  /// Rescans folders of dsp_dir whose mtime changed since the last call
+  /// and re-reads recently compiled files modified in place. Returns true
+  /// if any entry was added, removed or updated.
+  bool refresh(const std::filesystem::path &dsp_dir);
+
+  /// Records the outcome of compiling `path` (relative to the DSP dir)
+  /// and makes it one of the recent files refresh() checks for edits.
+  void record_compile(const std::string &path, bool success,
+                      const std::string &error,
+                      std::vector<std::string> param_names,
+                      const std::string &cache_key);
+
+  /// Returns the index of `path`, or -1 if it is not in the library.
+  int find(const std::string &path) const;
+
+  const std::vector<Entry> &entries() const { return entries_; }
+  bool empty() const { return entries_.empty(); }
+
+  /// Incremented on every change; lets views cache derived data.
+  uint64_t generation() const { return generation_; }
+
+  /// Number of recently compiled files refresh() stats on every call.
+  static constexpr size_t kMaxRecent = 32;
+
+private:
+  void rebuild_lookup();
+
+  std::filesystem::path index_path_;
+  std::vector<Entry> entries_;  // Sorted by path
+  std::unordered_map<std::string, int> lookup_;
+  std::unordered_map<std::string, std::filesystem::file_time_type> folder_mtimes_;
+  std::vector<std::string> recent_;  // Most recently compiled first
+  uint64_t generation_ = 0;
+};
+
+/// Returns true if `path` has an extension the plugin can compile.
+bool is_dsp_source(const std::filesystem::path &path);
+
+/// Scores `text` against a fuzzy `pattern` (subsequence match).
+/// Returns std::nullopt if the pattern doesn't match; any score, even a
+/// negative one, is a match.
+std::optional<int> fuzzy_score(std::string_view pattern, std::string_view text);
+
+/// Fills `out` with indices of entries matching `query`, best match first.
+/// An empty query returns all entries in path order.
+void search(const Library &lib, std::string_view query, std::vector<int> &out);
+
+} // namespace library
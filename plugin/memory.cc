@@ -0,0 +1,289 @@
+#include "memory.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <malloc.h>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+namespace memory {
+
+namespace {
+
+thread_local std::atomic<int64_t> *t_counter = nullptr;
+
+std::mutex g_accounts_mutex;
+std::vector<Account *> g_accounts;  // In creation order
+
+// Live charged allocations. JIT code also frees memory it never allocated
+// through us (e.g. from libstdc++'s own operator new), which must not be
+// refunded, and a free refunds the counter that paid for the allocation.
+//
+// Most frees come from process() on the audio thread, and ImGui frees
+// every frame, so this is a fixed open-addressing table that never locks
+// or allocates. A slot's ptr is null until first used and kFreed once its
+// allocation was refunded; probing stops at null. An allocation that
+// finds no slot within kMaxProbe goes uncharged.
+struct Slot {
+  std::atomic<void *> ptr{nullptr};
+  std::atomic<std::atomic<int64_t> *> counter{nullptr};
+  std::atomic<int64_t> size{0};
+};
+constexpr size_t kSlotBits = 16;
+constexpr size_t kSlots = size_t{1} << kSlotBits;
+constexpr size_t kMaxProbe = 64;
+Slot g_charges[kSlots];
+
+// Slot states besides null and a live pointer; malloc never returns these
+void *const kFreed = reinterpret_cast<void *>(1);
+void *const kFilling = reinterpret_cast<void *>(2);  // Being charged
+
+size_t home_slot(void *ptr) {
+  auto bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)) >> 4;
+  return static_cast<size_t>((bits * 0x9E3779B97F4A7C15ull) >> (64 - kSlotBits));
+}
+
+// Sizes are what the allocator really handed out
+void charge(void *ptr) {
+  if (!ptr || !t_counter)
+    return;
+  const auto size = static_cast<int64_t>(malloc_usable_size(ptr));
+  for (size_t i = 0, s = home_slot(ptr); i < kMaxProbe;
+       ++i, s = (s + 1) & (kSlots - 1)) {
+    Slot &slot = g_charges[s];
+    void *seen = slot.ptr.load(std::memory_order_relaxed);
+    if (seen != nullptr && seen != kFreed)
+      continue;
+    if (!slot.ptr.compare_exchange_strong(seen, kFilling,
+                                          std::memory_order_acquire))
+      continue;
+    slot.counter.store(t_counter, std::memory_order_relaxed);
+    slot.size.store(size, std::memory_order_relaxed);
+    slot.ptr.store(ptr, std::memory_order_release);
+    t_counter->fetch_add(size, std::memory_order_relaxed);
+    return;
+  }
+}
+
+// Before the memory is freed, so its address can't be charged again
+// meanwhile
+void refund(void *ptr) {
+  if (!ptr)
+    return;
+  for (size_t i = 0, s = home_slot(ptr); i < kMaxProbe;
+       ++i, s = (s + 1) & (kSlots - 1)) {
+    Slot &slot = g_charges[s];
+    void *seen = slot.ptr.load(std::memory_order_acquire);
+    if (seen == nullptr)
+      return;
+    if (seen != ptr)
+      continue;
+    auto *counter = slot.counter.load(std::memory_order_relaxed);
+    const int64_t size = slot.size.load(std::memory_order_relaxed);
+    // Lost only to forget(), which means the counter is going away
+    if (slot.ptr.compare_exchange_strong(seen, kFreed, std::memory_order_relaxed))
+      counter->fetch_sub(size, std::memory_order_relaxed);
+    return;
+  }
+}
+
+void *jit_calloc(size_t count, size_t size) {
+  void *ptr = calloc(count, size);
+  charge(ptr);
+  return ptr;
+}
+
+void *jit_realloc(void *ptr, size_t size) {
+  refund(ptr);
+  void *moved = realloc(ptr, size);
+  if (moved)
+    charge(moved);
+  else if (size != 0)
+    charge(ptr);  // Failed, ptr is still allocated. Size 0 freed it.
+  return moved;
+}
+
+int jit_posix_memalign(void **out, size_t alignment, size_t size) {
+  int err = posix_memalign(out, alignment, size);
+  if (err == 0)
+    charge(*out);
+  return err;
+}
+
+void *jit_aligned_alloc(size_t alignment, size_t size) {
+  void *ptr = aligned_alloc(alignment, size);
+  charge(ptr);
+  return ptr;
+}
+
+void *jit_new(size_t size) {
+  void *ptr = ::operator new(size);
+  charge(ptr);
+  return ptr;
+}
+
+void *jit_new_nothrow(size_t size, const std::nothrow_t &tag) noexcept {
+  void *ptr = ::operator new(size, tag);
+  charge(ptr);
+  return ptr;
+}
+
+void *jit_new_aligned(size_t size, std::align_val_t alignment) {
+  void *ptr = ::operator new(size, alignment);
+  charge(ptr);
+  return ptr;
+}
+
+void jit_delete(void *ptr) noexcept {
+  refund(ptr);
+  ::operator delete(ptr);
+}
+
+void jit_delete_sized(void *ptr, size_t) noexcept { jit_delete(ptr); }
+
+void jit_delete_aligned(void *ptr, std::align_val_t alignment) noexcept {
+  refund(ptr);
+  ::operator delete(ptr, alignment);
+}
+
+void jit_delete_sized_aligned(void *ptr, size_t,
+                              std::align_val_t alignment) noexcept {
+  jit_delete_aligned(ptr, alignment);
+}
+
+} // anonymous namespace
+
+Account::Account() {
+  std::lock_guard<std::mutex> lock(g_accounts_mutex);
+  g_accounts.push_back(this);
+}
+
+Account::~Account() {
+  forget(&dsp_heap);
+  forget(&gui_heap);
+  std::lock_guard<std::mutex> lock(g_accounts_mutex);
+  g_accounts.erase(std::find(g_accounts.begin(), g_accounts.end(), this));
+}
+
+int64_t Account::total() const {
+  return dsp_heap.load(std::memory_order_relaxed) +
+         gui_heap.load(std::memory_order_relaxed) +
+         static_cast<int64_t>(jit + gui_textures);
+}
+
+Scope::Scope(std::atomic<int64_t> *counter) : previous_(t_counter) {
+  t_counter = counter;
+}
+
+Scope::~Scope() { t_counter = previous_; }
+
+void forget(const std::atomic<int64_t> *counter) {
+  for (auto &slot : g_charges) {
+    void *seen = slot.ptr.load(std::memory_order_acquire);
+    if (seen == nullptr || seen == kFreed || seen == kFilling ||
+        slot.counter.load(std::memory_order_relaxed) != counter)
+      continue;
+    slot.ptr.compare_exchange_strong(seen, kFreed, std::memory_order_relaxed);
+  }
+}
+
+void *charged_malloc(size_t size) {
+  void *ptr = malloc(size);
+  charge(ptr);
+  return ptr;
+}
+
+void charged_free(void *ptr) {
+  refund(ptr);
+  free(ptr);
+}
+
+const std::vector<std::pair<const char *, void *>> &jit_symbols() {
+  using sized_delete = void (*)(void *, size_t) noexcept;
+  static const std::vector<std::pair<const char *, void *>> symbols = {
+      {"malloc", reinterpret_cast<void *>(&charged_malloc)},
+      {"free", reinterpret_cast<void *>(&charged_free)},
+      {"calloc", reinterpret_cast<void *>(&jit_calloc)},
+      {"realloc", reinterpret_cast<void *>(&jit_realloc)},
+      {"posix_memalign", reinterpret_cast<void *>(&jit_posix_memalign)},
+      {"aligned_alloc", reinterpret_cast<void *>(&jit_aligned_alloc)},
+      {"_Znwm", reinterpret_cast<void *>(&jit_new)},
+      {"_Znam", reinterpret_cast<void *>(&jit_new)},
+      {"_ZnwmRKSt9nothrow_t", reinterpret_cast<void *>(&jit_new_nothrow)},
+      {"_ZnamRKSt9nothrow_t", reinterpret_cast<void *>(&jit_new_nothrow)},
+      {"_ZnwmSt11align_val_t", reinterpret_cast<void *>(&jit_new_aligned)},
+      {"_ZnamSt11align_val_t", reinterpret_cast<void *>(&jit_new_aligned)},
+      {"_ZdlPv", reinterpret_cast<void *>(&jit_delete)},
+      {"_ZdaPv", reinterpret_cast<void *>(&jit_delete)},
+      {"_ZdlPvm", reinterpret_cast<void *>(sized_delete(&jit_delete_sized))},
+      {"_ZdaPvm", reinterpret_cast<void *>(sized_delete(&jit_delete_sized))},
+      {"_ZdlPvSt11align_val_t", reinterpret_cast<void *>(&jit_delete_aligned)},
+      {"_ZdaPvSt11align_val_t", reinterpret_cast<void *>(&jit_delete_aligned)},
+      {"_ZdlPvmSt11align_val_t",
+       reinterpret_cast<void *>(&jit_delete_sized_aligned)},
+      {"_ZdaPvmSt11align_val_t",
+       reinterpret_cast<void *>(&jit_delete_sized_aligned)},
+  };
+  return symbols;
+}
+
+int64_t budget() {
+  static const int64_t bytes = [] {
+    const char *mb = std::getenv("RTCLAP_MEMORY_BUDGET");
+    return mb ? static_cast<int64_t>(std::strtod(mb, nullptr) * 1024 * 1024)
+              : int64_t{0};
+  }();
+  return bytes;
+}
+
+std::string format_bytes(int64_t bytes) {
+  char text[32];
+  if (bytes < 1024 * 1024)
+    snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+  else
+    snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+  return text;
+}
+
+void write_stats(const std::filesystem::path &path) {
+  static std::string last_written;
+
+  std::ostringstream out;
+  out << "# instance\tbuild\tjit\tdsp_heap\tinit_heap\tgui_heap\t"
+         "gui_textures\ttotal\n";
+  {
+    std::lock_guard<std::mutex> lock(g_accounts_mutex);
+    for (size_t i = 0; i < g_accounts.size(); ++i) {
+      const Account &a = *g_accounts[i];
+      out << i << '\t' << (a.build.empty() ? "-" : a.build) << '\t' << a.jit
+          << '\t' << a.dsp_heap.load(std::memory_order_relaxed) << '\t'
+          << a.init_heap.load(std::memory_order_relaxed) << '\t'
+          << a.gui_heap.load(std::memory_order_relaxed) << '\t'
+          << a.gui_textures << '\t' << a.total() << '\n';
+    }
+  }
+  if (int64_t limit = budget())
+    out << "# budget\t" << limit << '\n';
+  std::string text = out.str();
+  if (text == last_written)
+    return;
+
+  // Write to a temp file and rename, like the library index
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    if (!file)
+      return;
+    file << text;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  if (!ec)
+    last_written = std::move(text);
+}
+
+} // namespace memory
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace memory {
+
+/// Memory attributed to one plugin instance.
+///
+/// Heap counters are charged by the allocator entry points below while a
+/// Scope for them is active on the calling thread; a free refunds the
+/// counter its allocation was charged to, on any thread and without
+/// locking, and memory that was never charged refunds nothing. The rest is
+/// set by the plugin on the main thread. Accounts register themselves for
+/// write_stats().
+struct Account {
+  Account();
+  ~Account();
+  Account(const Account &) = delete;
+  Account &operator=(const Account &) = delete;
+
+  std::atomic<int64_t> dsp_heap{0};   // malloc/new from JIT code
+  std::atomic<int64_t> gui_heap{0};   // ImGui allocations
+  std::atomic<int64_t> init_heap{0};  // Heap the last init() kept
+
+  // Main thread
+  std::string build;         // DSP file of the newest build
+  uint64_t jit = 0;          // Linked code and data of the newest build
+  uint64_t gui_textures = 0; // Font atlas and window buffers, estimated
+
+  int64_t total() const;
+};
+
+/// Charges allocations on this thread to `counter` (nullptr: no one)
+/// until destroyed. Nests.
+class Scope {
+public:
+  explicit Scope(std::atomic<int64_t> *counter);
+  ~Scope();
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  std::atomic<int64_t> *previous_;
+};
+
+/// Drops the record of allocations charged to `counter`, which is about to
+/// be destroyed; freeing them later refunds nothing.
+void forget(const std::atomic<int64_t> *counter);
+
+/// malloc() and free() that charge the active Scope
+void *charged_malloc(size_t size);
+void charged_free(void *ptr);
+
+/// Allocator functions for JIT code to link against instead of libc's and
+/// libstdc++'s (malloc, free, operator new and delete, ...). Allocations
+/// libstdc++ makes internally, e.g. when a std::string grows out of line,
+/// are not seen.
+const std::vector<std::pair<const char *, void *>> &jit_symbols();
+
+/// Per-instance budget from RTCLAP_MEMORY_BUDGET (in MB), or 0 for none
+int64_t budget();
+
+/// Formats a byte count as e.g. "1.5 MB"
+std::string format_bytes(int64_t bytes);
+
+/// Rewrites `path` with one line per live account, if anything changed
+/// since the last call. Main thread.
+void write_stats(const std::filesystem::path &path);
+
+} // namespace memory
@@ -0,0 +1,173 @@
+#include "oversampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace dsp {
+
+namespace {
+
+/// Nonzero taps per side of each stage, steepest first
+constexpr size_t kStageHalfTaps[] = {16, 8, 4};
+
+int stage_count(int factor) { return factor >= 8 ? 3 : factor >= 4 ? 2 : 1; }
+
+/// Round-trip delay of the stages in host samples; fractional past 2x
+double stage_latency(int factor) {
+  // Stage s runs between 2^s and 2^(s+1) times the host rate
+  double latency = 0.0;
+  for (int s = 0; s < stage_count(factor); ++s)
+    latency += (2.0 * kStageHalfTaps[s] - 1.0) / static_cast<double>(1 << s);
+  return latency;
+}
+
+/// Odd-indexed taps of a Blackman-Harris windowed half-band lowpass, in
+/// causal order. They sum to 0.5; the centre tap (0.5) is implicit.
+std::vector<float> design_half_band(size_t half_taps) {
+  const size_t taps = 2 * half_taps;
+  const double span = 4.0 * half_taps - 2.0;  // filter length - 1
+  std::vector<double> h(taps);
+  double sum = 0.0;
+  for (size_t i = 0; i < taps; ++i) {
+    // Causal index 2i holds tap k of the centred filter
+    double k = 2.0 * i - (2.0 * half_taps - 1.0);
+    double n = 2.0 * i;
+    double x = 2.0 * M_PI * n / span;
+    double window = 0.35875 - 0.48829 * std::cos(x) + 0.14128 * std::cos(2 * x) -
+                    0.01168 * std::cos(3 * x);
+    h[i] = std::sin(M_PI * k / 2.0) / (M_PI * k) * window;
+    sum += h[i];
+  }
+  std::vector<float> coeffs(taps);
+  for (size_t i = 0; i < taps; ++i)
+    coeffs[i] = static_cast<float>(h[i] * 0.5 / sum);
+  return coeffs;
+}
+
+} // anonymous namespace
+
+HalfBand::HalfBand(size_t half_taps, size_t max_frames)
+    : half_(half_taps), taps_(2 * half_taps),
+      coeffs_(design_half_band(half_taps)), up_(taps_ - 1 + max_frames),
+      even_(taps_ - 1 + max_frames), odd_(half_ + max_frames),
+      acc_(max_frames) {}
+
+void HalfBand::reset() {
+  std::fill(up_.begin(), up_.end(), 0.0f);
+  std::fill(even_.begin(), even_.end(), 0.0f);
+  std::fill(odd_.begin(), odd_.end(), 0.0f);
+}
+
+void HalfBand::fir(std::vector<float> &buf, size_t frames) {
+  float *acc = acc_.data();
+  std::fill(acc, acc + frames, 0.0f);
+  for (size_t i = 0; i < taps_; ++i) {
+    const float c = coeffs_[i];
+    const float *x = buf.data() + taps_ - 1 - i;
+    for (size_t n = 0; n < frames; ++n)
+      acc[n] += c * x[n];
+  }
+  std::memmove(buf.data(), buf.data() + frames, (taps_ - 1) * sizeof(float));
+}
+
+void HalfBand::upsample(const float *in, float *out, size_t frames) {
+  // Even outputs: FIR branch. Odd outputs: the centre tap, a delay of
+  // half_ - 1 input samples. Both are scaled by 2 for unity gain.
+  std::copy(in, in + frames, up_.begin() + (taps_ - 1));
+  const float *delayed = up_.data() + half_;
+  for (size_t n = 0; n < frames; ++n)
+    out[2 * n + 1] = delayed[n];
+  fir(up_, frames);
+  for (size_t n = 0; n < frames; ++n)
+    out[2 * n] = 2.0f * acc_[n];
+}
+
+void HalfBand::downsample(const float *in, float *out, size_t frames) {
+  float *even = even_.data() + (taps_ - 1);
+  float *odd = odd_.data() + half_;
+  for (size_t n = 0; n < frames; ++n) {
+    even[n] = in[2 * n];
+    odd[n] = in[2 * n + 1];
+  }
+  fir(even_, frames);
+  for (size_t n = 0; n < frames; ++n)
+    out[n] = acc_[n] + 0.5f * odd_[n];
+  std::memmove(odd_.data(), odd_.data() + frames, half_ * sizeof(float));
+}
+
+Oversampler::Oversampler(int factor, size_t channels, size_t max_frames)
+    : factor_(1 << stage_count(factor)), channels_(channels),
+      max_frames_(max_frames), state_(channels), up_ptrs_(channels),
+      out_ptrs_(channels) {
+  const int stages = stage_count(factor);
+  // Delay the DSP output by whole samples at the oversampled rate so the
+  // total latency comes out as whole host samples
+  pad_ = static_cast<size_t>(
+      std::lround((latency() - stage_latency(factor_)) * factor_));
+  for (size_t ch = 0; ch < channels; ++ch) {
+    Channel &c = state_[ch];
+    for (int s = 0; s < stages; ++s)
+      c.stages.emplace_back(kStageHalfTaps[s], max_frames << s);
+    c.up.resize(factor_ * max_frames);
+    c.out.resize(pad_ + factor_ * max_frames);
+    c.scratch.resize(factor_ * max_frames / 2);
+    up_ptrs_[ch] = c.up.data();
+    out_ptrs_[ch] = c.out.data() + pad_;
+  }
+}
+
+uint32_t Oversampler::latency_for(int factor) {
+  if (factor < 2)
+    return 0;
+  return static_cast<uint32_t>(std::ceil(stage_latency(factor)));
+}
+
+const float *const *Oversampler::upsample(const float *const *in,
+                                          size_t channels, size_t frames) {
+  for (size_t ch = 0; ch < channels && ch < channels_; ++ch) {
+    Channel &c = state_[ch];
+    const size_t stages = c.stages.size();
+    // Alternate between scratch and up so the last stage lands in up
+    const float *src = in[ch];
+    size_t n = frames;
+    for (size_t s = 0; s < stages; ++s) {
+      float *dst = ((stages - s) & 1) ? c.up.data() : c.scratch.data();
+      c.stages[s].upsample(src, dst, n);
+      src = dst;
+      n *= 2;
+    }
+  }
+  return up_ptrs_.data();
+}
+
+void Oversampler::downsample(float *const *out, size_t channels,
+                             size_t frames) {
+  for (size_t ch = 0; ch < channels && ch < channels_; ++ch) {
+    Channel &c = state_[ch];
+    const size_t stages = c.stages.size();
+    // Highest rate first, reading pad_ samples of the previous block;
+    // alternate so the last stage lands in out
+    const float *src = c.out.data();
+    size_t n = frames << (stages - 1);
+    const size_t produced = frames * factor_;
+    for (size_t s = stages; s-- > 0;) {
+      float *dst = s == 0 ? out[ch]
+                          : ((s & 1) ? c.scratch.data() : c.up.data());
+      c.stages[s].downsample(src, dst, n);
+      src = dst;
+      n /= 2;
+    }
+    std::memmove(c.out.data(), c.out.data() + produced, pad_ * sizeof(float));
+  }
+}
+
+void Oversampler::reset() {
+  for (auto &c : state_) {
+    for (auto &stage : c.stages)
+      stage.reset();
+    std::fill(c.out.begin(), c.out.begin() + pad_, 0.0f);
+  }
+}
+
+} // namespace dsp
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dsp {
+
+/// One 2x stage of linear-phase half-band FIR filtering for one channel.
+///
+/// Every other tap of a half-band filter is zero apart from the centre, so
+/// the filter splits into two polyphase branches: a 2 * half_taps FIR and
+/// a pure delay. Each branch runs at the low rate. The FIR loops run over
+/// frames per tap, which vectorizes without reassociating sums.
+class HalfBand {
+public:
+  /// half_taps: nonzero taps per side (16 gives a 63-tap filter).
+  /// max_frames: largest block at the low rate.
+  HalfBand(size_t half_taps, size_t max_frames);
+
+  /// frames samples -> 2 * frames samples
+  void upsample(const float *in, float *out, size_t frames);
+
+  /// 2 * frames samples -> frames samples
+  void downsample(const float *in, float *out, size_t frames);
+
+  void reset();
+
+  /// Delay of an upsample + downsample round trip, in low-rate samples
+  double latency() const { return static_cast<double>(taps_) - 1.0; }
+
+private:
+  /// acc_[n] = sum_i coeffs_[i] * buf[taps_ - 1 + n - i], then drops the
+  /// consumed samples from the front of buf, keeping taps_ - 1 of history
+  void fir(std::vector<float> &buf, size_t frames);
+
+  size_t half_;
+  size_t taps_;                  // 2 * half_: taps of the FIR branch
+  std::vector<float> coeffs_;
+  std::vector<float> up_;        // taps_ - 1 history + max_frames input
+  std::vector<float> even_;      // taps_ - 1 history + even input samples
+  std::vector<float> odd_;       // half_ history + odd input samples
+  std::vector<float> acc_;
+};
+
+/// Runs a DSP block at 2x, 4x or 8x the host rate with cascaded half-band
+/// stages. The first stage is the steepest; later ones only need to remove
+/// images above the previous stage's band, so they get shorter filters.
+///
+/// All buffers are allocated in the constructor. upsample(), output() and
+/// downsample() never allocate or lock.
+class Oversampler {
+public:
+  /// factor: 2, 4 or 8. max_frames: largest host block.
+  Oversampler(int factor, size_t channels, size_t max_frames);
+
+  int factor() const { return factor_; }
+  size_t channels() const { return channels_; }
+  size_t max_frames() const { return max_frames_; }
+
+  /// Added latency in host samples
+  uint32_t latency() const { return latency_for(factor_); }
+  static uint32_t latency_for(int factor);
+
+  /// Upsamples frames host samples per channel; returns the factor * frames
+  /// input for the DSP. channels may not exceed the constructor's count.
+  const float *const *upsample(const float *const *in, size_t channels,
+                               size_t frames);
+
+  /// Buffers the DSP writes its factor * frames output into
+  float *const *output() { return out_ptrs_.data(); }
+
+  /// Filters output() back down to frames host samples per channel
+  void downsample(float *const *out, size_t channels, size_t frames);
+
+  void reset();
+
+private:
+  struct Channel {
+    std::vector<HalfBand> stages;
+    std::vector<float> up;       // factor * max_frames, DSP input
+    std::vector<float> out;      // pad_ history + factor * max_frames
+    std::vector<float> scratch;  // intermediate rates
+  };
+
+  int factor_;
+  size_t channels_;
+  size_t max_frames_;
+  size_t pad_ = 0;  // extra delay at the oversampled rate
+  std::vector<Channel> state_;
+  std::vector<const float *> up_ptrs_;
+  std::vector<float *> out_ptrs_;
+};
+
+} // namespace dsp
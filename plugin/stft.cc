@@ -0,0 +1,90 @@
+#include "stft.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dsp {
+
+Stft::Stft(size_t size, size_t channels)
+    : size_(size), hop_(size / 4), fft_(size), window_(size), time_(size),
+      re_(fft_.bins()), im_(fft_.bins()), bins_(2 * fft_.bins()),
+      state_(channels) {
+  // Periodic Hann, used for analysis and synthesis. The squared windows
+  // overlapping any one sample sum to the same constant (1.5 at 75%).
+  double sum = 0.0;
+  for (size_t n = 0; n < size_; ++n) {
+    window_[n] = static_cast<float>(
+        0.5 - 0.5 * std::cos(2.0 * M_PI * static_cast<double>(n) / size_));
+    if (n % hop_ == 0)
+      sum += static_cast<double>(window_[n]) * window_[n];
+  }
+  ola_gain_ = static_cast<float>(1.0 / sum);
+
+  for (auto &c : state_) {
+    c.input.resize(size_);
+    c.output.resize(hop_);
+    c.acc.resize(size_);
+  }
+}
+
+void Stft::reset() {
+  for (auto &c : state_) {
+    std::fill(c.input.begin(), c.input.end(), 0.0f);
+    std::fill(c.output.begin(), c.output.end(), 0.0f);
+    std::fill(c.acc.begin(), c.acc.end(), 0.0f);
+  }
+  fill_ = 0;
+}
+
+void Stft::process(const float *const *in, float *const *out, size_t channels,
+                   size_t frames, SpectrumFn fn) {
+  channels = std::min(channels, state_.size());
+  size_t offset = 0;
+  while (offset < frames) {
+    size_t n = std::min(hop_ - fill_, frames - offset);
+    for (size_t ch = 0; ch < channels; ++ch) {
+      Channel &c = state_[ch];
+      // Read the input before writing: in and out may be the same buffer
+      std::copy_n(in[ch] + offset, n, c.input.begin() + (size_ - hop_ + fill_));
+      std::copy_n(c.output.begin() + fill_, n, out[ch] + offset);
+    }
+    fill_ += n;
+    offset += n;
+
+    if (fill_ == hop_) {
+      for (size_t ch = 0; ch < channels; ++ch)
+        process_frame(state_[ch], static_cast<int>(ch), fn);
+      fill_ = 0;
+    }
+  }
+}
+
+void Stft::process_frame(Channel &c, int channel, SpectrumFn fn) {
+  const size_t bins = fft_.bins();
+
+  for (size_t n = 0; n < size_; ++n)
+    time_[n] = c.input[n] * window_[n];
+  fft_.forward(time_.data(), re_.data(), im_.data());
+
+  for (size_t k = 0; k < bins; ++k) {
+    bins_[2 * k] = re_[k];
+    bins_[2 * k + 1] = im_[k];
+  }
+  fn(bins_.data(), static_cast<int>(bins), channel);
+  for (size_t k = 0; k < bins; ++k) {
+    re_[k] = bins_[2 * k];
+    im_[k] = bins_[2 * k + 1];
+  }
+
+  fft_.inverse(re_.data(), im_.data(), time_.data());
+  for (size_t n = 0; n < size_; ++n)
+    c.acc[n] += time_[n] * window_[n] * ola_gain_;
+
+  // The oldest hop has all its overlaps now; play it during the next hop
+  std::copy_n(c.acc.begin(), hop_, c.output.begin());
+  std::copy(c.acc.begin() + hop_, c.acc.end(), c.acc.begin());
+  std::fill(c.acc.end() - hop_, c.acc.end(), 0.0f);
+  std::copy(c.input.begin() + hop_, c.input.end(), c.input.begin());
+}
+
+} // namespace dsp
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "fft.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace dsp {
+
+/// Short-time Fourier transform with overlap-add resynthesis around a
+/// bin-domain callback.
+///
+/// Frames of size() samples are taken every hop() = size() / 4 samples,
+/// Hann-windowed, transformed, handed to the callback as interleaved
+/// (re, im) pairs, transformed back and overlap-added with the same
+/// window. Every hop costs one forward and one inverse FFT per channel.
+/// Output is delayed by size() samples. All buffers are allocated in the
+/// constructor; process() does not allocate or lock.
+class Stft {
+public:
+  using SpectrumFn = void (*)(float *bins, int num_bins, int channel);
+
+  /// size must be a power of two, at least 16
+  Stft(size_t size, size_t channels);
+
+  size_t size() const { return size_; }
+  size_t hop() const { return hop_; }
+  size_t bins() const { return fft_.bins(); }
+  size_t latency() const { return size_; }
+
+  /// in and out may alias. channels may not exceed the constructor's count.
+  void process(const float *const *in, float *const *out, size_t channels,
+               size_t frames, SpectrumFn fn);
+
+  void reset();
+
+private:
+  struct Channel {
+    std::vector<float> input;   // size_: last frame, newest hop at the end
+    std::vector<float> output;  // hop_ samples being played
+    std::vector<float> acc;     // size_: overlap-add accumulator
+  };
+
+  void process_frame(Channel &c, int channel, SpectrumFn fn);
+
+  size_t size_;
+  size_t hop_;
+  RealFFT fft_;
+  std::vector<float> window_;
+  float ola_gain_;  // 1 / sum of squared windows over one hop
+  std::vector<float> time_, re_, im_, bins_;
+  std::vector<Channel> state_;
+  size_t fill_ = 0;  // samples of the current hop, same for all channels
+};
+
+} // namespace dsp
@@ -0,0 +1,111 @@
+#include "voices.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace dsp {
+
+bool VoicePool::note_on(int32_t note_id, int16_t port, int16_t channel,
+                        int16_t key, float velocity, Ended *stolen) {
+  bool stole = false;
+  if (count_ == RTCLAP_MAX_VOICES) {
+    // Prefer the oldest voice that is already fading out
+    uint32_t victim = 0;
+    for (uint32_t i = 1; i < count_; ++i) {
+      bool released = voices_.gate[i] == 0.0f;
+      bool victim_released = voices_.gate[victim] == 0.0f;
+      if (released != victim_released ? released
+                                      : voices_.age[i] > voices_.age[victim])
+        victim = i;
+    }
+    if (stolen)
+      *stolen = ended(victim);
+    remove(victim);
+    stole = true;
+  }
+
+  uint32_t i = count_++;
+  voices_.key[i] = key;
+  voices_.freq[i] = 440.0f * std::exp2((key - 69) / 12.0f);
+  voices_.velocity[i] = velocity;
+  voices_.gate[i] = 1.0f;
+  voices_.age[i] = 0;
+  voices_.done[i] = 0;
+  for (auto &slot : voices_.state)
+    slot[i] = 0.0f;
+  voices_.note_id[i] = note_id;
+  voices_.channel[i] = channel;
+  voices_.port[i] = port;
+  for (auto &slot : voices_.mod)
+    slot[i] = 0.0f;
+  return stole;
+}
+
+void VoicePool::note_off(int32_t note_id, int16_t port, int16_t channel,
+                         int16_t key) {
+  for (uint32_t i = 0; i < count_; ++i) {
+    if (matches(i, note_id, port, channel, key))
+      voices_.gate[i] = 0.0f;
+  }
+}
+
+void VoicePool::modulate(int32_t note_id, int16_t port, int16_t channel,
+                         int16_t key, uint32_t param, float amount) {
+  if (param >= RTCLAP_VOICE_PARAMS)
+    return;
+  for (uint32_t i = 0; i < count_; ++i) {
+    if (matches(i, note_id, port, channel, key))
+      voices_.mod[param][i] = amount;
+  }
+}
+
+void VoicePool::remap_mod(const int8_t *from) {
+  float old[RTCLAP_VOICE_PARAMS][RTCLAP_MAX_VOICES];
+  std::memcpy(old, voices_.mod, sizeof(old));
+  for (uint32_t p = 0; p < RTCLAP_VOICE_PARAMS; ++p) {
+    for (uint32_t i = 0; i < count_; ++i)
+      voices_.mod[p][i] = from[p] >= 0 ? old[from[p]][i] : 0.0f;
+  }
+}
+
+void VoicePool::clear_state() {
+  for (uint32_t i = 0; i < count_; ++i) {
+    voices_.done[i] = 0;
+    for (auto &slot : voices_.state)
+      slot[i] = 0.0f;
+  }
+}
+
+bool VoicePool::matches(uint32_t i, int32_t note_id, int16_t port,
+                        int16_t channel, int16_t key) const {
+  return (note_id < 0 || voices_.note_id[i] == note_id) &&
+         (port < 0 || voices_.port[i] == port) &&
+         (channel < 0 || voices_.channel[i] == channel) &&
+         (key < 0 || static_cast<int16_t>(voices_.key[i]) == key);
+}
+
+VoicePool::Ended VoicePool::ended(uint32_t i) const {
+  return {voices_.note_id[i], voices_.port[i], voices_.channel[i],
+          static_cast<int16_t>(voices_.key[i])};
+}
+
+void VoicePool::remove(uint32_t i) {
+  uint32_t last = --count_;
+  if (i == last)
+    return;
+  voices_.key[i] = voices_.key[last];
+  voices_.freq[i] = voices_.freq[last];
+  voices_.velocity[i] = voices_.velocity[last];
+  voices_.gate[i] = voices_.gate[last];
+  voices_.age[i] = voices_.age[last];
+  voices_.done[i] = voices_.done[last];
+  for (auto &slot : voices_.state)
+    slot[i] = slot[last];
+  voices_.note_id[i] = voices_.note_id[last];
+  voices_.channel[i] = voices_.channel[last];
+  voices_.port[i] = voices_.port[last];
+  for (auto &slot : voices_.mod)
+    slot[i] = slot[last];
+}
+
+} // namespace dsp
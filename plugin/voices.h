@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+
+// Voice pool shared with JIT code (see examples/lib/rtclap/voices.h; the
+// layouts must match)
+extern "C" {
+
+enum {
+  RTCLAP_MAX_VOICES = 32,  // Fixed polyphony
+  RTCLAP_VOICE_STATE = 16,  // DSP-owned floats per voice
+  RTCLAP_VOICE_PARAMS = 16  // Params with per-voice modulation
+};
+
+/// Structure of arrays: field[i] belongs to voice i. Active voices are
+/// packed into slots [0, count) so loops over voices vectorize.
+struct alignas(64) rtclap_voices {
+  float key[RTCLAP_MAX_VOICES];       // MIDI key
+  float freq[RTCLAP_MAX_VOICES];      // Hz, equal temperament
+  float velocity[RTCLAP_MAX_VOICES];  // 0..1
+  float gate[RTCLAP_MAX_VOICES];      // 1 while held, 0 once released
+  uint32_t age[RTCLAP_MAX_VOICES];    // Samples since note on
+  int32_t done[RTCLAP_MAX_VOICES];    // Set by the DSP when the tail ended
+  float state[RTCLAP_VOICE_STATE][RTCLAP_MAX_VOICES];  // Zeroed on note on
+
+  // Host identity of each voice, for note-end events
+  int32_t note_id[RTCLAP_MAX_VOICES];
+  int16_t channel[RTCLAP_MAX_VOICES];
+  int16_t port[RTCLAP_MAX_VOICES];
+
+  // Polyphonic modulation: offset of g_params[p] for this voice, from
+  // note-targeted host modulation. Zeroed on note on.
+  float mod[RTCLAP_VOICE_PARAMS][RTCLAP_MAX_VOICES];
+};
+}
+
+namespace dsp {
+
+/// Allocates voices in an rtclap_voices pool. Nothing here allocates
+/// memory; everything runs on the audio thread.
+class VoicePool {
+public:
+  /// A voice that stopped: finished, choked or stolen
+  struct Ended {
+    int32_t note_id;
+    int16_t port;
+    int16_t channel;
+    int16_t key;
+  };
+
+  rtclap_voices *voices() { return &voices_; }
+  uint32_t count() const { return count_; }
+
+  /// Starts a voice. With every slot busy, the oldest released voice (or
+  /// the oldest held one) is stolen and reported in stolen.
+  bool note_on(int32_t note_id, int16_t port, int16_t channel, int16_t key,
+               float velocity, Ended *stolen);
+
+  /// Releases matching held voices; -1 matches anything
+  void note_off(int32_t note_id, int16_t port, int16_t channel, int16_t key);
+
+  /// Removes matching voices immediately; -1 matches anything
+  template <typename OnEnd>
+  void choke(int32_t note_id, int16_t port, int16_t channel, int16_t key,
+             OnEnd &&on_end) {
+    for (uint32_t i = count_; i-- > 0;) {
+      if (matches(i, note_id, port, channel, key)) {
+        on_end(ended(i));
+        remove(i);
+      }
+    }
+  }
+
+  /// Ages voices after a render and removes those the DSP marked done
+  template <typename OnEnd> void finish_render(uint32_t frames, OnEnd &&on_end) {
+    for (uint32_t i = count_; i-- > 0;) {
+      voices_.age[i] += frames;
+      if (voices_.done[i]) {
+        on_end(ended(i));
+        remove(i);
+      }
+    }
+  }
+
+  /// Sets the modulation of `param` for matching voices; -1 matches
+  /// anything
+  void modulate(int32_t note_id, int16_t port, int16_t channel, int16_t key,
+                uint32_t param, float amount);
+
+  /// Moves per-voice modulation to a new param layout: param p keeps that
+  /// of param from[p], or none if from[p] is negative
+  void remap_mod(const int8_t *from);
+
+  /// Zeroes DSP-owned state but keeps the notes, e.g. after a reload
+  void clear_state();
+
+private:
+  bool matches(uint32_t i, int32_t note_id, int16_t port, int16_t channel,
+               int16_t key) const;
+  Ended ended(uint32_t i) const;
+
+  /// Moves the last active voice into slot i
+  void remove(uint32_t i);
+
+  rtclap_voices voices_{};
+  uint32_t count_ = 0;
+};
+
+} // namespace dsp
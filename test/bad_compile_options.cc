@@ -0,0 +1,4 @@
+// rtclap: -O2 -fplugin=evil.so
+extern "C" int never_compiled() {
+  return 0;
+}
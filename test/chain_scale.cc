@@ -0,0 +1,15 @@
+// Chain node: scales the input by its only parameter
+
+extern float g_params[];
+
+int param_count() { return 1; }
+
+const char *param_name(int) { return "amount"; }
+
+void process(const float *const *inputs, float *const *outputs,
+             unsigned int num_channels, unsigned int num_frames) {
+  for (unsigned int ch = 0; ch < num_channels; ++ch) {
+    for (unsigned int i = 0; i < num_frames; ++i)
+      outputs[ch][i] = inputs[ch][i] * g_params[0];
+  }
+}
@@ -0,0 +1,172 @@
+#include <clap/clap.h>
+#include <dlfcn.h>
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <filesystem>
+#include <vector>
+
+// Loads the built plugin (RTCLAP_PLUGIN_PATH) the way a host does. Its DSP
+// folder lives in a temporary HOME holding the examples
+// (RTCLAP_EXAMPLES_DIR), so local/gain.cc is selected on init.
+
+namespace {
+
+const void *host_get_extension(const clap_host_t *, const char *) { return nullptr; }
+void host_request(const clap_host_t *) {}
+
+const clap_host_t kHost = {
+    .clap_version = CLAP_VERSION,
+    .host_data = nullptr,
+    .name = "rt-clap test",
+    .vendor = "rt-clap",
+    .url = "",
+    .version = "1",
+    .get_extension = host_get_extension,
+    .request_restart = host_request,
+    .request_process = host_request,
+    .request_callback = host_request,
+};
+
+/// Input events of one process() or flush() call
+struct InputEvents {
+  std::vector<const clap_event_header_t *> events;
+  clap_input_events_t list{this, size, get};
+
+  static uint32_t size(const clap_input_events_t *list) {
+    return static_cast<uint32_t>(
+        static_cast<const InputEvents *>(list->ctx)->events.size());
+  }
+  static const clap_event_header_t *get(const clap_input_events_t *list,
+                                        uint32_t index) {
+    return static_cast<const InputEvents *>(list->ctx)->events[index];
+  }
+};
+
+bool discard_event(const clap_output_events_t *, const clap_event_header_t *) {
+  return true;
+}
+const clap_output_events_t kNoOutput = {nullptr, discard_event};
+
+clap_event_param_value_t param_value(clap_id id, double value) {
+  clap_event_param_value_t event{};
+  event.header = {sizeof(event), 0, CLAP_CORE_EVENT_SPACE_ID,
+                  CLAP_EVENT_PARAM_VALUE, 0};
+  event.param_id = id;
+  event.note_id = event.port_index = event.channel = event.key = -1;
+  event.value = value;
+  return event;
+}
+
+clap_event_param_mod_t param_mod(clap_id id, double amount) {
+  clap_event_param_mod_t event{};
+  event.header = {sizeof(event), 0, CLAP_CORE_EVENT_SPACE_ID,
+                  CLAP_EVENT_PARAM_MOD, 0};
+  event.param_id = id;
+  event.note_id = event.port_index = event.channel = event.key = -1;
+  event.amount = amount;
+  return event;
+}
+
+} // anonymous namespace
+
+class ClapPluginTest : public ::testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    home_ = std::filesystem::temp_directory_path() / "clap_plugin_test_home";
+    std::filesystem::remove_all(home_);
+    auto dsp_dir = home_ / ".local" / "share" / "rt-clap";
+    std::filesystem::create_directories(dsp_dir);
+    std::filesystem::copy(RTCLAP_EXAMPLES_DIR, dsp_dir,
+                          std::filesystem::copy_options::recursive);
+    setenv("HOME", home_.c_str(), 1);
+
+    void *module = dlopen(RTCLAP_PLUGIN_PATH, RTLD_NOW | RTLD_LOCAL);
+    ASSERT_NE(module, nullptr) << dlerror();
+    entry_ = static_cast<const clap_plugin_entry_t *>(dlsym(module, "clap_entry"));
+    ASSERT_NE(entry_, nullptr);
+    ASSERT_TRUE(entry_->init(RTCLAP_PLUGIN_PATH));
+    factory_ = static_cast<const clap_plugin_factory_t *>(
+        entry_->get_factory(CLAP_PLUGIN_FACTORY_ID));
+    ASSERT_NE(factory_, nullptr);
+  }
+
+  // The module stays loaded: LLVM's static destructors don't survive dlclose
+  static void TearDownTestSuite() {
+    if (entry_)
+      entry_->deinit();
+    std::filesystem::remove_all(home_);
+  }
+
+  const clap_plugin_t *create_effect() {
+    if (!factory_)
+      return nullptr;
+    auto *desc = factory_->get_plugin_descriptor(factory_, 0);
+    auto *plugin = factory_->create_plugin(factory_, &kHost, desc->id);
+    if (plugin && !plugin->init(plugin)) {
+      plugin->destroy(plugin);
+      return nullptr;
+    }
+    return plugin;
+  }
+
+  /// Runs one block of ones through the plugin; returns the last left sample
+  static float process_ones(const clap_plugin_t *plugin, InputEvents &events) {
+    constexpr uint32_t kFrames = 64;
+    std::vector<float> in(kFrames, 1.0f), out_l(kFrames), out_r(kFrames);
+    float *in_channels[2] = {in.data(), in.data()};
+    float *out_channels[2] = {out_l.data(), out_r.data()};
+    clap_audio_buffer_t input{in_channels, nullptr, 2, 0, 0};
+    clap_audio_buffer_t output{out_channels, nullptr, 2, 0, 0};
+    clap_process_t process{};
+    process.steady_time = -1;
+    process.frames_count = kFrames;
+    process.audio_inputs = &input;
+    process.audio_outputs = &output;
+    process.audio_inputs_count = 1;
+    process.audio_outputs_count = 1;
+    process.in_events = &events.list;
+    process.out_events = &kNoOutput;
+    EXPECT_EQ(plugin->process(plugin, &process), CLAP_PROCESS_CONTINUE);
+    return out_l[kFrames - 1];
+  }
+
+  static inline std::filesystem::path home_;
+  static inline const clap_plugin_entry_t *entry_ = nullptr;
+  static inline const clap_plugin_factory_t *factory_ = nullptr;
+};
+
+TEST_F(ClapPluginTest, RenderModeSwitchKeepsParams) {
+  auto *plugin = create_effect();
+  ASSERT_NE(plugin, nullptr);
+  auto *params = static_cast<const clap_plugin_params_t *>(
+      plugin->get_extension(plugin, CLAP_EXT_PARAMS));
+  auto *render = static_cast<const clap_plugin_render_t *>(
+      plugin->get_extension(plugin, CLAP_EXT_RENDER));
+  ASSERT_NE(params, nullptr);
+  ASSERT_NE(render, nullptr);
+  ASSERT_EQ(params->count(plugin), 1u);  // local/gain.cc: Gain
+
+  ASSERT_TRUE(plugin->activate(plugin, 48000.0, 1, 64));
+  ASSERT_TRUE(plugin->start_processing(plugin));
+
+  // Gain 0.5, modulated down by 0.25
+  auto gain = param_value(0, 0.5);
+  auto mod = param_mod(0, -0.25);
+  InputEvents events;
+  events.events = {&gain.header, &mod.header};
+  EXPECT_FLOAT_EQ(process_ones(plugin, events), 0.25f);
+
+  // Each rebuild takes over at the next block, which has no events
+  for (auto mode : {CLAP_RENDER_OFFLINE, CLAP_RENDER_REALTIME}) {
+    ASSERT_TRUE(render->set(plugin, mode));
+    double value = 0.0;
+    ASSERT_TRUE(params->get_value(plugin, 0, &value));
+    EXPECT_DOUBLE_EQ(value, 0.5) << "mode " << mode;
+    InputEvents none;
+    EXPECT_FLOAT_EQ(process_ones(plugin, none), 0.25f) << "mode " << mode;
+  }
+
+  plugin->stop_processing(plugin);
+  plugin->deactivate(plugin);
+  plugin->destroy(plugin);
+}
@@ -0,0 +1,6 @@
+// rtclap: -O2 -ffast-math
+// rtclap: -DSCALE=3
+// Per-file compile options test
+extern "C" int scaled(int x) {
+  return x * SCALE;
+}
@@ -0,0 +1,331 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "../plugin/batcher.h"
+#include "../plugin/convolver.h"
+#include "../plugin/fft.h"
+#include "../plugin/oversampler.h"
+#include "../plugin/stft.h"
+#include "../plugin/voices.h"
+
+// Plugin-side DSP building blocks. None of them needs the JIT or a host.
+
+namespace {
+
+std::vector<float> noise(size_t length, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<float> out(length);
+  for (auto &v : out)
+    v = dist(rng);
+  return out;
+}
+
+// process_wide() that copies input to output, scaled by the lane's param 0
+void scale_wide(const float *in, float *out, const float *params,
+                const float *, uint32_t lanes, uint32_t frames) {
+  for (uint32_t t = 0; t < frames; ++t) {
+    for (uint32_t l = 0; l < lanes; ++l)
+      out[t * lanes + l] = in[t * lanes + l] * params[l];
+  }
+}
+
+// One stereo plugin instance feeding a Batcher block by block
+struct BatchedInstance {
+  int lane = -1;
+  float params[dsp::Batcher::kParams] = {};
+  std::vector<float> in[2];
+  std::vector<float> out[2];
+
+  BatchedInstance(size_t length, unsigned seed, float gain) {
+    params[0] = gain;
+    for (int ch = 0; ch < 2; ++ch) {
+      in[ch] = noise(length, seed + ch);
+      out[ch].assign(length, -1.0f);
+    }
+  }
+
+  void process(dsp::Batcher &batcher, size_t offset, uint32_t frames) {
+    const float *inputs[2] = {in[0].data() + offset, in[1].data() + offset};
+    float *outputs[2] = {out[0].data() + offset, out[1].data() + offset};
+    batcher.process(scale_wide, lane, inputs, outputs, 2, frames, params);
+  }
+
+  // Output sample t should be input t - latency, times the gain
+  void expect_delayed(size_t begin, size_t end, uint32_t latency) const {
+    for (int ch = 0; ch < 2; ++ch) {
+      for (size_t t = begin; t < end; ++t) {
+        float expected = t >= latency ? in[ch][t - latency] * params[0] : 0.0f;
+        ASSERT_FLOAT_EQ(out[ch][t], expected) << "channel " << ch << " sample " << t;
+      }
+    }
+  }
+};
+
+} // anonymous namespace
+
+TEST(DspTest, BatcherMatchesDelayedInput) {
+  constexpr uint32_t kFrames = 64;
+  constexpr size_t kBlocks = 40;
+  dsp::Batcher batcher(kFrames);
+  ASSERT_EQ(batcher.latency(), kFrames);
+
+  BatchedInstance a(kFrames * kBlocks, 1, 1.0f);
+  BatchedInstance b(kFrames * kBlocks, 7, 0.5f);
+  a.lane = batcher.join(2);
+  b.lane = batcher.join(2);
+  ASSERT_GE(a.lane, 0);
+  ASSERT_GE(b.lane, 0);
+  EXPECT_NE(a.lane, b.lane);
+
+  for (size_t block = 0; block < kBlocks; ++block) {
+    a.process(batcher, block * kFrames, kFrames);
+    b.process(batcher, block * kFrames, kFrames);
+  }
+  a.expect_delayed(0, kFrames * kBlocks, batcher.latency());
+  b.expect_delayed(0, kFrames * kBlocks, batcher.latency());
+
+  batcher.leave(a.lane, 2);
+  batcher.leave(b.lane, 2);
+}
+
+TEST(DspTest, BatcherStalledLaneDoesNotStallOthers) {
+  constexpr uint32_t kFrames = 64;
+  constexpr size_t kBlocks = 40;
+  dsp::Batcher batcher(kFrames);
+
+  BatchedInstance a(kFrames * kBlocks, 3, 1.0f);
+  BatchedInstance b(kFrames * kBlocks, 5, 2.0f);
+  a.lane = batcher.join(2);
+  b.lane = batcher.join(2);
+
+  // b stops after 10 blocks, like a track the host stopped processing
+  for (size_t block = 0; block < kBlocks; ++block) {
+    a.process(batcher, block * kFrames, kFrames);
+    if (block < 10)
+      b.process(batcher, block * kFrames, kFrames);
+  }
+  a.expect_delayed(0, kFrames * kBlocks, batcher.latency());
+  b.expect_delayed(0, kFrames * 10, batcher.latency());
+}
+
+TEST(DspTest, BatcherHandlesShortBlocks) {
+  // Hosts may call with fewer frames than the maximum
+  constexpr uint32_t kMaxFrames = 128;
+  dsp::Batcher batcher(kMaxFrames);
+  BatchedInstance a(4096, 11, 0.25f);
+  BatchedInstance b(4096, 13, 4.0f);
+  a.lane = batcher.join(2);
+  b.lane = batcher.join(2);
+
+  const uint32_t sizes[] = {128, 17, 64, 1, 128, 99};
+  size_t offset = 0;
+  for (int i = 0; offset + kMaxFrames <= 4096; ++i) {
+    uint32_t frames = sizes[i % std::size(sizes)];
+    a.process(batcher, offset, frames);
+    b.process(batcher, offset, frames);
+    offset += frames;
+  }
+  a.expect_delayed(0, offset, batcher.latency());
+  b.expect_delayed(0, offset, batcher.latency());
+}
+
+TEST(DspTest, BatcherFull) {
+  dsp::Batcher batcher(64);
+  for (uint32_t i = 0; i < dsp::Batcher::kMaxLanes / 2; ++i)
+    EXPECT_GE(batcher.join(2), 0);
+  EXPECT_EQ(batcher.join(2), -1);
+  batcher.leave(0, 2);
+  EXPECT_EQ(batcher.join(2), 0);
+}
+
+TEST(DspTest, ConvolverMatchesDirectConvolution) {
+  constexpr size_t kBlock = 64;
+  auto ir = noise(300, 21);
+  auto in = noise(2000, 22);
+
+  auto spectrum = dsp::get_ir_spectrum(ir.data(), ir.size(), kBlock);
+  EXPECT_EQ(spectrum, dsp::get_ir_spectrum(ir.data(), ir.size(), kBlock));
+  dsp::Convolver conv(spectrum);
+  ASSERT_EQ(conv.latency(), kBlock);
+
+  // Uneven block sizes, as a host might send
+  std::vector<float> out(in.size());
+  for (size_t offset = 0, i = 0; offset < in.size(); ++i) {
+    size_t frames = std::min<size_t>(1 + (i * 37) % 100, in.size() - offset);
+    conv.process(in.data() + offset, out.data() + offset, frames);
+    offset += frames;
+  }
+
+  for (size_t t = 0; t < in.size(); ++t) {
+    double expected = 0.0;
+    if (t >= kBlock) {
+      for (size_t k = 0; k < ir.size() && k <= t - kBlock; ++k)
+        expected += ir[k] * in[t - kBlock - k];
+    }
+    ASSERT_NEAR(out[t], expected, 1e-3) << "sample " << t;
+  }
+}
+
+TEST(DspTest, OversamplerPassesBandLimitedSignal) {
+  constexpr size_t kFrames = 128;
+  constexpr size_t kLength = 4096;
+  std::vector<float> in(kLength);
+  for (size_t t = 0; t < kLength; ++t)
+    in[t] = 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 1000.0f * t / 48000.0f);
+
+  for (int factor : {2, 4, 8}) {
+    dsp::Oversampler os(factor, 1, kFrames);
+    EXPECT_EQ(os.latency(), dsp::Oversampler::latency_for(factor));
+
+    // Identity DSP at the high rate
+    std::vector<float> out(kLength);
+    for (size_t offset = 0; offset < kLength; offset += kFrames) {
+      const float *host_in[1] = {in.data() + offset};
+      float *host_out[1] = {out.data() + offset};
+      const float *const *up = os.upsample(host_in, 1, kFrames);
+      std::copy_n(up[0], factor * kFrames, os.output()[0]);
+      os.downsample(host_out, 1, kFrames);
+    }
+
+    const uint32_t latency = os.latency();
+    for (size_t t = 512; t < kLength; ++t)
+      ASSERT_NEAR(out[t], in[t - latency], 2e-3) << factor << "x sample " << t;
+  }
+}
+
+TEST(DspTest, RealFFTRoundTrip) {
+  for (size_t size : {4, 16, 256, 2048}) {
+    dsp::RealFFT fft(size);
+    auto in = noise(size, static_cast<unsigned>(size));
+    std::vector<float> re(fft.bins()), im(fft.bins()), out(size);
+    fft.forward(in.data(), re.data(), im.data());
+
+    // Against a direct DFT
+    for (size_t k = 0; k < fft.bins(); ++k) {
+      double sr = 0.0, si = 0.0;
+      for (size_t n = 0; n < size; ++n) {
+        double a = -2.0 * M_PI * static_cast<double>(k * n) / size;
+        sr += in[n] * std::cos(a);
+        si += in[n] * std::sin(a);
+      }
+      EXPECT_NEAR(re[k], sr, 1e-4 * std::sqrt(size)) << size << " bin " << k;
+      EXPECT_NEAR(im[k], si, 1e-4 * std::sqrt(size)) << size << " bin " << k;
+    }
+
+    fft.inverse(re.data(), im.data(), out.data());
+    for (size_t n = 0; n < size; ++n)
+      EXPECT_NEAR(out[n], in[n], 1e-5f) << size << " sample " << n;
+  }
+}
+
+namespace {
+void identity_spectrum(float *, int, int) {}
+} // anonymous namespace
+
+TEST(DspTest, StftIdentityIsDelay) {
+  constexpr size_t kSize = 256;
+  auto in = noise(4096, 31);
+  dsp::Stft stft(kSize, 1);
+  ASSERT_EQ(stft.latency(), kSize);
+
+  // In place, in uneven blocks
+  std::vector<float> buf = in;
+  for (size_t offset = 0, i = 0; offset < buf.size(); ++i) {
+    size_t frames = std::min<size_t>(1 + (i * 53) % 160, buf.size() - offset);
+    float *io[1] = {buf.data() + offset};
+    stft.process(io, io, 1, frames, identity_spectrum);
+    offset += frames;
+  }
+
+  // The first frame overlaps fewer windows, compare after it
+  for (size_t t = 2 * kSize; t < buf.size(); ++t)
+    ASSERT_NEAR(buf[t], in[t - kSize], 1e-4) << "sample " << t;
+}
+
+TEST(DspTest, VoicePoolStealsOldestReleased) {
+  dsp::VoicePool pool;
+  dsp::VoicePool::Ended stolen{};
+  for (int i = 0; i < RTCLAP_MAX_VOICES; ++i) {
+    EXPECT_FALSE(pool.note_on(i, 0, 0, static_cast<int16_t>(40 + i), 1.0f, &stolen));
+    pool.finish_render(1, [](const auto &) {});  // Older voices age more
+  }
+  EXPECT_EQ(pool.count(), static_cast<uint32_t>(RTCLAP_MAX_VOICES));
+  EXPECT_FLOAT_EQ(pool.voices()->freq[29], 440.0f);  // Key 69
+
+  // Released voices go first, even when younger than held ones
+  pool.note_off(-1, -1, -1, 50);
+  EXPECT_TRUE(pool.note_on(100, 0, 0, 90, 1.0f, &stolen));
+  EXPECT_EQ(stolen.key, 50);
+  EXPECT_EQ(stolen.note_id, 10);
+
+  // Otherwise the oldest held voice
+  EXPECT_TRUE(pool.note_on(101, 0, 0, 91, 1.0f, &stolen));
+  EXPECT_EQ(stolen.key, 40);
+  EXPECT_EQ(pool.count(), static_cast<uint32_t>(RTCLAP_MAX_VOICES));
+}
+
+TEST(DspTest, VoicePoolRemovesFinishedVoices) {
+  dsp::VoicePool pool;
+  pool.note_on(1, 0, 0, 60, 1.0f, nullptr);
+  pool.note_on(2, 0, 0, 64, 1.0f, nullptr);
+  pool.note_on(3, 0, 0, 67, 1.0f, nullptr);
+  pool.voices()->state[0][2] = 5.0f;
+
+  // The DSP marks the middle voice done; the last one moves into its slot
+  pool.voices()->done[1] = 1;
+  std::vector<int32_t> ended;
+  pool.finish_render(64, [&](const auto &e) { ended.push_back(e.note_id); });
+  ASSERT_EQ(ended, std::vector<int32_t>{2});
+  ASSERT_EQ(pool.count(), 2u);
+  EXPECT_EQ(pool.voices()->note_id[1], 3);
+  EXPECT_EQ(pool.voices()->age[1], 64u);
+  EXPECT_FLOAT_EQ(pool.voices()->state[0][1], 5.0f);
+
+  // Choke by key
+  pool.choke(-1, -1, -1, 60, [&](const auto &e) { ended.push_back(e.note_id); });
+  EXPECT_EQ(ended, (std::vector<int32_t>{2, 1}));
+  ASSERT_EQ(pool.count(), 1u);
+  EXPECT_EQ(pool.voices()->note_id[0], 3);
+}
+
+TEST(DspTest, VoicePoolModulatesMatchingVoices) {
+  dsp::VoicePool pool;
+  pool.note_on(1, 0, 0, 60, 1.0f, nullptr);
+  pool.note_on(2, 0, 0, 64, 1.0f, nullptr);
+  pool.note_on(3, 0, 1, 64, 1.0f, nullptr);
+  auto *v = pool.voices();
+
+  pool.modulate(2, -1, -1, -1, 0, 0.25f);  // By note ID
+  pool.modulate(-1, -1, -1, 64, 1, 0.5f);  // By key, both channels
+  EXPECT_EQ(v->mod[0][0], 0.0f);
+  EXPECT_EQ(v->mod[0][1], 0.25f);
+  EXPECT_EQ(v->mod[0][2], 0.0f);
+  EXPECT_EQ(v->mod[1][0], 0.0f);
+  EXPECT_EQ(v->mod[1][1], 0.5f);
+  EXPECT_EQ(v->mod[1][2], 0.5f);
+  pool.modulate(2, -1, -1, -1, RTCLAP_VOICE_PARAMS, 1.0f);  // Ignored
+
+  // Modulation moves with its voice and starts at zero for new notes
+  v->done[0] = 1;
+  pool.finish_render(1, [](const auto &) {});
+  EXPECT_EQ(v->note_id[0], 3);
+  EXPECT_EQ(v->mod[1][0], 0.5f);
+  pool.note_on(4, 0, 0, 64, 1.0f, nullptr);
+  EXPECT_EQ(v->mod[1][2], 0.0f);
+
+  // A rebuild swapping params 0 and 1 and adding an unmodulated param 2
+  int8_t from[RTCLAP_VOICE_PARAMS];
+  std::fill(std::begin(from), std::end(from), -1);
+  from[0] = 1;
+  from[1] = 0;
+  pool.remap_mod(from);
+  EXPECT_EQ(v->mod[0][0], 0.5f);
+  EXPECT_EQ(v->mod[1][1], 0.25f);
+  EXPECT_EQ(v->mod[0][1], 0.5f);
+  EXPECT_EQ(v->mod[2][0], 0.0f);
+}
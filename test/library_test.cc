@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../plugin/library.h"
+
+namespace {
+
+void write_file(const std::filesystem::path &path, const std::string &text) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path, std::ios::trunc) << text;
+}
+
+std::vector<std::string> paths(const library::Library &lib) {
+  std::vector<std::string> out;
+  for (const auto &e : lib.entries())
+    out.push_back(e.path);
+  return out;
+}
+
+std::vector<std::string> search_paths(const library::Library &lib,
+                                      std::string_view query) {
+  std::vector<int> indices;
+  library::search(lib, query, indices);
+  std::vector<std::string> out;
+  for (int i : indices)
+    out.push_back(lib.entries()[i].path);
+  return out;
+}
+
+} // anonymous namespace
+
+TEST(LibraryTest, IndexRoundTrip) {
+  auto dir = std::filesystem::temp_directory_path() / "clap_library_test_index";
+  std::filesystem::remove_all(dir);
+  write_file(dir / "local/gain.cc", "// tags: Utility, level\n");
+  write_file(dir / "@alice/fuzz.cc", "// tags: distortion\n");
+  write_file(dir / "@alice/notes.txt", "not a DSP\n");
+
+  library::Library lib;
+  lib.load(dir / "library.index");
+  EXPECT_TRUE(lib.empty());
+  EXPECT_TRUE(lib.refresh(dir));
+  EXPECT_FALSE(lib.refresh(dir));
+  EXPECT_EQ(paths(lib), (std::vector<std::string>{"@alice/fuzz.cc", "local/gain.cc"}));
+
+  lib.record_compile("local/gain.cc", true, "", {"gain", "pan"}, "abc123");
+  lib.record_compile("@alice/fuzz.cc", false, "error: oops\nmore detail", {}, "");
+  lib.save();
+
+  library::Library loaded;
+  loaded.load(dir / "library.index");
+  ASSERT_EQ(paths(loaded), paths(lib));
+  const auto &gain = loaded.entries()[loaded.find("local/gain.cc")];
+  EXPECT_EQ(gain.tags, (std::vector<std::string>{"utility", "level"}));
+  EXPECT_EQ(gain.param_names, (std::vector<std::string>{"gain", "pan"}));
+  EXPECT_EQ(gain.cache_key, "abc123");
+  EXPECT_EQ(gain.status, library::CompileStatus::Ok);
+  EXPECT_EQ(gain.mtime, lib.entries()[lib.find("local/gain.cc")].mtime);
+  const auto &fuzz = loaded.entries()[loaded.find("@alice/fuzz.cc")];
+  EXPECT_EQ(fuzz.status, library::CompileStatus::Failed);
+  EXPECT_EQ(fuzz.error, "error: oops");
+
+  // Nothing changed on disk since the index was written
+  EXPECT_FALSE(loaded.refresh(dir));
+
+  // An index from another version is ignored
+  write_file(dir / "library.index", "rt-clap-library 0\nlocal/gain.cc\t1\n");
+  loaded.load(dir / "library.index");
+  EXPECT_TRUE(loaded.empty());
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(LibraryTest, RefreshAddsRemovesAndEdits) {
+  auto dir = std::filesystem::temp_directory_path() / "clap_library_test_refresh";
+  std::filesystem::remove_all(dir);
+  write_file(dir / "local/gain.cc", "");
+  write_file(dir / "local/delay.cc", "");
+  write_file(dir / "@bob/chorus.expr", "");
+
+  library::Library lib;
+  lib.load(dir / "library.index");
+  ASSERT_TRUE(lib.refresh(dir));
+  ASSERT_EQ(lib.entries().size(), 3u);
+
+  // New file and new folder
+  write_file(dir / "local/comp.cc", "");
+  write_file(dir / "@carol/reverb.chain", "");
+  EXPECT_TRUE(lib.refresh(dir));
+  EXPECT_GE(lib.find("local/comp.cc"), 0);
+  EXPECT_GE(lib.find("@carol/reverb.chain"), 0);
+
+  // Removed file and removed folder
+  std::filesystem::remove(dir / "local/delay.cc");
+  std::filesystem::remove_all(dir / "@bob");
+  EXPECT_TRUE(lib.refresh(dir));
+  EXPECT_EQ(paths(lib), (std::vector<std::string>{"@carol/reverb.chain", "local/comp.cc",
+                                                  "local/gain.cc"}));
+
+  // In-place edit of a compiled file: its folder's mtime stays the same
+  lib.record_compile("local/gain.cc", true, "", {"gain"}, "key");
+  auto folder_time = std::filesystem::last_write_time(dir / "local");
+  auto file_time = std::filesystem::last_write_time(dir / "local/gain.cc");
+  write_file(dir / "local/gain.cc", "// tags: mixing\n");
+  std::filesystem::last_write_time(dir / "local/gain.cc",
+                                   file_time + std::chrono::seconds(2));
+  std::filesystem::last_write_time(dir / "local", folder_time);
+  EXPECT_TRUE(lib.refresh(dir));
+  const auto &gain = lib.entries()[lib.find("local/gain.cc")];
+  EXPECT_EQ(gain.tags, std::vector<std::string>{"mixing"});
+  EXPECT_EQ(gain.status, library::CompileStatus::Unknown);
+  EXPECT_FALSE(lib.refresh(dir));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(LibraryTest, FuzzyScore) {
+  EXPECT_FALSE(library::fuzzy_score("xyz", "local/gain.cc"));
+  EXPECT_FALSE(library::fuzzy_score("niag", "local/gain.cc"));
+  EXPECT_TRUE(library::fuzzy_score("gain", "local/gain.cc"));
+  EXPECT_TRUE(library::fuzzy_score("GAIN", "local/gain.cc"));
+
+  // Consecutive and word-boundary matches beat scattered ones
+  EXPECT_GT(*library::fuzzy_score("gain", "local/gain.cc"),
+            *library::fuzzy_score("gain", "local/granular_chain.cc"));
+
+  // Widely scattered matches in a long path score below zero but still match
+  std::string text = "a" + std::string(40, 'x') + "b" + std::string(40, 'x') + "c" +
+                     std::string(40, 'x') + "d" + std::string(200, 'x');
+  auto score = library::fuzzy_score("abcd", text);
+  ASSERT_TRUE(score);
+  EXPECT_LT(*score, 0);
+}
+
+TEST(LibraryTest, SearchRanksBestMatchFirst) {
+  auto dir = std::filesystem::temp_directory_path() / "clap_library_test_search";
+  std::filesystem::remove_all(dir);
+  write_file(dir / "local/gain.cc", "");
+  write_file(dir / "local/granular_chain.cc", "");
+  write_file(dir / "local/delay.cc", "// tags: echo\n");
+  // Matches with a negative score
+  std::string scattered = "@dave/g" + std::string(40, 'x') + "a" + std::string(40, 'x') +
+                          "i" + std::string(40, 'x') + "n" + std::string(100, 'x') + ".cc";
+  write_file(dir / scattered, "");
+
+  library::Library lib;
+  lib.load(dir / "library.index");
+  lib.refresh(dir);
+
+  // An empty query lists everything in path order
+  EXPECT_EQ(search_paths(lib, "  "), paths(lib));
+
+  auto results = search_paths(lib, "gain");
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(results[0], "local/gain.cc");
+  EXPECT_EQ(results[1], "local/granular_chain.cc");
+  EXPECT_EQ(results[2], scattered);
+
+  // Tags are searchable
+  EXPECT_EQ(search_paths(lib, "echo"), std::vector<std::string>{"local/delay.cc"});
+  EXPECT_TRUE(search_paths(lib, "zzz").empty());
+
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../plugin/memory.h"
+
+TEST(MemoryTest, FreeRefundsTheChargedCounter) {
+  memory::Account a, b;
+  void *ptr = nullptr;
+  {
+    memory::Scope scope(&a.dsp_heap);
+    ptr = memory::charged_malloc(1000);
+  }
+  EXPECT_GE(a.dsp_heap.load(), 1000);
+
+  // Freed elsewhere, under another account's scope
+  {
+    memory::Scope scope(&b.dsp_heap);
+    memory::charged_free(ptr);
+  }
+  EXPECT_EQ(a.dsp_heap.load(), 0);
+  EXPECT_EQ(b.dsp_heap.load(), 0);
+
+  // Memory allocated outside any scope refunds nothing
+  ptr = memory::charged_malloc(1000);
+  {
+    memory::Scope scope(&a.dsp_heap);
+    memory::charged_free(ptr);
+  }
+  EXPECT_EQ(a.dsp_heap.load(), 0);
+}
+
+TEST(MemoryTest, ForgottenChargesRefundNothing) {
+  void *ptr = nullptr;
+  {
+    memory::Account a;
+    memory::Scope scope(&a.gui_heap);
+    ptr = memory::charged_malloc(64);
+    EXPECT_GT(a.gui_heap.load(), 0);
+  }
+  // a is gone; freeing must not touch its counter
+  memory::charged_free(ptr);
+}
+
+TEST(MemoryTest, ConcurrentChargesAndFrees) {
+  // Each thread charges its own counter and frees half of the memory on
+  // the other thread, as the audio thread frees what init() allocated
+  memory::Account accounts[2];
+  std::vector<void *> handoff[2];
+  auto work = [&](int t) {
+    memory::Scope scope(&accounts[t].dsp_heap);
+    std::vector<void *> mine;
+    for (int i = 0; i < 20000; ++i) {
+      void *ptr = memory::charged_malloc(16 + i % 200);
+      (i % 2 ? mine : handoff[t]).push_back(ptr);
+      if (mine.size() > 100) {
+        for (void *p : mine)
+          memory::charged_free(p);
+        mine.clear();
+      }
+    }
+    for (void *p : mine)
+      memory::charged_free(p);
+  };
+  std::thread first(work, 0), second(work, 1);
+  first.join();
+  second.join();
+
+  std::thread freer([&] {
+    for (auto &list : handoff) {
+      for (void *p : list)
+        memory::charged_free(p);
+    }
+  });
+  freer.join();
+  EXPECT_EQ(accounts[0].dsp_heap.load(), 0);
+  EXPECT_EQ(accounts[1].dsp_heap.load(), 0);
+}
@@ -0,0 +1,18 @@
+// rtclap: -O2
+#include "rtclap/rtclap.h"
+
+float runtime_tanh(float x) { return rtclap::fast_tanh(x); }
+
+float runtime_exp(float x) { return rtclap::fast_exp(x); }
+
+// Writes 1..8 in two blocks and reads the first block back
+float runtime_delay_sum() {
+  static rtclap::DelayLine<8> line;
+  float in[4] = {1, 2, 3, 4}, out[4];
+  line.write_block(in, 4);
+  for (auto &x : in)
+    x += 4;
+  line.write_block(in, 4);
+  line.read_block(out, 4, 8);
+  return out[0] + out[1] + out[2] + out[3];
+}
@@ -1,8 +1,18 @@
 #include <gtest/gtest.h>
 #include <llvm/Support/Error.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
 
+#include <unistd.h>
+
+#include "../jit/Expr.h"
 #include "../jit/JIT.h"
+#include "../jit/SlabMemory.h"
 
 class ClapJITTest : public ::testing::Test {
 protected:
@@ -223,6 +233,223 @@ TEST_F(ClapJITTest, CxxFunctionsWithoutExternC) {
   EXPECT_FLOAT_EQ(GetGain(), 1.0f);
 }
 
+TEST_F(ClapJITTest, PerFileCompileOptions) {
+  auto JITOrErr = clap_rt::ClapJIT::create();
+  ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+  auto JIT = std::move(*JITOrErr);
+
+  // Directives define SCALE and enable -O2 -ffast-math
+  auto Err = JIT.addModule("test/compile_options.cc");
+  ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+  auto ScaledOrErr = JIT.lookupAs<int(int)>("scaled");
+  ASSERT_TRUE(!!ScaledOrErr) << llvm::toString(ScaledOrErr.takeError());
+  EXPECT_EQ((*ScaledOrErr)(7), 21);
+}
+
+TEST_F(ClapJITTest, RejectsDisallowedCompileOption) {
+  auto JITOrErr = clap_rt::ClapJIT::create();
+  ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+  auto JIT = std::move(*JITOrErr);
+
+  auto Err = JIT.addModule("test/bad_compile_options.cc");
+  ASSERT_TRUE(!!Err);
+  EXPECT_NE(llvm::toString(std::move(Err)).find("-fplugin"), std::string::npos);
+}
+
+TEST_F(ClapJITTest, ModuleFromBuffer) {
+  auto dir = std::filesystem::temp_directory_path() / "clap_jit_test_buffer";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::ofstream(dir / "scale.h") << "constexpr int kScale = 3;\n";
+
+  clap_rt::JITOptions opts;
+  opts.sourceCache = llvm::makeIntrusiveRefCnt<clap_rt::SourceCache>();
+
+  // Quoted includes resolve next to the buffer's name; directives apply
+  const char *source = "// rtclap: -O2 -DOFFSET=1\n"
+                       "#include \"scale.h\"\n"
+                       "int scaled(int x) { return x * kScale + OFFSET; }\n";
+  auto compile = [&]() -> int {
+    auto JITOrErr = clap_rt::ClapJIT::create(opts);
+    EXPECT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+    auto Err = JIT.addModuleFromBuffer((dir / "scaled.cc").string(), source);
+    EXPECT_FALSE(!!Err) << llvm::toString(std::move(Err));
+    auto ScaledOrErr = JIT.lookupAs<int(int)>("scaled");
+    EXPECT_TRUE(!!ScaledOrErr) << llvm::toString(ScaledOrErr.takeError());
+    return ScaledOrErr ? (*ScaledOrErr)(7) : -1;
+  };
+  EXPECT_EQ(compile(), 22);
+  EXPECT_FALSE(std::filesystem::exists(dir / "scaled.cc"));
+
+  // The cache keeps serving the header until it is invalidated
+  std::ofstream(dir / "scale.h") << "constexpr int kScale = 5;\n";
+  EXPECT_EQ(compile(), 22);
+  opts.sourceCache->invalidate(dir.string());
+  EXPECT_EQ(compile(), 36);
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_F(ClapJITTest, ExprModule) {
+  auto JITOrErr = clap_rt::ClapJIT::create();
+  ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+  auto JIT = std::move(*JITOrErr);
+
+  static float params[16] = {2.0f, 0.5f};
+  auto DefErr = JIT.defineSymbol("g_params", params);
+  ASSERT_FALSE(!!DefErr) << llvm::toString(std::move(DefErr));
+
+  auto Err = JIT.addModule("test/gain.expr");
+  ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+  auto CountOrErr = JIT.lookupAs<int()>("param_count");
+  ASSERT_TRUE(!!CountOrErr) << llvm::toString(CountOrErr.takeError());
+  EXPECT_EQ((*CountOrErr)(), 2);
+
+  auto NameOrErr = JIT.lookupAs<const char *(int)>("param_name");
+  ASSERT_TRUE(!!NameOrErr) << llvm::toString(NameOrErr.takeError());
+  EXPECT_STREQ((*NameOrErr)(1), "offset");
+  EXPECT_STREQ((*NameOrErr)(5), "?");
+
+  auto MinOrErr = JIT.lookupAs<float(int)>("param_min");
+  ASSERT_TRUE(!!MinOrErr) << llvm::toString(MinOrErr.takeError());
+  EXPECT_FLOAT_EQ((*MinOrErr)(1), -1.0f);
+
+  auto ProcessOrErr = JIT.lookupAs<void(const float *const *, float *const *,
+                                        uint32_t, uint32_t)>("process");
+  ASSERT_TRUE(!!ProcessOrErr) << llvm::toString(ProcessOrErr.takeError());
+
+  // 11 frames covers one vector iteration plus the scalar tail
+  float in0[11], in1[11], out0[11], out1[11];
+  for (int i = 0; i < 11; ++i) {
+    in0[i] = static_cast<float>(i) * 0.25f;
+    in1[i] = static_cast<float>(i);
+  }
+  const float *ins[2] = {in0, in1};
+  float *outs[2] = {out0, out1};
+  (*ProcessOrErr)(ins, outs, 2, 11);
+
+  for (int i = 0; i < 11; ++i) {
+    EXPECT_FLOAT_EQ(out0[i], std::min(in0[i] * 2.0f + 0.5f, 4.0f));
+    EXPECT_FLOAT_EQ(out1[i], std::min(in1[i] * 2.0f + 1.0f, 4.0f));
+  }
+}
+
+TEST_F(ClapJITTest, ExprWideLanes) {
+  auto JITOrErr = clap_rt::ClapJIT::create();
+  ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+  auto JIT = std::move(*JITOrErr);
+
+  static float params[16] = {};
+  auto DefErr = JIT.defineSymbol("g_params", params);
+  ASSERT_FALSE(!!DefErr) << llvm::toString(std::move(DefErr));
+
+  auto Err = JIT.addModule("test/gain.expr");
+  ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+  auto WideOrErr = JIT.lookupAs<void(const float *, float *, const float *,
+                                     const float *, uint32_t, uint32_t)>(
+      "process_wide");
+  ASSERT_TRUE(!!WideOrErr) << llvm::toString(WideOrErr.takeError());
+
+  // 16 lanes (two vectors), each with its own gain, offset and channel
+  constexpr uint32_t kLanes = 16, kFrames = 5;
+  float lane_params[16 * kLanes] = {};
+  float channels[kLanes];
+  for (uint32_t l = 0; l < kLanes; ++l) {
+    lane_params[0 * kLanes + l] = 0.1f * static_cast<float>(l);
+    lane_params[1 * kLanes + l] = l % 2 ? 0.5f : -0.25f;
+    channels[l] = static_cast<float>(l % 2);
+  }
+  float in[kFrames * kLanes], out[kFrames * kLanes];
+  for (uint32_t i = 0; i < kFrames * kLanes; ++i)
+    in[i] = static_cast<float>(i % 7) - 3.0f;
+  (*WideOrErr)(in, out, lane_params, channels, kLanes, kFrames);
+
+  for (uint32_t t = 0; t < kFrames; ++t) {
+    for (uint32_t l = 0; l < kLanes; ++l) {
+      float x = in[t * kLanes + l];
+      float y = x * lane_params[l] + lane_params[kLanes + l] * (channels[l] + 1);
+      EXPECT_FLOAT_EQ(out[t * kLanes + l], std::clamp(y, -4.0f, 4.0f));
+    }
+  }
+}
+
+TEST_F(ClapJITTest, ExprSyntaxError) {
+  auto Ctx = std::make_unique<llvm::LLVMContext>();
+  auto ModOrErr = clap_rt::compileExpr("out = in * (p0 +", "bad.expr", *Ctx);
+  ASSERT_FALSE(!!ModOrErr);
+  EXPECT_NE(llvm::toString(ModOrErr.takeError()).find("1:"), std::string::npos);
+}
+
+TEST_F(ClapJITTest, ChainFusesNodes) {
+  auto JITOrErr = clap_rt::ClapJIT::create();
+  ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+  auto JIT = std::move(*JITOrErr);
+
+  // scale owns g_params[0], shape (gain.expr) owns g_params[1..2]
+  static float params[16] = {3.0f, 2.0f, 0.5f};
+  auto DefErr = JIT.defineSymbol("g_params", params);
+  ASSERT_FALSE(!!DefErr) << llvm::toString(std::move(DefErr));
+
+  auto Err = JIT.addChain("test/chain.chain");
+  ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+  auto CountOrErr = JIT.lookupAs<int()>("param_count");
+  ASSERT_TRUE(!!CountOrErr) << llvm::toString(CountOrErr.takeError());
+  EXPECT_EQ((*CountOrErr)(), 3);
+
+  auto NameOrErr = JIT.lookupAs<const char *(int)>("param_name");
+  ASSERT_TRUE(!!NameOrErr) << llvm::toString(NameOrErr.takeError());
+  EXPECT_STREQ((*NameOrErr)(0), "scale: amount");
+  EXPECT_STREQ((*NameOrErr)(1), "shape: gain");
+
+  auto ProcessOrErr = JIT.lookupAs<void(const float *const *, float *const *,
+                                        uint32_t, uint32_t)>("process");
+  ASSERT_TRUE(!!ProcessOrErr) << llvm::toString(ProcessOrErr.takeError());
+
+  // More frames than one internal block
+  constexpr int N = 300;
+  std::vector<float> in(N), out(N);
+  for (int i = 0; i < N; ++i)
+    in[i] = static_cast<float>(i % 10) * 0.05f;
+  const float *in_ptr = in.data();
+  float *out_ptr = out.data();
+  (*ProcessOrErr)(&in_ptr, &out_ptr, 1, N);
+
+  for (int i = 0; i < N; ++i)
+    EXPECT_FLOAT_EQ(out[i], std::min(in[i] * 3.0f * 2.0f + 0.5f, 4.0f));
+
+  EXPECT_EQ(JIT.sourceFiles().size(), 3u);
+}
+
+TEST_F(ClapJITTest, RuntimeHeaders) {
+  clap_rt::JITOptions opts;
+  opts.includePaths.push_back("examples/lib");
+  auto JITOrErr = clap_rt::ClapJIT::create(opts);
+  ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+  auto JIT = std::move(*JITOrErr);
+
+  auto Err = JIT.addModule("test/runtime_test.cc");
+  ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+  auto TanhOrErr = JIT.lookupAs<float(float)>("runtime_tanh");
+  ASSERT_TRUE(!!TanhOrErr) << llvm::toString(TanhOrErr.takeError());
+  EXPECT_NEAR((*TanhOrErr)(0.5f), std::tanh(0.5f), 1e-4f);
+  EXPECT_NEAR((*TanhOrErr)(100.0f), 1.0f, 1e-4f);
+  EXPECT_LE((*TanhOrErr)(100.0f), 1.0f);
+
+  auto ExpOrErr = JIT.lookupAs<float(float)>("runtime_exp");
+  ASSERT_TRUE(!!ExpOrErr) << llvm::toString(ExpOrErr.takeError());
+  EXPECT_NEAR((*ExpOrErr)(1.0f), std::exp(1.0f), 1e-5f);
+
+  auto DelayOrErr = JIT.lookupAs<float()>("runtime_delay_sum");
+  ASSERT_TRUE(!!DelayOrErr) << llvm::toString(DelayOrErr.takeError());
+  EXPECT_FLOAT_EQ((*DelayOrErr)(), 1.0f + 2.0f + 3.0f + 4.0f);
+}
+
 TEST_F(ClapJITTest, ObjectCaching) {
   // Create a temp cache directory
   auto cache_dir = std::filesystem::temp_directory_path() / "clap_jit_test_cache";
@@ -280,3 +507,431 @@ TEST_F(ClapJITTest, ObjectCaching) {
   // Clean up
   std::filesystem::remove_all(cache_dir);
 }
+
+TEST_F(ClapJITTest, ToolchainProbePersisted) {
+  auto cache_dir = std::filesystem::temp_directory_path() / "clap_jit_test_toolchain";
+  std::filesystem::remove_all(cache_dir);
+
+  clap_rt::JITOptions opts;
+  opts.cacheDir = cache_dir.string();
+
+  // Start from a fresh probe so this process writes the file
+  clap_rt::ClapJIT::resetToolchain();
+  for (int i = 0; i < 2; ++i) {
+    auto JITOrErr = clap_rt::ClapJIT::create(opts);
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+
+    auto Err = JIT.addModule("test/add.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+    auto AddOrErr = JIT.lookupAs<int(int, int)>("add");
+    ASSERT_TRUE(!!AddOrErr) << llvm::toString(AddOrErr.takeError());
+    EXPECT_EQ((*AddOrErr)(2, 3), 5);
+
+    // The second pass compiles again, reading the probe back from disk
+    for (const auto &entry : std::filesystem::directory_iterator(cache_dir)) {
+      if (!entry.path().filename().string().starts_with("toolchain-"))
+        std::filesystem::remove(entry.path());
+    }
+    clap_rt::ClapJIT::resetToolchain();
+  }
+
+  bool found = false;
+  for (const auto &entry : std::filesystem::directory_iterator(cache_dir))
+    found |= entry.path().filename().string().starts_with("toolchain-");
+  EXPECT_TRUE(found);
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST_F(ClapJITTest, BitcodeCacheSkipsLayoutEdits) {
+  auto dir = std::filesystem::temp_directory_path() / "clap_jit_test_bitcode";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto source = dir / "twice.cc";
+
+  clap_rt::JITOptions opts;
+  opts.cacheDir = (dir / "cache").string();
+
+  auto compile = [&](const char *text) -> int {
+    std::ofstream(source) << text;
+    // Newer than any object written so far, so the object cache misses
+    std::filesystem::last_write_time(
+        source, std::filesystem::file_time_type::clock::now() +
+                    std::chrono::seconds(1));
+    auto JITOrErr = clap_rt::ClapJIT::create(opts);
+    EXPECT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+    auto Err = JIT.addModule(source.string());
+    EXPECT_FALSE(!!Err) << llvm::toString(std::move(Err));
+    auto TwiceOrErr = JIT.lookupAs<int(int)>("twice");
+    EXPECT_TRUE(!!TwiceOrErr) << llvm::toString(TwiceOrErr.takeError());
+    return TwiceOrErr ? (*TwiceOrErr)(21) : -1;
+  };
+  auto bitcodeFiles = [&] {
+    auto bitcode = dir / "cache" / "bitcode";
+    if (!std::filesystem::exists(bitcode))
+      return 0;
+    return static_cast<int>(std::distance(
+        std::filesystem::directory_iterator(bitcode),
+        std::filesystem::directory_iterator()));
+  };
+
+  EXPECT_EQ(compile("int twice(int x) { return x * 2; }\n"), 42);
+  EXPECT_EQ(bitcodeFiles(), 1);
+
+  // Comments and layout don't change the key
+  EXPECT_EQ(compile("// doubles\nint twice(int x) {\n  return x * 2;\n}\n"), 42);
+  EXPECT_EQ(bitcodeFiles(), 1);
+
+  // Flags and tokens do
+  EXPECT_EQ(compile("// rtclap: -O2\nint twice(int x) { return x * 2; }\n"), 42);
+  EXPECT_EQ(bitcodeFiles(), 2);
+  EXPECT_EQ(compile("int twice(int x) { return x + x + 1; }\n"), 43);
+  EXPECT_EQ(bitcodeFiles(), 3);
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_F(ClapJITTest, PrelinkedCachedObject) {
+  auto cache_dir = std::filesystem::temp_directory_path() / "clap_jit_test_prelink";
+  std::filesystem::remove_all(cache_dir);
+
+  clap_rt::JITOptions opts;
+  opts.cacheDir = cache_dir.string();
+  opts.prelink = true;
+
+  // Compile, record the link table on the first cached load, then use it
+  for (int i = 0; i < 3; ++i) {
+    auto JITOrErr = clap_rt::ClapJIT::create(opts);
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+
+    auto Err = JIT.addModule("test/vector_test.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+    auto SumOrErr = JIT.lookupAs<int(int)>("vector_sum");
+    ASSERT_TRUE(!!SumOrErr) << llvm::toString(SumOrErr.takeError());
+    EXPECT_EQ((*SumOrErr)(10), 55);
+  }
+
+  // operator new comes from libstdc++
+  std::string table;
+  for (const auto &entry : std::filesystem::directory_iterator(cache_dir)) {
+    if (entry.path().extension() == ".link") {
+      std::ifstream in(entry.path());
+      table.assign(std::istreambuf_iterator<char>(in), {});
+    }
+  }
+  EXPECT_NE(table.find("libstdc++"), std::string::npos);
+  EXPECT_NE(table.find(" _Znwm\n"), std::string::npos);
+  EXPECT_TRUE(table.starts_with("cpu "));
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST_F(ClapJITTest, PrelinkTableFromOtherCpuRerecorded) {
+  auto cache_dir = std::filesystem::temp_directory_path() / "clap_jit_test_prelink_cpu";
+  std::filesystem::remove_all(cache_dir);
+
+  clap_rt::JITOptions opts;
+  opts.cacheDir = cache_dir.string();
+  opts.prelink = true;
+
+  auto load = [&] {
+    auto JITOrErr = clap_rt::ClapJIT::create(opts);
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+    auto Err = JIT.addModule("test/vector_test.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+    auto SumOrErr = JIT.lookupAs<int(int)>("vector_sum");
+    ASSERT_TRUE(!!SumOrErr) << llvm::toString(SumOrErr.takeError());
+    EXPECT_EQ((*SumOrErr)(10), 55);
+  };
+  auto tablePath = [&] {
+    for (const auto &entry : std::filesystem::directory_iterator(cache_dir)) {
+      if (entry.path().extension() == ".link")
+        return entry.path();
+    }
+    return std::filesystem::path();
+  };
+  auto read = [](const std::filesystem::path &path) {
+    std::ifstream in(path);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+  };
+
+  // Compile, then record the table on the first cached load
+  load();
+  load();
+  auto path = tablePath();
+  ASSERT_FALSE(path.empty());
+  std::string recorded = read(path);
+  ASSERT_TRUE(recorded.starts_with("cpu "));
+
+  // Pretend another machine sharing the cache recorded it, with an
+  // offset that would be wrong here
+  std::string foreign = "cpu pentium4+sse2\n" +
+                        recorded.substr(recorded.find('\n') + 1);
+  auto sym = foreign.find("sym ");
+  ASSERT_NE(sym, std::string::npos);
+  auto offset = foreign.find(' ', sym + 4) + 1;
+  foreign.replace(offset, foreign.find(' ', offset) - offset, "1");
+  std::ofstream(path, std::ios::trunc) << foreign;
+
+  load();
+  EXPECT_EQ(read(path), recorded);
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST_F(ClapJITTest, SlabMemoryShared) {
+  auto *Slab = clap_rt::SlabMemoryManager::get();
+  ASSERT_NE(Slab, nullptr);
+  uint64_t codeBefore = Slab->codeBytes();
+  uint64_t dataBefore = Slab->dataBytes();
+
+  clap_rt::JITOptions opts;
+  opts.slabMemory = true;
+  {
+    auto FirstOrErr = clap_rt::ClapJIT::create(opts);
+    ASSERT_TRUE(!!FirstOrErr) << llvm::toString(FirstOrErr.takeError());
+    auto First = std::move(*FirstOrErr);
+    auto SecondOrErr = clap_rt::ClapJIT::create(opts);
+    ASSERT_TRUE(!!SecondOrErr) << llvm::toString(SecondOrErr.takeError());
+    auto Second = std::move(*SecondOrErr);
+
+    auto Err = First.addModule("test/add.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+    Err = Second.addModule("test/vector_test.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+    auto AddOrErr = First.lookupAs<int(int, int)>("add");
+    ASSERT_TRUE(!!AddOrErr) << llvm::toString(AddOrErr.takeError());
+    EXPECT_EQ((*AddOrErr)(2, 3), 5);
+    auto SumOrErr = Second.lookupAs<int(int)>("vector_sum");
+    ASSERT_TRUE(!!SumOrErr) << llvm::toString(SumOrErr.takeError());
+    EXPECT_EQ((*SumOrErr)(10), 55);
+
+    // Both modules live in the slab, attributed to their own JIT
+    EXPECT_GT(Slab->codeBytes(), codeBefore);
+    EXPECT_GT(First.linkedBytes(), 0u);
+    EXPECT_GT(Second.linkedBytes(), First.linkedBytes());
+    EXPECT_GT(Slab->dataBytes(), dataBefore);
+  }
+
+  // Destroying the JITs hands their ranges back
+  EXPECT_EQ(Slab->codeBytes(), codeBefore);
+  EXPECT_EQ(Slab->dataBytes(), dataBefore);
+}
+
+// Resident set size in bytes, from /proc/self/statm
+static size_t residentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0, resident = 0;
+  statm >> pages >> resident;
+  return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+TEST_F(ClapJITTest, ReloadsKeepMemoryBounded) {
+  auto reload = [] {
+    auto JITOrErr = clap_rt::ClapJIT::create();
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+    auto Err = JIT.addModule("test/vector_test.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+    auto SumOrErr = JIT.lookupAs<int(int)>("vector_sum");
+    ASSERT_TRUE(!!SumOrErr) << llvm::toString(SumOrErr.takeError());
+    EXPECT_EQ((*SumOrErr)(10), 55);
+  };
+
+  // Warm up the toolchain probe, driver results and LLVM's own statics
+  for (int i = 0; i < 5; ++i)
+    reload();
+  clap_rt::ClapJIT::releaseMemory();
+  size_t before = residentBytes();
+
+  for (int i = 0; i < 100; ++i) {
+    reload();
+    clap_rt::ClapJIT::releaseMemory();
+  }
+
+  // Each compile allocates tens of MB; none of it may pile up
+  size_t after = residentBytes();
+  EXPECT_LT(after, before + (16u << 20))
+      << "RSS grew from " << before << " to " << after << " bytes";
+}
+
+TEST_F(ClapJITTest, MultiLevelObjectCaching) {
+  auto cache_dir = std::filesystem::temp_directory_path() / "clap_jit_test_levels";
+  std::filesystem::remove_all(cache_dir);
+
+  clap_rt::JITOptions opts;
+  opts.cacheDir = cache_dir.string();
+  opts.cacheLevels = {clap_rt::CpuLevel::Generic, clap_rt::CpuLevel::V2};
+
+  // First compile emits one object per level under the same key
+  {
+    auto JITOrErr = clap_rt::ClapJIT::create(opts);
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+
+    auto Err = JIT.addModule("test/add.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+    auto AddOrErr = JIT.lookupAs<int(int, int)>("add");
+    ASSERT_TRUE(!!AddOrErr) << llvm::toString(AddOrErr.takeError());
+    EXPECT_EQ((*AddOrErr)(1, 2), 3);
+  }
+
+  int generic = 0, v2 = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(cache_dir)) {
+    auto name = entry.path().filename().string();
+    if (name.ends_with(".generic.o"))
+      ++generic;
+    if (name.ends_with(".v2.o"))
+      ++v2;
+  }
+  EXPECT_EQ(generic, 1);
+  EXPECT_EQ(v2, 1);
+
+  // Second compile loads the best cached level
+  {
+    auto JITOrErr = clap_rt::ClapJIT::create(opts);
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+
+    auto Err = JIT.addModule("test/add.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+    auto AddOrErr = JIT.lookupAs<int(int, int)>("add");
+    ASSERT_TRUE(!!AddOrErr) << llvm::toString(AddOrErr.takeError());
+    EXPECT_EQ((*AddOrErr)(5, 7), 12);
+  }
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST_F(ClapJITTest, BundleRoundTrip) {
+  auto bundle_path =
+      std::filesystem::temp_directory_path() / "clap_jit_test_add.rtclap";
+
+  // Build a bundle with a prebuilt generic object
+  {
+    auto JITOrErr = clap_rt::ClapJIT::create();
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+
+    auto BundleOrErr =
+        JIT.buildBundle("test/add.cc", {}, {clap_rt::CpuLevel::Generic});
+    ASSERT_TRUE(!!BundleOrErr) << llvm::toString(BundleOrErr.takeError());
+    EXPECT_EQ(BundleOrErr->manifest.source, "add.cc");
+    ASSERT_EQ(BundleOrErr->objects.size(), 1u);
+
+    auto Err = clap_rt::writeBundle(*BundleOrErr, bundle_path.string());
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+  }
+
+  // Load it back - uses the prebuilt object
+  {
+    auto JITOrErr = clap_rt::ClapJIT::create();
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+
+    auto Err = JIT.addBundle(bundle_path.string());
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+    auto AddOrErr = JIT.lookupAs<int(int, int)>("add");
+    ASSERT_TRUE(!!AddOrErr) << llvm::toString(AddOrErr.takeError());
+    EXPECT_EQ((*AddOrErr)(2, 3), 5);
+  }
+
+  // Corrupt one byte - checksum must reject the bundle
+  {
+    std::fstream f(bundle_path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekg(-1, std::ios::end);
+    char last = static_cast<char>(f.get());
+    f.seekp(-1, std::ios::end);
+    f.put(static_cast<char>(~last));
+  }
+  {
+    auto JITOrErr = clap_rt::ClapJIT::create();
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+
+    auto Err = JIT.addBundle(bundle_path.string());
+    EXPECT_TRUE(!!Err);
+    llvm::consumeError(std::move(Err));
+  }
+
+  std::filesystem::remove(bundle_path);
+}
+
+TEST_F(ClapJITTest, BundleRejectsUnsafeNames) {
+  // Source names become file names on extraction
+  for (const char *name : {"../evil.cc", "/tmp/evil.cc", "..", ".", ""}) {
+    clap_rt::Bundle B;
+    B.manifest.source = "add.cc";
+    B.sources.push_back({name, "int add(int a, int b) { return a + b; }", false});
+    auto BundleOrErr = clap_rt::parseBundle(clap_rt::serializeBundle(B), name);
+    EXPECT_FALSE(!!BundleOrErr) << name;
+    if (!BundleOrErr)
+      llvm::consumeError(BundleOrErr.takeError());
+  }
+
+  clap_rt::Bundle B;
+  B.manifest.source = "add.cc";
+  B.sources.push_back({"add.cc", "int add(int a, int b) { return a + b; }", false});
+  B.objects.push_back({clap_rt::CpuLevel::Generic, "../add.cc", "ELF"});
+  auto BundleOrErr = clap_rt::parseBundle(clap_rt::serializeBundle(B), "object");
+  EXPECT_FALSE(!!BundleOrErr);
+  if (!BundleOrErr)
+    llvm::consumeError(BundleOrErr.takeError());
+}
+
+TEST_F(ClapJITTest, SnapshotBundleFromCache) {
+  auto cache_dir = std::filesystem::temp_directory_path() / "clap_jit_test_snapshot";
+  std::filesystem::remove_all(cache_dir);
+
+  clap_rt::JITOptions opts;
+  opts.cacheDir = cache_dir.string();
+
+  std::string data;
+  {
+    auto JITOrErr = clap_rt::ClapJIT::create(opts);
+    ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+    auto JIT = std::move(*JITOrErr);
+
+    // Cold cache: sources only
+    EXPECT_FALSE(JIT.hasCachedObject("test/add.cc"));
+    auto ColdOrErr = JIT.snapshotBundle("test/add.cc", {});
+    ASSERT_TRUE(!!ColdOrErr) << llvm::toString(ColdOrErr.takeError());
+    EXPECT_TRUE(ColdOrErr->objects.empty());
+    EXPECT_EQ(ColdOrErr->sources.size(), 1u);
+
+    auto Err = JIT.addModule("test/add.cc");
+    ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+    // Warm cache: the cached object comes along
+    EXPECT_TRUE(JIT.hasCachedObject("test/add.cc"));
+    auto BundleOrErr = JIT.snapshotBundle("test/add.cc", {});
+    ASSERT_TRUE(!!BundleOrErr) << llvm::toString(BundleOrErr.takeError());
+    ASSERT_EQ(BundleOrErr->objects.size(), 1u);
+    data = clap_rt::serializeBundle(*BundleOrErr);
+  }
+
+  // Load it from memory into a JIT without a cache
+  auto BundleOrErr = clap_rt::parseBundle(data, "snapshot");
+  ASSERT_TRUE(!!BundleOrErr) << llvm::toString(BundleOrErr.takeError());
+
+  auto JITOrErr = clap_rt::ClapJIT::create();
+  ASSERT_TRUE(!!JITOrErr) << llvm::toString(JITOrErr.takeError());
+  auto JIT = std::move(*JITOrErr);
+
+  auto Err = JIT.addBundle(*BundleOrErr, "snapshot");
+  ASSERT_FALSE(!!Err) << llvm::toString(std::move(Err));
+
+  auto AddOrErr = JIT.lookupAs<int(int, int)>("add");
+  ASSERT_TRUE(!!AddOrErr) << llvm::toString(AddOrErr.takeError());
+  EXPECT_EQ((*AddOrErr)(4, 5), 9);
+
+  std::filesystem::remove_all(cache_dir);
+}